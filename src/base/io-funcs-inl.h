@@ -49,6 +49,42 @@ template<class T>  void WriteBasicType(std::ostream &os,
   }
 }
 
+// Converts the sign and magnitude of an integer, as output by
+// ParseTextInteger(), to type T; returns false if it is out of range.
+template<class T>
+inline bool IntegerFromSignAndMagnitude(bool negative, uint64 magnitude,
+                                        T *t) {
+  if (magnitude == 0) {
+    *t = 0;
+  } else if (negative) {
+    if (!std::numeric_limits<T>::is_signed ||
+        magnitude - 1 > static_cast<uint64>(
+            -(static_cast<int64>(std::numeric_limits<T>::min()) + 1)))
+      return false;
+    *t = static_cast<T>(-static_cast<int64>(magnitude - 1) - 1);
+  } else {
+    if (magnitude > static_cast<uint64>(std::numeric_limits<T>::max()))
+      return false;
+    *t = static_cast<T>(magnitude);
+  }
+  return true;
+}
+
+// Template that covers integers.
+template<class T>
+inline bool ParseBasicType(const char **pos, const char *end, T *t) {
+  // Compile time assertion that this is not called with a wrong type.
+  KALDI_ASSERT_IS_INTEGER_TYPE(T);
+  const char *p = *pos;
+  bool negative;
+  uint64 magnitude;
+  if (!ParseTextInteger(&p, end, &negative, &magnitude) ||
+      !IntegerFromSignAndMagnitude(negative, magnitude, t))
+    return false;
+  *pos = p;
+  return true;
+}
+
 // Template that covers integers.
 template<class T> inline void ReadBasicType(std::istream &is,
                                             bool binary, T *t) {
@@ -73,13 +109,11 @@ template<class T> inline void ReadBasicType(std::istream &is,
     }
     is.read(reinterpret_cast<char *>(t), sizeof(*t));
   } else {
-    if (sizeof(*t) == 1) {
-      int16 i;
-      is >> i;
-      *t = i;
-    } else {
-      is >> *t;
-    }
+    bool negative;
+    uint64 magnitude;
+    if (ReadTextInteger(is, &negative, &magnitude) &&
+        !IntegerFromSignAndMagnitude(negative, magnitude, t))
+      is.setstate(std::ios_base::failbit);  // out of range.
   }
   if (is.fail()) {
     KALDI_ERR << "Read failure in ReadBasicType, file position is "
@@ -154,19 +188,16 @@ template<class T> inline void ReadIntegerVector(std::istream &is,
     is.get();  // consume the '['.
     is >> std::ws;  // consume whitespace.
     while (is.peek() != static_cast<int>(']')) {
-      if (sizeof(T) == 1) {  // read/write chars as numbers.
-        int16 next_t;
-        is >> next_t >> std::ws;
-        if (is.fail()) goto bad;
-        else
-            tmp_v.push_back((T)next_t);
-      } else {
-        T next_t;
-        is >> next_t >> std::ws;
-        if (is.fail()) goto bad;
-        else
-            tmp_v.push_back(next_t);
-      }
+      // Note: chars are read and written as numbers.
+      bool negative;
+      uint64 magnitude;
+      T next_t;
+      if (!ReadTextInteger(is, &negative, &magnitude) ||
+          !IntegerFromSignAndMagnitude(negative, magnitude, &next_t))
+        goto bad;
+      tmp_v.push_back(next_t);
+      is >> std::ws;
+      if (is.fail()) goto bad;
     }
     is.get();  // get the final ']'.
     *v = tmp_v;  // could use std::swap to use less temporary memory, but this
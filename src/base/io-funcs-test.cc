@@ -16,8 +16,10 @@
 // MERCHANTABLITY OR NON-INFRINGEMENT.
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
+#include <sstream>
 #include "base/io-funcs.h"
 #include "base/kaldi-math.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
@@ -122,7 +124,137 @@ void UnitTestIo(bool binary) {
   }
 }
 
+// Checks that ParseBasicType() and ReadBasicType() in text mode give exactly
+// the same results as the ">>" operator of the standard library.
+template<class Real>
+void UnitTestParseTextFloat() {
+  for (int32 i = 0; i < 2000; i++) {
+    std::ostringstream os;
+    Real r = RandGauss() * Exp(RandGauss() * 10.0);
+    if (i % 10 == 0) r = RandInt(-1000, 1000);
+    if (i % 10 == 1) r = RandInt(-1000, 1000) / 100.0;
+    os.precision(RandInt(1, 20));
+    if (i % 3 == 0) os << std::scientific;
+    os << r;
+    if (i % 7 == 0 && os.str().find('e') == std::string::npos)
+      os << "e" << RandInt(-20, 20);
+    std::string str = os.str();
+    Real r_ref = 0.0, r_parse = 0.0, r_read = 0.0;
+    std::istringstream ref_is(str);
+    ref_is >> r_ref;
+    KALDI_ASSERT(!ref_is.fail());
+    const char *pos = str.c_str(), *end = pos + str.size();
+    KALDI_ASSERT(ParseBasicType(&pos, end, &r_parse) && pos == end);
+    std::istringstream read_is(" " + str + " ");
+    ReadBasicType(read_is, false, &r_read);
+    // We check for bitwise equality, i.e. correct rounding.
+    KALDI_ASSERT(memcmp(&r_ref, &r_parse, sizeof(Real)) == 0 &&
+                 memcmp(&r_ref, &r_read, sizeof(Real)) == 0);
+  }
+  const char *bad[] = { "", "-", "+", ".", "-.", "e5", "abc", "1e99999" };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    Real r;
+    const char *pos = bad[i], *end = bad[i] + strlen(bad[i]);
+    KALDI_ASSERT(!ParseBasicType(&pos, end, &r) && pos == bad[i]);
+  }
+  {  // The exponent is not part of the number if it has no digits.
+    std::string str = "2.5e+x";
+    const char *pos = str.c_str(), *end = pos + str.size();
+    Real r;
+    KALDI_ASSERT(ParseBasicType(&pos, end, &r) && r == 2.5 &&
+                 pos == str.c_str() + 3);
+  }
+}
+
+void UnitTestParseTextInteger() {
+  for (int32 i = 0; i < 2000; i++) {
+    int32 n = RandInt(-1000000, 1000000) * RandInt(1, 1000);
+    std::ostringstream os;
+    os << n;
+    std::string str = os.str();
+    int32 n_parse;
+    const char *pos = str.c_str(), *end = pos + str.size();
+    KALDI_ASSERT(ParseBasicType(&pos, end, &n_parse) && pos == end &&
+                 n_parse == n);
+    std::istringstream is(str);
+    int32 n_read;
+    ReadBasicType(is, false, &n_read);
+    KALDI_ASSERT(n_read == n);
+  }
+  const char *bad[] = { "", "-", "+x", "2147483648", "-2147483649",
+                        "99999999999999999999999" };
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    int32 n;
+    const char *pos = bad[i], *end = bad[i] + strlen(bad[i]);
+    KALDI_ASSERT(!ParseBasicType(&pos, end, &n) && pos == bad[i]);
+  }
+  {
+    const char *str = "-2147483648 255 -1 +7";
+    const char *pos = str, *end = str + strlen(str);
+    int32 a; unsigned char b; signed char c; uint16 d;
+    KALDI_ASSERT(ParseBasicType(&pos, end, &a) && a == -2147483647 - 1);
+    pos++;
+    KALDI_ASSERT(ParseBasicType(&pos, end, &b) && b == 255);
+    pos++;
+    KALDI_ASSERT(ParseBasicType(&pos, end, &c) && c == -1);
+    pos++;
+    KALDI_ASSERT(ParseBasicType(&pos, end, &d) && d == 7 && pos == end);
+    unsigned char e;
+    const char *str2 = "256", *pos2 = str2;
+    KALDI_ASSERT(!ParseBasicType(&pos2, str2 + 3, &e));
+  }
+  {  // As with ">>", reading stops at the first character that cannot be part
+     // of the number.
+    std::istringstream is("12abc");
+    bool negative;
+    uint64 magnitude;
+    KALDI_ASSERT(ReadTextInteger(is, &negative, &magnitude) &&
+                 magnitude == 12 && is.peek() == 'a');
+    std::istringstream is1("abc");
+    KALDI_ASSERT(!ReadTextInteger(is1, &negative, &magnitude) && is1.fail());
+    std::istringstream is2(" \n 12 ");
+    KALDI_ASSERT(ReadTextInteger(is2, &negative, &magnitude) &&
+                 !negative && magnitude == 12 && !is2.eof());
+    std::istringstream is3("-12");
+    KALDI_ASSERT(ReadTextInteger(is3, &negative, &magnitude) &&
+                 negative && magnitude == 12 && is3.eof() && !is3.fail());
+  }
+}
 
+// Compares the speed of reading numbers in text mode with ">>" and with
+// ReadBasicType(), which uses the parsing functions above.
+void UnitTestReadTextSpeed() {
+  std::ostringstream os;
+  int32 num_floats = 200000;
+  for (int32 i = 0; i < num_floats; i++)
+    os << RandGauss() * 10.0 << ' ';
+  std::string str = os.str();
+  float sum_ref = 0.0, sum_new = 0.0;
+  Timer timer;
+  {
+    std::istringstream is(str);
+    for (int32 i = 0; i < num_floats; i++) {
+      float f;
+      is >> f;
+      sum_ref += f;
+    }
+  }
+  double time_ref = timer.Elapsed();
+  timer.Reset();
+  {
+    std::istringstream is(str);
+    for (int32 i = 0; i < num_floats; i++) {
+      float f;
+      ReadBasicType(is, false, &f);
+      sum_new += f;
+    }
+  }
+  double time_new = timer.Elapsed();
+  KALDI_ASSERT(sum_ref == sum_new);
+  KALDI_LOG << "Reading " << num_floats << " floats in text mode took "
+            << time_ref << " seconds with >>, " << time_new
+            << " seconds with ReadBasicType().";
+}
 
 }  // end namespace kaldi.
 
@@ -132,6 +264,10 @@ int main() {
     UnitTestIo(false);
     UnitTestIo(true);
   }
+  UnitTestParseTextFloat<float>();
+  UnitTestParseTextFloat<double>();
+  UnitTestParseTextInteger();
+  UnitTestReadTextSpeed();
   KALDI_ASSERT(1);  // just wanted to check that KALDI_ASSERT does not fail for 1.
   return 0;
 }
@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cerrno>
+#include <cstdlib>
 #include "base/io-funcs.h"
 #include "base/kaldi-math.h"
 
@@ -86,7 +88,7 @@ void ReadBasicType<float>(std::istream &is, bool binary, float *f) {
                 << ", at file position " << is.tellg();
     }
   } else {
-    is >> *f;
+    ReadTextFloat(is, f);
   }
   if (is.fail()) {
     KALDI_ERR << "ReadBasicType: failed to read, at file position "
@@ -111,7 +113,7 @@ void ReadBasicType<double>(std::istream &is, bool binary, double *d) {
                 << ", at file position " << is.tellg();
     }
   } else {
-    is >> *d;
+    ReadTextFloat(is, d);
   }
   if (is.fail()) {
     KALDI_ERR << "ReadBasicType: failed to read, at file position "
@@ -119,6 +121,230 @@ void ReadBasicType<double>(std::istream &is, bool binary, double *d) {
   }
 }
 
+static inline bool IsDigit(char c) { return (c >= '0' && c <= '9'); }
+
+bool ParseTextInteger(const char **pos, const char *end,
+                      bool *negative, uint64 *magnitude) {
+  const char *p = *pos;
+  *negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    *negative = (*p == '-');
+    p++;
+  }
+  if (p == end || !IsDigit(*p)) return false;
+  uint64 ans = 0;
+  const uint64 limit = std::numeric_limits<uint64>::max() / 10;
+  for (; p < end && IsDigit(*p); p++) {
+    uint64 digit = *p - '0';
+    if (ans > limit || ans * 10 > std::numeric_limits<uint64>::max() - digit)
+      return false;  // overflow.
+    ans = ans * 10 + digit;
+  }
+  *magnitude = ans;
+  *pos = p;
+  return true;
+}
+
+template<>
+bool ParseBasicType<bool>(const char **pos, const char *end, bool *b) {
+  if (*pos == end || (**pos != 'T' && **pos != 'F')) return false;
+  *b = (**pos == 'T');
+  (*pos)++;
+  return true;
+}
+
+// The parsed form of a decimal floating-point number: the value is
+// (negative ? -1 : 1) * mantissa * 10^exponent, exactly if "exact" is true.
+struct DecimalNumber {
+  bool negative;
+  uint64 mantissa;
+  int32 exponent;
+  bool exact;  // false if there were more significant digits than fit in
+               // "mantissa".
+};
+
+// Parses a decimal floating-point number (sign, digits with an optional
+// decimal point, optional exponent) at *pos; on success advances *pos and
+// returns true.
+static bool ParseDecimalNumber(const char **pos, const char *end,
+                               DecimalNumber *num) {
+  const char *p = *pos;
+  num->negative = false;
+  num->mantissa = 0;
+  num->exponent = 0;
+  num->exact = true;
+  if (p < end && (*p == '-' || *p == '+')) {
+    num->negative = (*p == '-');
+    p++;
+  }
+  bool any_digits = false;
+  int32 num_significant = 0;  // digits in mantissa, after leading zeros.
+  for (int32 part = 0; part < 2; part++) {  // before and after the '.'.
+    for (; p < end && IsDigit(*p); p++) {
+      any_digits = true;
+      int32 digit = *p - '0';
+      if (num_significant < 19) {
+        num->mantissa = num->mantissa * 10 + digit;
+        if (num->mantissa != 0) num_significant++;
+        if (part == 1) num->exponent--;
+      } else {
+        if (part == 0) num->exponent++;
+        if (digit != 0) num->exact = false;
+      }
+    }
+    if (part == 0) {
+      if (p < end && *p == '.') p++;
+      else break;
+    }
+  }
+  if (!any_digits) return false;
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    // The exponent is part of the number only if it has digits (as strtod).
+    const char *q = p + 1;
+    bool exponent_negative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      exponent_negative = (*q == '-');
+      q++;
+    }
+    if (q < end && IsDigit(*q)) {
+      int32 exponent = 0;
+      for (; q < end && IsDigit(*q); q++)
+        if (exponent < 100000)  // Avoid overflow; anything bigger is inf or 0.
+          exponent = exponent * 10 + (*q - '0');
+      num->exponent += (exponent_negative ? -exponent : exponent);
+      p = q;
+    }
+  }
+  *pos = p;
+  return true;
+}
+
+// Converts the text between begin and end, which is known to be a valid
+// number, with strtod or strtof.  Returns false on overflow (as ">>" does).
+template<class Real>
+static bool ConvertTextWithStrtod(const char *begin, const char *end,
+                                  Real *r) {
+  std::string str(begin, end);
+  errno = 0;
+  if (sizeof(Real) == sizeof(float))
+    *r = strtof(str.c_str(), NULL);
+  else
+    *r = strtod(str.c_str(), NULL);
+  return !(errno == ERANGE && (*r > 1.0 || *r < -1.0));
+}
+
+// Powers of ten that are exactly representable as double; the first 11 are
+// also exactly representable as float.
+static const double kExactPowersOfTen[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13,
+  1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+template<>
+bool ParseBasicType<float>(const char **pos, const char *end, float *f) {
+  const char *p = *pos;
+  DecimalNumber num;
+  if (!ParseDecimalNumber(&p, end, &num)) return false;
+  // If the mantissa and the power of ten are exactly representable as float,
+  // one multiplication or division gives the correctly rounded result.
+  if (num.exact && num.mantissa <= (static_cast<uint64>(1) << 24) &&
+      num.exponent >= -10 && num.exponent <= 10) {
+    float ans = static_cast<float>(num.mantissa);
+    if (num.exponent < 0)
+      ans /= static_cast<float>(kExactPowersOfTen[-num.exponent]);
+    else
+      ans *= static_cast<float>(kExactPowersOfTen[num.exponent]);
+    *f = (num.negative ? -ans : ans);
+  } else if (!ConvertTextWithStrtod(*pos, p, f)) {
+    return false;
+  }
+  *pos = p;
+  return true;
+}
+
+template<>
+bool ParseBasicType<double>(const char **pos, const char *end, double *d) {
+  const char *p = *pos;
+  DecimalNumber num;
+  if (!ParseDecimalNumber(&p, end, &num)) return false;
+  // As for float.
+  if (num.exact && num.mantissa <= (static_cast<uint64>(1) << 53) &&
+      num.exponent >= -22 && num.exponent <= 22) {
+    double ans = static_cast<double>(num.mantissa);
+    if (num.exponent < 0)
+      ans /= kExactPowersOfTen[-num.exponent];
+    else
+      ans *= kExactPowersOfTen[num.exponent];
+    *d = (num.negative ? -ans : ans);
+  } else if (!ConvertTextWithStrtod(*pos, p, d)) {
+    return false;
+  }
+  *pos = p;
+  return true;
+}
+
+// Skips whitespace and then reads the characters that may form a number into
+// "buf" (which has space for "size" characters), taking them straight from the
+// stream buffer; returns the number of characters read.  A number longer than
+// size - 1 characters will fail to parse.  Sets the stream state as ">>"
+// would.
+static size_t ReadNumberToken(std::istream &is, bool floating,
+                              char *buf, size_t size) {
+  if (!is.good()) {
+    is.setstate(std::ios_base::failbit);
+    return 0;
+  }
+  std::streambuf *sb = is.rdbuf();
+  int c = sb->sgetc();
+  while (c != EOF && ::isspace(c)) c = sb->snextc();
+  size_t n = 0;
+  for (; c != EOF && n + 1 < size; c = sb->snextc()) {
+    char ch = static_cast<char>(c);
+    if (!(IsDigit(ch) ||
+          ((ch == '-' || ch == '+') &&
+           (n == 0 || (floating && (buf[n-1] == 'e' || buf[n-1] == 'E')))) ||
+          (floating && (ch == '.' || ch == 'e' || ch == 'E'))))
+      break;
+    buf[n++] = ch;
+  }
+  if (c == EOF) is.setstate(std::ios_base::eofbit);
+  buf[n] = '\0';
+  return n;
+}
+
+bool ReadTextInteger(std::istream &is, bool *negative, uint64 *magnitude) {
+  char buf[64];
+  size_t n = ReadNumberToken(is, false, buf, sizeof(buf));
+  const char *p = buf;
+  if (n == 0 || !ParseTextInteger(&p, buf + n, negative, magnitude) ||
+      p != buf + n) {
+    is.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
+bool ReadTextFloat(std::istream &is, float *f) {
+  char buf[128];
+  size_t n = ReadNumberToken(is, true, buf, sizeof(buf));
+  const char *p = buf;
+  if (n == 0 || !ParseBasicType(&p, buf + n, f) || p != buf + n) {
+    is.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
+bool ReadTextFloat(std::istream &is, double *d) {
+  char buf[128];
+  size_t n = ReadNumberToken(is, true, buf, sizeof(buf));
+  const char *p = buf;
+  if (n == 0 || !ParseBasicType(&p, buf + n, d) || p != buf + n) {
+    is.setstate(std::ios_base::failbit);
+    return false;
+  }
+  return true;
+}
+
 void CheckToken(const char *token) {
   KALDI_ASSERT(*token != '\0');  // check it's nonempty.
   while (*token != '\0') {
@@ -174,6 +174,43 @@ inline void ReadBasicType(std::istream &is, bool binary, T *t, bool add) {
   }
 }
 
+/// ParseBasicType parses a value in the text format written by WriteBasicType
+/// directly from a buffer.  It is several times faster than extraction with
+/// ">>" (which ReadBasicType used to use in text mode), as it avoids the locale
+/// machinery of iostreams.  It parses the number starting exactly at *pos (it
+/// does not skip whitespace) and not extending past "end"; if successful it
+/// sets *t, advances *pos past the number and returns true, and otherwise it
+/// returns false and does not change *pos.  Integers are an optional sign and
+/// decimal digits, and must be in the range of T; floating-point numbers are
+/// as accepted by strtod() in the "C" locale, except for hexadecimal, "inf"
+/// and "nan" (which ">>" does not accept either); bools are "T" or "F".
+template<class T>
+inline bool ParseBasicType(const char **pos, const char *end, T *t);
+
+template<>
+bool ParseBasicType<bool>(const char **pos, const char *end, bool *b);
+
+template<>
+bool ParseBasicType<float>(const char **pos, const char *end, float *f);
+
+template<>
+bool ParseBasicType<double>(const char **pos, const char *end, double *d);
+
+/// Parses the sign and magnitude of an integer, for ParseBasicType; returns
+/// false if there is no integer at *pos, or its magnitude does not fit in a
+/// uint64.
+bool ParseTextInteger(const char **pos, const char *end,
+                      bool *negative, uint64 *magnitude);
+
+/// These read a number in text mode from a stream, skipping any leading
+/// whitespace, like ">>" but using the parsing code of ParseBasicType (the
+/// characters are taken straight from the stream buffer).  On failure they set
+/// the failbit of the stream and return false.  They are used by ReadBasicType
+/// in text mode.
+bool ReadTextInteger(std::istream &is, bool *negative, uint64 *magnitude);
+bool ReadTextFloat(std::istream &is, float *f);
+bool ReadTextFloat(std::istream &is, double *d);
+
 /// Function for writing STL vectors of integer types.
 template<class T> inline void WriteIntegerVector(std::ostream &os, bool binary,
                                                  const std::vector<T> &v);
@@ -19,6 +19,7 @@
 
 #include "decoder/decoder-wrappers.h"
 #include "decoder/faster-decoder.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
 
 namespace kaldi {
 
@@ -26,8 +27,9 @@ namespace kaldi {
 
 
 
-DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
-    LatticeFasterDecoder *decoder,
+template <typename Decoder>
+DecodeUtteranceLatticeFasterClassTpl<Decoder>::DecodeUtteranceLatticeFasterClassTpl(
+    Decoder *decoder,
     DecodableInterface *decodable,
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -58,7 +60,8 @@ DecodeUtteranceLatticeFasterClass::DecodeUtteranceLatticeFasterClass(
     clat_(NULL), lat_(NULL) { }
 
 
-void DecodeUtteranceLatticeFasterClass::operator () () {
+template <typename Decoder>
+void DecodeUtteranceLatticeFasterClassTpl<Decoder>::operator () () {
   // Decoding and lattice determinization happens here.
   computed_ = true; // Just means this function was called-- a check on the
   // calling code.
@@ -80,76 +83,76 @@ void DecodeUtteranceLatticeFasterClass::operator () () {
       success_ = false;
     }
   }
-  if (!success_) return;
+  if (success_) {
+    { // First get the word-level traceback.
+      VectorFst<LatticeArc> decoded;
+      decoder_->GetBestPath(&decoded);
+      if (decoded.NumStates() == 0) {
+        // Shouldn't really reach this point as already checked success.
+        KALDI_ERR << "Failed to get traceback for utterance " << utt_;
+      }
+      GetLinearSymbolSequence(decoded, &alignment_, &words_, &weight_);
+    }
 
-  // Get lattice, and do determinization if requested.
-  lat_ = new Lattice;
-  decoder_->GetRawLattice(lat_);
-  if (lat_->NumStates() == 0)
-    KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt_;
-  fst::Connect(lat_);
-  if (determinize_) {
-    clat_ = new CompactLattice;
-    if (!DeterminizeLatticePhonePrunedWrapper(
-            *trans_model_,
-            lat_,
-            decoder_->GetOptions().lattice_beam,
-            clat_,
-            decoder_->GetOptions().det_opts))
-      KALDI_WARN << "Determinization finished earlier than the beam for "
-                 << "utterance " << utt_;
-    delete lat_;
-    lat_ = NULL;
-    // We'll write the lattice without acoustic scaling.
-    if (acoustic_scale_ != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), clat_);
-  } else {
-    // We'll write the lattice without acoustic scaling.
-    if (acoustic_scale_ != 0.0)
-      fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), lat_);
+    // Get lattice, and do determinization if requested.
+    lat_ = new Lattice;
+    decoder_->GetRawLattice(lat_);
+    if (lat_->NumStates() == 0)
+      KALDI_ERR << "Unexpected problem getting lattice for utterance " << utt_;
+    fst::Connect(lat_);
+    if (determinize_) {
+      clat_ = new CompactLattice;
+      if (!DeterminizeLatticePhonePrunedWrapper(
+              *trans_model_,
+              lat_,
+              decoder_->GetOptions().lattice_beam,
+              clat_,
+              decoder_->GetOptions().det_opts))
+        KALDI_WARN << "Determinization finished earlier than the beam for "
+                   << "utterance " << utt_;
+      delete lat_;
+      lat_ = NULL;
+      // We'll write the lattice without acoustic scaling.
+      if (acoustic_scale_ != 0.0)
+        fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), clat_);
+    } else {
+      // We'll write the lattice without acoustic scaling.
+      if (acoustic_scale_ != 0.0)
+        fst::ScaleLattice(fst::AcousticLatticeScale(1.0 / acoustic_scale_), lat_);
+    }
   }
+  // We were given ownership of these two objects that were passed in in the
+  // initializer.  We are done with them, so we delete them now rather than in
+  // the destructor, which may be called much later.
+  delete decoder_;
+  decoder_ = NULL;
+  delete decodable_;
+  decodable_ = NULL;
 }
 
-DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
+template <typename Decoder>
+DecodeUtteranceLatticeFasterClassTpl<Decoder>::~DecodeUtteranceLatticeFasterClassTpl() {
   if (!computed_)
     KALDI_ERR << "Destructor called without operator (), error in calling code.";
 
   if (!success_) {
     if (num_err_ != NULL) (*num_err_)++;
   } else { // successful decode.
-    // Getting the one-best output is lightweight enough that we can do it in
-    // the destructor (easier than adding more variables to the class, and
-    // will rarely slow down the main thread.)
-    double likelihood;
-    LatticeWeight weight;
-    int32 num_frames;
-    { // First do some stuff with word-level traceback...
-      // This is basically for diagnostics.
-      fst::VectorFst<LatticeArc> decoded;
-      decoder_->GetBestPath(&decoded);
-      if (decoded.NumStates() == 0) {
-        // Shouldn't really reach this point as already checked success.
-        KALDI_ERR << "Failed to get traceback for utterance " << utt_;
-      }
-      std::vector<int32> alignment;
-      std::vector<int32> words;
-      GetLinearSymbolSequence(decoded, &alignment, &words, &weight);
-      num_frames = alignment.size();
-      if (words_writer_->IsOpen())
-        words_writer_->Write(utt_, words);
-      if (alignments_writer_->IsOpen())
-        alignments_writer_->Write(utt_, alignment);
-      if (word_syms_ != NULL) {
-        std::cerr << utt_ << ' ';
-        for (size_t i = 0; i < words.size(); i++) {
-          std::string s = word_syms_->Find(words[i]);
-          if (s == "")
-            KALDI_ERR << "Word-id " << words[i] << " not in symbol table.";
-          std::cerr << s << ' ';
-        }
-        std::cerr << '\n';
+    int32 num_frames = alignment_.size();
+    double likelihood = -(weight_.Value1() + weight_.Value2());
+    if (words_writer_->IsOpen())
+      words_writer_->Write(utt_, words_);
+    if (alignments_writer_->IsOpen())
+      alignments_writer_->Write(utt_, alignment_);
+    if (word_syms_ != NULL) {
+      std::cerr << utt_ << ' ';
+      for (size_t i = 0; i < words_.size(); i++) {
+        std::string s = word_syms_->Find(words_[i]);
+        if (s == "")
+          KALDI_ERR << "Word-id " << words_[i] << " not in symbol table.";
+        std::cerr << s << ' ';
       }
-      likelihood = -(weight.Value1() + weight.Value2());
+      std::cerr << '\n';
     }
 
     // Ouptut the lattices.
@@ -178,7 +181,7 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
               << (likelihood / num_frames) << " over "
               << num_frames << " frames.";
     KALDI_VLOG(2) << "Cost for utterance " << utt_ << " is "
-                  << weight.Value1() << " + " << weight.Value2();
+                  << weight_.Value1() << " + " << weight_.Value2();
 
     // Now output the various diagnostic variables.
     if (like_sum_ != NULL) *like_sum_ += likelihood;
@@ -186,16 +189,20 @@ DecodeUtteranceLatticeFasterClass::~DecodeUtteranceLatticeFasterClass() {
     if (num_done_ != NULL) (*num_done_)++;
     if (partial_ && num_partial_ != NULL) (*num_partial_)++;
   }
-  // We were given ownership of these two objects that were passed in in
-  // the initializer.
+  // These are normally deleted already by operator ().
   delete decoder_;
   delete decodable_;
 }
 
+// Instantiate the class above for the decoders it is used with.
+template class DecodeUtteranceLatticeFasterClassTpl<LatticeFasterDecoder>;
+template class DecodeUtteranceLatticeFasterClassTpl<LatticeBiglmFasterDecoder>;
+
 
 // Takes care of output.  Returns true on success.
+template <typename FST, template <class, class> class HashListType>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    LatticeFasterDecoderTpl<FST, HashListType> &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -291,6 +298,36 @@ bool DecodeUtteranceLatticeFaster(
   return true;
 }
 
+// Instantiate the template above for the same types as
+// LatticeFasterDecoderTpl.
+#define KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(FST, HASH)    \
+template bool DecodeUtteranceLatticeFaster(                             \
+    LatticeFasterDecoderTpl<FST, HASH> &decoder,                        \
+    DecodableInterface &decodable,                                      \
+    const TransitionModel &trans_model, const fst::SymbolTable *word_syms, \
+    std::string utt, double acoustic_scale, bool determinize,           \
+    bool allow_partial, Int32VectorWriter *alignment_writer,            \
+    Int32VectorWriter *words_writer,                                    \
+    CompactLatticeWriter *compact_lattice_writer,                       \
+    LatticeWriter *lattice_writer, double *like_ptr);
+
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::Fst<fst::StdArc>,
+                                                  HashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::VectorFst<fst::StdArc>,
+                                                  HashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::ConstFst<fst::StdArc>,
+                                                  HashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::MappedFst, HashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::Fst<fst::StdArc>,
+                                                  OpenHashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::VectorFst<fst::StdArc>,
+                                                  OpenHashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::ConstFst<fst::StdArc>,
+                                                  OpenHashList)
+KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER(fst::MappedFst, OpenHashList)
+
+#undef KALDI_INSTANTIATE_DECODE_UTTERANCE_LATTICE_FASTER
+
 // Takes care of output.  Returns true on success.
 bool DecodeUtteranceLatticeSimple(
     LatticeSimpleDecoder &decoder, // not const but is really an input.
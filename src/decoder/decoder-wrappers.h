@@ -94,8 +94,11 @@ void ModifyGraphForCarefulAlignment(
 /// other obvious place to put it.  If determinize == false, it writes to
 /// lattice_writer, else to compact_lattice_writer.  The writers for
 /// alignments and words will only be written to if they are open.
+/// It is instantiated for the same FST and token-container types as
+/// LatticeFasterDecoderTpl.
+template <typename FST, template <class, class> class HashListType>
 bool DecodeUtteranceLatticeFaster(
-    LatticeFasterDecoder &decoder, // not const but is really an input.
+    LatticeFasterDecoderTpl<FST, HashListType> &decoder, // not const but is really an input.
     DecodableInterface &decodable, // not const but is really an input.
     const TransitionModel &trans_model,
     const fst::SymbolTable *word_syms,
@@ -114,14 +117,18 @@ bool DecodeUtteranceLatticeFaster(
 /// to build a multi-threaded command line program more easily,
 /// using code in ../thread/kaldi-task-sequence.h.  The main
 /// computation takes place in operator (), and the output happens
-/// in the destructor.
-class DecodeUtteranceLatticeFasterClass {
+/// in the destructor.  The template argument is the type of the decoder;
+/// see the typedefs DecodeUtteranceLatticeFasterClass and
+/// DecodeUtteranceLatticeBiglmFasterClass below.
+template <typename Decoder>
+class DecodeUtteranceLatticeFasterClassTpl {
  public:
   // Initializer sets various variables.
-  // NOTE: we "take ownership" of "decoder" and "decodable".  These
-  // are deleted by the destructor.  On error, "num_err" is incremented.
-  DecodeUtteranceLatticeFasterClass(
-      LatticeFasterDecoder *decoder,
+  // NOTE: we "take ownership" of "decoder" and "decodable".  These are deleted
+  // at the end of operator (), so that tasks waiting to output their results
+  // do not hold on to them.  On error, "num_err" is incremented.
+  DecodeUtteranceLatticeFasterClassTpl(
+      Decoder *decoder,
       DecodableInterface *decodable,
       const TransitionModel &trans_model,
       const fst::SymbolTable *word_syms,
@@ -139,10 +146,10 @@ class DecodeUtteranceLatticeFasterClass {
       int32 *num_err,  // on failure, increments this.
       int32 *num_partial);  // If partial decode (final-state not reached), increments this.
   void operator () (); // The decoding happens here.
-  ~DecodeUtteranceLatticeFasterClass(); // Output happens here.
+  ~DecodeUtteranceLatticeFasterClassTpl(); // Output happens here.
  private:
   // The following variables correspond to inputs:
-  LatticeFasterDecoder *decoder_;
+  Decoder *decoder_;
   DecodableInterface *decodable_;
   const TransitionModel *trans_model_;
   const fst::SymbolTable *word_syms_;
@@ -164,10 +171,22 @@ class DecodeUtteranceLatticeFasterClass {
   bool computed_; // operator ()  was called.
   bool success_; // decoding succeeded (possibly partial)
   bool partial_; // decoding was partial.
+  std::vector<int32> alignment_; // alignment of the best path.
+  std::vector<int32> words_; // words on the best path.
+  LatticeWeight weight_; // weight of the best path.
   CompactLattice *clat_; // Stored output, if determinize_ == true.
   Lattice *lat_; // Stored output, if determinize_ == false.
 };
 
+typedef DecodeUtteranceLatticeFasterClassTpl<LatticeFasterDecoder>
+    DecodeUtteranceLatticeFasterClass;
+
+class LatticeBiglmFasterDecoder;
+/// This is for multi-threaded decoding with LatticeBiglmFasterDecoder, as in
+/// gmm-latgen-biglm-faster-parallel.
+typedef DecodeUtteranceLatticeFasterClassTpl<LatticeBiglmFasterDecoder>
+    DecodeUtteranceLatticeBiglmFasterClass;
+
 // This function DecodeUtteranceLatticeSimple is used in several decoders, and
 // we have moved it here.  Note: this is really "binary-level" code as it
 // involves table readers and writers; we've just put it here as there is no
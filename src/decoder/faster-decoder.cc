@@ -23,8 +23,9 @@
 namespace kaldi {
 
 
-FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                             const FasterDecoderOptions &opts):
+template <template <class, class> class HashListType>
+FasterDecoderTpl<HashListType>::FasterDecoderTpl(
+    const fst::Fst<fst::StdArc> &fst, const FasterDecoderOptions &opts):
     fst_(fst), config_(opts), num_frames_decoded_(-1) {
   KALDI_ASSERT(config_.hash_ratio >= 1.0);  // less doesn't make much sense.
   KALDI_ASSERT(config_.max_active > 1);
@@ -33,7 +34,8 @@ FasterDecoder::FasterDecoder(const fst::Fst<fst::StdArc> &fst,
 }
 
 
-void FasterDecoder::InitDecoding() {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::InitDecoding() {
   // clean up from last time:
   ClearToks(toks_.Clear());
   StateId start_state = fst_.Start();
@@ -45,7 +47,8 @@ void FasterDecoder::InitDecoding() {
 }
 
 
-void FasterDecoder::Decode(DecodableInterface *decodable) {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::Decode(DecodableInterface *decodable) {
   InitDecoding();
   while (!decodable->IsLastFrame(num_frames_decoded_ - 1)) {
     double weight_cutoff = ProcessEmitting(decodable);
@@ -53,8 +56,9 @@ void FasterDecoder::Decode(DecodableInterface *decodable) {
   }
 }
 
-void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                      int32 max_num_frames) {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::AdvanceDecoding(
+    DecodableInterface *decodable, int32 max_num_frames) {
   KALDI_ASSERT(num_frames_decoded_ >= 0 &&
                "You must call InitDecoding() before AdvanceDecoding()");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -75,7 +79,8 @@ void FasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
 }
 
 
-bool FasterDecoder::ReachedFinal() {
+template <template <class, class> class HashListType>
+bool FasterDecoderTpl<HashListType>::ReachedFinal() {
   for (const Elem *e = toks_.GetList(); e != NULL; e = e->tail) {
     if (e->val->cost_ != std::numeric_limits<double>::infinity() &&
         fst_.Final(e->key) != Weight::Zero())
@@ -84,8 +89,9 @@ bool FasterDecoder::ReachedFinal() {
   return false;
 }
 
-bool FasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *fst_out,
-                                bool use_final_probs) {
+template <template <class, class> class HashListType>
+bool FasterDecoderTpl<HashListType>::GetBestPath(
+    fst::MutableFst<LatticeArc> *fst_out, bool use_final_probs) {
   // GetBestPath gets the decoding output.  If "use_final_probs" is true
   // AND we reached a final state, it limits itself to final states;
   // otherwise it gets the most likely token not taking into
@@ -148,8 +154,11 @@ bool FasterDecoder::GetBestPath(fst::MutableFst<LatticeArc> *fst_out,
 
 
 // Gets the weight cutoff.  Also counts the active tokens.
-double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                BaseFloat *adaptive_beam, Elem **best_elem) {
+template <template <class, class> class HashListType>
+double FasterDecoderTpl<HashListType>::GetCutoff(Elem *list_head,
+                                                 size_t *tok_count,
+                                                 BaseFloat *adaptive_beam,
+                                                 Elem **best_elem) {
   double best_cost = std::numeric_limits<double>::infinity();
   size_t count = 0;
   if (config_.max_active == std::numeric_limits<int32>::max() &&
@@ -212,7 +221,8 @@ double FasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
   }
 }
 
-void FasterDecoder::PossiblyResizeHash(size_t num_toks) {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -221,7 +231,9 @@ void FasterDecoder::PossiblyResizeHash(size_t num_toks) {
 }
 
 // ProcessEmitting returns the likelihood cutoff used.
-double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+template <template <class, class> class HashListType>
+double FasterDecoderTpl<HashListType>::ProcessEmitting(
+    DecodableInterface *decodable) {
   int32 frame = num_frames_decoded_;
   Elem *last_toks = toks_.Clear();
   size_t tok_cnt;
@@ -303,7 +315,8 @@ double FasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
 }
 
 // TODO: first time we go through this, could avoid using the queue.
-void FasterDecoder::ProcessNonemitting(double cutoff) {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::ProcessNonemitting(double cutoff) {
   // Processes nonemitting arcs for one frame. 
   KALDI_ASSERT(queue_.empty());
   for (const Elem *e = toks_.GetList(); e != NULL;  e = e->tail)
@@ -345,7 +358,8 @@ void FasterDecoder::ProcessNonemitting(double cutoff) {
   }
 }
 
-void FasterDecoder::ClearToks(Elem *list) {
+template <template <class, class> class HashListType>
+void FasterDecoderTpl<HashListType>::ClearToks(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     Token::TokenDelete(e->val);
     e_tail = e->tail;
@@ -353,4 +367,9 @@ void FasterDecoder::ClearToks(Elem *list) {
   }
 }
 
+// Instantiate the template for the two types of token container; see
+// open-hash-list.h.
+template class FasterDecoderTpl<HashList>;
+template class FasterDecoderTpl<OpenHashList>;
+
 } // end namespace kaldi.
@@ -24,6 +24,7 @@
 #include "util/stl-utils.h"
 #include "itf/options-itf.h"
 #include "util/hash-list.h"
+#include "util/open-hash-list.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "lat/kaldi-lattice.h" // for CompactLatticeArc
@@ -58,19 +59,25 @@ struct FasterDecoderOptions {
   }
 };
 
-class FasterDecoder {
+/** The template argument HashListType is the container for the tokens on the
+    current frame (toks_): HashList or OpenHashList, which have the same
+    interface; see open-hash-list.h.  Both are instantiated in the .cc file.
+    Most code uses FasterDecoder (below), which is the version with HashList.
+ */
+template <template <class, class> class HashListType>
+class FasterDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
 
-  FasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                const FasterDecoderOptions &config);
+  FasterDecoderTpl(const fst::Fst<fst::StdArc> &fst,
+                   const FasterDecoderOptions &config);
 
   void SetOptions(const FasterDecoderOptions &config) { config_ = config; }
   
-  ~FasterDecoder() { ClearToks(toks_.Clear()); }
+  ~FasterDecoderTpl() { ClearToks(toks_.Clear()); }
 
   void Decode(DecodableInterface *decodable);
 
@@ -146,7 +153,8 @@ class FasterDecoder {
 #endif
     }
   };
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef HashListType<StateId, Token*> TokenHash;
+  typedef typename TokenHash::Elem Elem;
 
 
   /// Gets the weight cutoff.  Also counts the active tokens.
@@ -163,10 +171,11 @@ class FasterDecoder {
   // TODO: first time we go through this, could avoid using the queue.
   void ProcessNonemitting(double cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.
-  HashList<StateId, Token*> toks_;
+  // HashList defined in ../util/hash-list.h (or OpenHashList, see above).  It
+  // actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by
+  // StateId.
+  TokenHash toks_;
   const fst::Fst<fst::StdArc> &fst_;
   FasterDecoderOptions config_;
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
@@ -184,7 +193,15 @@ class FasterDecoder {
   // this way for convenience in propagating tokens from one frame to the next.
   void ClearToks(Elem *list);
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(FasterDecoder);
+  KALDI_DISALLOW_COPY_AND_ASSIGN(FasterDecoderTpl);
+};
+
+
+class FasterDecoder: public FasterDecoderTpl<HashList> {
+ public:
+  FasterDecoder(const fst::Fst<fst::StdArc> &fst,
+                const FasterDecoderOptions &config):
+      FasterDecoderTpl<HashList>(fst, config) { }
 };
 
 
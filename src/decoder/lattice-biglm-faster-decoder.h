@@ -67,7 +67,9 @@ class LatticeBiglmFasterDecoder {
   }
   void SetOptions(const LatticeBiglmFasterDecoderConfig &config) { config_ = config; } 
   LatticeBiglmFasterDecoderConfig GetOptions() { return config_; } 
-  ~LatticeBiglmFasterDecoder() {
+  // The destructor is virtual so that programs can derive from this class,
+  // e.g. to manage the LM-difference FST given to the constructor.
+  virtual ~LatticeBiglmFasterDecoder() {
     DeleteElems(toks_.Clear());    
     ClearActiveTokens();
   }
@@ -878,6 +880,8 @@ class LatticeBiglmFasterDecoder {
     active_toks_.clear();
     KALDI_ASSERT(num_toks_ == 0);
   }
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeBiglmFasterDecoder);
 };
 
 } // end namespace kaldi.
@@ -26,45 +26,52 @@
 
 #include "decoder/lattice-faster-decoder.h"
 #include "lat/lattice-functions.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
-LatticeFasterDecoder::LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                                           const LatticeFasterDecoderConfig &config):
+template <typename FST, template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, HashListType>::LatticeFasterDecoderTpl(
+    const FST &fst, const LatticeFasterDecoderConfig &config):
     fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterDecoder::LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
-                                           fst::Fst<fst::StdArc> *fst):
+template <typename FST, template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, HashListType>::LatticeFasterDecoderTpl(
+    const LatticeFasterDecoderConfig &config, FST *fst):
     fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterDecoder::~LatticeFasterDecoder() {
+template <typename FST, template <class, class> class HashListType>
+LatticeFasterDecoderTpl<FST, HashListType>::~LatticeFasterDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete &(fst_);
 }
 
-void LatticeFasterDecoder::InitDecoding() {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
   warned_ = false;
   num_toks_ = 0;
+  beam_controller_.Reset(config_);
   decoding_finalized_ = false;
   final_costs_.clear();
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL);
+  Token *start_tok = new (token_pool_.Allocate()) Token(
+      0.0, 0.0, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -74,7 +81,8 @@ void LatticeFasterDecoder::InitDecoding() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
+template <typename FST, template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, HashListType>::Decode(DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -84,8 +92,7 @@ bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
   while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
     if (NumFramesDecoded() % config_.prune_interval == 0)
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
+    ProcessFrame(decodable);
   }
   FinalizeDecoding();
 
@@ -96,8 +103,9 @@ bool LatticeFasterDecoder::Decode(DecodableInterface *decodable) {
 
 
 // Outputs an FST corresponding to the single best path through the lattice.
-bool LatticeFasterDecoder::GetBestPath(Lattice *olat,
-                                       bool use_final_probs) const {
+template <typename FST, template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, HashListType>::GetBestPath(Lattice *olat,
+                                               bool use_final_probs) const {
   Lattice raw_lat;
   GetRawLattice(&raw_lat, use_final_probs);
   ShortestPath(raw_lat, olat);
@@ -106,8 +114,9 @@ bool LatticeFasterDecoder::GetBestPath(Lattice *olat,
 
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
-bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
-                                         bool use_final_probs) const {
+template <typename FST, template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, HashListType>::GetRawLattice(Lattice *ofst,
+                                                 bool use_final_probs) const {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
   typedef Arc::Weight Weight;
@@ -161,7 +170,7 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
       for (ForwardLink *l = tok->links;
            l != NULL;
            l = l->next) {
-        unordered_map<Token*, StateId>::const_iterator iter =
+        typename unordered_map<Token*, StateId>::const_iterator iter =
             tok_map.find(l->next_tok);
         StateId nextstate = iter->second;
         KALDI_ASSERT(iter != tok_map.end());
@@ -177,7 +186,7 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
       }
       if (f == num_frames) {
         if (use_final_probs && !final_costs.empty()) {
-          unordered_map<Token*, BaseFloat>::const_iterator iter =
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
               final_costs.find(tok);
           if (iter != final_costs.end())
             ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -194,8 +203,9 @@ bool LatticeFasterDecoder::GetRawLattice(Lattice *ofst,
 // This function is now deprecated, since now we do determinization from outside
 // the LatticeFasterDecoder class.  Outputs an FST corresponding to the
 // lattice-determinized lattice (one path per word sequence).
-bool LatticeFasterDecoder::GetLattice(CompactLattice *ofst,
-                                      bool use_final_probs) const {
+template <typename FST, template <class, class> class HashListType>
+bool LatticeFasterDecoderTpl<FST, HashListType>::GetLattice(CompactLattice *ofst,
+                                              bool use_final_probs) const {
   Lattice raw_fst;
   GetRawLattice(&raw_fst, use_final_probs);
   Invert(&raw_fst);  // make it so word labels are on the input.
@@ -216,7 +226,8 @@ bool LatticeFasterDecoder::GetLattice(CompactLattice *ofst,
   return (ofst->NumStates() != 0);
 }
 
-void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::PossiblyResizeHash(size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -224,12 +235,25 @@ void LatticeFasterDecoder::PossiblyResizeHash(size_t num_toks) {
   }
 }
 
+template <typename FST, template <class, class> class HashListType>
+inline void LatticeFasterDecoderTpl<FST, HashListType>::DeleteForwardLinks(Token *tok) {
+  ForwardLink *l = tok->links, *m;
+  while (l != NULL) {
+    m = l->next;
+    link_pool_.Delete(l);
+    l = m;
+  }
+  tok->links = NULL;
+}
+
 // FindOrAddToken either locates a token in hash of toks_,
 // or if necessary inserts a new, empty token (i.e. with no forward links)
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
+template <typename FST, template <class, class> class HashListType>
+inline typename LatticeFasterDecoderTpl<FST, HashListType>::Token*
+LatticeFasterDecoderTpl<FST, HashListType>::FindOrAddToken(
     StateId state, int32 frame_plus_one, BaseFloat tot_cost, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
   // if the token was newly created or the cost changed.
@@ -241,7 +265,8 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks);
+    Token *new_tok = new (token_pool_.Allocate()) Token(
+        tot_cost, extra_cost, NULL, toks);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -270,7 +295,8 @@ inline LatticeFasterDecoder::Token *LatticeFasterDecoder::FindOrAddToken(
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-void LatticeFasterDecoder::PruneForwardLinks(
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -314,7 +340,7 @@ void LatticeFasterDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Delete(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -346,14 +372,15 @@ void LatticeFasterDecoder::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-void LatticeFasterDecoder::PruneForwardLinksFinal() {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
   if (active_toks_[frame_plus_one].toks == NULL)  // empty list; should not happen.
     KALDI_WARN << "No tokens alive at end of file";
   
-  typedef unordered_map<Token*, BaseFloat>::const_iterator IterType;
+  typedef typename unordered_map<Token*, BaseFloat>::const_iterator IterType;
   ComputeFinalCosts(&final_costs_, &final_relative_cost_, &final_best_cost_);
   decoding_finalized_ = true;
   // We call DeleteElems() as a nicety, not because it's really necessary;
@@ -401,7 +428,7 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Delete(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -430,7 +457,8 @@ void LatticeFasterDecoder::PruneForwardLinksFinal() {
   } // while changed
 }
 
-BaseFloat LatticeFasterDecoder::FinalRelativeCost() const {
+template <typename FST, template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, HashListType>::FinalRelativeCost() const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -447,7 +475,8 @@ BaseFloat LatticeFasterDecoder::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::PruneTokensForFrame(int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -460,7 +489,7 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Delete(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -473,7 +502,8 @@ void LatticeFasterDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::PruneActiveTokens(BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -502,7 +532,8 @@ void LatticeFasterDecoder::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-void LatticeFasterDecoder::ComputeFinalCosts(
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -544,8 +575,9 @@ void LatticeFasterDecoder::ComputeFinalCosts(
   }
 }
 
-void LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                             int32 max_num_frames) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::AdvanceDecoding(
+    DecodableInterface *decodable, int32 max_num_frames) {
   KALDI_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
                "You must call InitDecoding() before AdvanceDecoding");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -562,15 +594,15 @@ void LatticeFasterDecoder::AdvanceDecoding(DecodableInterface *decodable,
     if (NumFramesDecoded() % config_.prune_interval == 0) {
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
     }
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
+    ProcessFrame(decodable);
   }
 }
 
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-void LatticeFasterDecoder::FinalizeDecoding() {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::FinalizeDecoding() {
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -587,12 +619,35 @@ void LatticeFasterDecoder::FinalizeDecoding() {
                 << " to " << num_toks_;
 }
 
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::ProcessFrame(DecodableInterface *decodable) {
+  if (!LatticeFasterBeamController::Enabled(config_)) {
+    BaseFloat cost_cutoff = ProcessEmitting(decodable);
+    ProcessNonemitting(cost_cutoff);
+    return;
+  }
+  Timer timer;
+  int32 num_toks_begin = num_toks_;
+  BaseFloat cost_cutoff = ProcessEmitting(decodable);
+  ProcessNonemitting(cost_cutoff);
+  // Tokens are only deleted in PruneActiveTokens(), so this is the number of
+  // tokens on the new frame.
+  beam_controller_.Update(config_, num_toks_ - num_toks_begin,
+                          timer.Elapsed() * 1.0e+06);
+  KALDI_VLOG(6) << "Beam for frame " << NumFramesDecoded() << " is "
+                << beam_controller_.Beam();
+}
+
 /// Gets the weight cutoff.  Also counts the active tokens.
-BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                          BaseFloat *adaptive_beam, Elem **best_elem) {
+template <typename FST, template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, HashListType>::GetCutoff(Elem *list_head,
+                                                  size_t *tok_count,
+                                                  BaseFloat *adaptive_beam,
+                                                  Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
+  BaseFloat beam = beam_controller_.Beam();
   if (config_.max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -603,8 +658,8 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_weight + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam;
+    return best_weight + beam;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -617,7 +672,7 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
     }
     if (tok_count != NULL) *tok_count = count;
 
-    BaseFloat beam_cutoff = best_weight + config_.beam,
+    BaseFloat beam_cutoff = best_weight + beam,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
@@ -651,13 +706,15 @@ BaseFloat LatticeFasterDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
         *adaptive_beam = min_active_cutoff - best_weight + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam;
       return beam_cutoff;
     }
   }
 }
 
-BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
+template <typename FST, template <class, class> class HashListType>
+BaseFloat LatticeFasterDecoderTpl<FST, HashListType>::ProcessEmitting(
+    DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
                                          // (zero-based) used to get likelihoods
@@ -689,7 +746,7 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     StateId state = best_elem->key;
     Token *tok = best_elem->val;
     cost_offset = - tok->tot_cost;
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    for (fst::ArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
       Arc arc = aiter.Value();
@@ -718,7 +775,7 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
     StateId state = e->key;
     Token *tok = e->val;
     if (tok->tot_cost <= cur_cutoff) {
-      for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+      for (fst::ArcIterator<FST> aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
         const Arc &arc = aiter.Value();
@@ -738,8 +795,8 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLink(
+              next_tok, arc.ilabel, arc.olabel, graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -749,7 +806,8 @@ BaseFloat LatticeFasterDecoder::ProcessEmitting(DecodableInterface *decodable) {
   return next_cutoff;
 }
 
-void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::ProcessNonemitting(BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -784,9 +842,8 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
-    tok->links = NULL;
-    for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
+    DeleteForwardLinks(tok); // necessary when re-visiting
+    for (fst::ArcIterator<FST> aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
       const Arc &arc = aiter.Value();
@@ -799,8 +856,8 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLink(
+              new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -812,34 +869,32 @@ void LatticeFasterDecoder::ProcessNonemitting(BaseFloat cutoff) {
 }
 
 
-void LatticeFasterDecoder::DeleteElems(Elem *list) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     e_tail = e->tail;
     toks_.Delete(e);
   }
 }
 
-void LatticeFasterDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
-  }
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::ClearActiveTokens() { // a cleanup routine, at utt end/begin
+  // All tokens alive on any frame, and any forward links they may have, were
+  // allocated from token_pool_ and link_pool_, so we can free them all at once
+  // without traversing the lists.
+  KALDI_ASSERT(token_pool_.NumInUse() == static_cast<size_t>(num_toks_));
+  token_pool_.Reset();
+  link_pool_.Reset();
+  num_toks_ = 0;
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
 }
 
 // static
-void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
-                                         std::vector<Token*> *topsorted_list) {
+template <typename FST, template <class, class> class HashListType>
+void LatticeFasterDecoderTpl<FST, HashListType>::TopSortTokens(Token *tok_list,
+                                                 std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
-  typedef unordered_map<Token*, int32>::iterator IterType;
+  typedef typename unordered_map<Token*, int32>::iterator IterType;
   int32 num_toks = 0;
   for (Token *tok = tok_list; tok != NULL; tok = tok->next)
     num_toks++;
@@ -881,11 +936,11 @@ void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
   for (loop_count = 0;
        !reprocess.empty() && loop_count < max_loop; ++loop_count) {
     std::vector<Token*> reprocess_vec;
-    for (unordered_set<Token*>::iterator iter = reprocess.begin();
+    for (typename unordered_set<Token*>::iterator iter = reprocess.begin();
          iter != reprocess.end(); ++iter)
       reprocess_vec.push_back(*iter);
     reprocess.clear();
-    for (std::vector<Token*>::iterator iter = reprocess_vec.begin();
+    for (typename std::vector<Token*>::iterator iter = reprocess_vec.begin();
          iter != reprocess_vec.end(); ++iter) {
       Token *tok = *iter;
       int32 pos = token2pos[tok];
@@ -913,4 +968,39 @@ void LatticeFasterDecoder::TopSortTokens(Token *tok_list,
     (*topsorted_list)[iter->second] = iter->first;
 }
 
+void LatticeFasterBeamController::Update(
+    const LatticeFasterDecoderConfig &config,
+    int32 num_toks, BaseFloat frame_usec) {
+  BaseFloat ratio = 0.0;
+  if (config.target_active > 0)
+    ratio = num_toks / static_cast<BaseFloat>(config.target_active);
+  if (config.target_frame_usec > 0.0)
+    ratio = std::max(ratio, frame_usec / config.target_frame_usec);
+  // The load varies a lot from one frame to the next, so we smooth it over a
+  // few frames before comparing it with the budget.
+  const BaseFloat smoothing = 0.7, beam_step = 0.5, min_load = 0.01;
+  load_ = smoothing * load_ + (1.0 - smoothing) * ratio;
+  if (load_ > 1.0 + config.beam_hysteresis ||
+      load_ < 1.0 - config.beam_hysteresis) {
+    beam_ -= beam_step * Log(std::max(load_, min_load));
+    if (beam_ > config.beam) beam_ = config.beam;
+    if (beam_ < config.min_beam) beam_ = config.min_beam;
+  }
+}
+
+// Instantiate the template for the FST types we actually decode with.  The
+// versions for the specific types are faster than the one for fst::Fst,
+// because arc iteration does not have to go through the virtual interface.
+template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> >;
+template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc> >;
+template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc> >;
+template class LatticeFasterDecoderTpl<fst::MappedFst>;
+// ... and with OpenHashList for toks_ (see open-hash-list.h).
+template class LatticeFasterDecoderTpl<fst::Fst<fst::StdArc>, OpenHashList>;
+template class LatticeFasterDecoderTpl<fst::VectorFst<fst::StdArc>,
+                                       OpenHashList>;
+template class LatticeFasterDecoderTpl<fst::ConstFst<fst::StdArc>,
+                                       OpenHashList>;
+template class LatticeFasterDecoderTpl<fst::MappedFst, OpenHashList>;
+
 } // end namespace kaldi.
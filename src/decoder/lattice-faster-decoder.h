@@ -29,6 +29,8 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/open-hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -50,6 +52,13 @@ struct LatticeFasterDecoderConfig {
   BaseFloat prune_scale;   // Note: we don't make this configurable on the command line,
                            // it's not a very important parameter.  It affects the
                            // algorithm that prunes the tokens as we go.
+  // The next four configure the adaptive beam (see class
+  // LatticeFasterBeamController); it is only active if target_active or
+  // target_frame_usec is nonzero, and then "beam" is the largest beam used.
+  int32 target_active;
+  BaseFloat target_frame_usec;
+  BaseFloat min_beam;
+  BaseFloat beam_hysteresis;
   // Most of the options inside det_opts are not actually queried by the
   // LatticeFasterDecoder class itself, but by the code that calls it, for
   // example in the function DecodeUtteranceLatticeFaster.
@@ -63,7 +72,11 @@ struct LatticeFasterDecoderConfig {
                                 determinize_lattice(true),
                                 beam_delta(0.5),
                                 hash_ratio(2.0),
-                                prune_scale(0.1) { }
+                                prune_scale(0.1),
+                                target_active(0),
+                                target_frame_usec(0.0),
+                                min_beam(6.0),
+                                beam_hysteresis(0.2) { }
   void Register(OptionsItf *po) {
     det_opts.Register(po);
     po->Register("beam", &beam, "Decoding beam.");
@@ -80,20 +93,94 @@ struct LatticeFasterDecoderConfig {
                  "max-active constraint is applied.  Larger is more accurate.");
     po->Register("hash-ratio", &hash_ratio, "Setting used in decoder to control"
                  " hash behavior");
+    po->Register("target-active", &target_active, "If nonzero, the decoder "
+                 "adjusts its beam from frame to frame (between --min-beam and "
+                 "--beam) to keep the number of active tokens per frame near "
+                 "this value.");
+    po->Register("target-frame-usec", &target_frame_usec, "If nonzero, the "
+                 "decoder adjusts its beam from frame to frame (between "
+                 "--min-beam and --beam) to keep the time taken to decode each "
+                 "frame near this many microseconds.");
+    po->Register("min-beam", &min_beam, "Smallest beam the decoder will use "
+                 "when --target-active or --target-frame-usec is set.");
+    po->Register("beam-hysteresis", &beam_hysteresis, "Relative amount by "
+                 "which the load must differ from --target-active or "
+                 "--target-frame-usec before the beam is changed.");
   }
   void Check() const {
     KALDI_ASSERT(beam > 0.0 && max_active > 1 && lattice_beam > 0.0
                  && prune_interval > 0 && beam_delta > 0.0 && hash_ratio >= 1.0
-                 && prune_scale > 0.0 && prune_scale < 1.0);
+                 && prune_scale > 0.0 && prune_scale < 1.0
+                 && target_active >= 0 && target_frame_usec >= 0.0
+                 && beam_hysteresis >= 0.0 && beam_hysteresis < 1.0);
+    if (target_active > 0 || target_frame_usec > 0.0)
+      KALDI_ASSERT(min_beam > 0.0 && min_beam <= beam);
   }
 };
 
 
+/** LatticeFasterBeamController is used inside the lattice-faster decoders to
+    adapt the beam to a budget given as a number of active tokens per frame
+    (--target-active) and/or a decoding time per frame (--target-frame-usec).
+    After each frame, the decoder passes in the number of tokens it created and
+    the time it took.  The controller keeps a smoothed version of the load
+    relative to the budget (the larger ratio, if both budgets are set), and if
+    it is outside [1 - beam_hysteresis, 1 + beam_hysteresis] it moves the beam
+    by an amount proportional to the log of that ratio, since the number of
+    active tokens grows roughly exponentially with the beam.  The beam stays
+    between min_beam and beam.  The max-active and min-active constraints are
+    still applied on top of this.
+ */
+class LatticeFasterBeamController {
+ public:
+  LatticeFasterBeamController(): beam_(0.0), load_(1.0) { }
+
+  /// Sets the beam back to config.beam; call at the start of each utterance.
+  void Reset(const LatticeFasterDecoderConfig &config) {
+    beam_ = config.beam;
+    load_ = 1.0;
+  }
+
+  /// Returns true if config asks for the beam to be adapted.
+  static bool Enabled(const LatticeFasterDecoderConfig &config) {
+    return config.target_active > 0 || config.target_frame_usec > 0.0;
+  }
+
+  /// Updates the beam after a frame during which "num_toks" tokens were
+  /// created, taking "frame_usec" microseconds.
+  void Update(const LatticeFasterDecoderConfig &config,
+              int32 num_toks, BaseFloat frame_usec);
+
+  /// The beam to use for the next frame.
+  BaseFloat Beam() const { return beam_; }
+
+ private:
+  BaseFloat beam_;
+  BaseFloat load_;  // Smoothed ratio of the load to the budget.
+};
+
+
 /** A bit more optimized version of the lattice decoder.
    See \ref lattices_generation \ref decoders_faster and \ref decoders_simple
     for more information.
+
+   The template argument FST is the type of the decoding graph.  It is
+   instantiated (in the .cc file) for fst::Fst<fst::StdArc>, which will work
+   with any type of FST, and for fst::VectorFst<fst::StdArc>,
+   fst::ConstFst<fst::StdArc> and fst::MappedFst.  For the last three, a
+   specialized ArcIterator is used, so iterating over the arcs in the inner loop of the
+   decoder is inlined rather than going through virtual functions; if you know
+   the type of your graph, it is faster to use the corresponding version.
+   Most code just uses LatticeFasterDecoder (below), which is the version for
+   fst::Fst<fst::StdArc>.
+
+   The template argument HashListType is the container for the tokens on the
+   current frame (toks_): HashList (the default) or OpenHashList, which have
+   the same interface; see open-hash-list.h.  Both are instantiated for each
+   of the FST types above.
  */
-class LatticeFasterDecoder {
+template <typename FST, template <class, class> class HashListType = HashList>
+class LatticeFasterDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
@@ -101,24 +188,25 @@ class LatticeFasterDecoder {
   typedef Arc::Weight Weight;
   
   // instantiate this class once for each thing you have to decode.
-  LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
-                       const LatticeFasterDecoderConfig &config);
+  LatticeFasterDecoderTpl(const FST &fst,
+                          const LatticeFasterDecoderConfig &config);
 
   // This version of the initializer "takes ownership" of the fst,
   // and will delete it when this object is destroyed.
-  LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
-                       fst::Fst<fst::StdArc> *fst);
+  LatticeFasterDecoderTpl(const LatticeFasterDecoderConfig &config,
+                          FST *fst);
 
 
   void SetOptions(const LatticeFasterDecoderConfig &config) {
     config_ = config;
+    beam_controller_.Reset(config_);
   }
 
   const LatticeFasterDecoderConfig &GetOptions() const {
     return config_;
   }
   
-  ~LatticeFasterDecoder();
+  ~LatticeFasterDecoderTpl();
 
   /// Decodes until there are no more frames left in the "decodable" object..
   /// note, this may block waiting for input if the "decodable" object blocks.
@@ -244,15 +332,6 @@ class LatticeFasterDecoder {
     inline Token(BaseFloat tot_cost, BaseFloat extra_cost, ForwardLink *links,
                  Token *next):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
   // head of per-frame list of Tokens (list is in topological order),
@@ -265,10 +344,14 @@ class LatticeFasterDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef HashListType<StateId, Token*> TokenHash;
+  typedef typename TokenHash::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
 
+  // Deletes all the forward links of "tok", returning them to link_pool_.
+  inline void DeleteForwardLinks(Token *tok);
+
   // FindOrAddToken either locates a token in hash of toks_, or if necessary
   // inserts a new, empty token (i.e. with no forward links) for the current
   // frame.  [note: it's inserted if necessary into hash toks_ and also into the
@@ -347,14 +430,18 @@ class LatticeFasterDecoder {
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
 
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.  It is indexed by frame-index
-  // plus one, where the frame-index is zero-based, as used in decodable object.
-  // That is, the emitting probs of frame t are accounted for in tokens at
-  // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
-  // the graph.
-  HashList<StateId, Token*> toks_;
+  /// Calls ProcessEmitting() and ProcessNonemitting() for one frame, and
+  /// updates beam_controller_ if the beam is adaptive.
+  void ProcessFrame(DecodableInterface *decodable);
+
+  // HashList defined in ../util/hash-list.h (or OpenHashList, see above).  It
+  // actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by
+  // StateId.  It is indexed by frame-index plus one, where the frame-index is
+  // zero-based, as used in decodable object.  That is, the emitting probs of
+  // frame t are accounted for in tokens at toks_[t+1].  The zeroth frame is
+  // for nonemitting transition at the start of the graph.
+  TokenHash toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -362,13 +449,22 @@ class LatticeFasterDecoder {
   std::vector<StateId> queue_;  // temp variable used in ProcessNonemitting,
   std::vector<BaseFloat> tmp_array_;  // used in GetCutoff.
   // make it class member to avoid internal new/delete.
-  const fst::Fst<fst::StdArc> &fst_;
+  const FST &fst_;
   bool delete_fst_;
   std::vector<BaseFloat> cost_offsets_; // This contains, for each
   // frame, an offset that was added to the acoustic likelihoods on that
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  // Gives the beam to use on each frame; it is always config_.beam unless
+  // config_.target_active or config_.target_frame_usec is set.
+  LatticeFasterBeamController beam_controller_;
+
+  // Tokens and ForwardLinks are allocated from these pools rather than with
+  // new and delete; the memory is reused between frames and utterances, and
+  // ClearActiveTokens() frees everything at once by resetting the pools.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -409,7 +505,25 @@ class LatticeFasterDecoder {
 
   void ClearActiveTokens();
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoder);  
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterDecoderTpl);
+};
+
+
+/// LatticeFasterDecoder is the version of LatticeFasterDecoderTpl that works
+/// with any type of FST.  It is what most of the code uses.
+class LatticeFasterDecoder:
+      public LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> > {
+ public:
+  // instantiate this class once for each thing you have to decode.
+  LatticeFasterDecoder(const fst::Fst<fst::StdArc> &fst,
+                       const LatticeFasterDecoderConfig &config):
+      LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> >(fst, config) { }
+
+  // This version of the initializer "takes ownership" of the fst,
+  // and will delete it when this object is destroyed.
+  LatticeFasterDecoder(const LatticeFasterDecoderConfig &config,
+                       fst::Fst<fst::StdArc> *fst):
+      LatticeFasterDecoderTpl<fst::Fst<fst::StdArc> >(config, fst) { }
 };
 
 
@@ -0,0 +1,324 @@
+// decoder/lattice-faster-online-decoder-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+
+#include "decoder/lattice-faster-online-decoder.h"
+#include "decoder/decodable-matrix.h"
+#include "fstext/fstext-utils.h"
+#include "hmm/hmm-topology.h"
+#include "lat/lattice-functions.h"
+#include "tree/context-dep.h"
+
+namespace kaldi {
+
+// Makes a random TransitionModel.
+static TransitionModel *GenRandTransitionModel() {
+  std::vector<int32> phones;
+  for (int32 i = 1; i < 10; i++)
+    phones.push_back(i);
+  std::vector<int32> num_pdf_classes;
+  ContextDependency *ctx_dep =
+      GenRandContextDependencyLarge(phones, 3, 1, true, &num_pdf_classes);
+  TransitionModel *trans_model =
+      new TransitionModel(*ctx_dep, GetDefaultTopology(phones));
+  delete ctx_dep;
+  return trans_model;
+}
+
+// Makes a random decoding graph whose input labels are transition-ids and
+// whose output labels are words (mostly epsilon).  All states are final.
+static void GenRandGraph(const TransitionModel &trans_model,
+                         fst::VectorFst<fst::StdArc> *fst) {
+  typedef fst::StdArc Arc;
+  int32 num_states = 5 + Rand() % 10;
+  fst->DeleteStates();
+  for (int32 s = 0; s < num_states; s++) {
+    fst->AddState();
+    fst->SetFinal(s, Arc::Weight(RandUniform()));
+  }
+  fst->SetStart(0);
+  for (int32 s = 0; s < num_states; s++) {
+    int32 num_arcs = 2 + Rand() % 4;
+    for (int32 i = 0; i < num_arcs; i++) {
+      int32 ilabel = 1 + Rand() % trans_model.NumTransitionIds(),
+          olabel = (Rand() % 3 == 0 ? 1 + Rand() % 10 : 0);
+      fst->AddArc(s, Arc(ilabel, olabel, Arc::Weight(RandUniform()),
+                         Rand() % num_states));
+    }
+  }
+}
+
+// Outputs the words and the total cost of the best path through "clat".
+static void GetBestPathOfLattice(const CompactLattice &clat,
+                                 std::vector<int32> *words,
+                                 BaseFloat *cost) {
+  CompactLattice clat_best_path;
+  CompactLatticeShortestPath(clat, &clat_best_path);
+  Lattice best_path;
+  ConvertLattice(clat_best_path, &best_path);
+  std::vector<int32> alignment;
+  LatticeWeight weight;
+  bool ans = fst::GetLinearSymbolSequence(best_path, &alignment, words,
+                                          &weight);
+  KALDI_ASSERT(ans);
+  *cost = weight.Value1() + weight.Value2();
+}
+
+// Converts "clat" to an acceptor on words, with the costs summed into
+// tropical weights, and determinizes and minimizes it, so that it has one path
+// per word sequence with the best cost of that word sequence in "clat".
+static void GetWordAcceptor(const CompactLattice &clat,
+                            fst::VectorFst<fst::StdArc> *word_fst) {
+  Lattice lat;
+  ConvertLattice(clat, &lat);
+  fst::Project(&lat, fst::PROJECT_OUTPUT);
+  fst::VectorFst<fst::StdArc> fst;
+  ConvertLattice(lat, &fst);
+  fst::RmEpsilon(&fst);
+  fst::Determinize(fst, word_fst);
+  fst::Minimize(word_fst);
+}
+
+// Checks that the lattice we get by determinizing incrementally has the same
+// best path as the one we get by determinizing the raw lattice for the whole
+// utterance, as GetLattice() does in the online decoders.  If
+// "compare_lattices" is true, the lattice beam is set as wide as the decoding
+// beam, so that determinization prunes nothing; then the two lattices must
+// also have the same word sequences, with the same best cost for each.
+void TestIncrementalDeterminization(bool compare_lattices) {
+  TransitionModel *trans_model = GenRandTransitionModel();
+  fst::VectorFst<fst::StdArc> fst;
+  GenRandGraph(*trans_model, &fst);
+
+  int32 num_frames = 50 + Rand() % 150;
+  Matrix<BaseFloat> loglikes(num_frames, trans_model->NumPdfs());
+  loglikes.SetRandn();
+  DecodableMatrixScaledMapped decodable(*trans_model, loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 12.0;
+  config.lattice_beam = (compare_lattices ? config.beam : 4.0 + Rand() % 4);
+
+  LatticeFasterOnlineDecoder decoder(fst, config);
+  decoder.Decode(&decodable);
+  Lattice raw_lat;
+  decoder.GetRawLattice(&raw_lat, true);
+  KALDI_ASSERT(raw_lat.NumStates() > 0);
+  CompactLattice clat;
+  DeterminizeLatticePhonePrunedWrapper(*trans_model, &raw_lat,
+                                       config.lattice_beam, &clat,
+                                       config.det_opts);
+
+  LatticeFasterOnlineDecoder incremental_decoder(fst, config);
+  int32 period = 1 + Rand() % 20, delay = Rand() % 10;
+  incremental_decoder.InitDecoding();
+  while (incremental_decoder.NumFramesDecoded() < num_frames) {
+    incremental_decoder.AdvanceDecoding(&decodable, 1 + Rand() % 5);
+    int32 num_frames_det = incremental_decoder.NumFramesDecoded() - delay;
+    if (num_frames_det - incremental_decoder.NumFramesDeterminized() >=
+        period)
+      incremental_decoder.DeterminizeIncremental(*trans_model,
+                                                 num_frames_det);
+    // Getting the lattice in the middle of the utterance must not affect
+    // the end result.
+    if (Rand() % 4 == 0) {
+      const CompactLattice *partial_lat =
+          incremental_decoder.GetLatticeIncremental(*trans_model,
+                                                    Rand() % 2 == 0);
+      KALDI_ASSERT(partial_lat != NULL && partial_lat->NumStates() > 0);
+    }
+  }
+  incremental_decoder.FinalizeDecoding();
+  const CompactLattice *incremental_lat =
+      incremental_decoder.GetLatticeIncremental(*trans_model, true);
+  KALDI_ASSERT(incremental_lat != NULL);
+  CompactLattice incremental_clat(*incremental_lat);
+  fst::Connect(&incremental_clat);
+  KALDI_ASSERT(incremental_clat.NumStates() > 0);
+
+  std::vector<int32> words, incremental_words;
+  BaseFloat cost, incremental_cost;
+  GetBestPathOfLattice(clat, &words, &cost);
+  GetBestPathOfLattice(incremental_clat, &incremental_words,
+                       &incremental_cost);
+  KALDI_LOG << "Best-path cost is " << cost << " for the whole lattice, "
+            << incremental_cost << " with incremental determinization ("
+            << incremental_decoder.NumFramesDeterminized() << " of "
+            << num_frames << " frames determinized incrementally).";
+  KALDI_ASSERT(words == incremental_words);
+  KALDI_ASSERT(std::abs(cost - incremental_cost) <
+               1.0e-03 * (1.0 + std::abs(cost)));
+
+  if (compare_lattices) {
+    fst::VectorFst<fst::StdArc> word_fst, incremental_word_fst;
+    GetWordAcceptor(clat, &word_fst);
+    GetWordAcceptor(incremental_clat, &incremental_word_fst);
+    // RandEquivalent() draws random paths from both FSTs.
+    KALDI_ASSERT(fst::RandEquivalent(word_fst, incremental_word_fst,
+                                     20 /*paths*/, 0.01 /*delta*/,
+                                     Rand() /*seed*/, 1000 /*max length*/));
+  }
+  delete trans_model;
+}
+
+// Traces back the best path without using the decoder's cached traceback,
+// and outputs its words and total cost.
+static void GetBestPathUncached(const LatticeFasterOnlineDecoder &decoder,
+                                bool use_final_probs,
+                                std::vector<int32> *words,
+                                BaseFloat *cost) {
+  words->clear();
+  BaseFloat final_cost;
+  LatticeFasterOnlineDecoder::BestPathIterator iter =
+      decoder.BestPathEnd(use_final_probs, &final_cost);
+  *cost = final_cost;
+  while (!iter.Done()) {
+    LatticeArc arc;
+    iter = decoder.TraceBackBestPath(iter, &arc);
+    if (arc.olabel != 0)
+      words->push_back(arc.olabel);
+    *cost += arc.weight.Value1() + arc.weight.Value2();
+  }
+  std::reverse(words->begin(), words->end());
+}
+
+// Checks that GetBestPath() and GetBestPathWords(), which use the cached
+// traceback, agree with a traceback from scratch as the decoding proceeds,
+// and that the words they say are stable do not change.
+void TestBestPathCache() {
+  TransitionModel *trans_model = GenRandTransitionModel();
+  fst::VectorFst<fst::StdArc> fst;
+  GenRandGraph(*trans_model, &fst);
+
+  int32 num_frames = 50 + Rand() % 150;
+  Matrix<BaseFloat> loglikes(num_frames, trans_model->NumPdfs());
+  loglikes.SetRandn();
+  DecodableMatrixScaledMapped decodable(*trans_model, loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 8.0 + Rand() % 8;
+  LatticeFasterOnlineDecoder decoder(fst, config);
+  decoder.InitDecoding();
+  std::vector<int32> stable_words;
+  while (true) {
+    decoder.AdvanceDecoding(&decodable, 1 + Rand() % 5);
+    bool end = (decoder.NumFramesDecoded() == num_frames);
+    if (end)
+      decoder.FinalizeDecoding();
+    bool use_final_probs = (end || Rand() % 2 == 0);
+
+    std::vector<int32> words, words_cached, words_uncached, alignment;
+    BaseFloat cost_uncached;
+    GetBestPathUncached(decoder, use_final_probs, &words_uncached,
+                        &cost_uncached);
+
+    Lattice best_path;
+    decoder.GetBestPath(&best_path, use_final_probs);
+    LatticeWeight weight;
+    fst::GetLinearSymbolSequence(best_path, &alignment, &words, &weight);
+    KALDI_ASSERT(words == words_uncached);
+    BaseFloat cost = weight.Value1() + weight.Value2();
+    KALDI_ASSERT(std::abs(cost - cost_uncached) <
+                 1.0e-03 * (1.0 + std::abs(cost)));
+
+    int32 num_stable_words;
+    decoder.GetBestPathWords(use_final_probs, &words_cached,
+                             &num_stable_words);
+    KALDI_ASSERT(words_cached == words_uncached);
+    KALDI_ASSERT(num_stable_words >= 0 &&
+                 num_stable_words <= static_cast<int32>(words_cached.size()));
+    // The words that were stable before must still be on the best path.
+    KALDI_ASSERT(stable_words.size() <= words_cached.size() &&
+                 std::equal(stable_words.begin(), stable_words.end(),
+                            words_cached.begin()));
+    stable_words.assign(words_cached.begin(),
+                        words_cached.begin() + num_stable_words);
+    if (end)
+      break;
+  }
+  delete trans_model;
+}
+
+// Checks that the decoder gives the same best path and the same lattice
+// whether it keeps its tokens in a HashList or in an OpenHashList.
+void TestOpenHashList() {
+  TransitionModel *trans_model = GenRandTransitionModel();
+  fst::VectorFst<fst::StdArc> fst;
+  GenRandGraph(*trans_model, &fst);
+
+  int32 num_frames = 50 + Rand() % 150;
+  Matrix<BaseFloat> loglikes(num_frames, trans_model->NumPdfs());
+  loglikes.SetRandn();
+  DecodableMatrixScaledMapped decodable(*trans_model, loglikes, 1.0);
+
+  LatticeFasterDecoderConfig config;
+  config.beam = 8.0 + Rand() % 8;
+  config.lattice_beam = 4.0 + Rand() % 4;
+
+  LatticeFasterOnlineDecoder decoder(fst, config);
+  LatticeFasterOnlineDecoderTpl<OpenHashList> open_decoder(fst, config);
+  decoder.Decode(&decodable);
+  open_decoder.Decode(&decodable);
+
+  std::vector<int32> words, open_words;
+  BaseFloat cost, open_cost;
+  GetBestPathUncached(decoder, true, &words, &cost);
+  {
+    Lattice best_path;
+    open_decoder.GetBestPath(&best_path, true);
+    std::vector<int32> alignment;
+    LatticeWeight weight;
+    fst::GetLinearSymbolSequence(best_path, &alignment, &open_words,
+                                 &weight);
+    open_cost = weight.Value1() + weight.Value2();
+  }
+  KALDI_ASSERT(words == open_words);
+  KALDI_ASSERT(std::abs(cost - open_cost) < 1.0e-03 * (1.0 + std::abs(cost)));
+
+  Lattice raw_lat, open_raw_lat;
+  decoder.GetRawLattice(&raw_lat, true);
+  open_decoder.GetRawLattice(&open_raw_lat, true);
+  CompactLattice clat, open_clat;
+  DeterminizeLatticePhonePrunedWrapper(*trans_model, &raw_lat,
+                                       config.lattice_beam, &clat,
+                                       config.det_opts);
+  DeterminizeLatticePhonePrunedWrapper(*trans_model, &open_raw_lat,
+                                       config.lattice_beam, &open_clat,
+                                       config.det_opts);
+  fst::VectorFst<fst::StdArc> word_fst, open_word_fst;
+  GetWordAcceptor(clat, &word_fst);
+  GetWordAcceptor(open_clat, &open_word_fst);
+  KALDI_ASSERT(fst::RandEquivalent(word_fst, open_word_fst, 20 /*paths*/,
+                                   0.01 /*delta*/, Rand() /*seed*/,
+                                   1000 /*max length*/));
+  delete trans_model;
+}
+
+}  // namespace kaldi
+
+int main() {
+  for (int32 i = 0; i < 10; i++) {
+    kaldi::TestIncrementalDeterminization(false);
+    kaldi::TestIncrementalDeterminization(true);
+    kaldi::TestBestPathCache();
+    kaldi::TestOpenHashList();
+  }
+  KALDI_LOG << "Test OK.";
+}
@@ -25,46 +25,70 @@
 
 #include "decoder/lattice-faster-online-decoder.h"
 #include "lat/lattice-functions.h"
+#include "base/timer.h"
 
 namespace kaldi {
 
 // instantiate this class once for each thing you have to decode.
-LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(
+template <template <class, class> class HashListType>
+LatticeFasterOnlineDecoderTpl<HashListType>::LatticeFasterOnlineDecoderTpl(
     const fst::Fst<fst::StdArc> &fst,
     const LatticeFasterDecoderConfig &config):
-    fst_(fst), delete_fst_(false), config_(config), num_toks_(0) {
+    fst_(fst), delete_fst_(false), config_(config), num_toks_(0),
+    num_frames_determinized_(0), num_determinized_states_(0),
+    last_chunk_num_states_(0), boundary_label_offset_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterOnlineDecoder::LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
-                                                       fst::Fst<fst::StdArc> *fst):
-    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0) {
+template <template <class, class> class HashListType>
+LatticeFasterOnlineDecoderTpl<HashListType>::LatticeFasterOnlineDecoderTpl(
+    const LatticeFasterDecoderConfig &config, fst::Fst<fst::StdArc> *fst):
+    fst_(*fst), delete_fst_(true), config_(config), num_toks_(0),
+    num_frames_determinized_(0), num_determinized_states_(0),
+    last_chunk_num_states_(0), boundary_label_offset_(0) {
   config.Check();
   toks_.SetSize(1000);  // just so on the first frame we do something reasonable.
 }
 
 
-LatticeFasterOnlineDecoder::~LatticeFasterOnlineDecoder() {
+template <template <class, class> class HashListType>
+LatticeFasterOnlineDecoderTpl<HashListType>::~LatticeFasterOnlineDecoderTpl() {
   DeleteElems(toks_.Clear());
   ClearActiveTokens();
   if (delete_fst_) delete &(fst_);
 }
 
-void LatticeFasterOnlineDecoder::InitDecoding() {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::InitDecoding() {
   // clean up from last time:
   DeleteElems(toks_.Clear());
   cost_offsets_.clear();
   ClearActiveTokens();
   warned_ = false;
   num_toks_ = 0;
+  beam_controller_.Reset(config_);
   decoding_finalized_ = false;
   final_costs_.clear();
+  best_path_.clear();
+  best_path_index_.clear();
+  best_path_words_.clear();
+  determinized_lat_.DeleteStates();
+  num_frames_determinized_ = 0;
+  num_determinized_states_ = 0;
+  boundary_arcs_.clear();
+  last_chunk_num_states_ = 0;
+  last_chunk_saved_arcs_.clear();
+  last_chunk_saved_finals_.clear();
+  boundary_labels_.clear();
+  boundary_label_offset_ = 0;
+  boundary_costs_.clear();
   StateId start_state = fst_.Start();
   KALDI_ASSERT(start_state != fst::kNoStateId);
   active_toks_.resize(1);
-  Token *start_tok = new Token(0.0, 0.0, NULL, NULL, NULL);
+  Token *start_tok = new (token_pool_.Allocate()) Token(
+      0.0, 0.0, NULL, NULL, NULL);
   active_toks_[0].toks = start_tok;
   toks_.Insert(start_state, start_tok);
   num_toks_++;
@@ -74,7 +98,9 @@ void LatticeFasterOnlineDecoder::InitDecoding() {
 // Returns true if any kind of traceback is available (not necessarily from
 // a final state).  It should only very rarely return false; this indicates
 // an unusual search error.
-bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::Decode(
+    DecodableInterface *decodable) {
   InitDecoding();
 
   // We use 1-based indexing for frames in this decoder (if you view it in
@@ -84,8 +110,7 @@ bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
   while (!decodable->IsLastFrame(NumFramesDecoded() - 1)) {
     if (NumFramesDecoded() % config_.prune_interval == 0)
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);  // Note: the value returned by
-    ProcessNonemitting(cost_cutoff);
+    ProcessFrame(decodable);
   }
   FinalizeDecoding();
 
@@ -98,7 +123,9 @@ bool LatticeFasterOnlineDecoder::Decode(DecodableInterface *decodable) {
 
 
 
-bool LatticeFasterOnlineDecoder::TestGetBestPath(bool use_final_probs) const {
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::TestGetBestPath(
+    bool use_final_probs) const {
   Lattice lat1;
   {
     Lattice raw_lat;
@@ -119,31 +146,119 @@ bool LatticeFasterOnlineDecoder::TestGetBestPath(bool use_final_probs) const {
 
 
 // Outputs an FST corresponding to the single best path through the lattice.
-bool LatticeFasterOnlineDecoder::GetBestPath(Lattice *olat,
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::GetBestPath(Lattice *olat,
                                              bool use_final_probs) const {
   olat->DeleteStates();
   BaseFloat final_graph_cost;
   BestPathIterator iter = BestPathEnd(use_final_probs, &final_graph_cost);
   if (iter.Done())
     return false;  // would have printed warning.
+  UpdateBestPath(iter);
   StateId state = olat->AddState();
+  olat->SetStart(state);
+  for (size_t i = 0; i < best_path_.size(); i++) {
+    LatticeArc arc = best_path_[i].arc;
+    arc.nextstate = olat->AddState();
+    olat->AddArc(state, arc);
+    state = arc.nextstate;
+  }
   olat->SetFinal(state, LatticeWeight(final_graph_cost, 0.0));
+  return true;
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::GetBestPathWords(
+    bool use_final_probs, std::vector<int32> *words,
+    int32 *num_stable_words) const {
+  words->clear();
+  if (num_stable_words != NULL)
+    *num_stable_words = 0;
+  BestPathIterator iter = BestPathEnd(use_final_probs, NULL);
+  if (iter.Done())
+    return;  // would have printed warning.
+  UpdateBestPath(iter);
+  *words = best_path_words_;
+  if (num_stable_words == NULL)
+    return;
+
+  // Trace back from each token on the last frame until we reach the best
+  // path, or a token we already traced back from; the earliest position on
+  // the best path that we reach is where the paths to the active tokens
+  // diverge.  All tokens reached via backpointers from live tokens are live,
+  // and best_path_ has just been updated so it only contains live tokens;
+  // so here we do not need to check the frames.
+  unordered_map<Token*, size_t> reached;  // maps token to position reached.
+  std::vector<Token*> traced;
+  size_t stable_pos = best_path_.size() - 1;
+  for (Token *tok = active_toks_.back().toks; tok != NULL; tok = tok->next) {
+    traced.clear();
+    size_t pos = 0;
+    for (Token *t = tok; t != NULL; t = t->backpointer) {
+      typename unordered_map<Token*, size_t>::const_iterator map_iter =
+          best_path_index_.find(t);
+      if (map_iter != best_path_index_.end()) {
+        pos = map_iter->second;
+        break;
+      }
+      map_iter = reached.find(t);
+      if (map_iter != reached.end()) {
+        pos = map_iter->second;
+        break;
+      }
+      traced.push_back(t);
+    }
+    for (size_t i = 0; i < traced.size(); i++)
+      reached[traced[i]] = pos;
+    if (pos < stable_pos)
+      stable_pos = pos;
+  }
+  *num_stable_words = best_path_[stable_pos].num_words;
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::UpdateBestPath(
+    BestPathIterator iter) const {
+  // new_elems is the part of the path not in best_path_, in reverse order.
+  std::vector<BestPathElem> new_elems;
+  size_t num_keep = 0;
   while (!iter.Done()) {
-    LatticeArc arc;
-    iter = TraceBackBestPath(iter, &arc);
-    arc.nextstate = state;
-    StateId new_state = olat->AddState();
-    olat->AddArc(new_state, arc);
-    state = new_state;
+    Token *tok = static_cast<Token*>(iter.tok);
+    typename unordered_map<Token*, size_t>::const_iterator map_iter =
+        best_path_index_.find(tok);
+    if (map_iter != best_path_index_.end() &&
+        best_path_[map_iter->second].frame == iter.frame) {
+      num_keep = map_iter->second + 1;
+      break;
+    }
+    BestPathElem elem;
+    elem.tok = tok;
+    elem.frame = iter.frame;
+    iter = TraceBackBestPath(iter, &(elem.arc));
+    new_elems.push_back(elem);
+  }
+  for (size_t i = num_keep; i < best_path_.size(); i++)
+    best_path_index_.erase(best_path_[i].tok);
+  best_path_.resize(num_keep);
+  best_path_words_.resize(num_keep == 0 ? 0 :
+                          best_path_[num_keep - 1].num_words);
+  for (size_t i = new_elems.size(); i > 0; i--) {
+    BestPathElem &elem = new_elems[i - 1];
+    if (elem.arc.olabel != 0)
+      best_path_words_.push_back(elem.arc.olabel);
+    elem.num_words = best_path_words_.size();
+    best_path_index_[elem.tok] = best_path_.size();
+    best_path_.push_back(elem);
   }
-  olat->SetStart(state);
-  return true;
 }
 
 
 // Outputs an FST corresponding to the raw, state-level
 // tracebacks.
-bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::GetRawLattice(Lattice *ofst,
                                                bool use_final_probs) const {
   typedef LatticeArc Arc;
   typedef Arc::StateId StateId;
@@ -198,7 +313,7 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
       for (ForwardLink *l = tok->links;
            l != NULL;
            l = l->next) {
-        unordered_map<Token*, StateId>::const_iterator iter =
+        typename unordered_map<Token*, StateId>::const_iterator iter =
             tok_map.find(l->next_tok);
         StateId nextstate = iter->second;
         KALDI_ASSERT(iter != tok_map.end());
@@ -214,7 +329,7 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
       }
       if (f == num_frames) {
         if (use_final_probs && !final_costs.empty()) {
-          unordered_map<Token*, BaseFloat>::const_iterator iter =
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
               final_costs.find(tok);
           if (iter != final_costs.end())
             ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -227,7 +342,8 @@ bool LatticeFasterOnlineDecoder::GetRawLattice(Lattice *ofst,
   return (ofst->NumStates() > 0);
 }
 
-bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::GetRawLatticePruned(
     Lattice *ofst,
     bool use_final_probs,
     BaseFloat beam) const {
@@ -284,7 +400,7 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
     int32 cur_frame = cur_tok_pair.second;
     KALDI_ASSERT(cur_frame >= 0 && cur_frame <= cost_offsets_.size());
     
-    unordered_map<Token*, StateId>::const_iterator iter =
+    typename unordered_map<Token*, StateId>::const_iterator iter =
         tok_map.find(cur_tok);
     KALDI_ASSERT(iter != tok_map.end());
     StateId cur_state = iter->second;
@@ -312,7 +428,7 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
     }
     if (cur_frame == num_frames) {
       if (use_final_probs && !final_costs.empty()) {
-        unordered_map<Token*, BaseFloat>::const_iterator iter =
+        typename unordered_map<Token*, BaseFloat>::const_iterator iter =
             final_costs.find(cur_tok);
         if (iter != final_costs.end())
           ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
@@ -324,8 +440,308 @@ bool LatticeFasterOnlineDecoder::GetRawLatticePruned(
   return (ofst->NumStates() != 0);
 }
 
+template <template <class, class> class HashListType>
+bool LatticeFasterOnlineDecoderTpl<HashListType>::GetRawLatticeChunk(
+    int32 begin_frame, int32 end_frame, bool use_final_probs,
+    Label exit_label_offset, Lattice *ofst,
+    unordered_map<Token*, Label> *exit_labels,
+    std::vector<BaseFloat> *exit_costs) const {
+  typedef LatticeArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+
+  bool first_chunk = (num_determinized_states_ == 0),
+      last_chunk = (exit_labels == NULL);
+  KALDI_ASSERT(begin_frame >= 0 && begin_frame <= end_frame &&
+               end_frame <= NumFramesDecoded());
+  KALDI_ASSERT(first_chunk == (begin_frame == 0));
+  if (decoding_finalized_ && last_chunk && !use_final_probs)
+    KALDI_ERR << "You cannot call FinalizeDecoding() and then call "
+              << "GetLatticeIncremental() with use_final_probs == false";
+
+  unordered_map<Token*, BaseFloat> final_costs_local;
+  const unordered_map<Token*, BaseFloat> &final_costs =
+      (decoding_finalized_ ? final_costs_ : final_costs_local);
+  if (last_chunk && !decoding_finalized_ && use_final_probs)
+    ComputeFinalCosts(&final_costs_local, NULL, NULL);
 
-void LatticeFasterOnlineDecoder::PossiblyResizeHash(size_t num_toks) {
+  ofst->DeleteStates();
+  // If this is not the first chunk, state zero is a new start state, with an
+  // arc to each token on begin_frame.
+  if (!first_chunk)
+    ofst->SetStart(ofst->AddState());
+  unordered_map<Token*, StateId> tok_map;
+  std::vector<Token*> token_list;
+  for (int32 f = begin_frame; f <= end_frame; f++) {
+    if (active_toks_[f].toks == NULL) {
+      KALDI_WARN << "GetRawLatticeChunk: no tokens active on frame " << f
+                 << ": not producing lattice.\n";
+      return false;
+    }
+    TopSortTokens(active_toks_[f].toks, &token_list);
+    for (size_t i = 0; i < token_list.size(); i++)
+      if (token_list[i] != NULL)
+        tok_map[token_list[i]] = ofst->AddState();
+  }
+  if (first_chunk) {
+    // Because we topologically sorted the tokens, state zero is the
+    // start-state.
+    ofst->SetStart(0);
+  } else {
+    for (Token *tok = active_toks_[begin_frame].toks; tok != NULL;
+         tok = tok->next) {
+      typename unordered_map<Token*, Label>::const_iterator iter =
+          boundary_labels_.find(tok);
+      KALDI_ASSERT(iter != boundary_labels_.end());
+      ofst->AddArc(0, Arc(0, iter->second, Weight(tok->tot_cost, 0.0),
+                          tok_map[tok]));
+    }
+  }
+
+  StateId super_final = fst::kNoStateId;
+  for (int32 f = begin_frame; f <= end_frame; f++) {
+    for (Token *tok = active_toks_[f].toks; tok != NULL; tok = tok->next) {
+      StateId cur_state = tok_map[tok];
+      for (ForwardLink *l = tok->links; l != NULL; l = l->next) {
+        // Epsilon links from tokens on begin_frame belong to the previous
+        // chunk, and emitting links from tokens on end_frame to the next one.
+        if (l->ilabel == 0 ? (f == begin_frame && !first_chunk)
+            : (f == end_frame))
+          continue;
+        typename unordered_map<Token*, StateId>::const_iterator iter =
+            tok_map.find(l->next_tok);
+        KALDI_ASSERT(iter != tok_map.end());
+        BaseFloat cost_offset = 0.0;
+        if (l->ilabel != 0) {  // emitting..
+          KALDI_ASSERT(f >= 0 && f < cost_offsets_.size());
+          cost_offset = cost_offsets_[f];
+        }
+        ofst->AddArc(cur_state,
+                     Arc(l->ilabel, l->olabel,
+                         Weight(l->graph_cost, l->acoustic_cost - cost_offset),
+                         iter->second));
+      }
+      if (f != end_frame)
+        continue;
+      if (last_chunk) {
+        if (use_final_probs && !final_costs.empty()) {
+          typename unordered_map<Token*, BaseFloat>::const_iterator iter =
+              final_costs.find(tok);
+          if (iter != final_costs.end())
+            ofst->SetFinal(cur_state, LatticeWeight(iter->second, 0));
+        } else {
+          ofst->SetFinal(cur_state, LatticeWeight::One());
+        }
+      } else {
+        if (super_final == fst::kNoStateId) {
+          super_final = ofst->AddState();
+          ofst->SetFinal(super_final, LatticeWeight::One());
+        }
+        KALDI_ASSERT(exit_costs->size() < kBoundaryLabelRange);
+        Label label = exit_label_offset + exit_costs->size();
+        (*exit_labels)[tok] = label;
+        // tok->extra_cost is the difference between the cost of the best path
+        // through this token and the overall best cost.  The cost on the arc
+        // at the start of the next chunk is tok->tot_cost, so the total is the
+        // extra cost.
+        exit_costs->push_back(tok->extra_cost);
+        ofst->AddArc(cur_state,
+                     Arc(0, label, Weight(tok->extra_cost - tok->tot_cost, 0.0),
+                         super_final));
+      }
+    }
+  }
+  fst::Connect(ofst);
+  return (ofst->NumStates() != 0);
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::AppendChunk(
+    const CompactLattice &chunk, Label exit_label_offset,
+    std::vector<std::pair<int32, size_t> > *exit_arcs) {
+  typedef CompactLatticeArc::StateId StateId;
+  typedef CompactLatticeArc::Weight Weight;
+  CompactLattice *clat = &determinized_lat_;
+
+  KALDI_ASSERT(last_chunk_num_states_ == 0 && last_chunk_saved_arcs_.empty());
+  bool first_chunk = (num_determinized_states_ == 0);
+  StateId offset = num_determinized_states_;
+  exit_arcs->clear();
+  // Any states after offset are left over from a chunk that was removed;
+  // they have no arcs and are reused.
+  while (clat->NumStates() < offset + chunk.NumStates())
+    clat->AddState();
+  for (StateId s = 0; s < chunk.NumStates(); s++) {
+    clat->SetFinal(s + offset, chunk.Final(s));
+    size_t arc_index = 0;
+    for (fst::ArcIterator<CompactLattice> aiter(chunk, s); !aiter.Done();
+         aiter.Next(), arc_index++) {
+      CompactLatticeArc arc = aiter.Value();
+      arc.nextstate += offset;
+      clat->AddArc(s + offset, arc);
+      if (exit_label_offset != 0 && arc.ilabel >= exit_label_offset &&
+          arc.ilabel < exit_label_offset + kBoundaryLabelRange)
+        exit_arcs->push_back(std::pair<int32, size_t>(s + offset, arc_index));
+    }
+  }
+  last_chunk_num_states_ = chunk.NumStates();
+  if (first_chunk) {
+    clat->SetStart(chunk.Start() + offset);
+    return;
+  }
+  // The arcs leaving the start state of the chunk have the labels of the
+  // tokens on the boundary frame.
+  unordered_map<Label, const CompactLatticeArc*> entry_arcs;
+  for (fst::ArcIterator<CompactLattice> aiter(chunk, chunk.Start());
+       !aiter.Done(); aiter.Next()) {
+    const CompactLatticeArc &arc = aiter.Value();
+    KALDI_ASSERT(arc.ilabel >= boundary_label_offset_ &&
+                 arc.ilabel < boundary_label_offset_ + kBoundaryLabelRange);
+    entry_arcs[arc.ilabel] = &arc;
+  }
+  // Redirect each arc in "clat" that ended in a boundary label to the
+  // corresponding state in the chunk.  Arcs with labels that are not
+  // present in the chunk (because the token was pruned) lead to dead ends.
+  last_chunk_saved_arcs_.resize(boundary_arcs_.size());
+  last_chunk_saved_finals_.resize(boundary_arcs_.size());
+  for (size_t i = 0; i < boundary_arcs_.size(); i++) {
+    StateId s = boundary_arcs_[i].first;
+    fst::MutableArcIterator<CompactLattice> aiter(clat, s);
+    aiter.Seek(boundary_arcs_[i].second);
+    CompactLatticeArc arc = aiter.Value();
+    StateId boundary_state = arc.nextstate;
+    KALDI_ASSERT(clat->NumArcs(boundary_state) == 0);
+    last_chunk_saved_arcs_[i] = arc;
+    last_chunk_saved_finals_[i] = clat->Final(boundary_state);
+  }
+  for (size_t i = 0; i < boundary_arcs_.size(); i++) {
+    CompactLatticeArc arc = last_chunk_saved_arcs_[i];
+    // Several boundary arcs may lead to the same state, so we only change
+    // its final-prob once we have saved all of them.
+    clat->SetFinal(arc.nextstate, Weight::Zero());
+    unordered_map<Label, const CompactLatticeArc*>::const_iterator iter =
+        entry_arcs.find(arc.ilabel);
+    if (iter == entry_arcs.end())
+      continue;
+    const CompactLatticeArc &entry_arc = *(iter->second);
+    Weight weight = fst::Times(fst::Times(arc.weight,
+                                          last_chunk_saved_finals_[i]),
+                               entry_arc.weight);
+    // Remove the costs that GetRawLatticeChunk() added to the paths
+    // through this token.
+    BaseFloat cost = boundary_costs_[arc.ilabel - boundary_label_offset_];
+    weight.SetWeight(LatticeWeight(weight.Weight().Value1() - cost,
+                                   weight.Weight().Value2()));
+    arc.ilabel = 0;
+    arc.olabel = 0;
+    arc.weight = weight;
+    arc.nextstate = entry_arc.nextstate + offset;
+    fst::MutableArcIterator<CompactLattice> aiter(clat, boundary_arcs_[i].first);
+    aiter.Seek(boundary_arcs_[i].second);
+    aiter.SetValue(arc);
+  }
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::RemoveLastChunk() {
+  typedef CompactLatticeArc::StateId StateId;
+  for (size_t i = 0; i < last_chunk_saved_arcs_.size(); i++) {
+    fst::MutableArcIterator<CompactLattice> aiter(&determinized_lat_,
+                                                  boundary_arcs_[i].first);
+    aiter.Seek(boundary_arcs_[i].second);
+    aiter.SetValue(last_chunk_saved_arcs_[i]);
+    determinized_lat_.SetFinal(last_chunk_saved_arcs_[i].nextstate,
+                               last_chunk_saved_finals_[i]);
+  }
+  for (StateId s = num_determinized_states_;
+       s < num_determinized_states_ + last_chunk_num_states_; s++) {
+    determinized_lat_.DeleteArcs(s);
+    determinized_lat_.SetFinal(s, CompactLatticeWeight::Zero());
+  }
+  if (num_determinized_states_ == 0)
+    determinized_lat_.SetStart(fst::kNoStateId);
+  last_chunk_num_states_ = 0;
+  last_chunk_saved_arcs_.clear();
+  last_chunk_saved_finals_.clear();
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::DeterminizeIncremental(
+    const TransitionModel &trans_model, int32 num_frames) {
+  KALDI_ASSERT(num_frames > num_frames_determinized_ &&
+               num_frames <= NumFramesDecoded() && !decoding_finalized_);
+  KALDI_ASSERT(config_.det_opts.word_determinize &&
+               "Incremental determinization requires --word-determinize=true");
+  // Take away the provisional last chunk added by GetLatticeIncremental().
+  RemoveLastChunk();
+  // Make sure the extra_cost values of the tokens are up to date, as we use
+  // them in GetRawLatticeChunk().
+  PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
+
+  Label exit_label_offset = kBoundaryLabelOffset;
+  if (boundary_label_offset_ == kBoundaryLabelOffset)
+    exit_label_offset += kBoundaryLabelRange;
+  Lattice raw_lat;
+  unordered_map<Token*, Label> exit_labels;
+  std::vector<BaseFloat> exit_costs;
+  if (!GetRawLatticeChunk(num_frames_determinized_, num_frames, false,
+                          exit_label_offset, &raw_lat, &exit_labels,
+                          &exit_costs)) {
+    KALDI_WARN << "Not determinizing lattice incrementally: no tokens.";
+    return;
+  }
+  CompactLattice chunk;
+  if (!DeterminizeLatticePhonePrunedWrapper(trans_model, &raw_lat,
+                                            config_.lattice_beam, &chunk,
+                                            config_.det_opts))
+    KALDI_WARN << "Determinization finished earlier than the beam";
+  if (chunk.NumStates() == 0) {
+    KALDI_WARN << "Not determinizing lattice incrementally: empty lattice.";
+    return;
+  }
+  std::vector<std::pair<int32, size_t> > exit_arcs;
+  AppendChunk(chunk, exit_label_offset, &exit_arcs);
+  // Make the chunk permanent.
+  num_determinized_states_ += last_chunk_num_states_;
+  last_chunk_num_states_ = 0;
+  last_chunk_saved_arcs_.clear();
+  last_chunk_saved_finals_.clear();
+  boundary_arcs_.swap(exit_arcs);
+  boundary_labels_.swap(exit_labels);
+  boundary_costs_.swap(exit_costs);
+  boundary_label_offset_ = exit_label_offset;
+  num_frames_determinized_ = num_frames;
+}
+
+
+template <template <class, class> class HashListType>
+const CompactLattice *
+LatticeFasterOnlineDecoderTpl<HashListType>::GetLatticeIncremental(
+    const TransitionModel &trans_model, bool use_final_probs) {
+  RemoveLastChunk();
+  Lattice raw_lat;
+  if (!GetRawLatticeChunk(num_frames_determinized_, NumFramesDecoded(),
+                          use_final_probs, 0, &raw_lat, NULL, NULL))
+    return NULL;
+  CompactLattice chunk;
+  if (!DeterminizeLatticePhonePrunedWrapper(trans_model, &raw_lat,
+                                            config_.lattice_beam, &chunk,
+                                            config_.det_opts))
+    KALDI_WARN << "Determinization finished earlier than the beam";
+  if (chunk.NumStates() == 0)
+    return NULL;
+  std::vector<std::pair<int32, size_t> > exit_arcs;
+  AppendChunk(chunk, 0, &exit_arcs);
+  return &determinized_lat_;
+}
+
+
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::PossiblyResizeHash(
+    size_t num_toks) {
   size_t new_sz = static_cast<size_t>(static_cast<BaseFloat>(num_toks)
                                       * config_.hash_ratio);
   if (new_sz > toks_.Size()) {
@@ -333,12 +749,26 @@ void LatticeFasterOnlineDecoder::PossiblyResizeHash(size_t num_toks) {
   }
 }
 
+template <template <class, class> class HashListType>
+inline void LatticeFasterOnlineDecoderTpl<HashListType>::DeleteForwardLinks(
+    Token *tok) {
+  ForwardLink *l = tok->links, *m;
+  while (l != NULL) {
+    m = l->next;
+    link_pool_.Delete(l);
+    l = m;
+  }
+  tok->links = NULL;
+}
+
 // FindOrAddToken either locates a token in hash of toks_,
 // or if necessary inserts a new, empty token (i.e. with no forward links)
 // for the current frame.  [note: it's inserted if necessary into hash toks_
 // and also into the singly linked list of tokens active on this frame
 // (whose head is at active_toks_[frame]).
-inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddToken(
+template <template <class, class> class HashListType>
+inline typename LatticeFasterOnlineDecoderTpl<HashListType>::Token *
+LatticeFasterOnlineDecoderTpl<HashListType>::FindOrAddToken(
     StateId state, int32 frame_plus_one, BaseFloat tot_cost,
     Token *backpointer, bool *changed) {
   // Returns the Token pointer.  Sets "changed" (if non-NULL) to true
@@ -351,7 +781,8 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
     // tokens on the currently final frame have zero extra_cost
     // as any of them could end up
     // on the winning path.
-    Token *new_tok = new Token (tot_cost, extra_cost, NULL, toks, backpointer);
+    Token *new_tok = new (token_pool_.Allocate()) Token(
+        tot_cost, extra_cost, NULL, toks, backpointer);
     // NULL: no forward links yet
     toks = new_tok;
     num_toks_++;
@@ -381,7 +812,8 @@ inline LatticeFasterOnlineDecoder::Token *LatticeFasterOnlineDecoder::FindOrAddT
 // prunes outgoing links for all tokens in active_toks_[frame]
 // it's called by PruneActiveTokens
 // all links, that have link_extra_cost > lattice_beam are pruned
-void LatticeFasterOnlineDecoder::PruneForwardLinks(
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::PruneForwardLinks(
     int32 frame_plus_one, bool *extra_costs_changed,
     bool *links_pruned, BaseFloat delta) {
   // delta is the amount by which the extra_costs must change
@@ -425,7 +857,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Delete(link);
           link = next_link;  // advance link but leave prev_link the same.
           *links_pruned = true;
         } else {   // keep the link and update the tok_extra_cost if needed.
@@ -457,14 +889,15 @@ void LatticeFasterOnlineDecoder::PruneForwardLinks(
 // PruneForwardLinksFinal is a version of PruneForwardLinks that we call
 // on the final frame.  If there are final tokens active, it uses
 // the final-probs for pruning, otherwise it treats all tokens as final.
-void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::PruneForwardLinksFinal() {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame_plus_one = active_toks_.size() - 1;
 
   if (active_toks_[frame_plus_one].toks == NULL )  // empty list; should not happen.
     KALDI_WARN << "No tokens alive at end of file\n";
 
-  typedef unordered_map<Token*, BaseFloat>::const_iterator IterType;
+  typedef typename unordered_map<Token*, BaseFloat>::const_iterator IterType;
   ComputeFinalCosts(&final_costs_, &final_relative_cost_, &final_best_cost_);
   decoding_finalized_ = true;
   // We call DeleteElems() as a nicety, not because it's really necessary;
@@ -512,7 +945,7 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
           ForwardLink *next_link = link->next;
           if (prev_link != NULL) prev_link->next = next_link;
           else tok->links = next_link;
-          delete link;
+          link_pool_.Delete(link);
           link = next_link; // advance link but leave prev_link the same.
         } else { // keep the link and update the tok_extra_cost if needed.
           if (link_extra_cost < 0.0) { // this is just a precaution.
@@ -542,7 +975,9 @@ void LatticeFasterOnlineDecoder::PruneForwardLinksFinal() {
 
 }
 
-BaseFloat LatticeFasterOnlineDecoder::FinalRelativeCost() const {
+template <template <class, class> class HashListType>
+BaseFloat LatticeFasterOnlineDecoderTpl<HashListType>::FinalRelativeCost()
+    const {
   if (!decoding_finalized_) {
     BaseFloat relative_cost;
     ComputeFinalCosts(NULL, &relative_cost, NULL);
@@ -559,7 +994,9 @@ BaseFloat LatticeFasterOnlineDecoder::FinalRelativeCost() const {
 // [we don't do this in PruneForwardLinks because it would give us
 // a problem with dangling pointers].
 // It's called by PruneActiveTokens if any forward links have been pruned
-void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::PruneTokensForFrame(
+    int32 frame_plus_one) {
   KALDI_ASSERT(frame_plus_one >= 0 && frame_plus_one < active_toks_.size());
   Token *&toks = active_toks_[frame_plus_one].toks;
   if (toks == NULL)
@@ -572,7 +1009,7 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
       // excise tok from list and delete tok.
       if (prev_tok != NULL) prev_tok->next = tok->next;
       else toks = tok->next;
-      delete tok;
+      token_pool_.Delete(tok);
       num_toks_--;
     } else {  // fetch next Token
       prev_tok = tok;
@@ -585,7 +1022,9 @@ void LatticeFasterOnlineDecoder::PruneTokensForFrame(int32 frame_plus_one) {
 // that.  We go backwards through the frames and stop when we reach a point
 // where the delta-costs are not changing (and the delta controls when we consider
 // a cost to have "not changed").
-void LatticeFasterOnlineDecoder::PruneActiveTokens(BaseFloat delta) {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::PruneActiveTokens(
+    BaseFloat delta) {
   int32 cur_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // The index "f" below represents a "frame plus one", i.e. you'd have to subtract
@@ -614,7 +1053,8 @@ void LatticeFasterOnlineDecoder::PruneActiveTokens(BaseFloat delta) {
                 << " to " << num_toks_;
 }
 
-void LatticeFasterOnlineDecoder::ComputeFinalCosts(
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::ComputeFinalCosts(
     unordered_map<Token*, BaseFloat> *final_costs,
     BaseFloat *final_relative_cost,
     BaseFloat *final_best_cost) const {
@@ -657,7 +1097,9 @@ void LatticeFasterOnlineDecoder::ComputeFinalCosts(
 }
 
 
-LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPathEnd(
+template <template <class, class> class HashListType>
+typename LatticeFasterOnlineDecoderTpl<HashListType>::BestPathIterator
+LatticeFasterOnlineDecoderTpl<HashListType>::BestPathEnd(
     bool use_final_probs,
     BaseFloat *final_cost_out) const {
   if (decoding_finalized_ && !use_final_probs)
@@ -683,7 +1125,8 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPat
     if (use_final_probs && !final_costs.empty()) {
       // if we are instructed to use final-probs, and any final tokens were
       // active on final frame, include the final-prob in the cost of the token.
-      unordered_map<Token*, BaseFloat>::const_iterator iter = final_costs.find(tok);
+      typename unordered_map<Token*, BaseFloat>::const_iterator iter =
+          final_costs.find(tok);
       if (iter != final_costs.end()) {
         final_cost = iter->second;
         cost += final_cost;
@@ -708,7 +1151,9 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::BestPat
 }
 
 
-LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::TraceBackBestPath(
+template <template <class, class> class HashListType>
+typename LatticeFasterOnlineDecoderTpl<HashListType>::BestPathIterator
+LatticeFasterOnlineDecoderTpl<HashListType>::TraceBackBestPath(
     BestPathIterator iter, LatticeArc *oarc) const {
   KALDI_ASSERT(!iter.Done() && oarc != NULL);
   Token *tok = static_cast<Token*>(iter.tok);
@@ -744,8 +1189,9 @@ LatticeFasterOnlineDecoder::BestPathIterator LatticeFasterOnlineDecoder::TraceBa
 }
 
 
-void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
-                                                   int32 max_num_frames) {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::AdvanceDecoding(
+    DecodableInterface *decodable, int32 max_num_frames) {
   KALDI_ASSERT(!active_toks_.empty() && !decoding_finalized_ &&
                "You must call InitDecoding() before AdvanceDecoding");
   int32 num_frames_ready = decodable->NumFramesReady();
@@ -762,9 +1208,8 @@ void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
     if (NumFramesDecoded() % config_.prune_interval == 0) {
       PruneActiveTokens(config_.lattice_beam * config_.prune_scale);
     }
-    // note: ProcessEmitting() increments NumFramesDecoded().
-    BaseFloat cost_cutoff = ProcessEmitting(decodable);
-    ProcessNonemitting(cost_cutoff);
+    // note: ProcessFrame() increments NumFramesDecoded().
+    ProcessFrame(decodable);
   }
 }
 
@@ -772,7 +1217,8 @@ void LatticeFasterOnlineDecoder::AdvanceDecoding(DecodableInterface *decodable,
 // FinalizeDecoding() is a version of PruneActiveTokens that we call
 // (optionally) on the final frame.  Takes into account the final-prob of
 // tokens.  This function used to be called PruneActiveTokensFinal().
-void LatticeFasterOnlineDecoder::FinalizeDecoding() {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::FinalizeDecoding() {
   int32 final_frame_plus_one = NumFramesDecoded();
   int32 num_toks_begin = num_toks_;
   // PruneForwardLinksFinal() prunes final frame (with final-probs), and
@@ -789,12 +1235,35 @@ void LatticeFasterOnlineDecoder::FinalizeDecoding() {
                 << " to " << num_toks_;
 }
 
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::ProcessFrame(
+    DecodableInterface *decodable) {
+  if (!LatticeFasterBeamController::Enabled(config_)) {
+    BaseFloat cost_cutoff = ProcessEmitting(decodable);
+    ProcessNonemitting(cost_cutoff);
+    return;
+  }
+  Timer timer;
+  int32 num_toks_begin = num_toks_;
+  BaseFloat cost_cutoff = ProcessEmitting(decodable);
+  ProcessNonemitting(cost_cutoff);
+  // Tokens are only deleted in PruneActiveTokens(), so this is the number of
+  // tokens on the new frame.
+  beam_controller_.Update(config_, num_toks_ - num_toks_begin,
+                          timer.Elapsed() * 1.0e+06);
+  KALDI_VLOG(6) << "Beam for frame " << NumFramesDecoded() << " is "
+                << beam_controller_.Beam();
+}
+
 /// Gets the weight cutoff.  Also counts the active tokens.
-BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_count,
-                                                BaseFloat *adaptive_beam, Elem **best_elem) {
+template <template <class, class> class HashListType>
+BaseFloat LatticeFasterOnlineDecoderTpl<HashListType>::GetCutoff(
+    Elem *list_head, size_t *tok_count, BaseFloat *adaptive_beam,
+    Elem **best_elem) {
   BaseFloat best_weight = std::numeric_limits<BaseFloat>::infinity();
   // positive == high cost == bad.
   size_t count = 0;
+  BaseFloat beam = beam_controller_.Beam();
   if (config_.max_active == std::numeric_limits<int32>::max() &&
       config_.min_active == 0) {
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -805,8 +1274,8 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
       }
     }
     if (tok_count != NULL) *tok_count = count;
-    if (adaptive_beam != NULL) *adaptive_beam = config_.beam;
-    return best_weight + config_.beam;
+    if (adaptive_beam != NULL) *adaptive_beam = beam;
+    return best_weight + beam;
   } else {
     tmp_array_.clear();
     for (Elem *e = list_head; e != NULL; e = e->tail, count++) {
@@ -819,7 +1288,7 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
     }
     if (tok_count != NULL) *tok_count = count;
     
-    BaseFloat beam_cutoff = best_weight + config_.beam,
+    BaseFloat beam_cutoff = best_weight + beam,
         min_active_cutoff = std::numeric_limits<BaseFloat>::infinity(),
         max_active_cutoff = std::numeric_limits<BaseFloat>::infinity();
 
@@ -854,14 +1323,15 @@ BaseFloat LatticeFasterOnlineDecoder::GetCutoff(Elem *list_head, size_t *tok_cou
         *adaptive_beam = min_active_cutoff - best_weight + config_.beam_delta;
       return min_active_cutoff;
     } else {
-      *adaptive_beam = config_.beam;
+      *adaptive_beam = beam;
       return beam_cutoff;
     }
   }
 }
 
 
-BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
+template <template <class, class> class HashListType>
+BaseFloat LatticeFasterOnlineDecoderTpl<HashListType>::ProcessEmitting(
     DecodableInterface *decodable) {
   KALDI_ASSERT(active_toks_.size() > 0);
   int32 frame = active_toks_.size() - 1; // frame is the frame-index
@@ -919,7 +1389,7 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
     // loop this way because we delete "e" as we go.
     StateId state = e->key;
     Token *tok = e->val;
-    if (tok->tot_cost <=  cur_cutoff) {
+    if (tok->tot_cost <= cur_cutoff) {
       for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
            !aiter.Done();
            aiter.Next()) {
@@ -940,8 +1410,8 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
           // NULL: no change indicator needed
 
           // Add ForwardLink from tok to next_tok (put on head of list tok->links)
-          tok->links = new ForwardLink(next_tok, arc.ilabel, arc.olabel,
-                                       graph_cost, ac_cost, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLink(
+              next_tok, arc.ilabel, arc.olabel, graph_cost, ac_cost, tok->links);
         }
       } // for all arcs
     }
@@ -951,7 +1421,9 @@ BaseFloat LatticeFasterOnlineDecoder::ProcessEmitting(
   return next_cutoff;
 }
 
-void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::ProcessNonemitting(
+    BaseFloat cutoff) {
   KALDI_ASSERT(!active_toks_.empty());
   int32 frame = static_cast<int32>(active_toks_.size()) - 2;
   // Note: "frame" is the time-index we just processed, or -1 if
@@ -986,8 +1458,7 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
     // because we're about to regenerate them.  This is a kind
     // of non-optimality (remember, this is the simple decoder),
     // but since most states are emitting it's not a huge issue.
-    tok->DeleteForwardLinks(); // necessary when re-visiting
-    tok->links = NULL;
+    DeleteForwardLinks(tok); // necessary when re-visiting
     for (fst::ArcIterator<fst::Fst<Arc> > aiter(fst_, state);
          !aiter.Done();
          aiter.Next()) {
@@ -1001,8 +1472,8 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
           Token *new_tok = FindOrAddToken(arc.nextstate, frame + 1, tot_cost,
                                           tok, &changed);
 
-          tok->links = new ForwardLink(new_tok, 0, arc.olabel,
-                                       graph_cost, 0, tok->links);
+          tok->links = new (link_pool_.Allocate()) ForwardLink(
+              new_tok, 0, arc.olabel, graph_cost, 0, tok->links);
 
           // "changed" tells us whether the new token has a different
           // cost from before, or is new [if so, add into queue].
@@ -1014,7 +1485,8 @@ void LatticeFasterOnlineDecoder::ProcessNonemitting(BaseFloat cutoff) {
 }
 
 
-void LatticeFasterOnlineDecoder::DeleteElems(Elem *list) {
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::DeleteElems(Elem *list) {
   for (Elem *e = list, *e_tail; e != NULL; e = e_tail) {
     // Token::TokenDelete(e->val);
     e_tail = e->tail;
@@ -1022,27 +1494,25 @@ void LatticeFasterOnlineDecoder::DeleteElems(Elem *list) {
   }
 }
 
-void LatticeFasterOnlineDecoder::ClearActiveTokens() { // a cleanup routine, at utt end/begin
-  for (size_t i = 0; i < active_toks_.size(); i++) {
-    // Delete all tokens alive on this frame, and any forward
-    // links they may have.
-    for (Token *tok = active_toks_[i].toks; tok != NULL; ) {
-      tok->DeleteForwardLinks();
-      Token *next_tok = tok->next;
-      delete tok;
-      num_toks_--;
-      tok = next_tok;
-    }
-  }
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::ClearActiveTokens() {
+  // a cleanup routine, at utt end/begin
+  // All tokens alive on any frame, and any forward links they may have, were
+  // allocated from token_pool_ and link_pool_, so we can free them all at once
+  // without traversing the lists.
+  KALDI_ASSERT(token_pool_.NumInUse() == static_cast<size_t>(num_toks_));
+  token_pool_.Reset();
+  link_pool_.Reset();
+  num_toks_ = 0;
   active_toks_.clear();
-  KALDI_ASSERT(num_toks_ == 0);
 }
 
 // static
-void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
+template <template <class, class> class HashListType>
+void LatticeFasterOnlineDecoderTpl<HashListType>::TopSortTokens(Token *tok_list,
                                                std::vector<Token*> *topsorted_list) {
   unordered_map<Token*, int32> token2pos;
-  typedef unordered_map<Token*, int32>::iterator IterType;
+  typedef typename unordered_map<Token*, int32>::iterator IterType;
   int32 num_toks = 0;
   for (Token *tok = tok_list; tok != NULL; tok = tok->next)
     num_toks++;
@@ -1084,11 +1554,11 @@ void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
   for (loop_count = 0;
        !reprocess.empty() && loop_count < max_loop; ++loop_count) {
     std::vector<Token*> reprocess_vec;
-    for (unordered_set<Token*>::iterator iter = reprocess.begin();
+    for (typename unordered_set<Token*>::iterator iter = reprocess.begin();
          iter != reprocess.end(); ++iter)
       reprocess_vec.push_back(*iter);
     reprocess.clear();
-    for (std::vector<Token*>::iterator iter = reprocess_vec.begin();
+    for (typename std::vector<Token*>::iterator iter = reprocess_vec.begin();
          iter != reprocess_vec.end(); ++iter) {
       Token *tok = *iter;
       int32 pos = token2pos[tok];
@@ -1116,7 +1586,9 @@ void LatticeFasterOnlineDecoder::TopSortTokens(Token *tok_list,
     (*topsorted_list)[iter->second] = iter->first;
 }
 
-
-
+// Instantiate the template for the two types of token container; see
+// open-hash-list.h.
+template class LatticeFasterOnlineDecoderTpl<HashList>;
+template class LatticeFasterOnlineDecoderTpl<OpenHashList>;
 
 } // end namespace kaldi.
@@ -28,6 +28,8 @@
 
 #include "util/stl-utils.h"
 #include "util/hash-list.h"
+#include "util/open-hash-list.h"
+#include "util/memory-pool.h"
 #include "fst/fstlib.h"
 #include "itf/decodable-itf.h"
 #include "fstext/fstext-lib.h"
@@ -40,11 +42,16 @@ namespace kaldi {
 
 
 
-/** LatticeFasterOnlineDecoder is as LatticeFasterDecoder but also supports an
-    efficient way to get the best path (see the function BestPathEnd()), which
-    is useful in endpointing.
+/** LatticeFasterOnlineDecoderTpl is as LatticeFasterDecoderTpl but also
+    supports an efficient way to get the best path (see the function
+    BestPathEnd()), which is useful in endpointing.  The template argument
+    HashListType is the container for the tokens on the current frame
+    (toks_): HashList or OpenHashList, as for LatticeFasterDecoderTpl.  Most
+    code uses LatticeFasterOnlineDecoder (below), which is the version with
+    HashList.
  */
-class LatticeFasterOnlineDecoder {
+template <template <class, class> class HashListType>
+class LatticeFasterOnlineDecoderTpl {
  public:
   typedef fst::StdArc Arc;
   typedef Arc::Label Label;
@@ -64,24 +71,25 @@ class LatticeFasterOnlineDecoder {
   };
   
   // instantiate this class once for each thing you have to decode.
-  LatticeFasterOnlineDecoder(const fst::Fst<fst::StdArc> &fst,
-                             const LatticeFasterDecoderConfig &config);
+  LatticeFasterOnlineDecoderTpl(const fst::Fst<fst::StdArc> &fst,
+                                const LatticeFasterDecoderConfig &config);
 
   // This version of the initializer "takes ownership" of the fst,
   // and will delete it when this object is destroyed.
-  LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
-                             fst::Fst<fst::StdArc> *fst);
+  LatticeFasterOnlineDecoderTpl(const LatticeFasterDecoderConfig &config,
+                                fst::Fst<fst::StdArc> *fst);
 
 
   void SetOptions(const LatticeFasterDecoderConfig &config) {
     config_ = config;
+    beam_controller_.Reset(config_);
   }
 
   const LatticeFasterDecoderConfig &GetOptions() const {
     return config_;
   }
   
-  ~LatticeFasterOnlineDecoder();
+  ~LatticeFasterOnlineDecoderTpl();
 
   /// Decodes until there are no more frames left in the "decodable" object..
   /// note, this may block waiting for input if the "decodable" object blocks.
@@ -99,15 +107,38 @@ class LatticeFasterOnlineDecoder {
   /// Outputs an FST corresponding to the single best path through the lattice.
   /// This is quite efficient because it doesn't get the entire raw lattice and find
   /// the best path through it; insterad, it uses the BestPathEnd and BestPathIterator
-  /// so it basically traces it back through the lattice.
+  /// so it basically traces it back through the lattice.  The traceback is
+  /// cached between calls, and we only trace back as far as the point where
+  /// the best path joins the one from the previous call (see
+  /// GetBestPathWords()).
   /// Returns true if result is nonempty (using the return status is deprecated,
   /// it will become void).  If "use_final_probs" is true AND we reached the
   /// final-state of the graph then it will include those as final-probs, else
   /// it will treat all final-probs as one.
+  /// Note: although this is const, it updates the cached traceback, so it is
+  /// not safe to call it (or GetBestPathWords() or TestGetBestPath()) from
+  /// more than one thread at a time without a lock, as
+  /// SingleUtteranceNnet2DecoderThreaded does.
   bool GetBestPath(Lattice *ofst,
                    bool use_final_probs = true) const;
 
   
+  /// Outputs the word sequence on the current best path, as in GetBestPath().
+  /// This is intended for getting partial results frequently during online
+  /// decoding: the best path is cached between calls, so the work done
+  /// (apart from copying the words) is proportional to the number of frames
+  /// decoded since the last call, plus the length of the part of the best path
+  /// that changed, rather than to the length of the utterance.  If
+  /// num_stable_words is non-NULL, it outputs to it the number of words at
+  /// the start of "words" that are on the best path to every token currently
+  /// active, so will not change whatever happens in the rest of the
+  /// utterance; computing this involves tracing back from all the tokens on
+  /// the last frame, but only as far as the best path.  Not thread-safe; see
+  /// GetBestPath().
+  void GetBestPathWords(bool use_final_probs,
+                        std::vector<int32> *words,
+                        int32 *num_stable_words = NULL) const;
+
   /// This function does a self-test of GetBestPath().  Returns true on
   /// success; returns false and prints a warning on failure.
   bool TestGetBestPath(bool use_final_probs = true) const;
@@ -193,6 +224,50 @@ class LatticeFasterOnlineDecoder {
   // whenever we call ProcessEmitting().
   inline int32 NumFramesDecoded() const { return active_toks_.size() - 1; }
 
+  /// Incremental determinization: this determinizes the part of the lattice
+  /// between the last frame that was already determinized (see
+  /// NumFramesDeterminized()) and frame "num_frames", and appends it to the
+  /// determinized lattice kept in this class.  The idea is to call this
+  /// periodically while decoding long utterances, with "num_frames" somewhat
+  /// behind NumFramesDecoded() so that the tokens on the frames in question
+  /// are unlikely to be pruned any more, so that GetLatticeIncremental() only
+  /// has to determinize the last part of the lattice; the time it takes is
+  /// then bounded regardless of the length of the utterance.  The pieces are
+  /// joined at the tokens active on the boundary frames.  The result has the
+  /// same word sequences as the lattice we would get by determinizing the
+  /// whole utterance, with the same best cost for each (up to pruning), but it
+  /// is not deterministic: paths with the same words before a boundary may go
+  /// through different boundary tokens and so reach different states, and
+  /// there may be epsilon arcs at the joins.  If you need a deterministic
+  /// lattice, determinize the result again.  Requires
+  /// config.det_opts.word_determinize == true.
+  void DeterminizeIncremental(const TransitionModel &trans_model,
+                              int32 num_frames);
+
+  /// Returns the number of frames that DeterminizeIncremental() has
+  /// determinized so far in this utterance (zero if it has not been called).
+  int32 NumFramesDeterminized() const { return num_frames_determinized_; }
+
+  /// Outputs the determinized lattice for the whole utterance so far.  It
+  /// determinizes the frames after NumFramesDeterminized() and joins the
+  /// result to the lattice already determinized by DeterminizeIncremental();
+  /// if that was never called it just determinizes the raw lattice.  The
+  /// meaning of "use_final_probs" is as for GetRawLattice().  The join is done
+  /// in place in the lattice kept in this class, so the time taken does not
+  /// depend on the length of the utterance; the part added here is removed
+  /// again by the next call to this function or to DeterminizeIncremental().
+  /// Returns NULL if no lattice could be produced.  The lattice returned is
+  /// owned by this class and is only valid until the next call to this
+  /// function, DeterminizeIncremental() or InitDecoding().  It is not
+  /// connected: it may contain states that are not accessible or not
+  /// coaccessible, e.g. where tokens were pruned after the previous chunk was
+  /// determinized, so call fst::Connect() on a copy of it if you need to.
+  /// Be aware that if you hold a copy of it, the next change to it will make
+  /// a deep copy (OpenFst's copy-on-write), which takes time linear in its
+  /// size.
+  const CompactLattice *GetLatticeIncremental(
+      const TransitionModel &trans_model, bool use_final_probs);
+
  private:
   // ForwardLinks are the links from a token to a token on the next frame.
   // or sometimes on the current frame (for input-epsilon links).
@@ -240,15 +315,6 @@ class LatticeFasterOnlineDecoder {
                  Token *next, Token *backpointer):
         tot_cost(tot_cost), extra_cost(extra_cost), links(links), next(next),
         backpointer(backpointer) { }
-    inline void DeleteForwardLinks() {
-      ForwardLink *l = links, *m;
-      while (l != NULL) {
-        m = l->next;
-        delete l;
-        l = m;
-      }
-      links = NULL;
-    }
   };
 
   // head of per-frame list of Tokens (list is in topological order),
@@ -261,10 +327,14 @@ class LatticeFasterOnlineDecoder {
                  must_prune_tokens(true) { }
   };
 
-  typedef HashList<StateId, Token*>::Elem Elem;
+  typedef HashListType<StateId, Token*> TokenHash;
+  typedef typename TokenHash::Elem Elem;
 
   void PossiblyResizeHash(size_t num_toks);
 
+  // Deletes all the forward links of "tok", returning them to link_pool_.
+  inline void DeleteForwardLinks(Token *tok);
+
   // FindOrAddToken either locates a token in hash of toks_, or if necessary
   // inserts a new, empty token (i.e. with no forward links) for the current
   // frame.  [note: it's inserted if necessary into hash toks_ and also into the
@@ -343,15 +413,19 @@ class LatticeFasterOnlineDecoder {
   /// ProcessEmitting() on each frame.  The cost cutoff is computed by the
   /// preceding ProcessEmitting().
   void ProcessNonemitting(BaseFloat cost_cutoff);
-  
-  // HashList defined in ../util/hash-list.h.  It actually allows us to maintain
-  // more than one list (e.g. for current and previous frames), but only one of
-  // them at a time can be indexed by StateId.  It is indexed by frame-index
-  // plus one, where the frame-index is zero-based, as used in decodable object.
-  // That is, the emitting probs of frame t are accounted for in tokens at
-  // toks_[t+1].  The zeroth frame is for nonemitting transition at the start of
-  // the graph.
-  HashList<StateId, Token*> toks_;
+
+  /// Calls ProcessEmitting() and ProcessNonemitting() for one frame, and
+  /// updates beam_controller_ if the beam is adaptive.
+  void ProcessFrame(DecodableInterface *decodable);
+
+  // HashList defined in ../util/hash-list.h (or OpenHashList, see above).  It
+  // actually allows us to maintain more than one list (e.g. for current and
+  // previous frames), but only one of them at a time can be indexed by
+  // StateId.  It is indexed by frame-index plus one, where the frame-index is
+  // zero-based, as used in decodable object.  That is, the emitting probs of
+  // frame t are accounted for in tokens at toks_[t+1].  The zeroth frame is
+  // for nonemitting transition at the start of the graph.
+  TokenHash toks_;
 
   std::vector<TokenList> active_toks_; // Lists of tokens, indexed by
   // frame (members of TokenList are toks, must_prune_forward_links,
@@ -366,6 +440,15 @@ class LatticeFasterOnlineDecoder {
   // frame in order to keep everything in a nice dynamic range.
   LatticeFasterDecoderConfig config_;
   int32 num_toks_; // current total #toks allocated...
+  // Gives the beam to use on each frame; it is always config_.beam unless
+  // config_.target_active or config_.target_frame_usec is set.
+  LatticeFasterBeamController beam_controller_;
+
+  // Tokens and ForwardLinks are allocated from these pools rather than with
+  // new and delete; the memory is reused between frames and utterances, and
+  // ClearActiveTokens() frees everything at once by resetting the pools.
+  MemoryPool<Token> token_pool_;
+  MemoryPool<ForwardLink> link_pool_;
   bool warned_;
 
   /// decoding_finalized_ is true if someone called FinalizeDecoding().  [note,
@@ -406,8 +489,112 @@ class LatticeFasterOnlineDecoder {
 
   void ClearActiveTokens();
 
+  // The cached best path (see GetBestPathWords()).  best_path_ contains, for
+  // each token on the best path in order from the start, the token, the
+  // frame-index as in BestPathIterator, the arc leading to it that
+  // TraceBackBestPath() outputs, and the number of words on the path up to
+  // and including that arc.  best_path_index_ maps each token in it to its
+  // position.  best_path_words_ is the word sequence of the path.  These are
+  // mutable because the const functions GetBestPath() and GetBestPathWords()
+  // update them; they are not guarded by any lock.
+  struct BestPathElem {
+    Token *tok;
+    int32 frame;
+    LatticeArc arc;
+    int32 num_words;
+  };
+  mutable std::vector<BestPathElem> best_path_;
+  mutable unordered_map<Token*, size_t> best_path_index_;
+  mutable std::vector<int32> best_path_words_;
+
+  // Updates best_path_ and the related variables to the path that ends at
+  // "iter", which should have been returned by BestPathEnd().  It traces back
+  // until it reaches a token in the cached path.  Tokens in best_path_ may
+  // have been deleted since the last call, but their memory can only have
+  // been reused for tokens on later frames, so we check the frame as well as
+  // the pointer.
+  void UpdateBestPath(BestPathIterator iter) const;
+
+  // Variables and functions used in incremental determinization.  The
+  // lattice is split into chunks at "boundary frames".  In the raw lattice
+  // for a chunk, every token on the last frame has an arc to a super-final
+  // state whose label identifies the token, and (except for the first chunk)
+  // the start state has an arc with that same label to each token on the
+  // first frame.  After determinization these labels show us where to join
+  // each chunk to the previous one.  The labels are in two ranges, starting
+  // at kBoundaryLabelOffset and kBoundaryLabelOffset + kBoundaryLabelRange,
+  // which we use for alternate boundaries so that the labels at the start
+  // and end of a chunk never clash.
+  static const Label kBoundaryLabelOffset = 1000000000;
+  static const Label kBoundaryLabelRange = 100000000;
+
+  // Outputs the raw lattice for the tokens on frames begin_frame through
+  // end_frame, as described above.  If exit_labels is NULL this is the last
+  // chunk, and it has final-probs as in GetRawLattice(); otherwise this
+  // function assigns labels starting from exit_label_offset to the tokens on
+  // end_frame, and outputs them to "exit_labels", and also outputs the
+  // costs we put on the arcs with those labels (and on the corresponding
+  // arcs at the start of the next chunk) to "exit_costs", indexed by label
+  // minus exit_label_offset; these costs make pruned determinization prune
+  // the chunk correctly, and are removed again when we join the chunks.
+  bool GetRawLatticeChunk(int32 begin_frame, int32 end_frame,
+                          bool use_final_probs, Label exit_label_offset,
+                          Lattice *ofst,
+                          unordered_map<Token*, Label> *exit_labels,
+                          std::vector<BaseFloat> *exit_costs) const;
+
+  // Appends the determinized lattice "chunk" to determinized_lat_, joining it
+  // at the arcs listed in boundary_arcs_; outputs to "exit_arcs" the arcs at
+  // the end of "chunk" with labels starting from exit_label_offset (if
+  // exit_label_offset != 0).  The states of "chunk" are put after the first
+  // num_determinized_states_ states, and the arcs and final-probs it changes
+  // are saved, so that RemoveLastChunk() can undo it.
+  void AppendChunk(const CompactLattice &chunk, Label exit_label_offset,
+                   std::vector<std::pair<int32, size_t> > *exit_arcs);
+
+  // Undoes the last call to AppendChunk(), unless DeterminizeIncremental() has
+  // made it permanent.  The states it added are left in place with no arcs,
+  // to be reused by the next call to AppendChunk().
+  void RemoveLastChunk();
+
+  // The lattice up to frame num_frames_determinized_, determinized, which
+  // consists of the first num_determinized_states_ states; its paths end in
+  // arcs with the boundary labels, which are listed in boundary_arcs_ as
+  // (state, arc-index) pairs.  GetLatticeIncremental() appends the rest of the
+  // utterance to it after those states, as a provisional last chunk with
+  // last_chunk_num_states_ states, saving the boundary arcs and the final-probs
+  // of the states they lead to, as they were before it was joined.
+  CompactLattice determinized_lat_;
+  int32 num_frames_determinized_;
+  int32 num_determinized_states_;
+  std::vector<std::pair<int32, size_t> > boundary_arcs_;
+  int32 last_chunk_num_states_;
+  std::vector<CompactLatticeArc> last_chunk_saved_arcs_;
+  std::vector<CompactLatticeWeight> last_chunk_saved_finals_;
+  // The labels for the tokens on frame num_frames_determinized_, the offset
+  // of the range they are in, and the costs we added to the paths through
+  // them (see GetRawLatticeChunk()).
+  unordered_map<Token*, Label> boundary_labels_;
+  Label boundary_label_offset_;
+  std::vector<BaseFloat> boundary_costs_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoderTpl);
+};
+
 
-  KALDI_DISALLOW_COPY_AND_ASSIGN(LatticeFasterOnlineDecoder);
+class LatticeFasterOnlineDecoder:
+      public LatticeFasterOnlineDecoderTpl<HashList> {
+ public:
+  // instantiate this class once for each thing you have to decode.
+  LatticeFasterOnlineDecoder(const fst::Fst<fst::StdArc> &fst,
+                             const LatticeFasterDecoderConfig &config):
+      LatticeFasterOnlineDecoderTpl<HashList>(fst, config) { }
+
+  // This version of the initializer "takes ownership" of the fst,
+  // and will delete it when this object is destroyed.
+  LatticeFasterOnlineDecoder(const LatticeFasterDecoderConfig &config,
+                             fst::Fst<fst::StdArc> *fst):
+      LatticeFasterOnlineDecoderTpl<HashList>(config, fst) { }
 };
 
 
@@ -89,12 +89,13 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
 void Fbank::Compute(const VectorBase<BaseFloat> &wave,
                     BaseFloat vtln_warp,
                     Matrix<BaseFloat> *output,
-                    Vector<BaseFloat> *wave_remainder) const {
+                    Vector<BaseFloat> *wave_remainder,
+                    RandomState *random_state) const {
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                           &must_delete_mel_banks);
   
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  ComputeInternal(wave, *mel_banks, output, wave_remainder, random_state);
   
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -104,7 +105,8 @@ void Fbank::Compute(const VectorBase<BaseFloat> &wave,
 void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
                             const MelBanks &mel_banks,
                             Matrix<BaseFloat> *output,
-                            Vector<BaseFloat> *wave_remainder) const {
+                            Vector<BaseFloat> *wave_remainder,
+                            RandomState *random_state) const {
   KALDI_ASSERT(output != NULL);
 
   // Get dimensions of output features
@@ -122,62 +124,72 @@ void Fbank::ComputeInternal(const VectorBase<BaseFloat> &wave,
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
 
+  // We process the frames in blocks of kFeatureBlockSize, so that the Mel
+  // filterbank is a matrix multiplication.
+  int32 padded_window_size = opts_.frame_opts.PaddedWindowSize(),
+      num_bins = opts_.mel_opts.num_bins,
+      block_size = std::min(rows_out, kFeatureBlockSize);
   // Buffers
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.  
-  BaseFloat log_energy;
-
-  // Compute all the freames, r is frame index..
-  for (int32 r = 0; r < rows_out; r++) {
-    // Cut the window, apply window function
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
+  Matrix<BaseFloat> windows(block_size, padded_window_size, kUndefined);
+  Vector<BaseFloat> log_energies(block_size, kUndefined);
+
+  // Compute the frames in blocks; start is the index of the first frame.
+  for (int32 start = 0; start < rows_out; start += block_size) {
+    int32 num_frames = std::min(block_size, rows_out - start);
+    SubMatrix<BaseFloat> this_windows(windows, 0, num_frames,
+                                      0, padded_window_size);
+    SubVector<BaseFloat> this_log_energies(log_energies, 0, num_frames);
+    // Cut the windows, apply window function
+    ExtractWindows(wave, start, opts_.frame_opts, feature_window_function_,
+                   &this_windows,
+                   (opts_.use_energy && opts_.raw_energy ?
+                    &this_log_energies : NULL), random_state);
 
     // Compute energy after window function (not the raw one)
     if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> window(this_windows, r);
+        this_log_energies(r) = Log(std::max(VecVec(window, window),
+                                   std::numeric_limits<BaseFloat>::min()));
+      }
 
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+    // Compute the FFTs and convert them into power spectra.
+    ComputePowerSpectra(srfft_, &this_windows);
+    SubMatrix<BaseFloat> power_spectra(this_windows, 0, num_frames,
+                                       0, padded_window_size / 2 + 1);
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    // Output buffers
+    SubMatrix<BaseFloat> this_output(*output, start, num_frames, 0, cols_out);
+    SubMatrix<BaseFloat> this_fbank(this_output, 0, num_frames,
+                                    (opts_.use_energy ? 1 : 0), num_bins);
 
-    // Sum with MelFiterbank over power spectrum
-    mel_banks.Compute(power_spectrum, &mel_energies);
+    // Sum with MelFiterbank over power spectrum, directly into the output
+    mel_banks.Compute(power_spectra, &this_fbank);
     if (opts_.use_log_fbank) {
       // avoid log of zero (which should be prevented anyway by dithering).
-      mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-      mel_energies.ApplyLog();  // take the log.
+      this_fbank.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+      this_fbank.ApplyLog();  // take the log.
     }
 
-    // Output buffers
-    SubVector<BaseFloat> this_output(output->Row(r));
-    SubVector<BaseFloat> this_fbank(this_output.Range((opts_.use_energy? 1 : 0),
-                                                      opts_.mel_opts.num_bins));
-
-    // Copy to output
-    this_fbank.CopyFromVec(mel_energies);
-    // Copy energy as first value
     if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_) {
-        log_energy = log_energy_floor_;
-      }
-      this_output(0) = log_energy;
-    }
-
-    // HTK compat: Shift features, so energy is last value
-    if (opts_.htk_compat && opts_.use_energy) {
-      BaseFloat energy = this_output(0);
-      for (int32 i = 0; i < opts_.mel_opts.num_bins; i++) {
-        this_output(i) = this_output(i+1);
+      for (int32 r = 0; r < num_frames; r++) {
+        // Copy energy as first value
+        BaseFloat log_energy = this_log_energies(r);
+        if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_) {
+          log_energy = log_energy_floor_;
+        }
+        this_output(r, 0) = log_energy;
+
+        // HTK compat: Shift features, so energy is last value
+        if (opts_.htk_compat) {
+          SubVector<BaseFloat> output_row(this_output, r);
+          BaseFloat energy = output_row(0);
+          for (int32 i = 0; i < num_bins; i++) {
+            output_row(i) = output_row(i+1);
+          }
+          output_row(num_bins) = energy;
+        }
       }
-      this_output(opts_.mel_opts.num_bins) = energy;
     }
   }
 }
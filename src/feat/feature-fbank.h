@@ -93,17 +93,21 @@ class Fbank {
                Matrix<BaseFloat> *output,
                Vector<BaseFloat> *wave_remainder = NULL);
   
-  /// Const version of Compute()
+  /// Const version of Compute().  If "random_state" is not NULL the dither is
+  /// drawn from it rather than from the global random number generator, so the
+  /// output does not depend on what other threads are doing.
   void Compute(const VectorBase<BaseFloat> &wave,
                BaseFloat vtln_warp,
                Matrix<BaseFloat> *output,
-               Vector<BaseFloat> *wave_remainder = NULL) const;
+               Vector<BaseFloat> *wave_remainder = NULL,
+               RandomState *random_state = NULL) const;
   typedef FbankOptions Options;
  private:
   void ComputeInternal(const VectorBase<BaseFloat> &wave,
                        const MelBanks &mel_banks,
                        Matrix<BaseFloat> *output,
-                       Vector<BaseFloat> *wave_remainder = NULL) const;
+                       Vector<BaseFloat> *wave_remainder = NULL,
+                       RandomState *random_state = NULL) const;
   
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
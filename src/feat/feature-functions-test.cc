@@ -92,6 +92,63 @@ void UnitTestOnlineCmvn() {
   }
 }
 
+// Checks that the block versions of the window extraction, power spectrum and
+// Mel filterbank computation agree with the frame-by-frame versions.
+void UnitTestFeatureBlocks() {
+  for (int32 i = 0; i < 20; i++) {
+    FrameExtractionOptions frame_opts;
+    frame_opts.dither = 0.0;
+    frame_opts.snip_edges = (Rand() % 2 == 0);
+    frame_opts.round_to_power_of_two = (Rand() % 2 == 0);
+    MelBanksOptions mel_opts;
+    mel_opts.num_bins = 10 + Rand() % 20;
+    mel_opts.htk_mode = (Rand() % 2 == 0);
+    FeatureWindowFunction window_function(frame_opts);
+    MelBanks mel_banks(mel_opts, frame_opts, 1.0);
+
+    Vector<BaseFloat> wave(1000 + Rand() % 5000);
+    wave.SetRandn();
+    wave.Scale(1000.0);
+    int32 num_frames = NumFrames(wave.Dim(), frame_opts),
+        padded_window_size = frame_opts.PaddedWindowSize(),
+        first_frame = Rand() % num_frames,
+        block_size = std::min(num_frames - first_frame, 1 + Rand() % 70);
+    Matrix<BaseFloat> windows(block_size, padded_window_size);
+    Vector<BaseFloat> log_energies(block_size);
+    ExtractWindows(wave, first_frame, frame_opts, window_function, &windows,
+                   &log_energies);
+    SplitRadixRealFft<BaseFloat> *srfft = NULL;
+    if (frame_opts.round_to_power_of_two)
+      srfft = new SplitRadixRealFft<BaseFloat>(padded_window_size);
+    ComputePowerSpectra(srfft, &windows);
+    Matrix<BaseFloat> mel_energies(block_size, mel_opts.num_bins);
+    mel_banks.Compute(windows.ColRange(0, padded_window_size / 2 + 1),
+                      &mel_energies);
+
+    for (int32 r = 0; r < block_size; r++) {
+      Vector<BaseFloat> window, mel_energies_frame;
+      BaseFloat log_energy;
+      ExtractWindow(wave, first_frame + r, frame_opts, window_function,
+                    &window, &log_energy);
+      AssertEqual(log_energy, log_energies(r));
+      if (srfft != NULL) {
+        std::vector<BaseFloat> temp_buffer;
+        srfft->Compute(window.Data(), true, &temp_buffer);
+      } else {
+        RealFft(&window, true);
+      }
+      ComputePowerSpectrum(&window);
+      SubVector<BaseFloat> power_spectrum(window, 0, window.Dim() / 2 + 1);
+      KALDI_ASSERT(power_spectrum.ApproxEqual(
+          windows.Row(r).Range(0, window.Dim() / 2 + 1), 1.0e-05));
+      mel_banks.Compute(power_spectrum, &mel_energies_frame);
+      KALDI_ASSERT(mel_energies_frame.ApproxEqual(mel_energies.Row(r),
+                                                  1.0e-04));
+    }
+    delete srfft;
+  }
+}
+
 
 }
 
@@ -101,6 +158,7 @@ int main() {
   using namespace kaldi;
   try {
     UnitTestOnlineCmvn();
+    UnitTestFeatureBlocks();
     std::cout << "Tests succeeded.\n";
     return 0;
   } catch (const std::exception &e) {
@@ -48,9 +48,10 @@ int32 NumFrames(int32 nsamp,
 }
 
 
-void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value) {
+void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value,
+            RandomState *random_state) {
   for (int32 i = 0; i < waveform->Dim(); i++)
-    (*waveform)(i) += RandGauss() * dither_value;
+    (*waveform)(i) += RandGauss(random_state) * dither_value;
 }
 
 
@@ -88,22 +89,28 @@ FeatureWindowFunction::FeatureWindowFunction(const FrameExtractionOptions &opts)
 // padded size.  It does mean subtraction, pre-emphasis and dithering as
 // requested.
 
-void ExtractWindow(const VectorBase<BaseFloat> &wave,
-                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
-                   const FrameExtractionOptions &opts,
-                   const FeatureWindowFunction &window_function,
-                   Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window) {
+// This does the work of ExtractWindow() and ExtractWindows(); "window" must
+// already have dimension opts.PaddedWindowSize().
+static void ExtractWindowInternal(const VectorBase<BaseFloat> &wave,
+                                  int32 f,
+                                  const FrameExtractionOptions &opts,
+                                  const FeatureWindowFunction &window_function,
+                                  VectorBase<BaseFloat> *window,
+                                  BaseFloat *log_energy_pre_window,
+                                  RandomState *random_state) {
   int32 frame_shift = opts.WindowShift();
   int32 frame_length = opts.WindowSize();
   KALDI_ASSERT(window_function.window.Dim() == frame_length);
   KALDI_ASSERT(frame_shift != 0 && frame_length != 0);
+  KALDI_ASSERT(window != NULL);
+  int32 frame_length_padded = opts.PaddedWindowSize();
+  KALDI_ASSERT(window->Dim() == frame_length_padded);
 
-  Vector<BaseFloat> wave_part(frame_length);
+  SubVector<BaseFloat> window_part(*window, 0, frame_length);
   if (opts.snip_edges) {
     int32 start = frame_shift*f, end = start + frame_length;
     KALDI_ASSERT(start >= 0 && end <= wave.Dim());
-    wave_part.CopyFromVec(wave.Range(start, frame_length));
+    window_part.CopyFromVec(wave.Range(start, frame_length));
   } else {
     // If opts.snip_edges = false, we allow the frames to go slightly over the
     // edges of the file; we'll extend the data by reflection.
@@ -115,7 +122,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
         length_limited = end_limited - begin_limited;
 
     // Copy the main part.  Usually this will be the entire window.
-    wave_part.Range(begin_limited - begin, length_limited).
+    window_part.Range(begin_limited - begin, length_limited).
         CopyFromVec(wave.Range(begin_limited, length_limited));
     
     // Deal with any end effects by reflection, if needed.  This code will
@@ -125,7 +132,7 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // The next statement will only have an effect in the case of files
       // shorter than a single frame, it's to avoid a crash in those cases.
       reflected_f = reflected_f % wave.Dim(); 
-      wave_part(f - begin) = wave(reflected_f);
+      window_part(f - begin) = wave(reflected_f);
     }
     for (int32 f = wave.Dim(); f < end; f++) {
       int32 distance_to_end = f - wave.Dim();
@@ -133,19 +140,11 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
       // shorter than a single frame, it's to avoid a crash in those cases.
       distance_to_end = distance_to_end % wave.Dim();
       int32 reflected_f = wave.Dim() - 1 - distance_to_end;
-      wave_part(f - begin) = wave(reflected_f);
+      window_part(f - begin) = wave(reflected_f);
     }
   }
-  KALDI_ASSERT(window != NULL);
-  int32 frame_length_padded = opts.PaddedWindowSize();
-
-  if (window->Dim() != frame_length_padded)
-    window->Resize(frame_length_padded);
 
-  SubVector<BaseFloat> window_part(*window, 0, frame_length);
-  window_part.CopyFromVec(wave_part);
-
-  if (opts.dither != 0.0) Dither(&window_part, opts.dither);
+  if (opts.dither != 0.0) Dither(&window_part, opts.dither, random_state);
 
   if (opts.remove_dc_offset)
     window_part.Add(-window_part.Sum() / frame_length);
@@ -166,6 +165,40 @@ void ExtractWindow(const VectorBase<BaseFloat> &wave,
                          frame_length_padded-frame_length).SetZero();
 }
 
+void ExtractWindow(const VectorBase<BaseFloat> &wave,
+                   int32 f,  // with 0 <= f < NumFrames(feats, opts)
+                   const FrameExtractionOptions &opts,
+                   const FeatureWindowFunction &window_function,
+                   Vector<BaseFloat> *window,
+                   BaseFloat *log_energy_pre_window,
+                   RandomState *random_state) {
+  KALDI_ASSERT(window != NULL);
+  int32 frame_length_padded = opts.PaddedWindowSize();
+  if (window->Dim() != frame_length_padded)
+    window->Resize(frame_length_padded);
+  ExtractWindowInternal(wave, f, opts, window_function, window,
+                        log_energy_pre_window, random_state);
+}
+
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window,
+                    RandomState *random_state) {
+  KALDI_ASSERT(windows->NumCols() == opts.PaddedWindowSize());
+  KALDI_ASSERT(log_energy_pre_window == NULL ||
+               log_energy_pre_window->Dim() == windows->NumRows());
+  for (int32 r = 0; r < windows->NumRows(); r++) {
+    SubVector<BaseFloat> window(*windows, r);
+    ExtractWindowInternal(wave, first_frame + r, opts, window_function,
+                          &window, (log_energy_pre_window != NULL ?
+                                    &((*log_energy_pre_window)(r)) : NULL),
+                          random_state);
+  }
+}
+
 void ExtractWaveformRemainder(const VectorBase<BaseFloat> &wave,
                               const FrameExtractionOptions &opts,
                               Vector<BaseFloat> *wave_remainder) {
@@ -207,6 +240,22 @@ void ComputePowerSpectrum(VectorBase<BaseFloat> *waveform) {
 }
 
 
+void ComputePowerSpectra(SplitRadixRealFft<BaseFloat> *srfft,
+                         MatrixBase<BaseFloat> *windows) {
+  if (srfft != NULL) {
+    // Compute the FFTs using the split-radix algorithm, several rows at a time.
+    KALDI_ASSERT(srfft->Dim() == windows->NumCols());
+    srfft->Compute(windows, true);
+  }
+  for (int32 r = 0; r < windows->NumRows(); r++) {
+    SubVector<BaseFloat> window(*windows, r);
+    if (srfft == NULL)  // An alternative algorithm that works for non-powers-of-two.
+      RealFft(&window, true);
+    ComputePowerSpectrum(&window);
+  }
+}
+
+
 DeltaFeatures::DeltaFeatures(const DeltaFeaturesOptions &opts): opts_(opts) {
   KALDI_ASSERT(opts.order >= 0 && opts.order < 1000);  // just make sure we don't get binary junk.
   // opts will normally be 2 or 3.
@@ -138,20 +138,40 @@ struct FeatureWindowFunction {
 int32 NumFrames(int32 wave_length,
                 const FrameExtractionOptions &opts);
 
-void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value);
+// Adds Gaussian noise with standard deviation "dither_value" to "waveform".
+// The noise is drawn from "random_state" if it is not NULL, otherwise from the
+// global random number generator.
+void Dither(VectorBase<BaseFloat> *waveform, BaseFloat dither_value,
+            RandomState *random_state = NULL);
 
 void Preemphasize(VectorBase<BaseFloat> *waveform, BaseFloat preemph_coeff);
 
 
 // ExtractWindow extracts a windowed frame of waveform with a power-of-two,
 // padded size. If log_energy_pre_window != NULL, outputs the log of the
-// sum-of-squared samples before preemphasis and windowing
+// sum-of-squared samples before preemphasis and windowing.  The dither is drawn
+// from "random_state" if it is not NULL (see Dither()).
 void ExtractWindow(const VectorBase<BaseFloat> &wave,
                    int32 f,  // with 0 <= f < NumFrames(wave.Dim(), opts)
                    const FrameExtractionOptions &opts,
                    const FeatureWindowFunction &window_function,
                    Vector<BaseFloat> *window,
-                   BaseFloat *log_energy_pre_window = NULL);
+                   BaseFloat *log_energy_pre_window = NULL,
+                   RandomState *random_state = NULL);
+
+// ExtractWindows extracts the windowed frames first_frame ... first_frame +
+// windows->NumRows() - 1 into the rows of "windows", which must have
+// opts.PaddedWindowSize() columns; it is equivalent to calling ExtractWindow()
+// for each of them.  If log_energy_pre_window != NULL (it must then have
+// dimension windows->NumRows()), outputs the log energies of the frames before
+// preemphasis and windowing.
+void ExtractWindows(const VectorBase<BaseFloat> &wave,
+                    int32 first_frame,
+                    const FrameExtractionOptions &opts,
+                    const FeatureWindowFunction &window_function,
+                    MatrixBase<BaseFloat> *windows,
+                    VectorBase<BaseFloat> *log_energy_pre_window = NULL,
+                    RandomState *random_state = NULL);
 
 // ExtractWaveformRemainder is useful if the waveform is coming in segments.
 // It extracts the bit of the waveform at the end of this block that you
@@ -172,6 +192,21 @@ void ExtractWaveformRemainder(const VectorBase<BaseFloat> &wave,
 // remaining (n/2) - 1 elements are undefined at output.
 void ComputePowerSpectrum(VectorBase<BaseFloat> *complex_fft);
 
+// ComputePowerSpectra computes, in place, the power spectra of a block of
+// windowed frames (e.g. from ExtractWindows()): each row of "windows" is
+// transformed by "srfft" if it is not NULL (it must then be of dimension
+// windows->NumCols()) and otherwise by RealFft(), and converted with
+// ComputePowerSpectrum(), so that the first NumCols()/2 + 1 columns contain
+// the power spectrum of the frame.
+void ComputePowerSpectra(SplitRadixRealFft<BaseFloat> *srfft,
+                         MatrixBase<BaseFloat> *windows);
+
+// The number of frames that Mfcc, Fbank and Plp process as a block: the frames
+// of a block are windowed into the rows of a matrix and transformed one after
+// the other, and the Mel filterbank (and, for MFCC, the DCT) are applied to the
+// whole block as matrix multiplications.
+const int32 kFeatureBlockSize = 64;
+
 
 
 inline void MaxNormalizeEnergy(Matrix<BaseFloat> *feats) {
@@ -103,12 +103,13 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
 void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
                    BaseFloat vtln_warp,
                    Matrix<BaseFloat> *output,
-                   Vector<BaseFloat> *wave_remainder) const {
+                   Vector<BaseFloat> *wave_remainder,
+                   RandomState *random_state) const {
   bool must_delete_mel_banks;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                                &must_delete_mel_banks);
   
-  ComputeInternal(wave, *mel_banks, output, wave_remainder);
+  ComputeInternal(wave, *mel_banks, output, wave_remainder, random_state);
   
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -117,7 +118,8 @@ void Mfcc::Compute(const VectorBase<BaseFloat> &wave,
 void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
                            const MelBanks &mel_banks,
                            Matrix<BaseFloat> *output,
-                           Vector<BaseFloat> *wave_remainder) const {
+                           Vector<BaseFloat> *wave_remainder,
+                           RandomState *random_state) const {
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -129,56 +131,71 @@ void Mfcc::ComputeInternal(const VectorBase<BaseFloat> &wave,
   output->Resize(rows_out, cols_out);
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
-  Vector<BaseFloat> window;  // windowed waveform.
-  Vector<BaseFloat> mel_energies;
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
-    BaseFloat log_energy;
-    ExtractWindow(wave, r, opts_.frame_opts, feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
 
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
+  // We process the frames in blocks of kFeatureBlockSize, so that the Mel
+  // filterbank and the DCT are matrix multiplications.
+  int32 padded_window_size = opts_.frame_opts.PaddedWindowSize(),
+      num_bins = opts_.mel_opts.num_bins,
+      block_size = std::min(rows_out, kFeatureBlockSize);
+  Matrix<BaseFloat> windows(block_size, padded_window_size, kUndefined),
+      mel_energies(block_size, num_bins, kUndefined);
+  Vector<BaseFloat> log_energies(block_size, kUndefined);
+  for (int32 start = 0; start < rows_out; start += block_size) {
+    int32 num_frames = std::min(block_size, rows_out - start);
+    SubMatrix<BaseFloat> this_windows(windows, 0, num_frames,
+                                      0, padded_window_size),
+        this_mel_energies(mel_energies, 0, num_frames, 0, num_bins),
+        this_mfcc(*output, start, num_frames, 0, cols_out);
+    SubVector<BaseFloat> this_log_energies(log_energies, 0, num_frames);
+    ExtractWindows(wave, start, opts_.frame_opts, feature_window_function_,
+                   &this_windows,
+                   (opts_.use_energy && opts_.raw_energy ?
+                    &this_log_energies : NULL), random_state);
 
-    if (srfft_ != NULL)  // Compute FFT using the split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+    if (opts_.use_energy && !opts_.raw_energy)
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> window(this_windows, r);
+        this_log_energies(r) = Log(std::max(VecVec(window, window),
+                                   std::numeric_limits<BaseFloat>::min()));
+      }
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    // Compute the FFTs and convert them into power spectra.
+    ComputePowerSpectra(srfft_, &this_windows);
+    SubMatrix<BaseFloat> power_spectra(this_windows, 0, num_frames,
+                                       0, padded_window_size / 2 + 1);
 
-    mel_banks.Compute(power_spectrum, &mel_energies);
+    mel_banks.Compute(power_spectra, &this_mel_energies);
 
     // avoid log of zero (which should be prevented anyway by dithering).
-    mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
-    mel_energies.ApplyLog();  // take the log.
-
-    SubVector<BaseFloat> this_mfcc(output->Row(r));
+    this_mel_energies.ApplyFloor(std::numeric_limits<BaseFloat>::min());
+    this_mel_energies.ApplyLog();  // take the log.
 
-    // this_mfcc = dct_matrix_ * mel_energies [which now have log]
-    this_mfcc.AddMatVec(1.0, dct_matrix_, kNoTrans, mel_energies, 0.0);
+    // this_mfcc = mel_energies [which now have log] * dct_matrix_^T
+    this_mfcc.AddMatMat(1.0, this_mel_energies, kNoTrans,
+                        dct_matrix_, kTrans, 0.0);
 
     if (opts_.cepstral_lifter != 0.0)
-      this_mfcc.MulElements(lifter_coeffs_);
-
-    if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
-        log_energy = log_energy_floor_;
-      this_mfcc(0) = log_energy;
-    }
-
-    if (opts_.htk_compat) {
-      BaseFloat energy = this_mfcc(0);
-      for (int32 i = 0; i < opts_.num_ceps-1; i++)
-        this_mfcc(i) = this_mfcc(i+1);
-      if (!opts_.use_energy)
-        energy *= M_SQRT2;  // scale on C0 (actually removing scale
-      // we previously added that's part of one common definition of
-      // cosine transform.)
-      this_mfcc(opts_.num_ceps-1)  = energy;
+      this_mfcc.MulColsVec(lifter_coeffs_);
+
+    for (int32 r = 0; r < num_frames; r++) {
+      if (opts_.use_energy) {
+        BaseFloat log_energy = this_log_energies(r);
+        if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
+          log_energy = log_energy_floor_;
+        this_mfcc(r, 0) = log_energy;
+      }
+
+      if (opts_.htk_compat) {
+        SubVector<BaseFloat> mfcc(this_mfcc, r);
+        BaseFloat energy = mfcc(0);
+        for (int32 i = 0; i < opts_.num_ceps-1; i++)
+          mfcc(i) = mfcc(i+1);
+        if (!opts_.use_energy)
+          energy *= M_SQRT2;  // scale on C0 (actually removing scale
+        // we previously added that's part of one common definition of
+        // cosine transform.)
+        mfcc(opts_.num_ceps-1)  = energy;
+      }
     }
   }
 }
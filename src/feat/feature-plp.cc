@@ -140,7 +140,8 @@ void Plp::Compute(const VectorBase<BaseFloat> &wave,
 void Plp::Compute(const VectorBase<BaseFloat> &wave,
                    BaseFloat vtln_warp,
                    Matrix<BaseFloat> *output,
-                   Vector<BaseFloat> *wave_remainder) const {
+                   Vector<BaseFloat> *wave_remainder,
+                   RandomState *random_state) const {
   bool must_delete_mel_banks, must_delete_equal_loudness;
   const MelBanks *mel_banks = GetMelBanks(vtln_warp,
                                                &must_delete_mel_banks);
@@ -149,7 +150,7 @@ void Plp::Compute(const VectorBase<BaseFloat> &wave,
                          &must_delete_equal_loudness);
 
   ComputeInternal(wave, *mel_banks, *equal_loudness,
-                  output, wave_remainder);
+                  output, wave_remainder, random_state);
 
   if (must_delete_mel_banks)
     delete mel_banks;
@@ -162,7 +163,8 @@ void Plp::ComputeInternal(const VectorBase<BaseFloat> &wave,
                           const MelBanks &mel_banks,
                           const Vector<BaseFloat> &equal_loudness,
                           Matrix<BaseFloat> *output,
-                          Vector<BaseFloat> *wave_remainder) const {
+                          Vector<BaseFloat> *wave_remainder,
+                          RandomState *random_state) const {
   KALDI_ASSERT(output != NULL);
   int32 rows_out = NumFrames(wave.Dim(), opts_.frame_opts),
       cols_out = opts_.num_ceps;
@@ -174,93 +176,107 @@ void Plp::ComputeInternal(const VectorBase<BaseFloat> &wave,
   output->Resize(rows_out, cols_out);
   if (wave_remainder != NULL)
     ExtractWaveformRemainder(wave, opts_.frame_opts, wave_remainder);
-  Vector<BaseFloat> window;  // windowed waveform.
   int32 num_mel_bins = opts_.mel_opts.num_bins;
-  Vector<BaseFloat> mel_energies(num_mel_bins);
-  Vector<BaseFloat> mel_energies_duplicated(num_mel_bins+2);
-  Vector<BaseFloat> autocorr_coeffs(opts_.lpc_order+1);
   Vector<BaseFloat> lpc_coeffs(opts_.lpc_order);
   Vector<BaseFloat> raw_cepstrum(opts_.lpc_order);  // not including C0,
   // and size may differ from final size.
   Vector<BaseFloat> final_cepstrum(opts_.num_ceps);
-  std::vector<BaseFloat> temp_buffer;  // used by srfft.
   
   KALDI_ASSERT(opts_.num_ceps <= opts_.lpc_order+1);  // our num-ceps includes C0.
-  for (int32 r = 0; r < rows_out; r++) {  // r is frame index..
-    BaseFloat log_energy;
-    ExtractWindow(wave, r, opts_.frame_opts,
-                  feature_window_function_, &window,
-                  (opts_.use_energy && opts_.raw_energy ? &log_energy : NULL));
 
-    if (opts_.use_energy && !opts_.raw_energy)
-      log_energy = Log(std::max(VecVec(window, window),
-                                std::numeric_limits<BaseFloat>::min()));
-
-    if (srfft_ != NULL)  // Compute FFT using split-radix algorithm.
-      srfft_->Compute(window.Data(), true, &temp_buffer);
-    else  // An alternative algorithm that works for non-powers-of-two.
-      RealFft(&window, true);
+  // We process the frames in blocks of kFeatureBlockSize, so that the Mel
+  // filterbank and the IDFT are matrix multiplications.
+  int32 padded_window_size = opts_.frame_opts.PaddedWindowSize(),
+      block_size = std::min(rows_out, kFeatureBlockSize);
+  Matrix<BaseFloat> windows(block_size, padded_window_size, kUndefined),
+      mel_energies_duplicated(block_size, num_mel_bins + 2, kUndefined),
+      autocorr_coeffs(block_size, opts_.lpc_order + 1, kUndefined);
+  Vector<BaseFloat> log_energies(block_size, kUndefined);
+  for (int32 start = 0; start < rows_out; start += block_size) {
+    int32 num_frames = std::min(block_size, rows_out - start);
+    SubMatrix<BaseFloat> this_windows(windows, 0, num_frames,
+                                      0, padded_window_size),
+        this_mel_energies_duplicated(mel_energies_duplicated, 0, num_frames,
+                                     0, num_mel_bins + 2),
+        this_mel_energies(mel_energies_duplicated, 0, num_frames,
+                          1, num_mel_bins),
+        this_autocorr_coeffs(autocorr_coeffs, 0, num_frames,
+                             0, opts_.lpc_order + 1);
+    SubVector<BaseFloat> this_log_energies(log_energies, 0, num_frames);
+    ExtractWindows(wave, start, opts_.frame_opts, feature_window_function_,
+                   &this_windows,
+                   (opts_.use_energy && opts_.raw_energy ?
+                    &this_log_energies : NULL), random_state);
 
-    // Convert the FFT into a power spectrum.
-    ComputePowerSpectrum(&window);  // elements 0 ... window.Dim()/2
+    if (opts_.use_energy && !opts_.raw_energy)
+      for (int32 r = 0; r < num_frames; r++) {
+        SubVector<BaseFloat> window(this_windows, r);
+        this_log_energies(r) = Log(std::max(VecVec(window, window),
+                                   std::numeric_limits<BaseFloat>::min()));
+      }
 
-    SubVector<BaseFloat> power_spectrum(window, 0, window.Dim()/2 + 1);
+    // Compute the FFTs and convert them into power spectra.
+    ComputePowerSpectra(srfft_, &this_windows);
+    SubMatrix<BaseFloat> power_spectra(this_windows, 0, num_frames,
+                                       0, padded_window_size / 2 + 1);
 
-    mel_banks.Compute(power_spectrum, &mel_energies);
+    mel_banks.Compute(power_spectra, &this_mel_energies);
 
-    mel_energies.MulElements(equal_loudness);
+    this_mel_energies.MulColsVec(equal_loudness);
     
-    mel_energies.ApplyPow(opts_.compress_factor);
+    this_mel_energies.ApplyPow(opts_.compress_factor);
     
     // duplicate first and last elements.
-    {
-      SubVector<BaseFloat> v(mel_energies_duplicated, 1, num_mel_bins);
-      v.CopyFromVec(mel_energies);
-    }
-    mel_energies_duplicated(0) = mel_energies(0);
-    mel_energies_duplicated(num_mel_bins+1) = mel_energies(num_mel_bins-1);
-
-    autocorr_coeffs.AddMatVec(1.0, idft_bases_, kNoTrans,
-                              mel_energies_duplicated,  0.0);
-    
-    BaseFloat energy = ComputeLpc(autocorr_coeffs, &lpc_coeffs);
-
-    energy = std::max(energy,
-                      std::numeric_limits<BaseFloat>::min());
-    
-    Lpc2Cepstrum(opts_.lpc_order, lpc_coeffs.Data(), raw_cepstrum.Data());
-    {
-      SubVector<BaseFloat> dst(final_cepstrum, 1, opts_.num_ceps-1);
-      SubVector<BaseFloat> src(raw_cepstrum, 0, opts_.num_ceps-1);
-      dst.CopyFromVec(src);
-      final_cepstrum(0) = energy;
+    for (int32 r = 0; r < num_frames; r++) {
+      this_mel_energies_duplicated(r, 0) = this_mel_energies(r, 0);
+      this_mel_energies_duplicated(r, num_mel_bins + 1) =
+          this_mel_energies(r, num_mel_bins - 1);
     }
 
-    if (opts_.cepstral_lifter != 0.0)
-      final_cepstrum.MulElements(lifter_coeffs_);
-
-    if (opts_.cepstral_scale != 1.0)
-      final_cepstrum.Scale(opts_.cepstral_scale);
+    this_autocorr_coeffs.AddMatMat(1.0, this_mel_energies_duplicated, kNoTrans,
+                                   idft_bases_, kTrans, 0.0);
 
-    if (opts_.use_energy) {
-      if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
-        log_energy = log_energy_floor_;
-      final_cepstrum(0) = log_energy;
-    }
+    for (int32 r = 0; r < num_frames; r++) {
+      SubVector<BaseFloat> autocorr_row(this_autocorr_coeffs, r);
+      BaseFloat energy = ComputeLpc(autocorr_row, &lpc_coeffs);
 
-    if (opts_.htk_compat) {
-      BaseFloat energy = final_cepstrum(0);
-      for (int32 i = 0; i < opts_.num_ceps-1; i++)
-        final_cepstrum(i) = final_cepstrum(i+1);
-      // if (!opts_.use_energy)
-        // energy *= M_SQRT2;  // scale on C0 (actually removing scale
-      // we previously added that's part of one common definition of
-      // cosine transform.)
-      final_cepstrum(opts_.num_ceps-1)  = energy;
+      energy = std::max(energy,
+                        std::numeric_limits<BaseFloat>::min());
+    
+      Lpc2Cepstrum(opts_.lpc_order, lpc_coeffs.Data(), raw_cepstrum.Data());
+      {
+        SubVector<BaseFloat> dst(final_cepstrum, 1, opts_.num_ceps-1);
+        SubVector<BaseFloat> src(raw_cepstrum, 0, opts_.num_ceps-1);
+        dst.CopyFromVec(src);
+        final_cepstrum(0) = energy;
+      }
+
+      if (opts_.cepstral_lifter != 0.0)
+        final_cepstrum.MulElements(lifter_coeffs_);
+
+      if (opts_.cepstral_scale != 1.0)
+        final_cepstrum.Scale(opts_.cepstral_scale);
+
+      if (opts_.use_energy) {
+        BaseFloat log_energy = this_log_energies(r);
+        if (opts_.energy_floor > 0.0 && log_energy < log_energy_floor_)
+          log_energy = log_energy_floor_;
+        final_cepstrum(0) = log_energy;
+      }
+
+      if (opts_.htk_compat) {
+        BaseFloat energy = final_cepstrum(0);
+        for (int32 i = 0; i < opts_.num_ceps-1; i++)
+          final_cepstrum(i) = final_cepstrum(i+1);
+        // if (!opts_.use_energy)
+          // energy *= M_SQRT2;  // scale on C0 (actually removing scale
+        // we previously added that's part of one common definition of
+        // cosine transform.)
+        final_cepstrum(opts_.num_ceps-1)  = energy;
+      }
+
+      output->Row(start + r).CopyFromVec(final_cepstrum);
     }
-
-    output->Row(r).CopyFromVec(final_cepstrum);
-    // std::cout << "FIN" << final_cepstrum;
   }
 }
 
@@ -115,17 +115,21 @@ class Plp {
                Vector<BaseFloat> *wave_remainder = NULL);
 
   typedef PlpOptions Options;
-  /// Const version of Compute()
+  /// Const version of Compute().  If "random_state" is not NULL the dither is
+  /// drawn from it rather than from the global random number generator, so the
+  /// output does not depend on what other threads are doing.
   void Compute(const VectorBase<BaseFloat> &wave,
                BaseFloat vtln_warp,
                Matrix<BaseFloat> *output,
-               Vector<BaseFloat> *wave_remainder = NULL) const;
+               Vector<BaseFloat> *wave_remainder = NULL,
+               RandomState *random_state = NULL) const;
  private:
   void ComputeInternal(const VectorBase<BaseFloat> &wave,
                        const MelBanks &mel_banks,
                        const Vector<BaseFloat> &equal_loudness,
                        Matrix<BaseFloat> *output,
-                       Vector<BaseFloat> *wave_remainder = NULL) const;
+                       Vector<BaseFloat> *wave_remainder = NULL,
+                       RandomState *random_state = NULL) const;
 
   const MelBanks *GetMelBanks(BaseFloat vtln_warp);
 
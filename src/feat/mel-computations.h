@@ -76,6 +76,14 @@ class MelBanks {
   void Compute(const VectorBase<BaseFloat> &fft_energies,
                Vector<BaseFloat> *mel_energies_out) const;
 
+  /// Computes the Mel energies of a block of frames at once, as one matrix
+  /// multiplication: each row of "power_spectra" is the power spectrum of a
+  /// frame (of dimension padded-window-size / 2 + 1, as output by
+  /// ComputePowerSpectra()), and the corresponding row of "mel_energies_out"
+  /// (which must have NumBins() columns) is set to its Mel energies.
+  void Compute(const MatrixBase<BaseFloat> &power_spectra,
+               MatrixBase<BaseFloat> *mel_energies_out) const;
+
   int32 NumBins() const { return bins_.size(); }
 
   // returns vector of central freq of each bin; needed by plp code.
@@ -90,6 +98,10 @@ class MelBanks {
   // (the first nonzero fft-bin), (the vector of weights).
   std::vector<std::pair<int32, Vector<BaseFloat> > > bins_;
 
+  // The same weights as a matrix of dimension num-bins by (num-fft-bins + 1),
+  // for the version of Compute() that works on a block of frames.
+  Matrix<BaseFloat> bin_weights_;
+
   bool debug_;
   bool htk_mode_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(MelBanks);
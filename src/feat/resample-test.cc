@@ -273,6 +273,58 @@ void UnitTestLinearResample2() {
   AssertEqual(self1, cross, 0.001);
 }
 
+// LinearResample::Resample() computes most of the output a unit at a time
+// with SIMD dot products over zero-padded weights, and only the samples near
+// the edges of the input with the original per-sample code.  If we give it the
+// input one sample at a time there is never a whole unit of input available,
+// so every output sample goes through the per-sample code; this test checks
+// that the two agree sample for sample, for common and random rates.
+void UnitTestLinearResamplePolyphase() {
+  int32 rates[][2] = { { 16000, 8000 }, { 8000, 16000 }, { 48000, 16000 },
+                       { 44100, 16000 }, { 16000, 48000 }, { 16000, 16000 } };
+  int32 num_rates = sizeof(rates) / sizeof(rates[0]);
+  for (int32 r = 0; r <= num_rates; r++) {
+    int32 samp_freq, resamp_freq;
+    if (r < num_rates) {
+      samp_freq = rates[r][0];
+      resamp_freq = rates[r][1];
+    } else {  // and a random pair of rates.
+      samp_freq = 1000 + Rand() % 47000;
+      resamp_freq = 1000 + Rand() % 47000;
+    }
+    BaseFloat lowpass_freq =
+        std::min(samp_freq, resamp_freq) * 0.99 * 0.5 / (1.0 + RandUniform());
+    int32 num_zeros = 1 + Rand() % 16,
+        num_samp = 2000 + Rand() % 2000;
+    Vector<BaseFloat> test_signal(num_samp);
+    test_signal.SetRandn();
+
+    LinearResample linear_resampler(samp_freq, resamp_freq,
+                                    lowpass_freq, num_zeros);
+    Vector<BaseFloat> resampled_vec;
+    linear_resampler.Resample(test_signal, true, &resampled_vec);
+
+    Vector<BaseFloat> resampled_vec2(resampled_vec.Dim());
+    int32 output_dim = 0;
+    for (int32 i = 0; i < num_samp; i++) {
+      Vector<BaseFloat> out_piece;
+      linear_resampler.Resample(test_signal.Range(i, 1), i + 1 == num_samp,
+                                &out_piece);
+      KALDI_ASSERT(output_dim + out_piece.Dim() <= resampled_vec2.Dim());
+      resampled_vec2.Range(output_dim, out_piece.Dim()).CopyFromVec(out_piece);
+      output_dim += out_piece.Dim();
+    }
+    KALDI_ASSERT(output_dim == resampled_vec.Dim());
+    for (int32 i = 0; i < output_dim; i++) {
+      if (fabs(resampled_vec(i) - resampled_vec2(i)) > 1.0e-04)
+        KALDI_ERR << "Resampling from " << samp_freq << " to " << resamp_freq
+                  << " Hz: output sample " << i << " is " << resampled_vec(i)
+                  << " but " << resampled_vec2(i) << " when computed one "
+                  << "sample at a time.";
+    }
+  }
+}
+
 int main() {
   try {
     for (int32 x = 0; x < 50; x++)
@@ -281,6 +333,8 @@ int main() {
       UnitTestLinearResample2();    
     for (int32 x = 0; x < 50; x++)
       UnitTestArbitraryResample();
+    for (int32 x = 0; x < 10; x++)
+      UnitTestLinearResamplePolyphase();
 
     KALDI_LOG << "Tests succeeded.\n";
     return 0;
@@ -25,8 +25,44 @@
 #include "matrix/matrix-functions.h"
 #include "feat/resample.h"
 
+#if defined(__SSE__) && (KALDI_DOUBLEPRECISION == 0)
+#include <xmmintrin.h>
+#endif
+
 namespace kaldi {
 
+// Returns the dot product of weights[0 ... num_weights - 1] with
+// input[0 ... num_weights - 1], where num_weights is a multiple of eight and
+// "weights" is 16-byte aligned (see LinearResample::padded_weights_).  We use
+// two accumulators so that consecutive additions do not wait for each other.
+static inline BaseFloat PaddedDotProduct(const BaseFloat *weights,
+                                         const BaseFloat *input,
+                                         int32 num_weights) {
+#if defined(__SSE__) && (KALDI_DOUBLEPRECISION == 0)
+  __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+  for (int32 i = 0; i < num_weights; i += 8) {
+    sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_load_ps(weights + i),
+                                       _mm_loadu_ps(input + i)));
+    sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_load_ps(weights + i + 4),
+                                       _mm_loadu_ps(input + i + 4)));
+  }
+  // Add the eight lanes together.
+  __m128 sum = _mm_add_ps(sum0, sum1);
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+  return _mm_cvtss_f32(sum);
+#else
+  BaseFloat sum0 = 0.0, sum1 = 0.0, sum2 = 0.0, sum3 = 0.0;
+  for (int32 i = 0; i < num_weights; i += 4) {
+    sum0 += weights[i] * input[i];
+    sum1 += weights[i + 1] * input[i + 1];
+    sum2 += weights[i + 2] * input[i + 2];
+    sum3 += weights[i + 3] * input[i + 3];
+  }
+  return (sum0 + sum1) + (sum2 + sum3);
+#endif
+}
+
 
 LinearResample::LinearResample(int32 samp_rate_in_hz,
                                int32 samp_rate_out_hz,
@@ -128,6 +164,15 @@ void LinearResample::SetIndexesAndWeights() {
       weights_[i](j) = FilterFunc(delta_t) / samp_rate_in_;
     }
   }
+
+  int32 max_num_indices = 0;
+  for (int32 i = 0; i < output_samples_in_unit_; i++)
+    max_num_indices = std::max(max_num_indices, weights_[i].Dim());
+  int32 padded_num_indices = 8 * ((max_num_indices + 7) / 8);
+  padded_weights_.Resize(output_samples_in_unit_, padded_num_indices);
+  for (int32 i = 0; i < output_samples_in_unit_; i++)
+    padded_weights_.Row(i).Range(0, weights_[i].Dim()).CopyFromVec(
+        weights_[i]);
 }
 
 
@@ -158,44 +203,68 @@ void LinearResample::Resample(const VectorBase<BaseFloat> &input,
 
   output->Resize(tot_output_samp - output_sample_offset_);
 
+  // The first and last-plus-one indexes into "input" that padded_weights_
+  // cover for a unit, relative to the input index of the start of the unit.
+  int32 num_padded_weights = padded_weights_.NumCols(),
+      unit_begin = first_index_.front(),
+      unit_end = first_index_.back() + num_padded_weights;
+
   // samp_out is the index into the total output signal, not just the part
   // of it we are producing here.
-  for (int64 samp_out = output_sample_offset_;
-       samp_out < tot_output_samp;
-       samp_out++) {
+  int64 samp_out = output_sample_offset_;
+  while (samp_out < tot_output_samp) {
     int64 first_samp_in;
     int32 samp_out_wrapped;
     GetIndexes(samp_out, &first_samp_in, &samp_out_wrapped);
-    const Vector<BaseFloat> &weights = weights_[samp_out_wrapped];
     // first_input_index is the first index into "input" that we have a weight
     // for.
     int32 first_input_index = static_cast<int32>(first_samp_in -
                                                  input_sample_offset_);
-    BaseFloat this_output;
-    if (first_input_index >= 0 &&
-        first_input_index + weights.Dim() <= input_dim) {
-      SubVector<BaseFloat> input_part(input, first_input_index, weights.Dim());
-      this_output = VecVec(input_part, weights);
-    } else {  // Handle edge cases.
-      this_output = 0.0;
-      for (int32 i = 0; i < weights.Dim(); i++) {
-        BaseFloat weight = weights(i);
-        int32 input_index = first_input_index + i;
-        if (input_index < 0 && input_remainder_.Dim() + input_index >= 0) {
-          this_output += weight *
-              input_remainder_(input_remainder_.Dim() + input_index);
-        } else if (input_index >= 0 && input_index < input_dim) {
-          this_output += weight * input(input_index);
-        } else if (input_index >= input_dim) {
-          // We're past the end of the input and are adding zero; should only
-          // happen if the user specified flush == true, or else we would not
-          // be trying to output this sample.
-          KALDI_ASSERT(flush);
-        }
+    int32 output_index = static_cast<int32>(samp_out - output_sample_offset_);
+    // unit_start is the index into "input" of the start of the unit that this
+    // output sample is in.
+    int32 unit_start = first_input_index - first_index_[samp_out_wrapped];
+    if (samp_out_wrapped == 0 && unit_start + unit_begin >= 0) {
+      // This is the normal case, away from the edges: do as many whole units
+      // as we can.  For integer ratios the unit is one output sample (for
+      // downsampling) or one input sample (for upsampling).
+      int32 num_units = 0;
+      while (samp_out + output_samples_in_unit_ <= tot_output_samp &&
+             unit_start + unit_end <= input_dim) {
+        const BaseFloat *input_data = input.Data() + unit_start;
+        BaseFloat *output_data = output->Data() + output_index;
+        for (int32 i = 0; i < output_samples_in_unit_; i++)
+          output_data[i] = PaddedDotProduct(padded_weights_.RowData(i),
+                                            input_data + first_index_[i],
+                                            num_padded_weights);
+        samp_out += output_samples_in_unit_;
+        output_index += output_samples_in_unit_;
+        unit_start += input_samples_in_unit_;
+        num_units++;
+      }
+      if (num_units > 0)
+        continue;
+    }
+    // Handle edge cases.
+    const Vector<BaseFloat> &weights = weights_[samp_out_wrapped];
+    BaseFloat this_output = 0.0;
+    for (int32 i = 0; i < weights.Dim(); i++) {
+      BaseFloat weight = weights(i);
+      int32 input_index = first_input_index + i;
+      if (input_index < 0 && input_remainder_.Dim() + input_index >= 0) {
+        this_output += weight *
+            input_remainder_(input_remainder_.Dim() + input_index);
+      } else if (input_index >= 0 && input_index < input_dim) {
+        this_output += weight * input(input_index);
+      } else if (input_index >= input_dim) {
+        // We're past the end of the input and are adding zero; should only
+        // happen if the user specified flush == true, or else we would not
+        // be trying to output this sample.
+        KALDI_ASSERT(flush);
       }
     }
-    int32 output_index = static_cast<int32>(samp_out - output_sample_offset_);
     (*output)(output_index) = this_output;
+    samp_out++;
   }
 
   if (flush) {
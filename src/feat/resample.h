@@ -183,7 +183,7 @@ class LinearResample {
   /// Resample(x, y, true) for the last piece.  Call it unnecessarily between
   /// signals will not do any harm.
   void Reset();
- private:
+
   /// This function outputs the number of output samples we will output
   /// for a signal with "input_num_samp" input samples.  If flush == true,
   /// we return the largest n such that
@@ -192,8 +192,11 @@ class LinearResample {
   /// define window_width as num_zeros / (2.0 * filter_cutoff_);
   /// we return the largest n such that (n/samp_rate_out_) is in the interval
   /// [ 0, input_num_samp/samp_rate_in_ - window_width ).
+  /// With flush == true this is the total length of the output for a signal
+  /// of that length, however it is broken into pieces.
   int64 GetNumOutputSamples(int64 input_num_samp, bool flush) const;
 
+ private:
 
   /// Given an output-sample index, this function outputs to *first_samp_in the
   /// first input-sample index that we have a weight on (may be negative),
@@ -234,6 +237,12 @@ class LinearResample {
   /// Weights on the input samples, for this output-sample index.
   std::vector<Vector<BaseFloat> > weights_;
 
+  /// Row i of this matrix is weights_[i], padded with zeros to a number of
+  /// columns that is a multiple of eight.  Away from the edges of the input, we
+  /// compute the output a unit (output_samples_in_unit_ samples) at a time,
+  /// using these rows, which lets us use SIMD dot products.
+  Matrix<BaseFloat> padded_weights_;
+
   // the following variables keep track of where we are in a particular signal,
   // if it is being provided over multiple calls to Resample().
 
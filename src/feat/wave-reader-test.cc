@@ -0,0 +1,127 @@
+// feat/wave-reader-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <sstream>
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+
+// Makes random 16-bit wave data.
+static void GenRandWaveData(int32 num_channels, int32 num_samples,
+                            Matrix<BaseFloat> *data) {
+  data->Resize(num_channels, num_samples);
+  for (int32 c = 0; c < num_channels; c++)
+    for (int32 i = 0; i < num_samples; i++)
+      (*data)(c, i) = RandInt(-32768, 32767);
+}
+
+// Writes random data a block at a time with WaveStreamWriter, reads it back a
+// block at a time (with different block sizes) with WaveStreamReader, and
+// checks that we get the same samples, and that WaveData reads the same thing.
+static void UnitTestWaveStreamRoundTrip() {
+  int32 num_channels = 1 + Rand() % 3,
+      num_samples = Rand() % 5000;
+  BaseFloat samp_freq = (Rand() % 2 == 0 ? 16000 : 8000);
+  Matrix<BaseFloat> data;
+  GenRandWaveData(num_channels, num_samples, &data);
+
+  std::ostringstream os;
+  {
+    WaveStreamWriter writer(os, samp_freq, num_channels, num_samples);
+    int32 num_written = 0;
+    while (num_written < num_samples) {
+      int32 block_size = std::min(num_samples - num_written,
+                                  1 + Rand() % 1000);
+      writer.WriteBlock(data.Range(0, num_channels, num_written, block_size));
+      num_written += block_size;
+      KALDI_ASSERT(writer.NumSamplesLeft() == num_samples - num_written);
+    }
+    writer.Close();
+  }
+
+  std::istringstream is(os.str());
+  WaveStreamReader reader(is);
+  KALDI_ASSERT(reader.SampFreq() == samp_freq &&
+               reader.NumChannels() == num_channels &&
+               reader.NumSamples() == num_samples);
+  Matrix<BaseFloat> block;
+  int32 num_read = 0;
+  while (!reader.Done()) {
+    int32 this_num_read = reader.ReadBlock(1 + Rand() % 1000, &block);
+    KALDI_ASSERT(this_num_read > 0 && block.NumRows() == num_channels &&
+                 block.NumCols() == this_num_read &&
+                 num_read + this_num_read <= num_samples);
+    AssertEqual(block, data.Range(0, num_channels, num_read, this_num_read));
+    num_read += this_num_read;
+  }
+  KALDI_ASSERT(num_read == num_samples);
+
+  std::istringstream is2(os.str());
+  WaveData wave;
+  wave.Read(is2);
+  KALDI_ASSERT(wave.SampFreq() == samp_freq);
+  AssertEqual(wave.Data(), data);
+
+  // WaveData::Write() should produce exactly the same file.
+  std::ostringstream os2;
+  wave.Write(os2);
+  KALDI_ASSERT(os2.str() == os.str());
+}
+
+// Checks that WaveStreamWriter::Close() fails if we wrote fewer samples than
+// the header says, and that WriteBlock() fails if we write too many.
+static void UnitTestWaveStreamWriterCount() {
+  Matrix<BaseFloat> data;
+  GenRandWaveData(2, 100, &data);
+  {
+    std::ostringstream os;
+    WaveStreamWriter writer(os, 16000, 2, 101);
+    writer.WriteBlock(data);
+    bool threw = false;
+    try {
+      writer.Close();
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+  {
+    std::ostringstream os;
+    WaveStreamWriter writer(os, 16000, 2, 99);
+    bool threw = false;
+    try {
+      writer.WriteBlock(data);
+    } catch (const std::exception &e) {
+      threw = true;
+    }
+    KALDI_ASSERT(threw);
+  }
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 20; i++)
+    UnitTestWaveStreamRoundTrip();
+  UnitTestWaveStreamWriterCount();
+  KALDI_LOG << "Tests succeeded.";
+  return 0;
+}
@@ -19,6 +19,7 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
 #include <cstdio>
 #include <sstream>
 #include <vector>
@@ -29,8 +30,7 @@
 
 namespace kaldi {
 
-// static
-void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
+static void Expect4ByteTag(std::istream &is, const char *expected) {
   char tmp[5];
   tmp[4] = '\0';
   is.read(tmp, 4);
@@ -40,7 +40,7 @@ void WaveData::Expect4ByteTag(std::istream &is, const char *expected) {
     KALDI_ERR << "WaveData: expected " << expected << ", got " << tmp;
 }
 
-uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
+static uint32 ReadUint32(std::istream &is, bool swap) {
   union {
     char result[4];
     uint32 ans;
@@ -54,7 +54,7 @@ uint32 WaveData::ReadUint32(std::istream &is, bool swap) {
 }
 
 
-uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
+static uint16 ReadUint16(std::istream &is, bool swap) {
   union {
     char result[2];
     int16 ans;
@@ -67,15 +67,13 @@ uint16 WaveData::ReadUint16(std::istream &is, bool swap) {
   return u.ans;
 }
 
-// static
-void WaveData::Read4ByteTag(std::istream &is, char *dest) {
+static void Read4ByteTag(std::istream &is, char *dest) {
   is.read(dest, 4);
   if (is.fail())
     KALDI_ERR << "WaveData: expected 4-byte chunk-name, got read errror";
 }
 
-// static
-void WaveData::WriteUint32(std::ostream &os, int32 i) {
+static void WriteUint32(std::ostream &os, int32 i) {
   union {
     char buf[4];
     int i;
@@ -89,7 +87,7 @@ void WaveData::WriteUint32(std::ostream &os, int32 i) {
     KALDI_ERR << "WaveData: error writing to stream.";
 }
 
-void WaveData::WriteUint16(std::ostream &os, int16 i) {
+static void WriteUint16(std::ostream &os, int16 i) {
   union {
     char buf[2];
     int16 i;
@@ -105,12 +103,10 @@ void WaveData::WriteUint16(std::ostream &os, int16 i) {
 
 
 
-void WaveData::Read(std::istream &is) {
-  data_.Resize(0, 0);  // clear the data.
-
+WaveStreamReader::WaveStreamReader(std::istream &is): is_(is) {
   char tmp[5];
   tmp[4] = '\0';
-  Read4ByteTag(is, &tmp[0]);
+  Read4ByteTag(is_, &tmp[0]);
   bool is_rifx = false;
   if (!strcmp(tmp, "RIFX"))
     is_rifx = true;
@@ -118,25 +114,25 @@ void WaveData::Read(std::istream &is) {
     KALDI_ERR << "WaveData: expected RIFF or RIFX, got " << tmp;
 
 #ifdef __BIG_ENDIAN__
-  bool swap = !is_rifx;
+  swap_ = !is_rifx;
 #else
-  bool swap = is_rifx;
+  swap_ = is_rifx;
 #endif
 
-  uint32 riff_chunk_size = ReadUint32(is, swap);
-  Expect4ByteTag(is, "WAVE");
+  uint32 riff_chunk_size = ReadUint32(is_, swap_);
+  Expect4ByteTag(is_, "WAVE");
 
   uint32 riff_chunk_read = 0;
   riff_chunk_read += 4;  // WAVE included in riff_chunk_size.
 
-  Expect4ByteTag(is, "fmt ");
-  uint32 subchunk1_size = ReadUint32(is, swap);
-  uint16 audio_format = ReadUint16(is, swap),
-      num_channels = ReadUint16(is, swap);
-  uint32 sample_rate = ReadUint32(is, swap),
-      byte_rate = ReadUint32(is, swap),
-      block_align = ReadUint16(is, swap),
-      bits_per_sample = ReadUint16(is, swap);
+  Expect4ByteTag(is_, "fmt ");
+  uint32 subchunk1_size = ReadUint32(is_, swap_);
+  uint16 audio_format = ReadUint16(is_, swap_),
+      num_channels = ReadUint16(is_, swap_);
+  uint32 sample_rate = ReadUint32(is_, swap_),
+      byte_rate = ReadUint32(is_, swap_),
+      block_align = ReadUint16(is_, swap_),
+      bits_per_sample = ReadUint16(is_, swap_);
   uint32 fmt_chunk_read = 16;
 
   if (audio_format == 1) {
@@ -144,16 +140,16 @@ void WaveData::Read(std::istream &is) {
       KALDI_ERR << "WaveData: expect PCM format data to have fmt chunk of at least size 16.";
     }
   } else if (audio_format == 0xFFFE) {  // WAVE_FORMAT_EXTENSIBLE
-    uint16 extra_size = ReadUint16(is, swap);
+    uint16 extra_size = ReadUint16(is_, swap_);
     if (subchunk1_size < 40 || extra_size < 22) {
       KALDI_ERR << "WaveData: malformed WAVE_FORMAT_EXTENSIBLE format data.";
     }
-    ReadUint16(is, swap);  // Unused for PCM.
-    ReadUint32(is, swap);  // Channel map: we do not care.
-    uint32 guid1 = ReadUint32(is, swap),
-           guid2 = ReadUint32(is, swap),
-           guid3 = ReadUint32(is, swap),
-           guid4 = ReadUint32(is, swap);
+    ReadUint16(is_, swap_);  // Unused for PCM.
+    ReadUint32(is_, swap_);  // Channel map: we do not care.
+    uint32 guid1 = ReadUint32(is_, swap_),
+           guid2 = ReadUint32(is_, swap_),
+           guid3 = ReadUint32(is_, swap_),
+           guid4 = ReadUint32(is_, swap_);
     fmt_chunk_read = 40;
 
     // Support only KSDATAFORMAT_SUBTYPE_PCM for now. Interesting formats:
@@ -170,11 +166,10 @@ void WaveData::Read(std::istream &is) {
               << audio_format;
   }
 
-  for (uint32 i = fmt_chunk_read; i < subchunk1_size; i++) is.get();  // use up extra data.
+  for (uint32 i = fmt_chunk_read; i < subchunk1_size; i++) is_.get();  // use up extra data.
 
   if (num_channels <= 0)
     KALDI_ERR << "WaveData: no channels present";
-  samp_freq_ = static_cast<BaseFloat>(sample_rate);
   if (bits_per_sample != 8 && bits_per_sample != 16 && bits_per_sample != 32)
     KALDI_ERR << "WaveData: bits_per_sample is " << bits_per_sample;
   if (byte_rate != sample_rate * bits_per_sample/8 * num_channels)
@@ -193,7 +188,7 @@ void WaveData::Read(std::istream &is) {
   // we encountered), and then a single "data" chunk.
 
   char next_chunk_name[4];
-  Read4ByteTag(is, next_chunk_name);
+  Read4ByteTag(is_, next_chunk_name);
   riff_chunk_read += 4;
 
   // Skip any subchunks between "fmt" and "data".  Usually there will
@@ -201,15 +196,15 @@ void WaveData::Read(std::istream &is) {
   // "list" subchunk.
   while (strncmp(next_chunk_name, "data", 4) != 0) {
     // We will just ignore the data in these chunks.
-    uint32 chunk_sz = ReadUint32(is, swap);
+    uint32 chunk_sz = ReadUint32(is_, swap_);
     if (chunk_sz != 4 && strncmp(next_chunk_name, "fact", 4) == 0)
       KALDI_WARN << "Expected fact chunk to be 4 bytes long.";
     for (uint32 i = 0; i < chunk_sz; i++)
-      is.get();
+      is_.get();
     riff_chunk_read += 4 + chunk_sz;  // for chunk_sz (4) + chunk contents (chunk-sz)
 
     // Now read the next chunk name.
-    Read4ByteTag(is, next_chunk_name);
+    Read4ByteTag(is_, next_chunk_name);
     riff_chunk_read += 4;
   }
 
@@ -217,7 +212,7 @@ void WaveData::Read(std::istream &is) {
     KALDI_ERR << "WaveData: expected data chunk, got instead "
               << next_chunk_name;
 
-  uint32 data_chunk_size = ReadUint32(is, swap);
+  uint32 data_chunk_size = ReadUint32(is_, swap_);
   riff_chunk_read += 4;
 
   if (std::abs(static_cast<int64>(riff_chunk_read) +
@@ -232,76 +227,108 @@ void WaveData::Read(std::istream &is) {
               << "(we do not support reading multiple data chunks).";
   }
 
-  std::vector<char*> data_pointer_vec;
-  std::vector<int> data_size_vec;
-  uint32 num_bytes_read = 0;
-  for (int32 remain_chunk_size = data_chunk_size; remain_chunk_size > 0;
-       remain_chunk_size -= kBlockSize) {
-    int32 this_block_size = remain_chunk_size;
-    if (kBlockSize < remain_chunk_size)
-      this_block_size = kBlockSize;
-    char *block_data_vec = new char[this_block_size];
-    is.read(block_data_vec, this_block_size);
-    num_bytes_read += is.gcount();
-    data_size_vec.push_back(is.gcount());
-    data_pointer_vec.push_back(block_data_vec);
-    if (num_bytes_read < this_block_size)
-      break;
-  }
+  if (data_chunk_size == 0)
+    KALDI_ERR << "WaveData: empty file (no data)";
+
+  samp_freq_ = static_cast<BaseFloat>(sample_rate);
+  num_channels_ = num_channels;
+  bits_per_sample_ = bits_per_sample;
+  block_align_ = block_align;
+  num_samples_ = data_chunk_size / block_align;
+  samples_left_ = num_samples_;
+}
 
-  std::vector<char> chunk_data_vec(num_bytes_read);
-  uint32 data_address = 0;
-  for (int i = 0; i < data_pointer_vec.size(); i++) {
-    memcpy(&(chunk_data_vec[data_address]), data_pointer_vec[i],
-           data_size_vec[i]);
-    delete[] data_pointer_vec[i];
-    data_address += data_size_vec[i];
-  }
 
-  char *data_ptr = &(chunk_data_vec[0]);
-  if (num_bytes_read == 0 && num_bytes_read != data_chunk_size) {
-    KALDI_ERR << "WaveData: failed to read data chunk (read no bytes)";
-  } else if (num_bytes_read != data_chunk_size) {
-    KALDI_ASSERT(num_bytes_read < data_chunk_size);
+int32 WaveStreamReader::ReadBlock(int32 max_samples, Matrix<BaseFloat> *data) {
+  KALDI_ASSERT(max_samples > 0);
+  int64 num_samp = std::min<int64>(max_samples, samples_left_);
+  int64 num_bytes = num_samp * block_align_;
+  buffer_.resize(num_bytes);
+  int64 num_bytes_read = 0;
+  if (num_bytes > 0) {
+    is_.read(&(buffer_[0]), num_bytes);
+    num_bytes_read = is_.gcount();
+  }
+  if (num_bytes_read < num_bytes) {
+    int64 total_bytes_read = (num_samples_ - samples_left_) * block_align_ +
+        num_bytes_read;
+    if (total_bytes_read == 0)
+      KALDI_ERR << "WaveData: failed to read data chunk (read no bytes)";
     KALDI_WARN << "Read fewer bytes than specified in the header: "
-               << num_bytes_read << " < " << data_chunk_size;
+               << total_bytes_read << " < " << (num_samples_ * block_align_);
+    num_samp = num_bytes_read / block_align_;
+    samples_left_ = 0;
+  } else {
+    samples_left_ -= num_samp;
   }
 
-  if (data_chunk_size == 0)
-    KALDI_ERR << "WaveData: empty file (no data)";
-
-  uint32 num_samp = num_bytes_read / block_align;
-  data_.Resize(num_channels, num_samp);
-  for (uint32 i = 0; i < num_samp; i++) {
-    for (uint32 j = 0; j < num_channels; j++) {
-      switch (bits_per_sample) {
+  const char *data_ptr = (num_samp > 0 ? &(buffer_[0]) : NULL);
+  data->Resize(num_channels_, num_samp, kUndefined);
+  for (int32 i = 0; i < num_samp; i++) {
+    for (int32 j = 0; j < num_channels_; j++) {
+      switch (bits_per_sample_) {
         case 8:
-          data_(j, i) = *data_ptr;
+          (*data)(j, i) = *data_ptr;
           data_ptr++;
           break;
         case 16:
           {
-            int16 k = *reinterpret_cast<uint16*>(data_ptr);
-            if (swap)
+            int16 k;
+            memcpy(&k, data_ptr, 2);
+            if (swap_)
               KALDI_SWAP2(k);
-            data_(j, i) =  k;
+            (*data)(j, i) =  k;
             data_ptr += 2;
             break;
           }
         case 32:
           {
-            int32 k = *reinterpret_cast<uint32*>(data_ptr);
-            if (swap)
+            int32 k;
+            memcpy(&k, data_ptr, 4);
+            if (swap_)
               KALDI_SWAP4(k);
-            data_(j, i) =  k;
+            (*data)(j, i) =  k;
             data_ptr += 4;
             break;
           }
         default:
-          KALDI_ERR << "bits per sample is " << bits_per_sample;  // already checked this.
+          KALDI_ERR << "bits per sample is " << bits_per_sample_;  // already checked this.
       }
     }
   }
+  return num_samp;
+}
+
+
+void WaveData::Read(std::istream &is) {
+  data_.Resize(0, 0);  // clear the data.
+
+  WaveStreamReader reader(is);
+  samp_freq_ = reader.SampFreq();
+
+  // We read in blocks and only then allocate the whole matrix, so that a
+  // corrupted header can't make us allocate a huge amount of memory.
+  int32 num_channels = reader.NumChannels(),
+      block_samples = std::max<int32>(1, kBlockSize /
+                                      (num_channels * sizeof(BaseFloat)));
+  std::vector<Matrix<BaseFloat> > blocks;
+  int64 num_samp = 0;
+  while (!reader.Done()) {
+    blocks.resize(blocks.size() + 1);
+    num_samp += reader.ReadBlock(block_samples, &(blocks.back()));
+  }
+  if (blocks.size() == 1) {
+    data_.Swap(&(blocks[0]));
+    return;
+  }
+  data_.Resize(num_channels, num_samp, kUndefined);
+  int64 offset = 0;
+  for (size_t i = 0; i < blocks.size(); i++) {
+    int32 this_num_samp = blocks[i].NumCols();
+    if (this_num_samp > 0)
+      data_.Range(0, num_channels, offset, this_num_samp).CopyFromMat(blocks[i]);
+    offset += this_num_samp;
+  }
 }
 
 
@@ -309,52 +336,85 @@ void WaveData::Read(std::istream &is) {
 
 // note: the WAVE chunk contains 2 subchunks.
 //
-// subchunk2size = data.NumRows() * data.NumCols() * 2.
-
+// subchunk2size = num_channels * num_samples * 2.
 
-void WaveData::Write(std::ostream &os) const {
-  os << "RIFF";
-  if (data_.NumRows() == 0)
+WaveStreamWriter::WaveStreamWriter(std::ostream &os, BaseFloat samp_freq,
+                                   int32 num_channels, int64 num_samples):
+    os_(os), num_channels_(num_channels), samples_left_(num_samples),
+    closed_(false) {
+  if (num_channels <= 0)
     KALDI_ERR << "Error: attempting to write empty WAVE file";
+  KALDI_ASSERT(samp_freq > 0 && num_samples >= 0);
+  int32 bytes_per_samp = 2;
+  int64 subchunk2size = num_channels * num_samples * bytes_per_samp;
+  if (36 + subchunk2size > static_cast<int64>(0xFFFFFFFFu))
+    KALDI_ERR << "Wave data is too long for the WAVE format: "
+              << num_samples << " samples, " << num_channels << " channels.";
 
-  int32 num_chan = data_.NumRows(),
-      num_samp = data_.NumCols(),
-      bytes_per_samp = 2;
-
-  int32 subchunk2size = (num_chan * num_samp * bytes_per_samp);
-  int32 chunk_size = 36 + subchunk2size;
-  WriteUint32(os, chunk_size);
+  os << "RIFF";
+  WriteUint32(os, static_cast<uint32>(36 + subchunk2size));
   os << "WAVE";
   os << "fmt ";
   WriteUint32(os, 16);
   WriteUint16(os, 1);
-  WriteUint16(os, num_chan);
-  KALDI_ASSERT(samp_freq_ > 0);
-  WriteUint32(os, static_cast<int32>(samp_freq_));
-  WriteUint32(os, static_cast<int32>(samp_freq_) * num_chan * bytes_per_samp);
-  WriteUint16(os, num_chan * bytes_per_samp);
+  WriteUint16(os, num_channels);
+  WriteUint32(os, static_cast<int32>(samp_freq));
+  WriteUint32(os, static_cast<int32>(samp_freq) * num_channels * bytes_per_samp);
+  WriteUint16(os, num_channels * bytes_per_samp);
   WriteUint16(os, 8 * bytes_per_samp);
   os << "data";
-  WriteUint32(os, subchunk2size);
-
-  const BaseFloat *data_ptr = data_.Data();
-  int32 stride = data_.Stride();
+  WriteUint32(os, static_cast<uint32>(subchunk2size));
+}
 
-  for (int32 i = 0; i < num_samp; i++) {
-    for (int32 j = 0; j < num_chan; j++) {
-      int32 elem = static_cast<int32>(data_ptr[j*stride + i]);
+void WaveStreamWriter::WriteBlock(const MatrixBase<BaseFloat> &data) {
+  KALDI_ASSERT(data.NumRows() == num_channels_);
+  int32 num_samp = data.NumCols();
+  if (num_samp > samples_left_)
+    KALDI_ERR << "Writing more samples than were declared in the WAVE header.";
+  samples_left_ -= num_samp;
+
+  // Interleave the channels into a buffer so we can write it all at once.
+  buffer_.resize(static_cast<size_t>(num_samp) * num_channels_);
+  for (int32 j = 0; j < num_channels_; j++) {
+    const BaseFloat *data_ptr = data.RowData(j);
+    int16 *buffer_ptr = (num_samp > 0 ? &(buffer_[j]) : NULL);
+    for (int32 i = 0; i < num_samp; i++, buffer_ptr += num_channels_) {
+      int32 elem = static_cast<int32>(data_ptr[i]);
       int16 elem_16(elem);
       if (static_cast<int32>(elem_16) != elem)
         KALDI_ERR << "Wave file is out of range for 16-bit.";
 #ifdef __BIG_ENDIAN__
       KALDI_SWAP2(elem_16);
 #endif
-      os.write(reinterpret_cast<char*>(&elem_16), 2);
+      *buffer_ptr = elem_16;
     }
   }
-  if (os.fail())
+  if (!buffer_.empty())
+    os_.write(reinterpret_cast<char*>(&(buffer_[0])),
+              buffer_.size() * sizeof(int16));
+  if (os_.fail())
     KALDI_ERR << "Error writing wave data to stream.";
 }
 
+void WaveStreamWriter::Close() {
+  closed_ = true;
+  if (samples_left_ != 0)
+    KALDI_ERR << "Wave data is " << samples_left_ << " samples per channel "
+              << "shorter than declared in the WAVE header.";
+}
+
+WaveStreamWriter::~WaveStreamWriter() {
+  if (!closed_ && samples_left_ != 0)
+    KALDI_WARN << "Wave data is " << samples_left_ << " samples per channel "
+               << "shorter than declared in the WAVE header; the file will "
+               << "be invalid.";
+}
+
+void WaveData::Write(std::ostream &os) const {
+  WaveStreamWriter writer(os, samp_freq_, data_.NumRows(), data_.NumCols());
+  writer.WriteBlock(data_);
+  writer.Close();
+}
+
 
 }  // end namespace kaldi
@@ -44,6 +44,7 @@
 #define KALDI_FEAT_WAVE_READER_H_
 
 #include <cstring>
+#include <vector>
 
 #include "base/kaldi-types.h"
 #include "matrix/kaldi-vector.h"
@@ -52,6 +53,85 @@
 
 namespace kaldi {
 
+/// This class reads the header of a Wave file in its constructor, and then
+/// gives access to the samples a block at a time, so that arbitrarily long
+/// files can be processed in bounded memory.  WaveData::Read() is implemented
+/// using it.  All functions throw on error.
+class WaveStreamReader {
+ public:
+  /// Reads the header from "is", which should be opened in binary mode and
+  /// must outlive this object.
+  explicit WaveStreamReader(std::istream &is);
+
+  BaseFloat SampFreq() const { return samp_freq_; }
+
+  int32 NumChannels() const { return num_channels_; }
+
+  /// The number of samples per channel, according to the header.
+  int64 NumSamples() const { return num_samples_; }
+
+  /// Reads up to "max_samples" samples per channel into "data", which is
+  /// resized to NumChannels() by the number of samples read, and returns that
+  /// number.  If the file turns out to be shorter than the header says, warns
+  /// and returns what was there; after this, Done() will return true.
+  int32 ReadBlock(int32 max_samples, Matrix<BaseFloat> *data);
+
+  /// Returns true once all the data has been read.
+  bool Done() const { return samples_left_ == 0; }
+
+ private:
+  std::istream &is_;
+  bool swap_;
+  BaseFloat samp_freq_;
+  int32 num_channels_;
+  int32 bits_per_sample_;
+  int32 block_align_;
+  int64 num_samples_;
+  int64 samples_left_;
+  std::vector<char> buffer_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveStreamReader);
+};
+
+/// This class writes a 16-bit PCM Wave file a block at a time.  Because the
+/// header comes first, the total number of samples has to be known when the
+/// object is constructed, and Close() checks that this many were written.
+/// WaveData::Write() is implemented using it.
+class WaveStreamWriter {
+ public:
+  /// Writes the header to "os", which should be opened in binary mode and
+  /// must outlive this object.  "num_samples" is per channel.
+  WaveStreamWriter(std::ostream &os, BaseFloat samp_freq,
+                   int32 num_channels, int64 num_samples);
+
+  /// Writes the samples in "data", which must have NumChannels() rows.  The
+  /// values are truncated to integers, and it is an error if they are out of
+  /// range for 16 bits or if more samples are written than were declared in
+  /// the header.
+  void WriteBlock(const MatrixBase<BaseFloat> &data);
+
+  int32 NumChannels() const { return num_channels_; }
+
+  /// The number of samples per channel that remain to be written.
+  int64 NumSamplesLeft() const { return samples_left_; }
+
+  /// Throws if fewer samples were written than were declared in the header,
+  /// as the file would then be invalid.
+  void Close();
+
+  /// Warns if Close() was not called and the number of samples written does
+  /// not match the header (e.g. because an exception was thrown).
+  ~WaveStreamWriter();
+
+ private:
+  std::ostream &os_;
+  int32 num_channels_;
+  int64 samples_left_;
+  bool closed_;
+  std::vector<int16> buffer_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(WaveStreamWriter);
+};
+
+
 /// This class's purpose is to read in Wave files.
 class WaveData {
  public:
@@ -89,17 +169,15 @@ class WaveData {
     samp_freq_ = 0.0;
   }
 
+  void Swap(WaveData *other) {
+    data_.Swap(&(other->data_));
+    std::swap(samp_freq_, other->samp_freq_);
+  }
+
  private:
   static const uint32 kBlockSize = 1048576;  // 1024 * 1024, use 1M bytes
   Matrix<BaseFloat> data_;
   BaseFloat samp_freq_;
-  static void Expect4ByteTag(std::istream &is, const char *expected);
-  uint32 ReadUint32(std::istream &is, bool swap);
-  uint16 ReadUint16(std::istream &is, bool swap);
-  static void Read4ByteTag(std::istream &is, char *dest);
-
-  static void WriteUint32(std::ostream &os, int32 i);
-  static void WriteUint16(std::ostream &os, int16 i);
 };
 
 
@@ -132,6 +210,10 @@ class WaveHolder {
 
   const T &Value() { return t_; }
 
+  void Swap(WaveHolder *other) {
+    t_.Swap(&(other->t_));
+  }
+
   WaveHolder &operator = (const WaveHolder &other) {
     t_.CopyFrom(other.t_);
     return *this;
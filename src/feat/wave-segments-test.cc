@@ -0,0 +1,138 @@
+// feat/wave-segments-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include "feat/wave-segments.h"
+
+namespace kaldi {
+
+static void UnitTestParseWaveSegment() {
+  WaveSegment segment;
+  KALDI_ASSERT(ParseWaveSegment("seg1 rec1 0.5 1.5", &segment));
+  KALDI_ASSERT(segment.segment == "seg1" && segment.recording == "rec1" &&
+               segment.start == 0.5 && segment.end == 1.5 &&
+               segment.channel == -1);
+  KALDI_ASSERT(ParseWaveSegment("seg2 rec1 1.0 -1 1", &segment));
+  KALDI_ASSERT(segment.end == -1.0 && segment.channel == 1);
+  KALDI_ASSERT(!ParseWaveSegment("seg3 rec1 1.0", &segment));
+  KALDI_ASSERT(!ParseWaveSegment("seg3 rec1 x 2.0", &segment));
+  KALDI_ASSERT(!ParseWaveSegment("seg3 rec1 2.0 1.0", &segment));
+  KALDI_ASSERT(!ParseWaveSegment("seg3 rec1 1.0 2.0 -1", &segment));
+}
+
+static void UnitTestExtractWaveSegment() {
+  BaseFloat samp_freq = 100.0;
+  Matrix<BaseFloat> data(2, 300);
+  data.SetRandn();
+  WaveData wave(samp_freq, data);
+  WaveSegmentOptions opts;
+  WaveData segment_wave;
+
+  WaveSegment segment;
+  segment.segment = "seg";
+  segment.recording = "rec";
+  segment.start = 0.5;
+  segment.end = 1.5;
+  segment.channel = 1;
+  KALDI_ASSERT(ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  KALDI_ASSERT(segment_wave.SampFreq() == samp_freq);
+  AssertEqual(segment_wave.Data(), data.Range(1, 1, 50, 100));
+
+  segment.channel = -1;  // all channels.
+  segment.end = -1.0;  // till the end.
+  KALDI_ASSERT(ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  AssertEqual(segment_wave.Data(), data.Range(0, 2, 50, 250));
+
+  segment.end = 3.2;  // small overshoot: truncated.
+  KALDI_ASSERT(ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  KALDI_ASSERT(segment_wave.Data().NumCols() == 250);
+  segment.end = 4.0;  // large overshoot: rejected.
+  KALDI_ASSERT(!ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  segment.start = 3.5;  // starts after the end.
+  KALDI_ASSERT(!ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  segment.start = 1.0;
+  segment.end = 1.05;  // too short.
+  KALDI_ASSERT(!ExtractWaveSegment(wave, segment, opts, &segment_wave));
+  segment.end = 2.0;
+  segment.channel = 2;  // no such channel.
+  KALDI_ASSERT(!ExtractWaveSegment(wave, segment, opts, &segment_wave));
+}
+
+static void UnitTestSequentialWaveSegmentReader() {
+  BaseFloat samp_freq = 100.0;
+  Matrix<BaseFloat> data1(1, 200), data2(1, 400);
+  // WaveData is written as 16-bit integers, so use whole numbers.
+  for (int32 i = 0; i < 200; i++) data1(0, i) = i;
+  for (int32 i = 0; i < 400; i++) data2(0, i) = -i;
+  {
+    TableWriter<WaveHolder> writer("ark:tmp.wave.ark");
+    writer.Write("rec1", WaveData(samp_freq, data1));
+    writer.Write("rec2", WaveData(samp_freq, data2));
+  }
+  {
+    Output ko("tmp.segments", false);
+    ko.Stream() << "seg1 rec1 0.0 1.0\n"
+                << "seg2 rec3 0.0 1.0\n"  // no such recording.
+                << "seg3 rec2 1.0 -1\n"
+                << "seg4 rec2 4.0 5.0\n"  // out of range.
+                << "seg5 rec1 0.5 2.1\n";
+  }
+  WaveSegmentOptions opts;
+  {  // Without segments, we get the recordings.
+    SequentialWaveSegmentReader reader("ark:tmp.wave.ark", "", opts);
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "rec1");
+    AssertEqual(reader.Value().Data(), data1);
+    reader.Next();
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "rec2");
+    reader.Next();
+    KALDI_ASSERT(reader.Done() && reader.NumLines() == 0);
+  }
+  {
+    SequentialWaveSegmentReader reader("ark:tmp.wave.ark", "tmp.segments",
+                                       opts);
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "seg1");
+    AssertEqual(reader.Value().Data(), data1.Range(0, 1, 0, 100));
+    reader.Next();
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "seg3");
+    AssertEqual(reader.Value().Data(), data2.Range(0, 1, 100, 300));
+    reader.Next();
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "seg5");
+    AssertEqual(reader.Value().Data(), data1.Range(0, 1, 50, 150));
+    reader.Next();
+    KALDI_ASSERT(reader.Done() && reader.NumLines() == 5);
+  }
+  std::remove("tmp.wave.ark");
+  std::remove("tmp.segments");
+}
+
+}  // namespace kaldi
+
+int main() {
+  using namespace kaldi;
+  try {
+    UnitTestParseWaveSegment();
+    UnitTestExtractWaveSegment();
+    UnitTestSequentialWaveSegmentReader();
+    KALDI_LOG << "Tests succeeded.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return 1;
+  }
+}
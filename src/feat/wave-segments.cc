@@ -0,0 +1,196 @@
+// feat/wave-segments.cc
+
+// Copyright 2009-2011  Microsoft Corporation;  Govivace Inc.
+//           2013       Arnab Ghoshal
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+#include "feat/wave-segments.h"
+
+namespace kaldi {
+
+bool ParseWaveSegment(const std::string &line, WaveSegment *segment) {
+  std::vector<std::string> split_line;
+  // Split the line by space or tab and check the number of fields in each
+  // line. There must be 4 fields--segment name , reacording wav file name,
+  // start time, end time; 5th field (channel info) is optional.
+  SplitStringToVector(line, " \t\r", true, &split_line);
+  if (split_line.size() != 4 && split_line.size() != 5) {
+    KALDI_WARN << "Invalid line in segments file: " << line;
+    return false;
+  }
+  segment->segment = split_line[0];
+  segment->recording = split_line[1];
+
+  // Convert the start time and endtime to real from string. Segment is
+  // ignored if start or end time cannot be converted to real.
+  double start, end;
+  if (!ConvertStringToReal(split_line[2], &start)) {
+    KALDI_WARN << "Invalid line in segments file [bad start]: " << line;
+    return false;
+  }
+  if (!ConvertStringToReal(split_line[3], &end)) {
+    KALDI_WARN << "Invalid line in segments file [bad end]: " << line;
+    return false;
+  }
+  // start time must not be negative; start time must not be greater than
+  // end time, except if end time is -1
+  if (start < 0 || (end != -1.0 && end <= 0) || ((start >= end) && (end > 0))) {
+    KALDI_WARN << "Invalid line in segments file [empty or invalid segment]: "
+               << line;
+    return false;
+  }
+  segment->start = start;
+  segment->end = end;
+  segment->channel = -1;  // means channel info is unspecified.
+  // if each line has 5 elements then 5th element must be channel identifier
+  if (split_line.size() == 5) {
+    if (!ConvertStringToInteger(split_line[4], &(segment->channel)) ||
+        segment->channel < 0) {
+      KALDI_WARN << "Invalid line in segments file [bad channel]: " << line;
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ExtractWaveSegment(const WaveData &wave, const WaveSegment &segment,
+                        const WaveSegmentOptions &opts,
+                        WaveData *segment_wave) {
+  const Matrix<BaseFloat> &wave_data = wave.Data();
+  BaseFloat samp_freq = wave.SampFreq();  // read sampling fequency
+  int32 num_samp = wave_data.NumCols(),  // number of samples in recording
+      num_chan = wave_data.NumRows();  // number of channels in recording
+
+  // Convert starting time of the segment to corresponding sample number.
+  // If end time is -1 then use the whole file starting from start time.
+  int32 start_samp = segment.start * samp_freq,
+      end_samp = (segment.end != -1)? (segment.end * samp_freq) : num_samp;
+  KALDI_ASSERT(start_samp >= 0 && end_samp > 0 && "Invalid start or end.");
+
+  // start sample must be less than total number of samples,
+  // otherwise skip the segment
+  if (start_samp < 0 || start_samp >= num_samp) {
+    KALDI_WARN << "Start sample out of range " << start_samp << " [length:] "
+               << num_samp << ", skipping segment " << segment.segment;
+    return false;
+  }
+  // end sample must be less than total number samples,
+  // otherwise skip the segment
+  if (end_samp > num_samp) {
+    if ((end_samp >=
+         num_samp + static_cast<int32>(opts.max_overshoot * samp_freq))) {
+      KALDI_WARN << "End sample too far out of range " << end_samp
+                 << " [length:] " << num_samp << ", skipping segment "
+                 << segment.segment;
+      return false;
+    }
+    end_samp = num_samp;  // for small differences, just truncate.
+  }
+  // Skip if segment size is less than minimum segment length (default 0.1s)
+  if (end_samp <=
+      start_samp + static_cast<int32>(opts.min_segment_length * samp_freq)) {
+    KALDI_WARN << "Segment " << segment.segment << " too short, skipping it.";
+    return false;
+  }
+  if (segment.channel >= num_chan) {
+    KALDI_WARN << "Invalid channel " << segment.channel << " >= " << num_chan
+               << ", processing segment " << segment.segment;
+    return false;
+  }
+  int32 first_chan = (segment.channel == -1 ? 0 : segment.channel),
+      this_num_chan = (segment.channel == -1 ? num_chan : 1);
+  SubMatrix<BaseFloat> segment_matrix(wave_data, first_chan, this_num_chan,
+                                      start_samp, end_samp - start_samp);
+  WaveData this_segment_wave(samp_freq, segment_matrix);
+  segment_wave->Swap(&this_segment_wave);
+  return true;
+}
+
+
+SequentialWaveSegmentReader::SequentialWaveSegmentReader(
+    const std::string &wav_rspecifier,
+    const std::string &segments_rxfilename,
+    const WaveSegmentOptions &opts):
+    opts_(opts), wave_reader_(NULL), recording_reader_(NULL), done_(false),
+    num_lines_(0) {
+  if (segments_rxfilename == "") {
+    wave_reader_ = new SequentialTableReader<WaveHolder>(wav_rspecifier);
+  } else {
+    recording_reader_ = new RandomAccessTableReader<WaveHolder>(wav_rspecifier);
+    // no binary argument: never binary.
+    if (!segments_input_.Open(segments_rxfilename))
+      KALDI_ERR << "Error opening segments file "
+                << PrintableRxfilename(segments_rxfilename);
+    ReadSegment();
+  }
+}
+
+SequentialWaveSegmentReader::~SequentialWaveSegmentReader() {
+  delete wave_reader_;
+  delete recording_reader_;
+}
+
+bool SequentialWaveSegmentReader::Done() const {
+  return (wave_reader_ != NULL ? wave_reader_->Done() : done_);
+}
+
+std::string SequentialWaveSegmentReader::Key() const {
+  if (wave_reader_ != NULL)
+    return wave_reader_->Key();
+  KALDI_ASSERT(!done_);
+  return segment_id_;
+}
+
+const WaveData &SequentialWaveSegmentReader::Value() const {
+  if (wave_reader_ != NULL)
+    return wave_reader_->Value();
+  KALDI_ASSERT(!done_);
+  return segment_wave_;
+}
+
+void SequentialWaveSegmentReader::Next() {
+  if (wave_reader_ != NULL)
+    wave_reader_->Next();
+  else
+    ReadSegment();
+}
+
+void SequentialWaveSegmentReader::ReadSegment() {
+  std::string line;
+  while (std::getline(segments_input_.Stream(), line)) {
+    num_lines_++;
+    WaveSegment segment;
+    if (!ParseWaveSegment(line, &segment))
+      continue;
+    if (!recording_reader_->HasKey(segment.recording)) {
+      KALDI_WARN << "Could not find recording " << segment.recording
+                 << ", skipping segment " << segment.segment;
+      continue;
+    }
+    const WaveData &wave = recording_reader_->Value(segment.recording);
+    if (!ExtractWaveSegment(wave, segment, opts_, &segment_wave_))
+      continue;
+    segment_id_ = segment.segment;
+    return;
+  }
+  done_ = true;
+  segment_id_ = "";
+  segment_wave_.Clear();
+}
+
+}  // namespace kaldi
@@ -0,0 +1,115 @@
+// feat/wave-segments.h
+
+// Copyright 2009-2011  Microsoft Corporation;  Govivace Inc.
+//           2013       Arnab Ghoshal
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FEAT_WAVE_SEGMENTS_H_
+#define KALDI_FEAT_WAVE_SEGMENTS_H_
+
+#include <string>
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/wave-reader.h"
+
+namespace kaldi {
+/// @addtogroup  feat FeatureExtraction
+/// @{
+
+struct WaveSegmentOptions {
+  BaseFloat min_segment_length;  // Minimum segment length in seconds.
+  BaseFloat max_overshoot;  // Max time by which the last segment can overshoot.
+  WaveSegmentOptions(): min_segment_length(0.1), max_overshoot(0.5) { }
+  void Register(OptionsItf *po) {
+    po->Register("min-segment-length", &min_segment_length,
+                 "Minimum segment length in seconds (reject shorter segments)");
+    po->Register("max-overshoot", &max_overshoot,
+                 "End segments overshooting audio by less than this (in "
+                 "seconds) are truncated, else rejected.");
+  }
+};
+
+/// A line of a segments file, which is either
+/// <segment-id> <recording-id> <start-time> <end-time>
+/// or
+/// <segment-id> <recording-id> <start-time> <end-time> <channel>
+/// where an <end-time> of -1 means the end of the recording.
+struct WaveSegment {
+  std::string segment;
+  std::string recording;
+  double start;
+  double end;
+  int32 channel;  // -1 if not specified.
+};
+
+/// Parses a line of a segments file; returns false, with a warning, if it is
+/// invalid.
+bool ParseWaveSegment(const std::string &line, WaveSegment *segment);
+
+/// Outputs to "segment_wave" the part of "wave" that "segment" refers to: just
+/// the channel it specifies, or all the channels if it does not specify one.
+/// Returns false, with a warning, if the segment is out of range or too short.
+bool ExtractWaveSegment(const WaveData &wave, const WaveSegment &segment,
+                        const WaveSegmentOptions &opts,
+                        WaveData *segment_wave);
+
+/// This class reads a sequence of waveforms, as SequentialTableReader<WaveHolder>
+/// would: if "segments_rxfilename" is empty these are the recordings in
+/// "wav_rspecifier"; otherwise they are the segments listed in that file (as
+/// for extract-segments), taken from the recordings in "wav_rspecifier", which
+/// are then accessed as a RandomAccessTableReader.  Invalid segments are
+/// skipped with a warning.
+class SequentialWaveSegmentReader {
+ public:
+  SequentialWaveSegmentReader(const std::string &wav_rspecifier,
+                              const std::string &segments_rxfilename,
+                              const WaveSegmentOptions &opts);
+
+  bool Done() const;
+  /// The utterance-id (recording-id or segment-id).
+  std::string Key() const;
+  const WaveData &Value() const;
+  void Next();
+
+  /// The number of lines of the segments file read so far (zero if there
+  /// isn't one).
+  int32 NumLines() const { return num_lines_; }
+
+  ~SequentialWaveSegmentReader();
+ private:
+  // Reads lines of the segments file until it gets a valid segment or reaches
+  // the end.
+  void ReadSegment();
+
+  WaveSegmentOptions opts_;
+  // Exactly one of the following two is non-NULL.
+  SequentialTableReader<WaveHolder> *wave_reader_;
+  RandomAccessTableReader<WaveHolder> *recording_reader_;
+
+  // The following are only used if there is a segments file.
+  Input segments_input_;
+  bool done_;
+  std::string segment_id_;
+  WaveData segment_wave_;
+  int32 num_lines_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialWaveSegmentReader);
+};
+
+/// @} End of "addtogroup feat"
+}  // namespace kaldi
+
+#endif  // KALDI_FEAT_WAVE_SEGMENTS_H_
@@ -22,7 +22,91 @@
 #include "util/common-utils.h"
 #include "feat/feature-fbank.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// This class is used to parallelize this program over multiple threads.  The
+// features are computed in operator (), and written in the destructor, which
+// TaskSequencer calls in the same order as the utterances were read.
+class FbankComputeTask {
+ public:
+  FbankComputeTask(const Fbank &fbank, const FbankOptions &fbank_opts,
+                       const std::string &utt,
+                       const VectorBase<BaseFloat> &waveform,
+                       BaseFloat vtln_warp, bool subtract_mean,
+                       BaseFloatMatrixWriter *kaldi_writer,
+                       TableWriter<HtkMatrixHolder> *htk_writer,
+                       int32 *num_success):
+      fbank_(fbank), fbank_opts_(fbank_opts), utt_(utt), waveform_(waveform),
+      vtln_warp_(vtln_warp), subtract_mean_(subtract_mean),
+      kaldi_writer_(kaldi_writer), htk_writer_(htk_writer),
+      num_success_(num_success), failed_(false) {
+    // The dither is drawn from a generator seeded from the utterance-id, so
+    // that the output does not depend on --num-threads or on the order in
+    // which the threads happen to run.
+    random_state_.seed = StringHasher()(utt);
+  }
 
+  void operator () () {
+    try {
+      // Calls the const version of Compute(), which is safe to call from
+      // multiple threads at once.
+      fbank_.Compute(waveform_, vtln_warp_, &features_, NULL, &random_state_);
+    } catch (...) {
+      KALDI_WARN << "Failed to compute features for utterance "
+                 << utt_;
+      failed_ = true;
+      return;
+    }
+    if (subtract_mean_) {
+      Vector<BaseFloat> mean(features_.NumCols());
+      mean.AddRowSumMat(1.0, features_);
+      mean.Scale(1.0 / features_.NumRows());
+      for (int32 i = 0; i < features_.NumRows(); i++)
+        features_.Row(i).AddVec(-1.0, mean);
+    }
+  }
+
+  ~FbankComputeTask() {
+    if (failed_)
+      return;
+    if (kaldi_writer_ != NULL) {
+      kaldi_writer_->Write(utt_, features_);
+    } else {
+      std::pair<Matrix<BaseFloat>, HtkHeader> p;
+      p.first.Resize(features_.NumRows(), features_.NumCols());
+      p.first.CopyFromMat(features_);
+      HtkHeader header = {
+        features_.NumRows(),
+        100000,  // 10ms shift
+        static_cast<int16>(sizeof(float)*features_.NumCols()),
+        static_cast<uint16>(007 | // FBANK
+        (fbank_opts_.use_energy ? 0100 : 020000)) // energy; otherwise c0
+      };
+      p.second = header;
+      htk_writer_->Write(utt_, p);
+    }
+    KALDI_VLOG(2) << "Processed features for key " << utt_;
+    (*num_success_)++;
+  }
+ private:
+  const Fbank &fbank_;
+  const FbankOptions &fbank_opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloat vtln_warp_;
+  bool subtract_mean_;
+  BaseFloatMatrixWriter *kaldi_writer_;  // NULL if writing HTK format.
+  TableWriter<HtkMatrixHolder> *htk_writer_;  // NULL if writing Kaldi format.
+  int32 *num_success_;
+  bool failed_;
+  RandomState random_state_;
+  Matrix<BaseFloat> features_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -42,6 +126,9 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    std::string segments_rxfilename;
+    WaveSegmentOptions segment_opts;
+    TaskSequencerConfig sequencer_config;  // --num-threads etc.
 
     // Register the option struct
     fbank_opts.Register(&po);
@@ -53,6 +140,12 @@ int main(int argc, char *argv[]) {
     po.Register("utt2spk", &utt2spk_rspecifier, "Utterance to speaker-id map (if doing VTLN and you have warps per speaker)");
     po.Register("channel", &channel, "Channel to extract (-1 -> expect mono, 0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "If supplied, segments file "
+                "(as for extract-segments): compute features for these segments "
+                "of the recordings in <wav-rspecifier>, instead of for the "
+                "whole recordings.");
+    segment_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     // OPTION PARSING ..........................................................
     //
@@ -71,7 +164,8 @@ int main(int argc, char *argv[]) {
 
     Fbank fbank(fbank_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    SequentialWaveSegmentReader reader(wav_rspecifier, segments_rxfilename,
+                                       segment_opts);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -94,6 +188,7 @@ int main(int argc, char *argv[]) {
     }
 
     int32 num_utts = 0, num_success = 0;
+    TaskSequencer<FbankComputeTask> sequencer(sequencer_config);
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
       std::string utt = reader.Key();
@@ -139,42 +234,14 @@ int main(int argc, char *argv[]) {
                   << "option).  Utterance is " << utt;
 
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        fbank.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          static_cast<uint16>(007 | // FBANK
-          (fbank_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
+      sequencer.Run(new FbankComputeTask(
+          fbank, fbank_opts, utt, waveform, vtln_warp_local, subtract_mean,
+          (output_format == "kaldi" ? &kaldi_writer : NULL),
+          (output_format == "kaldi" ? NULL : &htk_writer), &num_success));
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
     }
+    sequencer.Wait();  // Wait for the remaining utterances to be written.
     KALDI_LOG << " Done " << num_success << " out of " << num_utts
               << " utterances.";
     return (num_success != 0 ? 0 : 1);
@@ -20,7 +20,57 @@
 #include "util/common-utils.h"
 #include "feat/pitch-functions.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
+#include "thread/kaldi-task-sequence.h"
 
+namespace kaldi {
+
+// This class is used to parallelize this program over multiple threads.  The
+// pitch is computed in operator (), and written in the destructor, which
+// TaskSequencer calls in the same order as the utterances were read.
+class PitchComputeTask {
+ public:
+  PitchComputeTask(const PitchExtractionOptions &pitch_opts,
+                   const std::string &utt,
+                   const VectorBase<BaseFloat> &waveform,
+                   BaseFloatMatrixWriter *feat_writer,
+                   int32 *num_done, int32 *num_err):
+      pitch_opts_(pitch_opts), utt_(utt), waveform_(waveform),
+      feat_writer_(feat_writer), num_done_(num_done), num_err_(num_err),
+      failed_(false) { }
+
+  void operator () () {
+    try {
+      ComputeKaldiPitch(pitch_opts_, waveform_, &features_);
+    } catch (...) {
+      KALDI_WARN << "Failed to compute pitch for utterance "
+                 << utt_;
+      failed_ = true;
+    }
+  }
+
+  ~PitchComputeTask() {
+    if (failed_) {
+      (*num_err_)++;
+      return;
+    }
+    feat_writer_->Write(utt_, features_);
+    if (*num_done_ % 50 == 0 && *num_done_ != 0)
+      KALDI_VLOG(2) << "Processed " << *num_done_ << " utterances";
+    (*num_done_)++;
+  }
+ private:
+  const PitchExtractionOptions &pitch_opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloatMatrixWriter *feat_writer_;
+  int32 *num_done_;
+  int32 *num_err_;
+  bool failed_;
+  Matrix<BaseFloat> features_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -33,6 +83,8 @@ int main(int argc, char *argv[]) {
         "Usage: compute-kaldi-pitch-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
         "e.g.\n"
         "compute-kaldi-pitch-feats --sample-frequency=8000 scp:wav.scp ark:- \n"
+        "compute-kaldi-pitch-feats --num-threads=8 --segments=segments \\\n"
+        "   scp:wav.scp ark:- \n"
         "\n"
         "See also: process-kaldi-pitch-feats, compute-and-process-kaldi-pitch-feats\n";
     
@@ -43,8 +95,17 @@ int main(int argc, char *argv[]) {
                         // good idea to control it this way: better to extract the
                         // on the command line (in the .scp file) using sox or
                         // similar.
+    std::string segments_rxfilename;
+    WaveSegmentOptions segment_opts;
+    TaskSequencerConfig sequencer_config;  // --num-threads etc.
 
     pitch_opts.Register(&po);
+    po.Register("segments", &segments_rxfilename, "If supplied, segments file "
+                "(as for extract-segments): compute pitch for these segments "
+                "of the recordings in <wav-rspecifier>, instead of for the "
+                "whole recordings.");
+    segment_opts.Register(&po);
+    sequencer_config.Register(&po);
     
     po.Read(argc, argv);
 
@@ -56,10 +117,12 @@ int main(int argc, char *argv[]) {
     std::string wav_rspecifier = po.GetArg(1),
         feat_wspecifier = po.GetArg(2);
 
-    SequentialTableReader<WaveHolder> wav_reader(wav_rspecifier);
+    SequentialWaveSegmentReader wav_reader(wav_rspecifier, segments_rxfilename,
+                                           segment_opts);
     BaseFloatMatrixWriter feat_writer(feat_wspecifier);
 
     int32 num_done = 0, num_err = 0;
+    TaskSequencer<PitchComputeTask> sequencer(sequencer_config);
     for (; !wav_reader.Done(); wav_reader.Next()) {
       std::string utt = wav_reader.Key();  
       const WaveData &wave_data = wav_reader.Value(); 
@@ -91,21 +154,10 @@ int main(int argc, char *argv[]) {
       
       
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        ComputeKaldiPitch(pitch_opts, waveform, &features);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute pitch for utterance "
-                   << utt;
-        num_err++;        
-        continue;
-      }
-      
-      feat_writer.Write(utt, features);
-      if (num_done % 50 == 0 && num_done != 0)
-        KALDI_VLOG(2) << "Processed " << num_done << " utterances";
-      num_done++;
+      sequencer.Run(new PitchComputeTask(pitch_opts, utt, waveform,
+                                         &feat_writer, &num_done, &num_err));
     }
+    sequencer.Wait();  // Wait for the remaining utterances to be written.
     KALDI_LOG << "Done " << num_done << " utterances, " << num_err
               << " with errors.";
     return (num_done != 0 ? 0 : 1);
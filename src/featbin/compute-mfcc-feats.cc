@@ -22,13 +22,100 @@
 #include "util/common-utils.h"
 #include "feat/feature-mfcc.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
+#include "thread/kaldi-task-sequence.h"
+
+namespace kaldi {
+
+// This class is used to parallelize this program over multiple threads.  The
+// features are computed in operator (), and written in the destructor, which
+// TaskSequencer calls in the same order as the utterances were read.
+class MfccComputeTask {
+ public:
+  MfccComputeTask(const Mfcc &mfcc, const MfccOptions &mfcc_opts,
+                  const std::string &utt,
+                  const VectorBase<BaseFloat> &waveform,
+                  BaseFloat vtln_warp, bool subtract_mean,
+                  BaseFloatMatrixWriter *kaldi_writer,
+                  TableWriter<HtkMatrixHolder> *htk_writer,
+                  int32 *num_success):
+      mfcc_(mfcc), mfcc_opts_(mfcc_opts), utt_(utt), waveform_(waveform),
+      vtln_warp_(vtln_warp), subtract_mean_(subtract_mean),
+      kaldi_writer_(kaldi_writer), htk_writer_(htk_writer),
+      num_success_(num_success), failed_(false) {
+    // The dither is drawn from a generator seeded from the utterance-id, so
+    // that the output does not depend on --num-threads or on the order in
+    // which the threads happen to run.
+    random_state_.seed = StringHasher()(utt);
+  }
+
+  void operator () () {
+    try {
+      // Calls the const version of Compute(), which is safe to call from
+      // multiple threads at once.
+      mfcc_.Compute(waveform_, vtln_warp_, &features_, NULL, &random_state_);
+    } catch (...) {
+      KALDI_WARN << "Failed to compute features for utterance "
+                 << utt_;
+      failed_ = true;
+      return;
+    }
+    if (subtract_mean_) {
+      Vector<BaseFloat> mean(features_.NumCols());
+      mean.AddRowSumMat(1.0, features_);
+      mean.Scale(1.0 / features_.NumRows());
+      for (int32 i = 0; i < features_.NumRows(); i++)
+        features_.Row(i).AddVec(-1.0, mean);
+    }
+  }
+
+  ~MfccComputeTask() {
+    if (failed_)
+      return;
+    if (kaldi_writer_ != NULL) {
+      kaldi_writer_->Write(utt_, features_);
+    } else {
+      std::pair<Matrix<BaseFloat>, HtkHeader> p;
+      p.first.Resize(features_.NumRows(), features_.NumCols());
+      p.first.CopyFromMat(features_);
+      HtkHeader header = {
+        features_.NumRows(),
+        100000,  // 10ms shift
+        static_cast<int16>(sizeof(float)*(features_.NumCols())),
+        static_cast<uint16>( 006 | // MFCC
+        (mfcc_opts_.use_energy ? 0100 : 020000)) // energy; otherwise c0
+      };
+      p.second = header;
+      htk_writer_->Write(utt_, p);
+    }
+    KALDI_VLOG(2) << "Processed features for key " << utt_;
+    (*num_success_)++;
+  }
+ private:
+  const Mfcc &mfcc_;
+  const MfccOptions &mfcc_opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloat vtln_warp_;
+  bool subtract_mean_;
+  BaseFloatMatrixWriter *kaldi_writer_;  // NULL if writing HTK format.
+  TableWriter<HtkMatrixHolder> *htk_writer_;  // NULL if writing Kaldi format.
+  int32 *num_success_;
+  bool failed_;
+  RandomState random_state_;
+  Matrix<BaseFloat> features_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
     const char *usage =
         "Create MFCC feature files.\n"
-        "Usage:  compute-mfcc-feats [options...] <wav-rspecifier> <feats-wspecifier>\n";
+        "Usage:  compute-mfcc-feats [options...] <wav-rspecifier> <feats-wspecifier>\n"
+        "e.g. compute-mfcc-feats --num-threads=8 --segments=data/train/segments \\\n"
+        "   scp:data/train/wav.scp ark:- \n";
 
     // construct all the global objects
     ParseOptions po(usage);
@@ -41,6 +128,9 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    std::string segments_rxfilename;
+    WaveSegmentOptions segment_opts;
+    TaskSequencerConfig sequencer_config;  // --num-threads etc.
 
     // Register the MFCC option struct
     mfcc_opts.Register(&po);
@@ -60,6 +150,12 @@ int main(int argc, char *argv[]) {
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "If supplied, segments file "
+                "(as for extract-segments): compute features for these segments "
+                "of the recordings in <wav-rspecifier>, instead of for the "
+                "whole recordings.");
+    segment_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     po.Read(argc, argv);
 
@@ -74,7 +170,8 @@ int main(int argc, char *argv[]) {
 
     Mfcc mfcc(mfcc_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    SequentialWaveSegmentReader reader(wav_rspecifier, segments_rxfilename,
+                                       segment_opts);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -97,6 +194,7 @@ int main(int argc, char *argv[]) {
     }
 
     int32 num_utts = 0, num_success = 0;
+    TaskSequencer<MfccComputeTask> sequencer(sequencer_config);
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
       std::string utt = reader.Key();
@@ -142,42 +240,14 @@ int main(int argc, char *argv[]) {
                   << "option).  Utterance is " << utt;
 
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        mfcc.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (int32 i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*(features.NumCols())),
-          static_cast<uint16>( 006 | // MFCC
-          (mfcc_opts.use_energy ? 0100 : 020000)) // energy; otherwise c0
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
+      sequencer.Run(new MfccComputeTask(
+          mfcc, mfcc_opts, utt, waveform, vtln_warp_local, subtract_mean,
+          (output_format == "kaldi" ? &kaldi_writer : NULL),
+          (output_format == "kaldi" ? NULL : &htk_writer), &num_success));
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
     }
+    sequencer.Wait();  // Wait for the remaining utterances to be written.
     KALDI_LOG << " Done " << num_success << " out of " << num_utts
               << " utterances.";
     return (num_success != 0 ? 0 : 1);
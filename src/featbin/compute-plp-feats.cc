@@ -22,7 +22,91 @@
 #include "util/common-utils.h"
 #include "feat/feature-plp.h"
 #include "feat/wave-reader.h"
+#include "feat/wave-segments.h"
+#include "thread/kaldi-task-sequence.h"
 
+namespace kaldi {
+
+// This class is used to parallelize this program over multiple threads.  The
+// features are computed in operator (), and written in the destructor, which
+// TaskSequencer calls in the same order as the utterances were read.
+class PlpComputeTask {
+ public:
+  PlpComputeTask(const Plp &plp, const PlpOptions &plp_opts,
+                     const std::string &utt,
+                     const VectorBase<BaseFloat> &waveform,
+                     BaseFloat vtln_warp, bool subtract_mean,
+                     BaseFloatMatrixWriter *kaldi_writer,
+                     TableWriter<HtkMatrixHolder> *htk_writer,
+                     int32 *num_success):
+      plp_(plp), plp_opts_(plp_opts), utt_(utt), waveform_(waveform),
+      vtln_warp_(vtln_warp), subtract_mean_(subtract_mean),
+      kaldi_writer_(kaldi_writer), htk_writer_(htk_writer),
+      num_success_(num_success), failed_(false) {
+    // The dither is drawn from a generator seeded from the utterance-id, so
+    // that the output does not depend on --num-threads or on the order in
+    // which the threads happen to run.
+    random_state_.seed = StringHasher()(utt);
+  }
+
+  void operator () () {
+    try {
+      // Calls the const version of Compute(), which is safe to call from
+      // multiple threads at once.
+      plp_.Compute(waveform_, vtln_warp_, &features_, NULL, &random_state_);
+    } catch (...) {
+      KALDI_WARN << "Failed to compute features for utterance "
+                 << utt_;
+      failed_ = true;
+      return;
+    }
+    if (subtract_mean_) {
+      Vector<BaseFloat> mean(features_.NumCols());
+      mean.AddRowSumMat(1.0, features_);
+      mean.Scale(1.0 / features_.NumRows());
+      for (int32 i = 0; i < features_.NumRows(); i++)
+        features_.Row(i).AddVec(-1.0, mean);
+    }
+  }
+
+  ~PlpComputeTask() {
+    if (failed_)
+      return;
+    if (kaldi_writer_ != NULL) {
+      kaldi_writer_->Write(utt_, features_);
+    } else {
+      std::pair<Matrix<BaseFloat>, HtkHeader> p;
+      p.first.Resize(features_.NumRows(), features_.NumCols());
+      p.first.CopyFromMat(features_);
+      HtkHeader header = {
+        features_.NumRows(),
+        100000,  // 10ms shift
+        static_cast<int16>(sizeof(float)*features_.NumCols()),
+        013 | // PLP
+        020000 // C0 [no option currently to use energy in PLP.
+      };
+      p.second = header;
+      htk_writer_->Write(utt_, p);
+    }
+    KALDI_VLOG(2) << "Processed features for key " << utt_;
+    (*num_success_)++;
+  }
+ private:
+  const Plp &plp_;
+  const PlpOptions &plp_opts_;
+  std::string utt_;
+  Vector<BaseFloat> waveform_;
+  BaseFloat vtln_warp_;
+  bool subtract_mean_;
+  BaseFloatMatrixWriter *kaldi_writer_;  // NULL if writing HTK format.
+  TableWriter<HtkMatrixHolder> *htk_writer_;  // NULL if writing Kaldi format.
+  int32 *num_success_;
+  bool failed_;
+  RandomState random_state_;
+  Matrix<BaseFloat> features_;
+};
+
+}  // namespace kaldi
 
 int main(int argc, char *argv[]) {
   try {
@@ -42,6 +126,9 @@ int main(int argc, char *argv[]) {
     BaseFloat min_duration = 0.0;
     // Define defaults for gobal options
     std::string output_format = "kaldi";
+    std::string segments_rxfilename;
+    WaveSegmentOptions segment_opts;
+    TaskSequencerConfig sequencer_config;  // --num-threads etc.
 
     // Register the options
     po.Register("output-format", &output_format, "Format of the output "
@@ -58,6 +145,12 @@ int main(int argc, char *argv[]) {
                 "0 -> left, 1 -> right)");
     po.Register("min-duration", &min_duration, "Minimum duration of segments "
                 "to process (in seconds).");
+    po.Register("segments", &segments_rxfilename, "If supplied, segments file "
+                "(as for extract-segments): compute features for these segments "
+                "of the recordings in <wav-rspecifier>, instead of for the "
+                "whole recordings.");
+    segment_opts.Register(&po);
+    sequencer_config.Register(&po);
 
     plp_opts.Register(&po);
 
@@ -74,7 +167,8 @@ int main(int argc, char *argv[]) {
 
     Plp plp(plp_opts);
 
-    SequentialTableReader<WaveHolder> reader(wav_rspecifier);
+    SequentialWaveSegmentReader reader(wav_rspecifier, segments_rxfilename,
+                                       segment_opts);
     BaseFloatMatrixWriter kaldi_writer;  // typedef to TableWriter<something>.
     TableWriter<HtkMatrixHolder> htk_writer;
 
@@ -97,6 +191,7 @@ int main(int argc, char *argv[]) {
     }
 
     int32 num_utts = 0, num_success = 0;
+    TaskSequencer<PlpComputeTask> sequencer(sequencer_config);
     for (; !reader.Done(); reader.Next()) {
       num_utts++;
       std::string utt = reader.Key();
@@ -142,42 +237,14 @@ int main(int argc, char *argv[]) {
                   << "option).  Utterance is " << utt;
 
       SubVector<BaseFloat> waveform(wave_data.Data(), this_chan);
-      Matrix<BaseFloat> features;
-      try {
-        plp.Compute(waveform, vtln_warp_local, &features, NULL);
-      } catch (...) {
-        KALDI_WARN << "Failed to compute features for utterance "
-                   << utt;
-        continue;
-      }
-      if (subtract_mean) {
-        Vector<BaseFloat> mean(features.NumCols());
-        mean.AddRowSumMat(1.0, features);
-        mean.Scale(1.0 / features.NumRows());
-        for (size_t i = 0; i < features.NumRows(); i++)
-          features.Row(i).AddVec(-1.0, mean);
-      }
-      if (output_format == "kaldi") {
-        kaldi_writer.Write(utt, features);
-      } else {
-        std::pair<Matrix<BaseFloat>, HtkHeader> p;
-        p.first.Resize(features.NumRows(), features.NumCols());
-        p.first.CopyFromMat(features);
-        HtkHeader header = {
-          features.NumRows(),
-          100000,  // 10ms shift
-          static_cast<int16>(sizeof(float)*features.NumCols()),
-          013 | // PLP
-          020000 // C0 [no option currently to use energy in PLP.
-        };
-        p.second = header;
-        htk_writer.Write(utt, p);
-      }
+      sequencer.Run(new PlpComputeTask(
+          plp, plp_opts, utt, waveform, vtln_warp_local, subtract_mean,
+          (output_format == "kaldi" ? &kaldi_writer : NULL),
+          (output_format == "kaldi" ? NULL : &htk_writer), &num_success));
       if (num_utts % 10 == 0)
         KALDI_LOG << "Processed " << num_utts << " utterances";
-      KALDI_VLOG(2) << "Processed features for key " << utt;
-      num_success++;
     }
+    sequencer.Wait();  // Wait for the remaining utterances to be written.
     KALDI_LOG << " Done " << num_success << " out of " << num_utts
               << " utterances.";
     return (num_success != 0 ? 0 : 1);
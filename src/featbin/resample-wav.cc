@@ -0,0 +1,160 @@
+// featbin/resample-wav.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "feat/resample.h"
+#include "feat/wave-reader.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    const char *usage =
+        "Change the sampling rate of a wave file.  The file is processed a\n"
+        "block at a time, so arbitrarily long files can be resampled in\n"
+        "bounded memory.  Output is 16-bit PCM, with the same number of\n"
+        "channels as the input.\n"
+        "\n"
+        "Usage:  resample-wav [options...] <wav-rxfilename> <wav-wxfilename>\n"
+        "e.g. resample-wav --new-sample-rate=8000 in.wav out.wav\n"
+        "See also: wav-copy extract-segments\n";
+
+    int32 new_sample_rate = 0;
+    BaseFloat lowpass_cutoff = -1.0;
+    int32 lowpass_filter_width = 16;
+    int32 block_size = 65536;
+
+    ParseOptions po(usage);
+    po.Register("new-sample-rate", &new_sample_rate, "Sampling rate of the "
+                "output, in Hz (required)");
+    po.Register("lowpass-cutoff", &lowpass_cutoff, "Cutoff frequency of the "
+                "anti-aliasing filter, in Hz; if <= 0, 0.45 times the lower "
+                "of the two sampling rates is used.");
+    po.Register("lowpass-filter-width", &lowpass_filter_width, "Number of "
+                "zero-crossings of the windowed sinc filter on each side; "
+                "larger is sharper but slower.");
+    po.Register("block-size", &block_size, "Number of input samples per "
+                "channel to process at a time.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() != 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string wav_rxfilename = po.GetArg(1),
+        wav_wxfilename = po.GetArg(2);
+
+    if (new_sample_rate <= 0)
+      KALDI_ERR << "--new-sample-rate option must be set to a positive value.";
+    if (lowpass_filter_width <= 0 || block_size <= 0)
+      KALDI_ERR << "Invalid options --lowpass-filter-width="
+                << lowpass_filter_width << " --block-size=" << block_size;
+
+    Input ki(wav_rxfilename);
+    WaveStreamReader reader(ki.Stream());
+
+    int32 sample_rate = static_cast<int32>(reader.SampFreq()),
+        num_channels = reader.NumChannels();
+    if (sample_rate != reader.SampFreq())
+      KALDI_ERR << "Non-integer sampling rate " << reader.SampFreq()
+                << " in " << wav_rxfilename;
+    if (lowpass_cutoff <= 0.0)
+      lowpass_cutoff = 0.45 * std::min(sample_rate, new_sample_rate);
+    if (lowpass_cutoff * 2.0 >= std::min(sample_rate, new_sample_rate))
+      KALDI_ERR << "--lowpass-cutoff=" << lowpass_cutoff << " must be less "
+                << "than half of both sampling rates (" << sample_rate
+                << ", " << new_sample_rate << ")";
+
+    // If the rate does not change we just copy the data, rather than
+    // low-pass filtering it.
+    std::vector<LinearResample*> resamplers;
+    if (new_sample_rate != sample_rate)
+      for (int32 c = 0; c < num_channels; c++)
+        resamplers.push_back(new LinearResample(sample_rate, new_sample_rate,
+                                                lowpass_cutoff,
+                                                lowpass_filter_width));
+
+    int64 num_samples_out = (resamplers.empty() ? reader.NumSamples() :
+                             resamplers[0]->GetNumOutputSamples(
+                                 reader.NumSamples(), true));
+
+    Output ko(wav_wxfilename, true, false);  // binary, no Kaldi header.
+    WaveStreamWriter writer(ko.Stream(), new_sample_rate, num_channels,
+                            num_samples_out);
+
+    Matrix<BaseFloat> input_block, output_block;
+    Vector<BaseFloat> output_row;
+    int64 num_clipped = 0;
+    while (!reader.Done()) {
+      reader.ReadBlock(block_size, &input_block);
+      bool flush = reader.Done();
+      if (resamplers.empty()) {
+        output_block.Swap(&input_block);
+      } else {
+        for (int32 c = 0; c < num_channels; c++) {
+          resamplers[c]->Resample(input_block.Row(c), flush, &output_row);
+          if (c == 0)
+            output_block.Resize(num_channels, output_row.Dim(), kUndefined);
+          output_block.Row(c).CopyFromVec(output_row);
+        }
+      }
+      // Round to the nearest integer and clip to the 16-bit range.
+      for (int32 c = 0; c < output_block.NumRows(); c++) {
+        BaseFloat *data = output_block.RowData(c);
+        for (int32 i = 0; i < output_block.NumCols(); i++) {
+          BaseFloat x = floor(data[i] + 0.5);
+          if (x > 32767.0) { x = 32767.0; num_clipped++; }
+          else if (x < -32768.0) { x = -32768.0; num_clipped++; }
+          data[i] = x;
+        }
+      }
+      // In case the input was truncated, we may get fewer samples than we
+      // wrote in the header; in that case we pad with zeros below.
+      if (output_block.NumCols() > writer.NumSamplesLeft())
+        output_block.Resize(num_channels, writer.NumSamplesLeft(),
+                            kCopyData);
+      writer.WriteBlock(output_block);
+    }
+    if (writer.NumSamplesLeft() > 0) {
+      KALDI_WARN << "Padding output with " << writer.NumSamplesLeft()
+                 << " zero samples because the input was truncated.";
+      while (writer.NumSamplesLeft() > 0) {
+        int32 this_num_samp = std::min<int64>(block_size,
+                                              writer.NumSamplesLeft());
+        output_block.Resize(num_channels, this_num_samp);
+        writer.WriteBlock(output_block);
+      }
+    }
+    writer.Close();
+    for (size_t c = 0; c < resamplers.size(); c++)
+      delete resamplers[c];
+
+    if (num_clipped > 0)
+      KALDI_WARN << "Clipped " << num_clipped << " samples to the 16-bit range.";
+    KALDI_LOG << "Resampled " << wav_rxfilename << " from " << sample_rate
+              << " to " << new_sample_rate << " Hz, " << num_samples_out
+              << " samples per channel.";
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
@@ -0,0 +1,68 @@
+// fstbin/fstmakemapped.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/kaldi-io.h"
+#include "util/parse-options.h"
+#include "fst/fstlib.h"
+#include "fstext/fstext-utils.h"
+#include "fstext/mapped-fst.h"
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    using namespace fst;
+    using kaldi::int32;
+
+    const char *usage =
+        "Converts an FST (normally the decoding graph HCLG.fst) to the flat\n"
+        "format of MappedFst, which the decoding programs can map directly\n"
+        "into memory instead of reading it in.  This makes startup much faster\n"
+        "for large graphs, and lets processes on the same machine share the\n"
+        "graph's memory.  The format is machine-dependent (native byte order).\n"
+        "\n"
+        "Usage:  fstmakemapped [in.fst [out.fst] ]\n"
+        "e.g.: fstmakemapped exp/tri3b/graph/HCLG.fst exp/tri3b/graph/HCLG.mfst\n";
+
+    ParseOptions po(usage);
+    po.Read(argc, argv);
+
+    if (po.NumArgs() > 2) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string fst_in_filename = po.GetOptArg(1),
+        fst_out_filename = po.GetOptArg(2);
+    if (fst_out_filename == "") fst_out_filename = "-";
+
+    Fst<StdArc> *fst = ReadDecodingGraph(fst_in_filename);
+
+    MappedFst::WriteMapped(*fst, fst_out_filename);
+    KALDI_LOG << "Wrote FST with " << CountStates(*fst)
+              << " states in mapped format to "
+              << PrintableWxfilename(fst_out_filename);
+    delete fst;
+    return 0;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
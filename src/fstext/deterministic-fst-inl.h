@@ -253,6 +253,79 @@ bool CacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
   }  
 }
 
+template<class Arc>
+LruCacheDeterministicOnDemandFst<Arc>::LruCacheDeterministicOnDemandFst(
+    DeterministicOnDemandFst<Arc> *fst, size_t num_cached_arcs):
+    fst_(fst), num_cached_arcs_(num_cached_arcs), head_(-1), tail_(-1),
+    num_hits_(0), num_misses_(0) {
+  KALDI_ASSERT(fst != NULL &&
+               num_cached_arcs <=
+               static_cast<size_t>(std::numeric_limits<kaldi::int32>::max()));
+}
+
+template<class Arc>
+inline void LruCacheDeterministicOnDemandFst<Arc>::Unlink(kaldi::int32 i) {
+  Entry &e = entries_[i];
+  if (e.prev != -1) entries_[e.prev].next = e.next;
+  else head_ = e.next;
+  if (e.next != -1) entries_[e.next].prev = e.prev;
+  else tail_ = e.prev;
+}
+
+template<class Arc>
+inline void LruCacheDeterministicOnDemandFst<Arc>::PushFront(kaldi::int32 i) {
+  Entry &e = entries_[i];
+  e.prev = -1;
+  e.next = head_;
+  if (head_ != -1) entries_[head_].prev = i;
+  else tail_ = i;
+  head_ = i;
+}
+
+template<class Arc>
+bool LruCacheDeterministicOnDemandFst<Arc>::GetArc(StateId s, Label ilabel,
+                                                   Arc *oarc) {
+  KALDI_ASSERT(s >= 0 && ilabel != 0);
+  if (num_cached_arcs_ == 0) {
+    num_misses_++;
+    return fst_->GetArc(s, ilabel, oarc);
+  }
+  kaldi::uint64 key = (static_cast<kaldi::uint64>(s) << 32) |
+      static_cast<kaldi::uint32>(ilabel);
+  typename MapType::iterator iter = index_.find(key);
+  if (iter != index_.end()) {
+    num_hits_++;
+    kaldi::int32 i = iter->second;
+    if (i != head_) {
+      Unlink(i);
+      PushFront(i);
+    }
+    if (!entries_[i].exists) return false;
+    *oarc = entries_[i].arc;
+    return true;
+  }
+  num_misses_++;
+  Arc arc;
+  bool exists = fst_->GetArc(s, ilabel, &arc);
+  kaldi::int32 i;
+  if (entries_.size() < num_cached_arcs_) {
+    i = entries_.size();
+    entries_.resize(i + 1);
+  } else {  // evict the least recently used arc.
+    i = tail_;
+    Unlink(i);
+    index_.erase(entries_[i].key);
+  }
+  Entry &e = entries_[i];
+  e.key = key;
+  e.exists = exists;
+  e.arc = arc;
+  PushFront(i);
+  index_[key] = i;
+  if (exists) *oarc = arc;
+  return exists;
+}
+
 template<class Arc>
 LmExampleDeterministicOnDemandFst<Arc>::LmExampleDeterministicOnDemandFst(
     void *lm, Label bos_symbol, Label eos_symbol):
@@ -177,6 +177,39 @@ void TestBackoffAndCache() {
   delete rfst;
 }
 
+void TestLruCache() {
+  cout << "Test LRU cache with single generated backoff FST" << endl;
+  StdVectorFst *nfst = CreateBackoffFst();
+  StdVectorFst *rfst = CreateResultFst();
+  ArcSort(nfst, StdILabelCompare());
+  BackoffDeterministicOnDemandFst<StdArc> dfst1a(*nfst);
+  // a small cache, so that arcs get evicted.
+  LruCacheDeterministicOnDemandFst<StdArc> dfst1(&dfst1a, 3);
+
+  int32 num_requests = 0;
+  for (int32 iter = 0; iter < 3; iter++) {
+    for (StateIterator<StdVectorFst> riter(*rfst); !riter.Done(); riter.Next()) {
+      StateId rsrc = riter.Value();
+      for (ArcIterator<StdVectorFst> aiter(*rfst, rsrc); !aiter.Done();
+           aiter.Next()) {
+        StdArc rarc = aiter.Value(), darc;
+        // ask twice in a row; the second time must be a hit.
+        for (int32 j = 0; j < 2; j++, num_requests++) {
+          KALDI_ASSERT(dfst1.GetArc(rsrc, rarc.ilabel, &darc));
+          KALDI_ASSERT(ApproxEqual(rarc.weight, darc.weight, 0.001) &&
+                       rarc.ilabel == darc.ilabel &&
+                       rarc.olabel == darc.olabel &&
+                       rarc.nextstate == darc.nextstate);
+        }
+      }
+    }
+  }
+  KALDI_ASSERT(dfst1.NumHits() + dfst1.NumMisses() == num_requests &&
+               dfst1.NumHits() >= num_requests / 2);
+  delete nfst;
+  delete rfst;
+}
+
 void TestCompose() {
   cout << "Test with single generated backoff FST" << endl;
   StdVectorFst *nfst = CreateBackoffFst();
@@ -224,6 +257,7 @@ void TestCompose() {
 int main() {
   using namespace fst;
   TestBackoffAndCache();
+  TestLruCache();
   TestCompose();
 }
   
@@ -212,6 +212,64 @@ class CacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
 };
 
 
+/// LruCacheDeterministicOnDemandFst is like CacheDeterministicOnDemandFst,
+/// but instead of a direct-mapped cache (where an arc is evicted whenever
+/// another arc maps to the same slot) it keeps the num_cached_arcs arcs that
+/// were used most recently.  It also remembers (s, ilabel) pairs for which no
+/// arc exists, and counts how many requests it answered from the cache, so the
+/// hit rate can be monitored.  It is not thread-safe; with --lru-lm-cache=true,
+/// gmm-latgen-biglm-faster-parallel uses one per decoding thread.
+template<class Arc>
+class LruCacheDeterministicOnDemandFst: public DeterministicOnDemandFst<Arc> {
+ public:
+  typedef typename Arc::StateId StateId;
+  typedef typename Arc::Weight Weight;
+  typedef typename Arc::Label Label;
+
+  /// We don't take ownership of this pointer.  If num_cached_arcs is zero,
+  /// nothing is cached (but the requests are still counted).
+  LruCacheDeterministicOnDemandFst(DeterministicOnDemandFst<Arc> *fst,
+                                   size_t num_cached_arcs = 100000);
+
+  virtual StateId Start() { return fst_->Start(); }
+
+  /// We don't bother caching the final-probs, just the arcs.
+  virtual Weight Final(StateId s) { return fst_->Final(s); }
+
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc);
+
+  /// Number of GetArc() calls answered from the cache.
+  kaldi::int64 NumHits() const { return num_hits_; }
+  /// Number of GetArc() calls we had to pass on to the underlying FST.
+  kaldi::int64 NumMisses() const { return num_misses_; }
+
+ private:
+  struct Entry {
+    kaldi::uint64 key;  // (s, ilabel) packed together.
+    bool exists;  // false if fst_ had no such arc.
+    Arc arc;
+    kaldi::int32 prev;  // neighbor that was used more recently, or -1.
+    kaldi::int32 next;  // neighbor that was used less recently, or -1.
+  };
+
+  // Removes entry i from the recency list.
+  inline void Unlink(kaldi::int32 i);
+  // Makes entry i the most recently used one.
+  inline void PushFront(kaldi::int32 i);
+
+  typedef unordered_map<kaldi::uint64, kaldi::int32> MapType;
+
+  DeterministicOnDemandFst<Arc> *fst_;
+  size_t num_cached_arcs_;
+  std::vector<Entry> entries_;
+  MapType index_;  // maps from key to position in entries_.
+  kaldi::int32 head_;  // most recently used entry, or -1.
+  kaldi::int32 tail_;  // least recently used entry, or -1.
+  kaldi::int64 num_hits_;
+  kaldi::int64 num_misses_;
+};
+
+
 /// This class is for didactic purposes, it does not really do anything.
 /// It shows how you would wrap a language model.  Note: you should probably
 /// have <s> and </s> not be real words in your LM, but <s> correspond somehow
@@ -0,0 +1,330 @@
+// fstext/mapped-fst.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "fstext/mapped-fst.h"
+#include "fstext/fstext-utils.h"
+#include "util/kaldi-io.h"
+
+namespace fst {
+
+namespace {
+
+// The first character must not be the first byte of the OpenFst magic number
+// (0xD6 on little-endian machines), so ReadDecodingGraph() can tell the
+// formats apart by looking at one character.
+const char kMappedFstMagic[16] = "KaldiMappedFst1";
+
+// The file header; it is padded to 64 bytes so the arrays that follow are
+// suitably aligned.
+struct MappedFstHeader {
+  char magic[16];
+  int64 num_states;
+  int64 num_arcs;
+  int64 start;
+  uint64 properties;
+  int64 reserved[2];
+};
+
+// Size of the states array on disk, rounded up so that the arcs start on a
+// 16-byte boundary.
+size_t StatesSize(int64 num_states) {
+  size_t size = num_states * sizeof(MappedFst::State);
+  return (size + 15) & ~static_cast<size_t>(15);
+}
+
+void CheckHeader(const MappedFstHeader &header, const std::string &rxfilename) {
+  if (std::memcmp(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic)) != 0)
+    KALDI_ERR << "Reading mapped FST: bad magic number in "
+              << kaldi::PrintableRxfilename(rxfilename);
+  // State-ids are int32 and first_arc is uint32, which bounds the counts.
+  if (header.num_states < 0 || header.num_arcs < 0 ||
+      header.num_states > static_cast<int64>(std::numeric_limits<kaldi::int32>::max()) ||
+      header.num_arcs > static_cast<int64>(0xFFFFFFFFu) ||
+      header.start < kNoStateId || header.start >= header.num_states)
+    KALDI_ERR << "Reading mapped FST: bad header in "
+              << kaldi::PrintableRxfilename(rxfilename);
+}
+
+// Checks that the arcs of each state lie within the arcs array and that each
+// arc's next-state is a valid state, so that nothing we do with the FST can
+// read outside the arrays.  This touches all of the data once.
+void CheckStructure(const MappedFst::State *states, int64 num_states,
+                    const StdArc *arcs, int64 num_arcs,
+                    const std::string &rxfilename) {
+  for (int64 s = 0; s < num_states; s++) {
+    const MappedFst::State &state = states[s];
+    if (static_cast<uint64>(state.first_arc) + state.num_arcs >
+        static_cast<uint64>(num_arcs) ||
+        state.num_input_epsilons > state.num_arcs ||
+        state.num_output_epsilons > state.num_arcs)
+      KALDI_ERR << "Reading mapped FST: bad arc range for state " << s
+                << " in " << kaldi::PrintableRxfilename(rxfilename);
+  }
+  for (int64 a = 0; a < num_arcs; a++) {
+    if (arcs[a].nextstate < 0 || arcs[a].nextstate >= num_states)
+      KALDI_ERR << "Reading mapped FST: arc " << a << " has bad next-state "
+                << arcs[a].nextstate << " in "
+                << kaldi::PrintableRxfilename(rxfilename);
+  }
+}
+
+// Reads "num_elements" objects of type T into "vec".  We read a bounded chunk
+// at a time, so that a corrupt header can't make us allocate a huge amount of
+// memory before we find the data isn't there.
+template<class T>
+void ReadArray(std::istream &is, int64 num_elements, std::vector<T> *vec) {
+  const int64 kChunkSize = (1 << 20);
+  vec->clear();
+  while (static_cast<int64>(vec->size()) < num_elements && is) {
+    int64 cur_size = vec->size(),
+        this_size = std::min(kChunkSize, num_elements - cur_size);
+    vec->resize(cur_size + this_size);
+    is.read(reinterpret_cast<char*>(&((*vec)[cur_size])),
+            this_size * sizeof(T));
+  }
+}
+
+}  // namespace
+
+
+MappedFst::Storage::~Storage() {
+#ifndef _MSC_VER
+  if (mapped_data != NULL)
+    munmap(mapped_data, mapped_size);
+#endif
+}
+
+MappedFst::MappedFst(const MappedFst &other):
+    ExpandedFst<StdArc>(other), storage_(other.storage_),
+    states_(other.states_), arcs_(other.arcs_),
+    num_states_(other.num_states_), start_(other.start_),
+    properties_(other.properties_) {
+  storage_->ref_count_mutex.Lock();
+  storage_->ref_count++;
+  storage_->ref_count_mutex.Unlock();
+}
+
+MappedFst::~MappedFst() {
+  if (storage_ == NULL) return;
+  storage_->ref_count_mutex.Lock();
+  bool last_reference = (--storage_->ref_count == 0);
+  storage_->ref_count_mutex.Unlock();
+  if (last_reference)
+    delete storage_;
+}
+
+const std::string& MappedFst::Type() const {
+  static const std::string type = "mapped";
+  return type;
+}
+
+bool MappedFst::IsMappedFormat(std::istream &is) {
+  return is.peek() == kMappedFstMagic[0];
+}
+
+MappedFst *MappedFst::Read(const std::string &rxfilename) {
+#ifndef _MSC_VER
+  if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput)
+    return ReadMapped(rxfilename);
+#endif
+  kaldi::Input ki(rxfilename);
+  return ReadFromStream(ki.Stream(), rxfilename);
+}
+
+MappedFst *MappedFst::ReadMapped(const std::string &filename) {
+#ifdef _MSC_VER
+  KALDI_ERR << "Memory-mapping FSTs is not supported on this platform.";
+  return NULL;
+#else
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd < 0)
+    KALDI_ERR << "Reading mapped FST: could not open " << filename << ": "
+              << strerror(errno);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    KALDI_ERR << "Reading mapped FST: could not stat " << filename << ": "
+              << strerror(errno);
+  }
+  size_t size = st.st_size;
+  if (size < sizeof(MappedFstHeader)) {
+    close(fd);
+    KALDI_ERR << "Reading mapped FST: file " << filename << " is too small.";
+  }
+  void *data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);  // the mapping stays valid after we close the file.
+  if (data == MAP_FAILED)
+    KALDI_ERR << "Reading mapped FST: mmap failed for " << filename << ": "
+              << strerror(errno);
+
+  Storage *storage = new Storage();
+  storage->mapped_data = data;
+  storage->mapped_size = size;
+  MappedFst *ans = new MappedFst();
+  ans->storage_ = storage;  // from here on, ans owns the mapping.
+
+  const MappedFstHeader &header = *static_cast<const MappedFstHeader*>(data);
+  try {
+    CheckHeader(header, filename);
+    size_t states_size = StatesSize(header.num_states),
+        expected_size = sizeof(MappedFstHeader) + states_size +
+        header.num_arcs * sizeof(Arc);
+    if (size != expected_size)
+      KALDI_ERR << "Reading mapped FST: file " << filename << " has size "
+                << size << ", expected " << expected_size;
+    const char *states_begin =
+        static_cast<const char*>(data) + sizeof(MappedFstHeader);
+    ans->states_ = reinterpret_cast<const State*>(states_begin);
+    ans->arcs_ = reinterpret_cast<const Arc*>(states_begin + states_size);
+    CheckStructure(ans->states_, header.num_states, ans->arcs_,
+                   header.num_arcs, filename);
+  } catch (...) {
+    delete ans;
+    throw;
+  }
+  ans->num_states_ = header.num_states;
+  ans->start_ = header.start;
+  ans->properties_ = header.properties;
+  return ans;
+#endif
+}
+
+MappedFst *MappedFst::ReadFromStream(std::istream &is,
+                                     const std::string &rxfilename) {
+  MappedFstHeader header;
+  is.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!is)
+    KALDI_ERR << "Reading mapped FST: error reading header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  CheckHeader(header, rxfilename);
+
+  MappedFst *ans = new MappedFst();
+  ans->storage_ = new Storage();
+  std::vector<State> &states = ans->storage_->states;
+  std::vector<Arc> &arcs = ans->storage_->arcs;
+  size_t states_size = header.num_states * sizeof(State),
+      padding = StatesSize(header.num_states) - states_size;
+  char pad[16];
+  ReadArray(is, header.num_states, &states);
+  is.read(pad, padding);
+  ReadArray(is, header.num_arcs, &arcs);
+  if (!is) {
+    delete ans;
+    KALDI_ERR << "Reading mapped FST: error reading from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  }
+  try {
+    CheckStructure(states.empty() ? NULL : &(states[0]), header.num_states,
+                   arcs.empty() ? NULL : &(arcs[0]), header.num_arcs,
+                   rxfilename);
+  } catch (...) {
+    delete ans;
+    throw;
+  }
+  ans->states_ = (states.empty() ? NULL : &(states[0]));
+  ans->arcs_ = (arcs.empty() ? NULL : &(arcs[0]));
+  ans->num_states_ = header.num_states;
+  ans->start_ = header.start;
+  ans->properties_ = header.properties;
+  return ans;
+}
+
+void MappedFst::WriteMapped(const Fst<Arc> &fst,
+                            const std::string &wxfilename) {
+  MappedFstHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMappedFstMagic, sizeof(kMappedFstMagic));
+  header.num_states = CountStates(fst);
+  header.start = fst.Start();
+  header.properties = (fst.Properties(kCopyProperties, false) |
+                       kExpanded) & ~kMutable;
+
+  std::vector<State> states(header.num_states);
+  int64 num_arcs = 0;
+  for (StateId s = 0; s < header.num_states; s++) {
+    State &state = states[s];
+    state.final_cost = fst.Final(s).Value();
+    state.first_arc = num_arcs;
+    state.num_arcs = fst.NumArcs(s);
+    state.num_input_epsilons = fst.NumInputEpsilons(s);
+    state.num_output_epsilons = fst.NumOutputEpsilons(s);
+    num_arcs += state.num_arcs;
+    if (num_arcs > static_cast<int64>(0xFFFFFFFFu))
+      KALDI_ERR << "Writing mapped FST: too many arcs (more than 2^32)";
+  }
+  header.num_arcs = num_arcs;
+
+  bool binary = true, write_header = false;
+  kaldi::Output ko(wxfilename, binary, write_header);
+  std::ostream &os = ko.Stream();
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  size_t states_size = header.num_states * sizeof(State);
+  if (!states.empty())
+    os.write(reinterpret_cast<const char*>(&(states[0])), states_size);
+  char pad[16] = { 0 };
+  os.write(pad, StatesSize(header.num_states) - states_size);
+  for (StateId s = 0; s < header.num_states; s++) {
+    for (ArcIterator<Fst<Arc> > aiter(fst, s); !aiter.Done(); aiter.Next()) {
+      const Arc &arc = aiter.Value();
+      os.write(reinterpret_cast<const char*>(&arc), sizeof(Arc));
+    }
+  }
+  if (!ko.Close())
+    KALDI_ERR << "Writing mapped FST: error writing to "
+              << kaldi::PrintableWxfilename(wxfilename);
+}
+
+
+Fst<StdArc> *ReadDecodingGraph(std::string rxfilename) {
+  if (rxfilename == "") rxfilename = "-"; // interpret "" as stdin,
+  // for compatibility with OpenFst conventions.
+  kaldi::Input ki(rxfilename);
+  if (MappedFst::IsMappedFormat(ki.Stream())) {
+#ifndef _MSC_VER
+    if (kaldi::ClassifyRxfilename(rxfilename) == kaldi::kFileInput) {
+      ki.Close();
+      return MappedFst::Read(rxfilename);
+    }
+#endif
+    return MappedFst::ReadFromStream(ki.Stream(), rxfilename);
+  }
+  fst::FstHeader hdr;
+  if (!hdr.Read(ki.Stream(), rxfilename))
+    KALDI_ERR << "Reading FST: error reading FST header from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  FstReadOptions ropts("<unspecified>", &hdr);
+  VectorFst<StdArc> *fst = VectorFst<StdArc>::Read(ki.Stream(), ropts);
+  if (!fst)
+    KALDI_ERR << "Could not read fst from "
+              << kaldi::PrintableRxfilename(rxfilename);
+  return fst;
+}
+
+}  // namespace fst
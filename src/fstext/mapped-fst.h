@@ -0,0 +1,224 @@
+// fstext/mapped-fst.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_FSTEXT_MAPPED_FST_H_
+#define KALDI_FSTEXT_MAPPED_FST_H_
+
+/* This header defines MappedFst, a read-only FST of StdArc whose states and
+   arcs are stored in two contiguous arrays, in a format that we can map
+   straight into memory with mmap().  The point of this is to make it fast to
+   load very large decoding graphs (the normal OpenFst formats have to be
+   parsed and copied into newly allocated memory), and to allow many decoding
+   processes on the same machine to share a single copy of the graph in the
+   page cache.
+
+   The arcs are stored in exactly the in-memory layout of StdArc, so the arc
+   iterator just gets a pointer into the mapped file, the same way as for
+   ConstFst; the decoders iterate over the arcs without any virtual function
+   calls per arc.  This is also why the weights are not quantized: a 16-bit
+   weight only saves space if the arc is packed to 14 bytes instead of 16, and
+   then the decoders could not be handed StdArc pointers.
+
+   The on-disk format is native-endian and is not intended to be portable
+   between machines with different byte orders; it consists of a header,
+   followed by the array of states and then the array of arcs.  Use
+   fstmakemapped to convert a normal FST to this format.  Programs that read
+   decoding graphs with ReadDecodingGraph() accept either format.
+*/
+
+#include <string>
+#include <vector>
+#include <fst/fstlib.h>
+#include "base/kaldi-common.h"
+#include "thread/kaldi-mutex.h"
+
+namespace fst {
+
+class MappedFst : public ExpandedFst<StdArc> {
+ public:
+  typedef StdArc Arc;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+  typedef Arc::StateId StateId;
+
+  /// The per-state information, as stored on disk.
+  struct State {
+    float final_cost;  // final-cost, or infinity if not final.
+    uint32 first_arc;  // index of the first arc of this state.
+    uint32 num_arcs;
+    uint32 num_input_epsilons;
+    uint32 num_output_epsilons;
+  };
+
+  /// Reads the FST in the mapped format from "rxfilename".  If this is an
+  /// ordinary file, it is mapped into memory with mmap(); otherwise (e.g. for
+  /// a pipe or the standard input) it is read into memory.  Throws on error,
+  /// including if any state's arcs or any arc's next-state are out of range,
+  /// so a corrupt file can't lead to out-of-bounds reads while decoding.
+  static MappedFst *Read(const std::string &rxfilename);
+
+  /// Writes "fst" in the mapped format to "wxfilename".  Throws on error.
+  static void WriteMapped(const Fst<Arc> &fst, const std::string &wxfilename);
+
+  /// Returns true if "is" is positioned at the start of an FST in the mapped
+  /// format (it checks the first character only, which is enough to
+  /// distinguish it from the OpenFst binary format).
+  static bool IsMappedFormat(std::istream &is);
+
+  MappedFst(const MappedFst &other);
+
+  virtual ~MappedFst();
+
+  virtual StateId Start() const { return start_; }
+
+  virtual Weight Final(StateId s) const { return Weight(states_[s].final_cost); }
+
+  virtual StateId NumStates() const { return num_states_; }
+
+  virtual size_t NumArcs(StateId s) const { return states_[s].num_arcs; }
+
+  virtual size_t NumInputEpsilons(StateId s) const {
+    return states_[s].num_input_epsilons;
+  }
+
+  virtual size_t NumOutputEpsilons(StateId s) const {
+    return states_[s].num_output_epsilons;
+  }
+
+  virtual uint64 Properties(uint64 mask, bool test) const {
+    if (test) {
+      uint64 known, tested = TestProperties(*this, mask, &known);
+      return tested & mask;
+    } else {
+      return properties_ & mask;
+    }
+  }
+
+  virtual const std::string& Type() const;
+
+  virtual MappedFst *Copy(bool safe = false) const {
+    return new MappedFst(*this);
+  }
+
+  virtual const SymbolTable* InputSymbols() const { return NULL; }
+
+  virtual const SymbolTable* OutputSymbols() const { return NULL; }
+
+  virtual void InitStateIterator(StateIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->nstates = num_states_;
+  }
+
+  virtual void InitArcIterator(StateId s, ArcIteratorData<Arc> *data) const {
+    data->base = NULL;
+    data->arcs = arcs_ + states_[s].first_arc;
+    data->narcs = states_[s].num_arcs;
+    data->ref_count = NULL;
+  }
+
+  /// Returns the arcs of state s and sets *num_arcs to their number; this is
+  /// non-virtual, for use by ArcIterator<MappedFst>.
+  const Arc *Arcs(StateId s, size_t *num_arcs) const {
+    *num_arcs = states_[s].num_arcs;
+    return arcs_ + states_[s].first_arc;
+  }
+
+ private:
+  // Holds the memory (mapped or allocated) that states_ and arcs_ point into;
+  // it is shared between copies of the FST, which may be used (and copied or
+  // destroyed) by different decoding threads, so ref_count is guarded by
+  // ref_count_mutex.
+  struct Storage {
+    int32 ref_count;
+    kaldi::Mutex ref_count_mutex;
+    void *mapped_data;  // if non-NULL, the region we got from mmap().
+    size_t mapped_size;
+    std::vector<State> states;  // used if we could not map the file.
+    std::vector<Arc> arcs;
+    Storage(): ref_count(1), mapped_data(NULL), mapped_size(0) { }
+    ~Storage();
+  };
+
+  MappedFst(): storage_(NULL), states_(NULL), arcs_(NULL), num_states_(0),
+               start_(kNoStateId), properties_(0) { }
+
+  static MappedFst *ReadMapped(const std::string &filename);
+  static MappedFst *ReadFromStream(std::istream &is,
+                                   const std::string &rxfilename);
+
+  Storage *storage_;
+  const State *states_;
+  const Arc *arcs_;
+  StateId num_states_;
+  StateId start_;
+  uint64 properties_;
+
+  void operator = (const MappedFst &other);  // disallow
+
+  friend Fst<StdArc> *ReadDecodingGraph(std::string rxfilename);
+};
+
+
+/// Specialization of ArcIterator for MappedFst, like the one OpenFst has for
+/// ConstFst: when code is templated on the FST type (e.g.
+/// kaldi::LatticeFasterDecoderTpl<MappedFst>), iterating over the arcs of a
+/// state is inlined and involves no virtual function calls.
+template<>
+class ArcIterator<MappedFst> {
+ public:
+  typedef MappedFst::Arc Arc;
+  typedef Arc::StateId StateId;
+
+  ArcIterator(const MappedFst &fst, StateId s): i_(0) {
+    arcs_ = fst.Arcs(s, &narcs_);
+  }
+
+  bool Done() const { return i_ >= narcs_; }
+
+  const Arc& Value() const { return arcs_[i_]; }
+
+  void Next() { ++i_; }
+
+  size_t Position() const { return i_; }
+
+  void Reset() { i_ = 0; }
+
+  void Seek(size_t a) { i_ = a; }
+
+  uint32 Flags() const { return kArcValueFlags; }
+
+  void SetFlags(uint32 flags, uint32 mask) { }
+
+ private:
+  const Arc *arcs_;
+  size_t narcs_;
+  size_t i_;
+  DISALLOW_COPY_AND_ASSIGN(ArcIterator);
+};
+
+
+/// Reads a decoding graph from "rxfilename", which may be in either the normal
+/// OpenFst binary format (in which case it is read as a VectorFst, as in
+/// ReadFstKaldi()), or in the format of MappedFst.  Throws on error.  The
+/// caller owns the returned object.
+Fst<StdArc> *ReadDecodingGraph(std::string rxfilename);
+
+}  // namespace fst
+
+#endif  // KALDI_FSTEXT_MAPPED_FST_H_
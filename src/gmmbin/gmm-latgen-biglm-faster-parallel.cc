@@ -0,0 +1,378 @@
+// gmmbin/gmm-latgen-biglm-faster-parallel.cc
+
+// Copyright 2009-2011  Microsoft Corporation
+//                2013  Johns Hopkins University (author: Daniel Povey)
+//                2014  Guoguo Chen
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "base/kaldi-common.h"
+#include "util/common-utils.h"
+#include "gmm/am-diag-gmm.h"
+#include "tree/context-dep.h"
+#include "hmm/transition-model.h"
+#include "fstext/fstext-lib.h"
+#include "decoder/lattice-biglm-faster-decoder.h"
+#include "gmm/decodable-am-diag-gmm.h"
+#include "decoder/decoder-wrappers.h"
+#include "base/timer.h"
+#include "thread/kaldi-mutex.h"
+#include "thread/kaldi-task-sequence.h"
+
+
+namespace kaldi {
+
+// The on-demand LM-difference FST is not thread-safe (it builds its state
+// table as it goes), so the decoders share it through this wrapper, which
+// holds a lock during each call.  Each decoder has its own cache in front of
+// it, so most lookups never get here.
+class LockedDeterministicOnDemandFst:
+      public fst::DeterministicOnDemandFst<fst::StdArc> {
+ public:
+  typedef fst::StdArc Arc;
+  typedef Arc::StateId StateId;
+  typedef Arc::Weight Weight;
+  typedef Arc::Label Label;
+
+  // We don't take ownership of this pointer.
+  explicit LockedDeterministicOnDemandFst(
+      fst::DeterministicOnDemandFst<Arc> *fst): fst_(fst) { }
+
+  virtual StateId Start() {
+    mutex_.Lock();
+    StateId ans = fst_->Start();
+    mutex_.Unlock();
+    return ans;
+  }
+  virtual Weight Final(StateId s) {
+    mutex_.Lock();
+    Weight ans = fst_->Final(s);
+    mutex_.Unlock();
+    return ans;
+  }
+  virtual bool GetArc(StateId s, Label ilabel, Arc *oarc) {
+    mutex_.Lock();
+    bool ans = fst_->GetArc(s, ilabel, oarc);
+    mutex_.Unlock();
+    return ans;
+  }
+ private:
+  fst::DeterministicOnDemandFst<Arc> *fst_;
+  Mutex mutex_;
+};
+
+// The decoders look up the LM-difference FST through caches from this pool.
+// Each decoder takes a cache when it is created and gives it back when it is
+// deleted, which DecodeUtteranceLatticeBiglmFasterClass does as soon as the
+// utterance has been decoded.  So we create about one cache per thread, and
+// the caches stay warm from one utterance to the next, whether or not there is
+// a separate decoding graph for each utterance.  The caches are the
+// direct-mapped CacheDeterministicOnDemandFst, as in gmm-latgen-biglm-faster,
+// unless use_lru is true.
+class LmCachePool {
+ public:
+  typedef fst::DeterministicOnDemandFst<fst::StdArc> Cache;
+  typedef fst::LruCacheDeterministicOnDemandFst<fst::StdArc> LruCache;
+  LmCachePool(fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst,
+              int32 cache_size, bool use_lru):
+      lm_diff_fst_(lm_diff_fst), cache_size_(cache_size), use_lru_(use_lru) { }
+
+  Cache *Get() {
+    Cache *ans = NULL;
+    mutex_.Lock();
+    if (!free_.empty()) {
+      ans = free_.back();
+      free_.pop_back();
+    } else {
+      if (use_lru_)
+        ans = new LruCache(lm_diff_fst_, cache_size_);
+      else
+        ans = new fst::CacheDeterministicOnDemandFst<fst::StdArc>(
+            lm_diff_fst_, cache_size_);
+      all_.push_back(ans);
+    }
+    mutex_.Unlock();
+    return ans;
+  }
+
+  void Release(Cache *cache) {
+    mutex_.Lock();
+    free_.push_back(cache);
+    mutex_.Unlock();
+  }
+
+  // Adds up the statistics of all the caches; returns false if they don't
+  // keep any (i.e. if use_lru was false).  Call this only when all the
+  // decoders have been deleted.
+  bool GetStats(int64 *num_hits, int64 *num_misses) const {
+    if (!use_lru_) return false;
+    for (size_t i = 0; i < all_.size(); i++) {
+      const LruCache *cache = static_cast<const LruCache*>(all_[i]);
+      *num_hits += cache->NumHits();
+      *num_misses += cache->NumMisses();
+    }
+    return true;
+  }
+
+  ~LmCachePool() { DeletePointers(&all_); }
+ private:
+  fst::DeterministicOnDemandFst<fst::StdArc> *lm_diff_fst_;
+  int32 cache_size_;
+  bool use_lru_;
+  std::vector<Cache*> all_;
+  std::vector<Cache*> free_;
+  Mutex mutex_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(LmCachePool);
+};
+
+// This is LatticeBiglmFasterDecoder with a cache from an LmCachePool, which it
+// gives back when it is deleted.  If "fst_to_delete" is non-NULL it is the
+// decoding graph, and we delete it too.
+class PooledCacheBiglmDecoder: public LatticeBiglmFasterDecoder {
+ public:
+  PooledCacheBiglmDecoder(const fst::Fst<fst::StdArc> &fst,
+                          const LatticeBiglmFasterDecoderConfig &config,
+                          LmCachePool *pool,
+                          LmCachePool::Cache *cache,
+                          fst::Fst<fst::StdArc> *fst_to_delete):
+      LatticeBiglmFasterDecoder(fst, config, cache), pool_(pool),
+      cache_(cache), fst_to_delete_(fst_to_delete) { }
+
+  ~PooledCacheBiglmDecoder() {
+    pool_->Release(cache_);
+    delete fst_to_delete_;
+  }
+ private:
+  LmCachePool *pool_;
+  LmCachePool::Cache *cache_;
+  fst::Fst<fst::StdArc> *fst_to_delete_;
+};
+
+}  // namespace kaldi
+
+
+int main(int argc, char *argv[]) {
+  try {
+    using namespace kaldi;
+    typedef kaldi::int32 int32;
+    using fst::SymbolTable;
+    using fst::VectorFst;
+    using fst::StdArc;
+    using fst::ReadFstKaldi;
+
+    const char *usage =
+        "Generate lattices using GMM-based model.  Uses multiple decoding threads,\n"
+        "but interface and behavior is otherwise the same as gmm-latgen-biglm-faster\n"
+        "User supplies LM used to generate decoding graph, and desired LM;\n"
+        "this decoder applies the difference during decoding\n"
+        "Usage: gmm-latgen-biglm-faster-parallel [options] model-in "
+        "(fst-in|fsts-rspecifier) oldlm-fst-in newlm-fst-in features-rspecifier"
+        " lattice-wspecifier [ words-wspecifier [alignments-wspecifier] ]\n";
+    ParseOptions po(usage);
+    Timer timer;
+    bool allow_partial = false;
+    BaseFloat acoustic_scale = 0.1;
+    BaseFloat log_sum_exp_prune = 0.0;
+    int32 lm_cache_size = 100000;
+    bool lru_lm_cache = false;
+    LatticeBiglmFasterDecoderConfig config;
+    TaskSequencerConfig sequencer_config; // has --num-threads option
+
+    std::string word_syms_filename;
+    config.Register(&po);
+    sequencer_config.Register(&po);
+    po.Register("acoustic-scale", &acoustic_scale,
+                "Scaling factor for acoustic likelihoods");
+    po.Register("log-sum-exp-prune", &log_sum_exp_prune,
+                "If >0, pruning parameter to minimize exp()'s.  Suggest 3 to 5; "
+                "larger is more exact.");
+    po.Register("word-symbol-table", &word_syms_filename,
+                "Symbol table for words [for debug output]");
+    po.Register("allow-partial", &allow_partial,
+                "If true, produce output even if end state was not reached.");
+    po.Register("lm-cache-size", &lm_cache_size,
+                "Number of arcs of the LM-difference FST that each decoding "
+                "thread caches.");
+    po.Register("lru-lm-cache", &lru_lm_cache,
+                "If true, each thread keeps the most recently used arcs of the "
+                "LM-difference FST, instead of using a direct-mapped cache; "
+                "the hit rate is then printed at the end.");
+
+    po.Read(argc, argv);
+
+    if (po.NumArgs() < 6 || po.NumArgs() > 8) {
+      po.PrintUsage();
+      exit(1);
+    }
+
+    std::string model_in_filename = po.GetArg(1),
+        fst_in_str = po.GetArg(2),
+        old_lm_fst_rxfilename = po.GetArg(3),
+        new_lm_fst_rxfilename = po.GetArg(4),
+        feature_rspecifier = po.GetArg(5),
+        lattice_wspecifier = po.GetArg(6),
+        words_wspecifier = po.GetOptArg(7),
+        alignment_wspecifier = po.GetOptArg(8);
+
+    TransitionModel trans_model;
+    AmDiagGmm am_gmm;
+    {
+      bool binary;
+      Input ki(model_in_filename, &binary);
+      trans_model.Read(ki.Stream(), binary);
+      am_gmm.Read(ki.Stream(), binary);
+    }
+
+    VectorFst<StdArc> *old_lm_fst = ReadFstKaldi(old_lm_fst_rxfilename);
+    ApplyProbabilityScale(-1.0, old_lm_fst); // Negate old LM probs...
+
+    VectorFst<StdArc> *new_lm_fst = ReadFstKaldi(new_lm_fst_rxfilename);
+
+    fst::BackoffDeterministicOnDemandFst<StdArc> old_lm_dfst(*old_lm_fst);
+    fst::BackoffDeterministicOnDemandFst<StdArc> new_lm_dfst(*new_lm_fst);
+    fst::ComposeDeterministicOnDemandFst<StdArc> compose_dfst(&old_lm_dfst,
+                                                              &new_lm_dfst);
+    LockedDeterministicOnDemandFst locked_dfst(&compose_dfst);
+    LmCachePool cache_pool(&locked_dfst, lm_cache_size, lru_lm_cache);
+
+    CompactLatticeWriter compact_lattice_writer;
+    LatticeWriter lattice_writer;
+    if (! (config.determinize_lattice ?
+           compact_lattice_writer.Open(lattice_wspecifier) :
+           lattice_writer.Open(lattice_wspecifier)))
+      KALDI_ERR << "Could not open table for writing lattices: "
+                 << lattice_wspecifier;
+
+    Int32VectorWriter words_writer(words_wspecifier);
+
+    Int32VectorWriter alignment_writer(alignment_wspecifier);
+
+    fst::SymbolTable *word_syms = NULL;
+    if (word_syms_filename != "")
+      if (!(word_syms = fst::SymbolTable::ReadText(word_syms_filename)))
+        KALDI_ERR << "Could not read symbol table from file "
+                   << word_syms_filename;
+
+    double tot_like = 0.0;
+    kaldi::int64 frame_count = 0;
+    int32 num_done = 0, num_err = 0, num_partial = 0;
+    fst::Fst<StdArc> *decode_fst = NULL; // only used if there is a single
+                                          // decoding graph.
+
+    {
+      TaskSequencer<DecodeUtteranceLatticeBiglmFasterClass> sequencer(
+          sequencer_config);
+
+      if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
+        SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
+        // Input FST is just one FST, not a table of FSTs.
+        decode_fst = fst::ReadDecodingGraph(fst_in_str);
+
+        for (; !feature_reader.Done(); feature_reader.Next()) {
+          std::string utt = feature_reader.Key();
+          Matrix<BaseFloat> *features =
+              new Matrix<BaseFloat>(feature_reader.Value());
+          feature_reader.FreeCurrent();
+          if (features->NumRows() == 0) {
+            KALDI_WARN << "Zero-length utterance: " << utt;
+            num_err++;
+            delete features;
+            continue;
+          }
+          // takes ownership of "features"
+          DecodableAmDiagGmmScaled *gmm_decodable =
+              new DecodableAmDiagGmmScaled(am_gmm, trans_model,
+                                           acoustic_scale,
+                                           log_sum_exp_prune,
+                                           features);
+          PooledCacheBiglmDecoder *decoder = new PooledCacheBiglmDecoder(
+              *decode_fst, config, &cache_pool, cache_pool.Get(), NULL);
+          // the task takes ownership of "decoder" and "gmm_decodable".
+          sequencer.Run(new DecodeUtteranceLatticeBiglmFasterClass(
+              decoder, gmm_decodable, trans_model, word_syms, utt,
+              acoustic_scale, config.determinize_lattice, allow_partial,
+              &alignment_writer, &words_writer, &compact_lattice_writer,
+              &lattice_writer, &tot_like, &frame_count, &num_done, &num_err,
+              &num_partial));
+        }
+      } else { // We have different FSTs for different utterances.
+        SequentialTableReader<fst::VectorFstHolder> fst_reader(fst_in_str);
+        RandomAccessBaseFloatMatrixReader feature_reader(feature_rspecifier);
+        for (; !fst_reader.Done(); fst_reader.Next()) {
+          std::string utt = fst_reader.Key();
+          if (!feature_reader.HasKey(utt)) {
+            KALDI_WARN << "Not decoding utterance " << utt
+                       << " because no features available.";
+            num_err++;
+            continue;
+          }
+          Matrix<BaseFloat> *features = new Matrix<BaseFloat>(
+              feature_reader.Value(utt));
+          if (features->NumRows() == 0) {
+            KALDI_WARN << "Zero-length utterance: " << utt;
+            num_err++;
+            delete features;
+            continue;
+          }
+          DecodableAmDiagGmmScaled *gmm_decodable =
+              new DecodableAmDiagGmmScaled(am_gmm, trans_model, acoustic_scale,
+                                           log_sum_exp_prune, features);
+          // the decoder takes ownership of the new FST object.
+          VectorFst<StdArc> *fst = new VectorFst<StdArc>(fst_reader.Value());
+          PooledCacheBiglmDecoder *decoder = new PooledCacheBiglmDecoder(
+              *fst, config, &cache_pool, cache_pool.Get(), fst);
+          sequencer.Run(new DecodeUtteranceLatticeBiglmFasterClass(
+              decoder, gmm_decodable, trans_model, word_syms, utt,
+              acoustic_scale, config.determinize_lattice, allow_partial,
+              &alignment_writer, &words_writer, &compact_lattice_writer,
+              &lattice_writer, &tot_like, &frame_count, &num_done, &num_err,
+              &num_partial));
+        }
+      }
+      sequencer.Wait();
+    }
+
+    kaldi::int64 lm_cache_hits = 0, lm_cache_misses = 0;
+    bool have_lm_cache_stats = cache_pool.GetStats(&lm_cache_hits,
+                                                   &lm_cache_misses);
+    if (decode_fst != NULL) delete decode_fst;
+    delete old_lm_fst;
+    delete new_lm_fst;
+
+    double elapsed = timer.Elapsed();
+    KALDI_LOG << "Decoded with " << sequencer_config.num_threads << " threads.";
+    KALDI_LOG << "Time taken "<< elapsed
+              << "s: real-time factor per thread assuming 100 frames/sec is "
+              << (sequencer_config.num_threads * elapsed * 100.0 / frame_count);
+    KALDI_LOG << "Done " << num_done << " utterances, failed for "
+              << num_err << " (" << num_partial << " partial)";
+    if (have_lm_cache_stats)
+      KALDI_LOG << "LM-difference cache hit rate was "
+                << (lm_cache_hits / (lm_cache_hits + lm_cache_misses + 1.0e-10))
+                << " over " << (lm_cache_hits + lm_cache_misses) << " lookups.";
+    KALDI_LOG << "Overall log-likelihood per frame is "
+              << (tot_like/frame_count) << " over "
+              << frame_count << " frames.";
+
+    if (word_syms) delete word_syms;
+    if (num_done != 0) return 0;
+    else return 1;
+  } catch(const std::exception &e) {
+    std::cerr << e.what();
+    return -1;
+  }
+}
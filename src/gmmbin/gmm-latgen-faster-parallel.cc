@@ -111,7 +111,7 @@ int main(int argc, char *argv[]) {
     double tot_like = 0.0;
     kaldi::int64 frame_count = 0;
     int num_done = 0, num_err = 0;
-    VectorFst<StdArc> *decode_fst = NULL; // only used if there is a single
+    fst::Fst<StdArc> *decode_fst = NULL; // only used if there is a single
                                           // decoding graph.
     
     TaskSequencer<DecodeUtteranceLatticeFasterClass> sequencer(sequencer_config);
@@ -120,7 +120,7 @@ int main(int argc, char *argv[]) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
 
-      decode_fst = fst::ReadFstKaldi(fst_in_str);
+      decode_fst = fst::ReadDecodingGraph(fst_in_str);
       
       {    
         for (; !feature_reader.Done(); feature_reader.Next()) {
@@ -31,6 +31,58 @@
 #include "base/timer.h"
 #include "feat/feature-functions.h"  // feature reversal
 
+namespace kaldi {
+
+// Decodes all the utterances in "feature_reader" with a single graph.  This is
+// templated on the type of the graph so that, when we know the graph is a
+// VectorFst or a MappedFst, we can use the version of the decoder specialized
+// for it.
+template <typename FST>
+void DecodeWithSingleGraph(const FST &decode_fst,
+                           const LatticeFasterDecoderConfig &config,
+                           const AmDiagGmm &am_gmm,
+                           const TransitionModel &trans_model,
+                           const fst::SymbolTable *word_syms,
+                           BaseFloat acoustic_scale,
+                           bool allow_partial,
+                           SequentialBaseFloatMatrixReader *feature_reader,
+                           Int32VectorWriter *alignment_writer,
+                           Int32VectorWriter *words_writer,
+                           CompactLatticeWriter *compact_lattice_writer,
+                           LatticeWriter *lattice_writer,
+                           double *tot_like, int64 *frame_count,
+                           int *num_done, int *num_err) {
+  LatticeFasterDecoderTpl<FST> decoder(decode_fst, config);
+  bool determinize = config.determinize_lattice;
+
+  for (; !feature_reader->Done(); feature_reader->Next()) {
+    std::string utt = feature_reader->Key();
+    Matrix<BaseFloat> features (feature_reader->Value());
+    feature_reader->FreeCurrent();
+    if (features.NumRows() == 0) {
+      KALDI_WARN << "Zero-length utterance: " << utt;
+      (*num_err)++;
+      continue;
+    }
+
+    DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
+                                           acoustic_scale);
+
+    double like;
+    if (DecodeUtteranceLatticeFaster(
+            decoder, gmm_decodable, trans_model, word_syms, utt,
+            acoustic_scale, determinize, allow_partial, alignment_writer,
+            words_writer, compact_lattice_writer, lattice_writer,
+            &like)) {
+      *tot_like += like;
+      *frame_count += features.NumRows();
+      (*num_done)++;
+    } else (*num_err)++;
+  }
+}
+
+}  // namespace kaldi
+
 int main(int argc, char *argv[]) {
   try {
     using namespace kaldi;
@@ -106,35 +158,29 @@ int main(int argc, char *argv[]) {
     if (ClassifyRspecifier(fst_in_str, NULL, NULL) == kNoRspecifier) {
       SequentialBaseFloatMatrixReader feature_reader(feature_rspecifier);
       // Input FST is just one FST, not a table of FSTs.
-      VectorFst<StdArc> *decode_fst = fst::ReadFstKaldi(fst_in_str);
-      
-      {
-        LatticeFasterDecoder decoder(*decode_fst, config);
-    
-        for (; !feature_reader.Done(); feature_reader.Next()) {
-          std::string utt = feature_reader.Key();
-          Matrix<BaseFloat> features (feature_reader.Value());
-          feature_reader.FreeCurrent();
-          if (features.NumRows() == 0) {
-            KALDI_WARN << "Zero-length utterance: " << utt;
-            num_err++;
-            continue;
-          }
-          
-          DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
-                                                 acoustic_scale);
-
-          double like;
-          if (DecodeUtteranceLatticeFaster(
-                  decoder, gmm_decodable, trans_model, word_syms, utt,
-                  acoustic_scale, determinize, allow_partial, &alignment_writer,
-                  &words_writer, &compact_lattice_writer, &lattice_writer,
-                  &like)) {
-            tot_like += like;
-            frame_count += features.NumRows();
-            num_done++;
-          } else num_err++;
-        }
+      fst::Fst<StdArc> *decode_fst = fst::ReadDecodingGraph(fst_in_str);
+
+      if (decode_fst->Type() == "vector") {
+        DecodeWithSingleGraph(
+            *static_cast<VectorFst<StdArc>*>(decode_fst), config, am_gmm,
+            trans_model, word_syms, acoustic_scale, allow_partial,
+            &feature_reader, &alignment_writer, &words_writer,
+            &compact_lattice_writer, &lattice_writer,
+            &tot_like, &frame_count, &num_done, &num_err);
+      } else if (decode_fst->Type() == "mapped") {
+        DecodeWithSingleGraph(
+            *static_cast<fst::MappedFst*>(decode_fst), config, am_gmm,
+            trans_model, word_syms, acoustic_scale, allow_partial,
+            &feature_reader, &alignment_writer, &words_writer,
+            &compact_lattice_writer, &lattice_writer,
+            &tot_like, &frame_count, &num_done, &num_err);
+      } else {
+        DecodeWithSingleGraph(
+            *decode_fst, config, am_gmm,
+            trans_model, word_syms, acoustic_scale, allow_partial,
+            &feature_reader, &alignment_writer, &words_writer,
+            &compact_lattice_writer, &lattice_writer,
+            &tot_like, &frame_count, &num_done, &num_err);
       }
       delete decode_fst; // delete this only after decoder goes out of scope.
     } else { // We have different FSTs for different utterances.
@@ -155,7 +201,8 @@ int main(int argc, char *argv[]) {
           continue;
         }
 
-        LatticeFasterDecoder decoder(fst_reader.Value(), config);
+        LatticeFasterDecoderTpl<VectorFst<StdArc> > decoder(fst_reader.Value(),
+                                                            config);
         DecodableAmDiagGmmScaled gmm_decodable(am_gmm, trans_model, features,
                                                acoustic_scale);
         double like;
@@ -103,25 +103,29 @@ bool PosteriorHolder::Read(std::istream &is) {
         KALDI_WARN << "holder of Posterior: error reading line " << (is.eof() ? "[eof]" : "");
         return false;  // probably eof.  fail in any case.
       }
-      std::istringstream line_is(line);
+      // Parse the line in place, which is much faster than using a
+      // std::istringstream.
+      const char *pos = line.data(), *end = pos + line.size();
       while (1) {
-        std::string str;
-        line_is >> std::ws;  // eat up whitespace.
-        if (line_is.eof()) break;
-        line_is >> str;
-        if (str != "[") KALDI_ERR << "Reading Posterior object: expecting [, got "
-                                  << str << " (if this is an integer, possibly "
+        while (pos != end && ::isspace(static_cast<unsigned char>(*pos))) pos++;
+        if (pos == end) break;
+        const char *token_begin = pos;
+        while (pos != end && !::isspace(static_cast<unsigned char>(*pos))) pos++;
+        if (pos - token_begin != 1 || *token_begin != '[')
+          KALDI_ERR << "Reading Posterior object: expecting [, got "
+                    << std::string(token_begin, pos) << " (if this is an integer, possibly "
                             "you gave alignments in place of posteriors?)";
         std::vector<std::pair<int32, BaseFloat> > this_vec;
         while (1) {
-          line_is >> std::ws;
-          if (line_is.peek() == ']') {
-            line_is.get();
+          while (pos != end && ::isspace(static_cast<unsigned char>(*pos))) pos++;
+          if (pos != end && *pos == ']') {
+            pos++;
             break;
           }
           int32 i; BaseFloat p;
-          line_is >> i >> p;
-          if (line_is.fail())
+          bool ok = ParseBasicType(&pos, end, &i);
+          while (ok && pos != end && ::isspace(static_cast<unsigned char>(*pos))) pos++;
+          if (!ok || !ParseBasicType(&pos, end, &p))
             KALDI_ERR << "Error reading Posterior object (could not get data after \"[\");";
           this_vec.push_back(std::make_pair(i, p));
         }
@@ -73,6 +73,10 @@ class PosteriorHolder {
   static bool IsReadInBinary() { return true; }
 
   const T &Value() const { return t_; }
+
+  void Swap(PosteriorHolder *other) {
+    t_.swap(other->t_);
+  }
   
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(PosteriorHolder);
@@ -102,6 +106,10 @@ class GaussPostHolder {
   static bool IsReadInBinary() { return true; }
 
   const T &Value() const { return t_; }
+
+  void Swap(GaussPostHolder *other) {
+    t_.swap(other->t_);
+  }
   
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(GaussPostHolder);
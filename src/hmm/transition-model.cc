@@ -91,9 +91,13 @@ void TransitionModel::ComputeDerived() {
   }
 
   id2state_.resize(cur_transition_id);   // cur_transition_id is #transition-ids+1.
-  for (int32 tstate = 1; tstate <= static_cast<int32>(triples_.size()); tstate++)
-    for (int32 tid = state2id_[tstate]; tid < state2id_[tstate+1]; tid++)
+  id2pdf_id_.resize(cur_transition_id);
+  for (int32 tstate = 1; tstate <= static_cast<int32>(triples_.size()); tstate++) {
+    for (int32 tid = state2id_[tstate]; tid < state2id_[tstate+1]; tid++) {
       id2state_[tid] = tstate;
+      id2pdf_id_[tid] = triples_[tstate-1].pdf;
+    }
+  }
 
 }
 void TransitionModel::InitializeProbs() {
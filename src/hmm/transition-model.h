@@ -152,6 +152,7 @@ class TransitionModel {
   // this state doesn't have a self-loop.
 
   inline int32 TransitionIdToPdf(int32 trans_id) const;
+
   int32 TransitionIdToPhone(int32 trans_id) const;
   int32 TransitionIdToPdfClass(int32 trans_id) const;
   int32 TransitionIdToHmmState(int32 trans_id) const;
@@ -250,7 +251,7 @@ class TransitionModel {
                        const MapTransitionUpdateConfig &cfg,
                        BaseFloat *objf_impr_out, BaseFloat *count_out);
   void ComputeTriples(const ContextDependency &ctx_dep);  // called from constructor.  initializes triples_.
-  void ComputeDerived();  // called from constructor and Read function: computes state2id_ and id2state_.
+  void ComputeDerived();  // called from constructor and Read function: computes state2id_, id2state_ and id2pdf_id_.
   void ComputeDerivedOfProbs();  // computes quantities derived from log-probs (currently just
   // non_self_loop_log_probs_; called whenever log-probs change.
   void InitializeProbs();  // called from constructor.
@@ -292,6 +293,11 @@ class TransitionModel {
   /// state (indexed by transition-id).
   std::vector<int32> id2state_;
 
+  /// For each transition-id, the corresponding pdf-id (indexed by
+  /// transition-id).  This is derived from id2state_ and triples_, and is
+  /// only there for speed.
+  std::vector<int32> id2pdf_id_;
+
   /// For each transition-id, the corresponding log-prob.  Indexed by transition-id.
   Vector<BaseFloat> log_probs_;
 
@@ -310,12 +316,9 @@ class TransitionModel {
 };
 
 inline int32 TransitionModel::TransitionIdToPdf(int32 trans_id) const {
-  // If a lot of time is spent here we may create an extra array
-  // to handle this.
-  KALDI_ASSERT(static_cast<size_t>(trans_id) < id2state_.size() &&
+  KALDI_ASSERT(static_cast<size_t>(trans_id) < id2pdf_id_.size() &&
                "Likely graph/model mismatch (graph built from wrong model?)");
-  int32 trans_state = id2state_[trans_id];
-  return triples_[trans_state-1].pdf;
+  return id2pdf_id_[trans_id];
 }
 
 /// Works out which pdfs might correspond to the given phones.  Will return true
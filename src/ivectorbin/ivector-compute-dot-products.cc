@@ -46,6 +46,11 @@ int main(int argc, char *argv[]) {
         "See also: ivector-plda-scoring\n";
     
     ParseOptions po(usage);
+
+    int32 batch_size = 1000;
+    po.Register("batch-size", &batch_size, "Number of trials for which the "
+                "iVectors are read ahead together (this makes the reads from "
+                "scp files nearly sequential).");
     
     po.Read(argc, argv);
     
@@ -72,34 +77,55 @@ int main(int argc, char *argv[]) {
     double sum = 0.0, sumsq = 0.0;
 
     std::string line;
-    while (std::getline(ki.Stream(), line)) {
-      std::vector<std::string> fields;
-      SplitStringToVector(line, " \t\n\r", true, &fields);
-      if (fields.size() != 2) {
-        KALDI_ERR << "Bad line " << (num_done + num_err) << " in input "
-                  << "(expected two fields: key1 key2): " << line;
+    std::vector<std::pair<std::string, std::string> > trials;
+    bool eof = false;
+    while (!eof) {
+      // Read a batch of trials, and read ahead the iVectors they need.
+      trials.clear();
+      while (static_cast<int32>(trials.size()) < batch_size) {
+        if (!std::getline(ki.Stream(), line)) {
+          eof = true;
+          break;
+        }
+        std::vector<std::string> fields;
+        SplitStringToVector(line, " \t\n\r", true, &fields);
+        if (fields.size() != 2) {
+          KALDI_ERR << "Bad line " << (num_done + num_err + trials.size())
+                    << " in input (expected two fields: key1 key2): " << line;
+        }
+        trials.push_back(std::make_pair(fields[0], fields[1]));
       }
-      std::string key1 = fields[0], key2 = fields[1];
-      if (!ivector1_reader.HasKey(key1)) {
-        KALDI_WARN << "Key " << key1 << " not present in 1st table of ivectors.";
-        num_err++;
-        continue;
+      std::vector<std::string> keys1(trials.size()), keys2(trials.size());
+      for (size_t i = 0; i < trials.size(); i++) {
+        keys1[i] = trials[i].first;
+        keys2[i] = trials[i].second;
       }
-      if (!ivector2_reader.HasKey(key2)) {
-        KALDI_WARN << "Key " << key2 << " not present in 2nd table of ivectors.";
-        num_err++;
-        continue;
+      ivector1_reader.Prefetch(keys1);
+      ivector2_reader.Prefetch(keys2);
+
+      for (size_t i = 0; i < trials.size(); i++) {
+        const std::string &key1 = trials[i].first, &key2 = trials[i].second;
+        if (!ivector1_reader.HasKey(key1)) {
+          KALDI_WARN << "Key " << key1 << " not present in 1st table of ivectors.";
+          num_err++;
+          continue;
+        }
+        if (!ivector2_reader.HasKey(key2)) {
+          KALDI_WARN << "Key " << key2 << " not present in 2nd table of ivectors.";
+          num_err++;
+          continue;
+        }
+        const Vector<BaseFloat> &ivector1 = ivector1_reader.Value(key1),
+            &ivector2 = ivector2_reader.Value(key2);
+        // The following will crash if the dimensions differ, but
+        // they would likely also differ for all the ivectors so it's probably
+        // best to just crash.
+        BaseFloat dot_prod = VecVec(ivector1, ivector2);
+        sum += dot_prod;
+        sumsq += dot_prod * dot_prod;
+        num_done++;
+        ko.Stream() << key1 << ' ' << key2 << ' ' << dot_prod << std::endl;
       }
-      const Vector<BaseFloat> &ivector1 = ivector1_reader.Value(key1),
-          &ivector2 = ivector2_reader.Value(key2);
-      // The following will crash if the dimensions differ, but
-      // they would likely also differ for all the ivectors so it's probably
-      // best to just crash.
-      BaseFloat dot_prod = VecVec(ivector1, ivector2);
-      sum += dot_prod;
-      sumsq += dot_prod * dot_prod;
-      num_done++;
-      ko.Stream() << key1 << ' ' << key2 << ' ' << dot_prod << std::endl;
     }
     
     if (num_done != 0) {
@@ -0,0 +1,18 @@
+# local sandbox config (not committed)
+CONFIGURE_VERSION := 2
+FSTROOT = /nonexistent
+OPENBLASROOT = /usr
+OPENBLASLIBS = -lopenblas -llapack
+CXXFLAGS = -msse -msse2 -Wall -I.. -pthread -std=gnu++98 \
+      -DKALDI_DOUBLEPRECISION=0 -DHAVE_POSIX_MEMALIGN \
+      -Wno-sign-compare -Wno-unused-local-typedefs -Winit-self \
+      -DHAVE_EXECINFO_H=1 -rdynamic -DHAVE_CXXABI_H \
+      -DHAVE_CLAPACK -I../../tools/CLAPACK \
+      $(EXTRA_CXXFLAGS) -g -O1
+LDFLAGS = -rdynamic
+LDLIBS = $(EXTRA_LDLIBS) $(OPENBLASLIBS) -lm -lpthread -ldl
+CC = g++
+CXX = g++
+AR = ar
+AS = as
+RANLIB = ranlib
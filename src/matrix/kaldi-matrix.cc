@@ -1264,6 +1264,9 @@ void Matrix<Real>::Read(std::istream & is, bool binary, bool add) {
   std::ostringstream specific_error;
 
   if (binary) {  // Read in binary mode.
+    // Table writers may put spaces before the token so that the data is
+    // aligned in the file (see AlignMatrixData() in util/kaldi-holder-inl.h).
+    while (is.peek() == ' ') is.get();
     int peekval = Peek(is, binary);
     if (peekval == 'C') {
       // This code enable us to read CompressedMatrix as a regular matrix.
@@ -57,6 +57,36 @@ template<typename Real> static void UnitTestSplitRadixRealFftSpeed() {
   KALDI_LOG << __func__ << " finished in " << t.Elapsed() << " seconds.";
 }
 
+template<typename Real> static void UnitTestSplitRadixRealFftRowsSpeed() {
+  Timer t;
+  MatrixIndexT num_rows = 1000;  // ten seconds of speech.
+  std::vector<MatrixIndexT> sizes;
+  sizes.push_back(256);
+  sizes.push_back(512);
+  sizes.push_back(1024);
+  for (size_t i = 0; i < sizes.size(); i++) {
+    MatrixIndexT sz = sizes[i];
+    SplitRadixRealFft<Real> srfft(sz);
+    Matrix<Real> M(num_rows, sz);
+    M.SetRandn();
+    std::vector<Real> temp_buffer;
+    Timer t1;
+    for (MatrixIndexT j = 0; j < 10; j++)
+      for (MatrixIndexT r = 0; r < num_rows; r++)
+        srfft.Compute(M.RowData(r), true, &temp_buffer);
+    double single_time = t1.Elapsed();
+    Timer t2;
+    for (MatrixIndexT j = 0; j < 10; j++)
+      srfft.Compute(&M, true);
+    double rows_time = t2.Elapsed();
+    KALDI_LOG << "For SplitRadixRealFft" << NameOf<Real>() << ", size " << sz
+              << ", one row at a time took " << single_time
+              << " seconds, all rows at once took " << rows_time
+              << " seconds, speedup " << (single_time / rows_time);
+  }
+  KALDI_LOG << __func__ << " finished in " << t.Elapsed() << " seconds.";
+}
+
 template<typename Real>
 static void UnitTestSvdSpeed() {
   Timer t;
@@ -271,6 +301,7 @@ static void UnitTestAddVecToColsSpeed() {
 template<typename Real> static void MatrixUnitSpeedTest() {
   UnitTestRealFftSpeed<Real>();
   UnitTestSplitRadixRealFftSpeed<Real>();
+  UnitTestSplitRadixRealFftRowsSpeed<Real>();
   UnitTestSvdSpeed<Real>();
   UnitTestAddMatMatSpeed<Real>();
   UnitTestAddRowSumMatSpeed<Real>();
@@ -3587,6 +3587,33 @@ template<typename Real> static void UnitTestSplitRadixRealFft() {
 }
 
 
+template<typename Real> static void UnitTestSplitRadixRealFftRows() {
+  for (MatrixIndexT p = 0; p < 20; p++) {
+    MatrixIndexT logn = 2 + Rand() % 9,
+        N = 1 << logn, num_rows = 1 + Rand() % 20;
+    SplitRadixRealFft<Real> srfft(N);
+    KALDI_ASSERT(srfft.Dim() == N);
+    // Use a sub-matrix so the stride is not the same as the number of columns.
+    Matrix<Real> M(num_rows, N + 3);
+    M.SetRandn();
+    SubMatrix<Real> x(M, 0, num_rows, 1, N);
+    Matrix<Real> y(x), orig(x);
+    bool forward = (Rand() % 2 == 0);
+    srfft.Compute(&x, forward);
+    std::vector<Real> temp_buffer;
+    for (MatrixIndexT r = 0; r < num_rows; r++)
+      srfft.Compute(y.RowData(r), forward, &temp_buffer);
+    // The rows should be the same as if they were done one by one (in fact,
+    // they are the same to the last bit).
+    AssertEqual(x, y, 1.0e-05);
+    // And going back should give the original data.
+    srfft.Compute(&x, !forward);
+    x.Scale(1.0 / N);
+    AssertEqual(x, orig, 1.0e-03);
+  }
+}
+
+
 
 template<typename Real> static void UnitTestRealFftSpeed() {
 
@@ -4357,6 +4384,7 @@ template<typename Real> static void MatrixUnitTest(bool full_test) {
   UnitTestRealFft<Real>();
   KALDI_LOG << " Point C";
   UnitTestSplitRadixRealFft<Real>();
+  UnitTestSplitRadixRealFftRows<Real>();
   UnitTestSvd<Real>();
   UnitTestSvdNodestroy<Real>();
   UnitTestSvdJustvec<Real>();
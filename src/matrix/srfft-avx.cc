@@ -0,0 +1,122 @@
+// matrix/srfft-avx.cc
+
+// Copyright 2009-2011  Microsoft Corporation;  Go Vivace Inc.
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+// This file is compiled with -mavx (see the Makefile); the code in it is only
+// called if the CPU supports AVX (see SplitRadixRealFft::Compute() in
+// srfft.cc), so nothing else should go in it.  The entry points must call
+// _mm256_zeroupper() on every path back to their (non-AVX) caller.
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#include "matrix/srfft-inl.h"
+
+namespace kaldi {
+
+#if defined(__AVX__)
+
+// These hold an element of eight (float) or four (double) transforms, one in
+// each lane, for SrfftComputeRealLanes().
+struct SrfftLanesFloat8 {
+  __m256 v;
+  SrfftLanesFloat8() { }
+  SrfftLanesFloat8(float f): v(_mm256_set1_ps(f)) { }
+  explicit SrfftLanesFloat8(__m256 v): v(v) { }
+};
+inline SrfftLanesFloat8 operator + (SrfftLanesFloat8 a, SrfftLanesFloat8 b) {
+  return SrfftLanesFloat8(_mm256_add_ps(a.v, b.v));
+}
+inline SrfftLanesFloat8 operator - (SrfftLanesFloat8 a, SrfftLanesFloat8 b) {
+  return SrfftLanesFloat8(_mm256_sub_ps(a.v, b.v));
+}
+inline SrfftLanesFloat8 operator * (SrfftLanesFloat8 a, SrfftLanesFloat8 b) {
+  return SrfftLanesFloat8(_mm256_mul_ps(a.v, b.v));
+}
+inline SrfftLanesFloat8 operator - (SrfftLanesFloat8 a) {
+  return SrfftLanesFloat8(_mm256_xor_ps(a.v, _mm256_set1_ps(-0.0f)));
+}
+
+struct SrfftLanesDouble4 {
+  __m256d v;
+  SrfftLanesDouble4() { }
+  SrfftLanesDouble4(double d): v(_mm256_set1_pd(d)) { }
+  explicit SrfftLanesDouble4(__m256d v): v(v) { }
+};
+inline SrfftLanesDouble4 operator + (SrfftLanesDouble4 a, SrfftLanesDouble4 b) {
+  return SrfftLanesDouble4(_mm256_add_pd(a.v, b.v));
+}
+inline SrfftLanesDouble4 operator - (SrfftLanesDouble4 a, SrfftLanesDouble4 b) {
+  return SrfftLanesDouble4(_mm256_sub_pd(a.v, b.v));
+}
+inline SrfftLanesDouble4 operator * (SrfftLanesDouble4 a, SrfftLanesDouble4 b) {
+  return SrfftLanesDouble4(_mm256_mul_pd(a.v, b.v));
+}
+inline SrfftLanesDouble4 operator - (SrfftLanesDouble4 a) {
+  return SrfftLanesDouble4(_mm256_xor_pd(a.v, _mm256_set1_pd(-0.0)));
+}
+
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<float> &tables, float *data,
+                                 MatrixIndexT num_rows, MatrixIndexT stride,
+                                 bool forward, void *buffer) {
+  MatrixIndexT r = 0;
+  for (; r + 8 <= num_rows; r += 8)
+    SrfftComputeRealLanes<float, SrfftLanesFloat8, 8>(
+        tables, data + r * stride, stride, forward,
+        static_cast<SrfftLanesFloat8*>(buffer));
+  // Clear the upper halves of the AVX registers before returning to code
+  // compiled without -mavx; otherwise, on many CPUs, the SSE instructions that
+  // follow (e.g. in libm) run several times slower.
+  _mm256_zeroupper();
+  return r;
+}
+
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<double> &tables,
+                                 double *data, MatrixIndexT num_rows,
+                                 MatrixIndexT stride, bool forward,
+                                 void *buffer) {
+  MatrixIndexT r = 0;
+  for (; r + 4 <= num_rows; r += 4)
+    SrfftComputeRealLanes<double, SrfftLanesDouble4, 4>(
+        tables, data + r * stride, stride, forward,
+        static_cast<SrfftLanesDouble4*>(buffer));
+  // Clear the upper halves of the AVX registers before returning to code
+  // compiled without -mavx; otherwise, on many CPUs, the SSE instructions that
+  // follow (e.g. in libm) run several times slower.
+  _mm256_zeroupper();
+  return r;
+}
+
+#else  // !defined(__AVX__)
+
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<float> &tables, float *data,
+                                 MatrixIndexT num_rows, MatrixIndexT stride,
+                                 bool forward, void *buffer) {
+  return 0;
+}
+
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<double> &tables,
+                                 double *data, MatrixIndexT num_rows,
+                                 MatrixIndexT stride, bool forward,
+                                 void *buffer) {
+  return 0;
+}
+
+#endif  // defined(__AVX__)
+
+}  // namespace kaldi
@@ -0,0 +1,345 @@
+// matrix/srfft-inl.h
+
+// Copyright 2009-2011  Microsoft Corporation;  Go Vivace Inc.
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+//
+// This file includes a modified version of code originally published in Malvar,
+// H., "Signal processing with lapped transforms, " Artech House, Inc., 1992.  The
+// current copyright holder of the original code, Henrique S. Malvar, has given
+// his permission for the release of this modified version under the Apache
+// License v2.0.
+
+#ifndef KALDI_MATRIX_SRFFT_INL_H_
+#define KALDI_MATRIX_SRFFT_INL_H_
+
+// This header is only included by srfft.cc and srfft-avx.cc.  It contains the
+// split-radix FFT templated on the type V of the elements it operates on, which
+// is either Real, for a single transform, or a SIMD vector of Reals that holds
+// the same element of several transforms (one per lane), for
+// SplitRadixRealFft::Compute() on the rows of a matrix.  V must support +, -
+// (binary and unary) and *, and construction from Real.  As the lanes do
+// exactly the same operations as the scalar code, the results of the two are
+// the same.
+//
+// Do not use any standard-library containers here: srfft-avx.cc is compiled
+// with -mavx, and out-of-line copies of them could end up being used by code
+// that runs on CPUs without AVX.
+
+#include "matrix/srfft.h"
+
+namespace kaldi {
+
+// Does the complex FFT (without the bit-reversal) of the 2^logn points in xr,
+// xi (the real and imaginary parts).
+template<typename Real, typename V>
+void SrfftComputeRecursive(Real *const *tab, V *xr, V *xi,
+                           MatrixIndexT logn) {
+  MatrixIndexT    m, m2, m4, m8, nel, n;
+  V    *xr1, *xr2, *xi1, *xi2;
+  const Real    *cn = NULL, *spcn = NULL, *smcn = NULL, *c3n = NULL,
+      *spc3n = NULL, *smc3n = NULL;
+  V    tmp1, tmp2;
+  Real   sqhalf = M_SQRT1_2;
+
+  /* Check range of logn */
+  KALDI_ASSERT(logn >= 0);
+
+  /* Compute trivial cases */
+  if (logn < 3) {
+    if (logn == 2) {  /* length m = 4 */
+      xr2  = xr + 2;
+      xi2  = xi + 2;
+      tmp1 = *xr + *xr2;
+      *xr2 = *xr - *xr2;
+      *xr  = tmp1;
+      tmp1 = *xi + *xi2;
+      *xi2 = *xi - *xi2;
+      *xi  = tmp1;
+      xr1  = xr + 1;
+      xi1  = xi + 1;
+      xr2++;
+      xi2++;
+      tmp1 = *xr1 + *xr2;
+      *xr2 = *xr1 - *xr2;
+      *xr1 = tmp1;
+      tmp1 = *xi1 + *xi2;
+      *xi2 = *xi1 - *xi2;
+      *xi1 = tmp1;
+      xr2  = xr + 1;
+      xi2  = xi + 1;
+      tmp1 = *xr + *xr2;
+      *xr2 = *xr - *xr2;
+      *xr  = tmp1;
+      tmp1 = *xi + *xi2;
+      *xi2 = *xi - *xi2;
+      *xi  = tmp1;
+      xr1  = xr + 2;
+      xi1  = xi + 2;
+      xr2  = xr + 3;
+      xi2  = xi + 3;
+      tmp1 = *xr1 + *xi2;
+      tmp2 = *xi1 + *xr2;
+      *xi1 = *xi1 - *xr2;
+      *xr2 = *xr1 - *xi2;
+      *xr1 = tmp1;
+      *xi2 = tmp2;
+      return;
+    }
+    else if (logn == 1) {   /* length m = 2 */
+      xr2  = xr + 1;
+      xi2  = xi + 1;
+      tmp1 = *xr + *xr2;
+      *xr2 = *xr - *xr2;
+      *xr  = tmp1;
+      tmp1 = *xi + *xi2;
+      *xi2 = *xi - *xi2;
+      *xi  = tmp1;
+      return;
+    }
+    else if (logn == 0) return;   /* length m = 1 */
+  }
+
+  /* Compute a few constants */
+  m = 1 << logn; m2 = m / 2; m4 = m2 / 2; m8 = m4 /2;
+
+
+  /* Step 1 */
+  xr1 = xr; xr2 = xr1 + m2;
+  xi1 = xi; xi2 = xi1 + m2;
+  for (n = 0; n < m2; n++) {
+    tmp1 = *xr1 + *xr2;
+    *xr2 = *xr1 - *xr2;
+    xr2++;
+    *xr1++ = tmp1;
+    tmp2 = *xi1 + *xi2;
+    *xi2 = *xi1 - *xi2;
+    xi2++;
+    *xi1++ = tmp2;
+  }
+
+  /* Step 2 */
+  xr1 = xr + m2; xr2 = xr1 + m4;
+  xi1 = xi + m2; xi2 = xi1 + m4;
+  for (n = 0; n < m4; n++) {
+    tmp1 = *xr1 + *xi2;
+    tmp2 = *xi1 + *xr2;
+    *xi1 = *xi1 - *xr2;
+    xi1++;
+    *xr2++ = *xr1 - *xi2;
+    *xr1++ = tmp1;
+    *xi2++ = tmp2;
+  }
+
+  /* Steps 3 & 4 */
+  xr1 = xr + m2; xr2 = xr1 + m4;
+  xi1 = xi + m2; xi2 = xi1 + m4;
+  if (logn >= 4) {
+    nel = m4 - 2;
+    cn  = tab[logn-4]; spcn  = cn + nel;  smcn  = spcn + nel;
+    c3n = smcn + nel;  spc3n = c3n + nel; smc3n = spc3n + nel;
+  }
+  xr1++; xr2++; xi1++; xi2++;
+  for (n = 1; n < m4; n++) {
+    if (n == m8) {
+      tmp1 =  sqhalf * (*xr1 + *xi1);
+      *xi1 =  sqhalf * (*xi1 - *xr1);
+      *xr1 =  tmp1;
+      tmp2 =  sqhalf * (*xi2 - *xr2);
+      *xi2 = -sqhalf * (*xr2 + *xi2);
+      *xr2 =  tmp2;
+    } else {
+      tmp2 = *cn++ * (*xr1 + *xi1);
+      tmp1 = *spcn++ * *xr1 + tmp2;
+      *xr1 = *smcn++ * *xi1 + tmp2;
+      *xi1 = tmp1;
+      tmp2 = *c3n++ * (*xr2 + *xi2);
+      tmp1 = *spc3n++ * *xr2 + tmp2;
+      *xr2 = *smc3n++ * *xi2 + tmp2;
+      *xi2 = tmp1;
+    }
+    xr1++; xr2++; xi1++; xi2++;
+  }
+
+  /* Call ssrec again with half DFT length */
+  SrfftComputeRecursive(tab, xr, xi, logn-1);
+
+  /* Call ssrec again twice with one quarter DFT length. */
+  SrfftComputeRecursive(tab, xr + m2, xi + m2, logn - 2);
+  m4 = 3 * (m / 4);
+  SrfftComputeRecursive(tab, xr + m4, xi + m4, logn - 2);
+}
+
+template<typename V>
+void SrfftBitReversePermute(const MatrixIndexT *brseed, V *x,
+                            MatrixIndexT logn) {
+  MatrixIndexT      i, j, lg2, n;
+  MatrixIndexT      off, fj, gno;
+  const MatrixIndexT *brp;
+  V    tmp, *xp, *xq;
+
+  lg2 = logn >> 1;
+  n = 1 << lg2;
+  if (logn & 1) lg2++;
+
+  /* Unshuffling loop */
+  for (off = 1; off < n; off++) {
+    fj = n * brseed[off]; i = off; j = fj;
+    tmp = x[i]; x[i] = x[j]; x[j] = tmp;
+    xp = &x[i];
+    brp = &(brseed[1]);
+    for (gno = 1; gno < brseed[off]; gno++) {
+      xp += n;
+      j = fj + *brp++;
+      xq = x + j;
+      tmp = *xp; *xp = *xq; *xq = tmp;
+    }
+  }
+}
+
+// Does the complex FFT of the points in xr, xi.
+template<typename Real, typename V>
+void SrfftComputeComplex(const SrfftTables<Real> &tables, V *xr, V *xi,
+                         bool forward) {
+  if (!forward) {  // reverse real and imaginary parts for complex FFT.
+    V *tmp = xr;
+    xr = xi;
+    xi = tmp;
+  }
+  SrfftComputeRecursive(tables.tab, xr, xi, tables.logn);
+  if (tables.logn > 1) {
+    SrfftBitReversePermute(tables.brseed, xr, tables.logn);
+    SrfftBitReversePermute(tables.brseed, xi, tables.logn);
+  }
+}
+
+// Does the real FFT (see SplitRadixRealFft::Compute()) of the N real points
+// whose even-numbered elements are in re and odd-numbered elements are in im
+// (each of size N/2); at output, (re[k], im[k]) is the k'th complex element of
+// the transform, as interleaved in the output of SplitRadixRealFft::Compute().
+// This code is mostly the same as the RealFft function.
+template<typename Real, typename V>
+void SrfftComputeReal(const SrfftTables<Real> &tables, V *re, V *im,
+                      bool forward) {
+  MatrixIndexT N = tables.N, N2 = N/2;
+  if (forward)
+    SrfftComputeComplex(tables, re, im, true);
+
+  // The powers of exp(-2pi/N), forward, and of exp(2pi/N), backward,
+  // starting from exp(-2pi/N), forward, and -exp(2pi/N), backward.
+  const Real *kN_re_table = tables.twiddle_re[forward ? 0 : 1],
+      *kN_im_table = tables.twiddle_im[forward ? 0 : 1];
+  for (MatrixIndexT k = 1; 2*k <= N2; k++) {
+    Real kN_re = kN_re_table[k], kN_im = kN_im_table[k];
+    MatrixIndexT kdash = N2 - k;
+
+    V Ck_re, Ck_im, Dk_re, Dk_im;
+    // C_k = 1/2 (B_k + B_{N/2 - k}^*) :
+    Ck_re = static_cast<Real>(0.5) * (re[k] + re[kdash]);
+    Ck_im = static_cast<Real>(0.5) * (im[k] - im[kdash]);
+    // re(D_k)= 1/2 (im(B_k) + im(B_{N/2-k})):
+    Dk_re = static_cast<Real>(0.5) * (im[k] + im[kdash]);
+    // im(D_k) = -1/2 (re(B_k) - re(B_{N/2-k}))
+    Dk_im = static_cast<Real>(-0.5) * (re[k] - re[kdash]);
+    // A_k = C_k + 1^(k/N) D_k:
+    re[k] = Ck_re + (kN_re * Dk_re - kN_im * Dk_im);
+    im[k] = Ck_im + (kN_re * Dk_im + kN_im * Dk_re);
+
+    if (kdash != k) {
+      // Next we handle the index k' = N/2 - k.  This is necessary
+      // to do now, to avoid invalidating data that we will later need.
+      // The quantities C_{k'} and D_{k'} are just the conjugates of C_k
+      // and D_k, so the equations are simple modifications of the above,
+      // replacing Ck_im and Dk_im with their negatives.
+      // We use 1^(k'/N) = 1^((N/2 - k) / N) = 1^(1/2) 1^(-k/N) = -1 * (1^(k/N))^*
+      // so it's the same as 1^(k/N) but with the real part negated.
+      Real minus_kN_re = -kN_re;
+      V minus_Dk_im = -Dk_im;
+      re[kdash] = Ck_re + (minus_kN_re * Dk_re - kN_im * minus_Dk_im);
+      im[kdash] = -Ck_im + (minus_kN_re * minus_Dk_im + kN_im * Dk_re);
+    }
+  }
+
+  {  // Now handle k = 0.
+    // In simple terms: after the complex fft, re[0] becomes the sum of real
+    // parts input[0], input[2]... and im[0] becomes the sum of imaginary
+    // pats input[1], input[3]...
+    // "zeroth" [A_0] is just the sum of input[0]+input[1]+input[2]..
+    // and "n2th" [A_{N/2}] is input[0]-input[1]+input[2]... .
+    V zeroth = re[0] + im[0],
+        n2th = re[0] - im[0];
+    re[0] = zeroth;
+    im[0] = n2th;
+    if (!forward) {
+      re[0] = static_cast<Real>(0.5) * re[0];
+      im[0] = static_cast<Real>(0.5) * im[0];
+    }
+  }
+  if (!forward) {
+    SrfftComputeComplex(tables, re, im, false);
+    // This is so we get a factor of N increase, rather than N/2 which we would
+    // otherwise get from [ComplexFft, forward] + [ComplexFft, backward] in
+    // dimension N/2.  It's for consistency with our normal FFT convensions.
+    for (MatrixIndexT i = 0; i < N2; i++) {
+      re[i] = static_cast<Real>(2.0) * re[i];
+      im[i] = static_cast<Real>(2.0) * im[i];
+    }
+  }
+}
+
+// Does the real FFTs of kNumLanes rows of "data" (the rows being "stride"
+// apart) using the lanes of V, which has kNumLanes elements of type Real;
+// "buffer" is space for N elements of type V.
+template<typename Real, typename V, MatrixIndexT kNumLanes>
+void SrfftComputeRealLanes(const SrfftTables<Real> &tables, Real *data,
+                           MatrixIndexT stride, bool forward, V *buffer) {
+  MatrixIndexT N2 = tables.N / 2;
+  // Element k of lane l of the real and imaginary parts.
+  Real *re = reinterpret_cast<Real*>(buffer),
+      *im = reinterpret_cast<Real*>(buffer + N2);
+  for (MatrixIndexT l = 0; l < kNumLanes; l++) {
+    const Real *row = data + l * stride;
+    for (MatrixIndexT k = 0; k < N2; k++) {
+      re[k * kNumLanes + l] = row[2 * k];
+      im[k * kNumLanes + l] = row[2 * k + 1];
+    }
+  }
+  SrfftComputeReal(tables, buffer, buffer + N2, forward);
+  for (MatrixIndexT l = 0; l < kNumLanes; l++) {
+    Real *row = data + l * stride;
+    for (MatrixIndexT k = 0; k < N2; k++) {
+      row[2 * k] = re[k * kNumLanes + l];
+      row[2 * k + 1] = im[k * kNumLanes + l];
+    }
+  }
+}
+
+// The following are defined in srfft-avx.cc.  They do the real FFTs of as many
+// rows of "data" as they can in groups of 8 (float) or 4 (double), and return
+// the number of rows done; this is zero if the code was compiled without AVX
+// support.  They must only be called if the CPU supports AVX.  "buffer" must
+// be 32-byte aligned space for 8 * N floats or 4 * N doubles.
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<float> &tables, float *data,
+                                 MatrixIndexT num_rows, MatrixIndexT stride,
+                                 bool forward, void *buffer);
+MatrixIndexT SrfftComputeRowsAvx(const SrfftTables<double> &tables,
+                                 double *data, MatrixIndexT num_rows,
+                                 MatrixIndexT stride, bool forward,
+                                 void *buffer);
+
+}  // namespace kaldi
+
+#endif  // KALDI_MATRIX_SRFFT_INL_H_
@@ -25,7 +25,11 @@
 // License v2.0.
 
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "matrix/srfft.h"
+#include "matrix/srfft-inl.h"
 #include "matrix/matrix-functions.h"
 
 namespace kaldi {
@@ -43,6 +47,12 @@ SplitRadixComplexFft<Real>::SplitRadixComplexFft(MatrixIndexT N) {
     logn_ ++;
   }
   ComputeTables();
+  tables_.N = N_;
+  tables_.logn = logn_;
+  tables_.brseed = brseed_;
+  tables_.tab = tab_;
+  tables_.twiddle_re[0] = tables_.twiddle_re[1] = NULL;
+  tables_.twiddle_im[0] = tables_.twiddle_im[1] = NULL;
 }
 
 template<typename Real>
@@ -108,16 +118,7 @@ SplitRadixComplexFft<Real>::~SplitRadixComplexFft() {
 
 template<typename Real>
 void SplitRadixComplexFft<Real>::Compute(Real *xr, Real *xi, bool forward) const {
-  if (!forward) {  // reverse real and imaginary parts for complex FFT.
-    Real *tmp = xr;
-    xr = xi;
-    xi = tmp;
-  }
-  ComputeRecursive(xr, xi, logn_);
-  if (logn_ > 1) {
-    BitReversePermute(xr, logn_);
-    BitReversePermute(xi, logn_);
-  }
+  SrfftComputeComplex(tables_, xr, xi, forward);
 }
 
 template<typename Real>
@@ -156,252 +157,171 @@ void SplitRadixComplexFft<Real>::Compute(Real *x, bool forward) {
 }
 
 template<typename Real>
-void SplitRadixComplexFft<Real>::BitReversePermute(Real *x, MatrixIndexT logn) const {
-  MatrixIndexT      i, j, lg2, n;
-  MatrixIndexT      off, fj, gno, *brp;
-  Real    tmp, *xp, *xq;
-
-  lg2 = logn >> 1;
-  n = 1 << lg2;
-  if (logn & 1) lg2++;
-
-  /* Unshuffling loop */
-  for (off = 1; off < n; off++) {
-    fj = n * brseed_[off]; i = off; j = fj;
-    tmp = x[i]; x[i] = x[j]; x[j] = tmp;
-    xp = &x[i];
-    brp = &(brseed_[1]);
-    for (gno = 1; gno < brseed_[off]; gno++) {
-      xp += n;
-      j = fj + *brp++;
-      xq = x + j;
-      tmp = *xp; *xp = *xq; *xq = tmp;
+SplitRadixRealFft<Real>::SplitRadixRealFft(MatrixIndexT N):
+    SplitRadixComplexFft<Real> (N/2), N_(N) {
+  this->tables_.N = N;
+  // Compute the factors exactly as the real-FFT code used to compute them on
+  // the fly, so that the results do not change.
+  MatrixIndexT N2 = N/2, size = N2/2 + 1;
+  twiddles_ = new Real[4 * size];
+  for (int32 i = 0; i < 2; i++) {
+    bool forward = (i == 0);
+    Real *kN_re_table = twiddles_ + 2 * i * size,
+        *kN_im_table = kN_re_table + size;
+    Real rootN_re, rootN_im;  // exp(-2pi/N), forward; exp(2pi/N), backward
+    int forward_sign = forward ? -1 : 1;
+    ComplexImExp(static_cast<Real>(M_2PI/N *forward_sign), &rootN_re, &rootN_im);
+    Real kN_re = -forward_sign, kN_im = 0.0;  // exp(-2pik/N), forward; exp(-2pik/N), backward
+    // kN starts out as 1.0 for forward algorithm but -1.0 for backward.
+    kN_re_table[0] = kN_re;
+    kN_im_table[0] = kN_im;
+    for (MatrixIndexT k = 1; 2*k <= N2; k++) {
+      ComplexMul(rootN_re, rootN_im, &kN_re, &kN_im);
+      kN_re_table[k] = kN_re;
+      kN_im_table[k] = kN_im;
     }
+    this->tables_.twiddle_re[i] = kN_re_table;
+    this->tables_.twiddle_im[i] = kN_im_table;
   }
 }
 
-
 template<typename Real>
-void SplitRadixComplexFft<Real>::ComputeRecursive(Real *xr, Real *xi, MatrixIndexT logn) const {
-
-  MatrixIndexT    m, m2, m4, m8, nel, n;
-  Real    *xr1, *xr2, *xi1, *xi2;
-  Real    *cn, *spcn, *smcn, *c3n, *spc3n, *smc3n;
-  Real    tmp1, tmp2;
-  Real   sqhalf = M_SQRT1_2;
-
-  /* Check range of logn */
-  if (logn < 0)
-    KALDI_ERR << "Error: logn is out of bounds in SRFFT";
-
-  /* Compute trivial cases */
-  if (logn < 3) {
-    if (logn == 2) {  /* length m = 4 */
-      xr2  = xr + 2;
-      xi2  = xi + 2;
-      tmp1 = *xr + *xr2;
-      *xr2 = *xr - *xr2;
-      *xr  = tmp1;
-      tmp1 = *xi + *xi2;
-      *xi2 = *xi - *xi2;
-      *xi  = tmp1;
-      xr1  = xr + 1;
-      xi1  = xi + 1;
-      xr2++;
-      xi2++;
-      tmp1 = *xr1 + *xr2;
-      *xr2 = *xr1 - *xr2;
-      *xr1 = tmp1;
-      tmp1 = *xi1 + *xi2;
-      *xi2 = *xi1 - *xi2;
-      *xi1 = tmp1;
-      xr2  = xr + 1;
-      xi2  = xi + 1;
-      tmp1 = *xr + *xr2;
-      *xr2 = *xr - *xr2;
-      *xr  = tmp1;
-      tmp1 = *xi + *xi2;
-      *xi2 = *xi - *xi2;
-      *xi  = tmp1;
-      xr1  = xr + 2;
-      xi1  = xi + 2;
-      xr2  = xr + 3;
-      xi2  = xi + 3;
-      tmp1 = *xr1 + *xi2;
-      tmp2 = *xi1 + *xr2;
-      *xi1 = *xi1 - *xr2;
-      *xr2 = *xr1 - *xi2;
-      *xr1 = tmp1;
-      *xi2 = tmp2;
-      return;
-    }
-    else if (logn == 1) {   /* length m = 2 */
-      xr2  = xr + 1;
-      xi2  = xi + 1;
-      tmp1 = *xr + *xr2;
-      *xr2 = *xr - *xr2;
-      *xr  = tmp1;
-      tmp1 = *xi + *xi2;
-      *xi2 = *xi - *xi2;
-      *xi  = tmp1;
-      return;
-    }
-    else if (logn == 0) return;   /* length m = 1 */
-  }
-
-  /* Compute a few constants */
-  m = 1 << logn; m2 = m / 2; m4 = m2 / 2; m8 = m4 /2;
-
-
-  /* Step 1 */
-  xr1 = xr; xr2 = xr1 + m2;
-  xi1 = xi; xi2 = xi1 + m2;
-  for (n = 0; n < m2; n++) {
-    tmp1 = *xr1 + *xr2;
-    *xr2 = *xr1 - *xr2;
-    xr2++;
-    *xr1++ = tmp1;
-    tmp2 = *xi1 + *xi2;
-    *xi2 = *xi1 - *xi2;
-    xi2++;
-    *xi1++ = tmp2;
-  }
-
-  /* Step 2 */
-  xr1 = xr + m2; xr2 = xr1 + m4;
-  xi1 = xi + m2; xi2 = xi1 + m4;
-  for (n = 0; n < m4; n++) {
-    tmp1 = *xr1 + *xi2;
-    tmp2 = *xi1 + *xr2;
-    *xi1 = *xi1 - *xr2;
-    xi1++;
-    *xr2++ = *xr1 - *xi2;
-    *xr1++ = tmp1;
-    *xi2++ = tmp2;
-    // xr1++; xr2++; xi1++; xi2++;
-  }
-
-  /* Steps 3 & 4 */
-  xr1 = xr + m2; xr2 = xr1 + m4;
-  xi1 = xi + m2; xi2 = xi1 + m4;
-  if (logn >= 4) {
-    nel = m4 - 2;
-    cn  = tab_[logn-4]; spcn  = cn + nel;  smcn  = spcn + nel;
-    c3n = smcn + nel;  spc3n = c3n + nel; smc3n = spc3n + nel;
-  }
-  xr1++; xr2++; xi1++; xi2++;
-  // xr1++; xi1++;
-  for (n = 1; n < m4; n++) {
-    if (n == m8) {
-      tmp1 =  sqhalf * (*xr1 + *xi1);
-      *xi1 =  sqhalf * (*xi1 - *xr1);
-      *xr1 =  tmp1;
-      tmp2 =  sqhalf * (*xi2 - *xr2);
-      *xi2 = -sqhalf * (*xr2 + *xi2);
-      *xr2 =  tmp2;
-    } else {
-      tmp2 = *cn++ * (*xr1 + *xi1);
-      tmp1 = *spcn++ * *xr1 + tmp2;
-      *xr1 = *smcn++ * *xi1 + tmp2;
-      *xi1 = tmp1;
-      tmp2 = *c3n++ * (*xr2 + *xi2);
-      tmp1 = *spc3n++ * *xr2 + tmp2;
-      *xr2 = *smc3n++ * *xi2 + tmp2;
-      *xi2 = tmp1;
-    }
-    xr1++; xr2++; xi1++; xi2++;
-  }
-
-  /* Call ssrec again with half DFT length */
-  ComputeRecursive(xr, xi, logn-1);
-
-  /* Call ssrec again twice with one quarter DFT length.
-     Constants have to be recomputed, because they are static! */
-  // m = 1 << logn; m2 = m / 2;
-  ComputeRecursive(xr + m2, xi + m2, logn - 2);
-  // m = 1 << logn;
-  m4 = 3 * (m / 4);
-  ComputeRecursive(xr + m4, xi + m4, logn - 2);
+SplitRadixRealFft<Real>::~SplitRadixRealFft() {
+  delete [] twiddles_;
 }
 
-
 template<typename Real>
 void SplitRadixRealFft<Real>::Compute(Real *data, bool forward) {
   Compute(data, forward, &this->temp_buffer_);
 }
 
 
-// This code is mostly the same as the RealFft function.  It would be
-// possible to replace it with more efficient code from Rico's book.
 template<typename Real>
 void SplitRadixRealFft<Real>::Compute(Real *data, bool forward,
                                       std::vector<Real> *temp_buffer) const {
   MatrixIndexT N = N_, N2 = N/2;
   KALDI_ASSERT(N%2 == 0);
-  if (forward) // call to base class
-    SplitRadixComplexFft<Real>::Compute(data, true, temp_buffer);
-
-  Real rootN_re, rootN_im;  // exp(-2pi/N), forward; exp(2pi/N), backward
-  int forward_sign = forward ? -1 : 1;
-  ComplexImExp(static_cast<Real>(M_2PI/N *forward_sign), &rootN_re, &rootN_im);
-  Real kN_re = -forward_sign, kN_im = 0.0;  // exp(-2pik/N), forward; exp(-2pik/N), backward
-  // kN starts out as 1.0 for forward algorithm but -1.0 for backward.
-  for (MatrixIndexT k = 1; 2*k <= N2; k++) {
-    ComplexMul(rootN_re, rootN_im, &kN_re, &kN_im);
-
-    Real Ck_re, Ck_im, Dk_re, Dk_im;
-    // C_k = 1/2 (B_k + B_{N/2 - k}^*) :
-    Ck_re = 0.5 * (data[2*k] + data[N - 2*k]);
-    Ck_im = 0.5 * (data[2*k + 1] - data[N - 2*k + 1]);
-    // re(D_k)= 1/2 (im(B_k) + im(B_{N/2-k})):
-    Dk_re = 0.5 * (data[2*k + 1] + data[N - 2*k + 1]);
-    // im(D_k) = -1/2 (re(B_k) - re(B_{N/2-k}))
-    Dk_im =-0.5 * (data[2*k] - data[N - 2*k]);
-    // A_k = C_k + 1^(k/N) D_k:
-    data[2*k] = Ck_re;  // A_k <-- C_k
-    data[2*k+1] = Ck_im;
-    // now A_k += D_k 1^(k/N)
-    ComplexAddProduct(Dk_re, Dk_im, kN_re, kN_im, &(data[2*k]), &(data[2*k+1]));
-
-    MatrixIndexT kdash = N2 - k;
-    if (kdash != k) {
-      // Next we handle the index k' = N/2 - k.  This is necessary
-      // to do now, to avoid invalidating data that we will later need.
-      // The quantities C_{k'} and D_{k'} are just the conjugates of C_k
-      // and D_k, so the equations are simple modifications of the above,
-      // replacing Ck_im and Dk_im with their negatives.
-      data[2*kdash] = Ck_re;  // A_k' <-- C_k'
-      data[2*kdash+1] = -Ck_im;
-      // now A_k' += D_k' 1^(k'/N)
-      // We use 1^(k'/N) = 1^((N/2 - k) / N) = 1^(1/2) 1^(-k/N) = -1 * (1^(k/N))^*
-      // so it's the same as 1^(k/N) but with the real part negated.
-      ComplexAddProduct(Dk_re, -Dk_im, -kN_re, kN_im, &(data[2*kdash]), &(data[2*kdash+1]));
-    }
+  KALDI_ASSERT(temp_buffer != NULL);
+  if (temp_buffer->size() != N)
+    temp_buffer->resize(N);
+  // The even-numbered elements (real parts) go in the first half of
+  // temp_buffer, and the odd-numbered ones (imaginary parts) in the second.
+  Real *re = &((*temp_buffer)[0]), *im = re + N2;
+  for (MatrixIndexT k = 0; k < N2; k++) {
+    re[k] = data[2 * k];
+    im[k] = data[2 * k + 1];
   }
-
-  {  // Now handle k = 0.
-    // In simple terms: after the complex fft, data[0] becomes the sum of real
-    // parts input[0], input[2]... and data[1] becomes the sum of imaginary
-    // pats input[1], input[3]...
-    // "zeroth" [A_0] is just the sum of input[0]+input[1]+input[2]..
-    // and "n2th" [A_{N/2}] is input[0]-input[1]+input[2]... .
-    Real zeroth = data[0] + data[1],
-        n2th = data[0] - data[1];
-    data[0] = zeroth;
-    data[1] = n2th;
-    if (!forward) {
-      data[0] /= 2;
-      data[1] /= 2;
-    }
+  SrfftComputeReal(this->tables_, re, im, forward);
+  for (MatrixIndexT k = 0; k < N2; k++) {
+    data[2 * k] = re[k];
+    data[2 * k + 1] = im[k];
   }
-  if (!forward) {  // call to base class
-    SplitRadixComplexFft<Real>::Compute(data, false, temp_buffer);
-    for (MatrixIndexT i = 0; i < N; i++)
-      data[i] *= 2.0;
-    // This is so we get a factor of N increase, rather than N/2 which we would
-    // otherwise get from [ComplexFft, forward] + [ComplexFft, backward] in dimension N/2.
-    // It's for consistency with our normal FFT convensions.
+}
+
+
+#if defined(__SSE2__)
+// These hold an element of four (float) or two (double) transforms, one in each
+// lane, for SrfftComputeRealLanes().  Negation flips the sign bit, as it does
+// for scalars.
+struct SrfftLanesFloat4 {
+  __m128 v;
+  SrfftLanesFloat4() { }
+  SrfftLanesFloat4(float f): v(_mm_set1_ps(f)) { }
+  explicit SrfftLanesFloat4(__m128 v): v(v) { }
+};
+inline SrfftLanesFloat4 operator + (SrfftLanesFloat4 a, SrfftLanesFloat4 b) {
+  return SrfftLanesFloat4(_mm_add_ps(a.v, b.v));
+}
+inline SrfftLanesFloat4 operator - (SrfftLanesFloat4 a, SrfftLanesFloat4 b) {
+  return SrfftLanesFloat4(_mm_sub_ps(a.v, b.v));
+}
+inline SrfftLanesFloat4 operator * (SrfftLanesFloat4 a, SrfftLanesFloat4 b) {
+  return SrfftLanesFloat4(_mm_mul_ps(a.v, b.v));
+}
+inline SrfftLanesFloat4 operator - (SrfftLanesFloat4 a) {
+  return SrfftLanesFloat4(_mm_xor_ps(a.v, _mm_set1_ps(-0.0f)));
+}
+
+struct SrfftLanesDouble2 {
+  __m128d v;
+  SrfftLanesDouble2() { }
+  SrfftLanesDouble2(double d): v(_mm_set1_pd(d)) { }
+  explicit SrfftLanesDouble2(__m128d v): v(v) { }
+};
+inline SrfftLanesDouble2 operator + (SrfftLanesDouble2 a, SrfftLanesDouble2 b) {
+  return SrfftLanesDouble2(_mm_add_pd(a.v, b.v));
+}
+inline SrfftLanesDouble2 operator - (SrfftLanesDouble2 a, SrfftLanesDouble2 b) {
+  return SrfftLanesDouble2(_mm_sub_pd(a.v, b.v));
+}
+inline SrfftLanesDouble2 operator * (SrfftLanesDouble2 a, SrfftLanesDouble2 b) {
+  return SrfftLanesDouble2(_mm_mul_pd(a.v, b.v));
+}
+inline SrfftLanesDouble2 operator - (SrfftLanesDouble2 a) {
+  return SrfftLanesDouble2(_mm_xor_pd(a.v, _mm_set1_pd(-0.0)));
+}
+
+// Does as many rows as it can in groups of 4 (float) or 2 (double), and
+// returns the number of rows done.
+static MatrixIndexT SrfftComputeRowsSse(const SrfftTables<float> &tables,
+                                        float *data, MatrixIndexT num_rows,
+                                        MatrixIndexT stride, bool forward,
+                                        void *buffer) {
+  MatrixIndexT r = 0;
+  for (; r + 4 <= num_rows; r += 4)
+    SrfftComputeRealLanes<float, SrfftLanesFloat4, 4>(
+        tables, data + r * stride, stride, forward,
+        static_cast<SrfftLanesFloat4*>(buffer));
+  return r;
+}
+
+static MatrixIndexT SrfftComputeRowsSse(const SrfftTables<double> &tables,
+                                        double *data, MatrixIndexT num_rows,
+                                        MatrixIndexT stride, bool forward,
+                                        void *buffer) {
+  MatrixIndexT r = 0;
+  for (; r + 2 <= num_rows; r += 2)
+    SrfftComputeRealLanes<double, SrfftLanesDouble2, 2>(
+        tables, data + r * stride, stride, forward,
+        static_cast<SrfftLanesDouble2*>(buffer));
+  return r;
+}
+#endif  // defined(__SSE2__)
+
+// Returns true if the CPU (and operating system) support AVX.
+static bool SrfftCpuHasAvx() {
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 8))
+  static bool has_avx = __builtin_cpu_supports("avx");
+  return has_avx;
+#else
+  return false;
+#endif
+}
+
+template<typename Real>
+void SplitRadixRealFft<Real>::Compute(MatrixBase<Real> *x, bool forward) const {
+  KALDI_ASSERT(x->NumCols() == N_);
+  MatrixIndexT num_rows = x->NumRows(), stride = x->Stride(), r = 0;
+  Real *data = x->Data();
+  if (num_rows > 1) {
+    // Space for N elements of the widest vector type (8 floats or 4 doubles).
+    void *buffer = NULL, *temp;
+    if ((buffer = KALDI_MEMALIGN(32, 32 * N_, &temp)) == NULL)
+      throw std::bad_alloc();
+    if (SrfftCpuHasAvx())
+      r = SrfftComputeRowsAvx(this->tables_, data, num_rows, stride, forward,
+                              buffer);
+#if defined(__SSE2__)
+    r += SrfftComputeRowsSse(this->tables_, data + r * stride, num_rows - r,
+                             stride, forward, buffer);
+#endif
+    KALDI_MEMALIGN_FREE(buffer);
   }
+  // Do the rest one at a time.
+  std::vector<Real> temp_buffer;
+  for (; r < num_rows; r++)
+    Compute(data + r * stride, forward, &temp_buffer);
 }
 
 template class SplitRadixComplexFft<float>;
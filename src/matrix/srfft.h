@@ -36,6 +36,21 @@ namespace kaldi {
 /// @{
 
 
+// The tables that the split-radix FFT of a particular size uses, which the
+// classes below compute in their constructors; for the code in srfft-inl.h.
+template<typename Real>
+struct SrfftTables {
+  MatrixIndexT N;  // The number of points (real points, for the real FFT).
+  MatrixIndexT logn;  // log2 of the number of points of the complex FFT.
+  const MatrixIndexT *brseed;  // Evans' seed table for the bit reversal.
+  Real *const *tab;  // Tables of butterfly coefficients.
+  // For the real FFT only: the complex factors exp(-2pi k/N) for the forward
+  // transform (index 0) and -exp(2pi k/N) for the backward transform (index
+  // 1), for k = 0 ... N/4.
+  const Real *twiddle_re[2];
+  const Real *twiddle_im[2];
+};
+
 // This class is based on code by Henrique (Rico) Malvar, from his book
 // "Signal Processing with Lapped Transforms" (1992).  Copied with
 // permission, optimized by Go Vivace Inc., and converted into C++ by
@@ -44,6 +59,7 @@ namespace kaldi {
 // (declared in matrix-functios.h), but it only works for powers of 2.
 // Note: in multi-threaded code, you would need to have one of these objects per
 // thread, because multiple calls to Compute in parallel would not work.
+
 template<typename Real>
 class SplitRadixComplexFft {
  public:
@@ -80,10 +96,11 @@ class SplitRadixComplexFft {
   // temp_buffer_ is allocated only if someone calls Compute with only one Real*
   // argument and we need a temporary buffer while creating interleaved data.
   std::vector<Real> temp_buffer_;
+
+  // Pointers to the tables below, for the code in srfft-inl.h.
+  SrfftTables<Real> tables_;
  private:
   void ComputeTables();
-  void ComputeRecursive(Real *xr, Real *xi, Integer logn) const;
-  void BitReversePermute(Real *x, Integer logn) const;
 
   Integer N_;
   Integer logn_;  // log(N)
@@ -100,8 +117,7 @@ class SplitRadixComplexFft {
 template<typename Real>
 class SplitRadixRealFft: private SplitRadixComplexFft<Real> {
  public:
-  SplitRadixRealFft(MatrixIndexT N):  // will fail unless N>=4 and N is a power of 2.
-      SplitRadixComplexFft<Real> (N/2), N_(N) { }
+  SplitRadixRealFft(MatrixIndexT N);  // will fail unless N>=4 and N is a power of 2.
   
   /// If forward == true, this function transforms from a sequence of N real points to its complex fourier
   /// transform; otherwise it goes in the reverse direction.  If you call it
@@ -117,9 +133,27 @@ class SplitRadixRealFft: private SplitRadixComplexFft<Real> {
   /// uses a user-supplied buffer.
   void Compute(Real *x, bool forward, std::vector<Real> *temp_buffer) const;
 
+  /// Does the transform of each row of "x" (which must have N columns), with
+  /// the same results as calling Compute() on each of them.  It does several
+  /// rows at a time, one in each lane of the SSE2 registers (four floats or two
+  /// doubles), or of the AVX registers (eight floats or four doubles) if the
+  /// CPU supports them, so it is a good deal faster than the single-row
+  /// version if there are many rows.  Like the version of Compute() with the
+  /// temp_buffer argument, it is const, so it may be called from several
+  /// threads at once.
+  void Compute(MatrixBase<Real> *x, bool forward) const;
+
+  /// Returns the number of points N.
+  MatrixIndexT Dim() const { return N_; }
+
+  ~SplitRadixRealFft();
+
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SplitRadixRealFft);  
   int N_;
+  // The factors for the real-FFT part of the computation, which the
+  // single-row version used to compute on the fly (see tables_.twiddle_re).
+  Real *twiddles_;
 };
 
 
@@ -106,6 +106,7 @@ void OnlineNnet2DecodingThreadedConfig::Check() {
   KALDI_ASSERT(max_loglikes_copy >= 0);
   KALDI_ASSERT(nnet_batch_size > 0);
   KALDI_ASSERT(decode_batch_size >= 1);
+  KALDI_ASSERT(determinize_period >= 0 && determinize_delay >= 0);
 }
 
 
@@ -316,7 +317,7 @@ void SingleUtteranceNnet2DecoderThreaded::GetAdaptationState(
 void SingleUtteranceNnet2DecoderThreaded::GetLattice(
     bool end_of_utterance,
     CompactLattice *clat,
-    BaseFloat *final_relative_cost) const {
+    BaseFloat *final_relative_cost) {
   clat->DeleteStates();
   // we'll make an exception to the normal const rules, for mutexes, since
   // we're not really changing the class.
@@ -329,12 +330,25 @@ void SingleUtteranceNnet2DecoderThreaded::GetLattice(
                    CompactLatticeWeight::One());
     return;
   }
+  if (!config_.decoder_opts.determinize_lattice) {
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
+  }
+  if (config_.determinize_period > 0) {
+    const CompactLattice *lat =
+        decoder_.GetLatticeIncremental(tmodel_, end_of_utterance);
+    if (lat != NULL) {
+      *clat = *lat;
+      // Connect() makes clat a deep copy; we do it while holding the lock
+      // since the decoding thread will modify the decoder's lattice.
+      fst::Connect(clat);
+    }
+    const_cast<Mutex&>(decoder_mutex_).Unlock();
+    return;
+  }
   Lattice raw_lat;
   decoder_.GetRawLattice(&raw_lat, end_of_utterance);
   const_cast<Mutex&>(decoder_mutex_).Unlock();
-  
-  if (!config_.decoder_opts.determinize_lattice)
-    KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
@@ -669,6 +683,12 @@ bool SingleUtteranceNnet2DecoderThreaded::RunDecoderSearchInternal() {
       decoder_mutex_.Lock();
       decoder_.AdvanceDecoding(&decodable_, config_.decode_batch_size);
       num_frames_decoded = decoder_.NumFramesDecoded();
+      if (config_.determinize_period > 0) {
+        int32 num_frames = num_frames_decoded - config_.determinize_delay;
+        if (num_frames - decoder_.NumFramesDeterminized() >=
+            config_.determinize_period)
+          decoder_.DeterminizeIncremental(tmodel_, num_frames);
+      }
       if (silence_weighting_.Active()) {
         silence_weighting_mutex_.Lock();
         // the next function does not trace back all the way; it's very fast.
@@ -148,6 +148,13 @@ struct OnlineNnet2DecodingThreadedConfig {
                             // before unlocking the mutex.  The only real cost
                             // here is a mutex lock/unlock, so it's OK to make
                             // this fairly small.
+  int32 determinize_period;  // if > 0, we determinize the lattice
+                             // incrementally while decoding, in chunks of at
+                             // least this many frames; see
+                             // LatticeFasterOnlineDecoder::DeterminizeIncremental().
+  int32 determinize_delay;  // the number of most recent frames that we leave
+                            // out of the incremental determinization, because
+                            // their tokens may still be pruned.
   
   OnlineNnet2DecodingThreadedConfig() {
     acoustic_scale = 0.1;
@@ -156,6 +163,8 @@ struct OnlineNnet2DecodingThreadedConfig {
     nnet_batch_size = 32;
     max_loglikes_copy = 20;
     decode_batch_size = 2;
+    determinize_period = 0;
+    determinize_delay = 25;
   }
 
   void Check();
@@ -174,6 +183,14 @@ struct OnlineNnet2DecodingThreadedConfig {
                  "setting, affects multi-threaded decoding.");
     po->Register("decode-batch-sie", &decode_batch_size, "Obscure "
                  "setting, affects multi-threaded decoding.");
+    po->Register("determinize-period", &determinize_period, "If >0, "
+                 "determinize the lattice incrementally during decoding, in "
+                 "chunks of at least this many frames, so that getting the "
+                 "lattice at the end of a long utterance is fast.");
+    po->Register("determinize-delay", &determinize_delay, "With "
+                 "--determinize-period > 0, the number of most recent frames "
+                 "that are not determinized yet, since their tokens may still "
+                 "be pruned.");
   }
 };
 
@@ -264,9 +281,11 @@ class SingleUtteranceNnet2DecoderThreaded {
   /// The output to final_relative_cost (if non-NULL) is a number >= 0 that's
   /// closer to 0 if a final-state was close to the best-likelihood state
   /// active on the last frame, at the time we obtained the lattice.
+  /// With --determinize-period > 0, only the frames that the decoding thread
+  /// has not yet determinized are determinized here.
   void GetLattice(bool end_of_utterance,
                   CompactLattice *clat,
-                  BaseFloat *final_relative_cost) const;
+                  BaseFloat *final_relative_cost);
   
   /// Outputs an FST corresponding to the single best path through the current
   /// lattice. If "use_final_probs" is true AND we reached the final-state of
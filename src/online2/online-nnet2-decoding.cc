@@ -39,6 +39,12 @@ SingleUtteranceNnet2Decoder::SingleUtteranceNnet2Decoder(
 
 void SingleUtteranceNnet2Decoder::AdvanceDecoding() {
   decoder_.AdvanceDecoding(&decodable_);
+  if (config_.determinize_period > 0) {
+    int32 num_frames = decoder_.NumFramesDecoded() - config_.determinize_delay;
+    if (num_frames - decoder_.NumFramesDeterminized() >=
+        config_.determinize_period)
+      decoder_.DeterminizeIncremental(tmodel_, num_frames);
+  }
 }
 
 void SingleUtteranceNnet2Decoder::FinalizeDecoding() {
@@ -50,15 +56,25 @@ int32 SingleUtteranceNnet2Decoder::NumFramesDecoded() const {
 }
 
 void SingleUtteranceNnet2Decoder::GetLattice(bool end_of_utterance,
-                                             CompactLattice *clat) const {
+                                             CompactLattice *clat) {
   if (NumFramesDecoded() == 0)
     KALDI_ERR << "You cannot get a lattice if you decoded no frames.";
-  Lattice raw_lat;
-  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
-
   if (!config_.decoder_opts.determinize_lattice)
     KALDI_ERR << "--determinize-lattice=false option is not supported at the moment";
 
+  if (config_.determinize_period > 0) {
+    const CompactLattice *lat =
+        decoder_.GetLatticeIncremental(tmodel_, end_of_utterance);
+    if (lat == NULL)
+      clat->DeleteStates();
+    else
+      *clat = *lat;
+    fst::Connect(clat);
+    return;
+  }
+  Lattice raw_lat;
+  decoder_.GetRawLattice(&raw_lat, end_of_utterance);
+
   BaseFloat lat_beam = config_.decoder_opts.lattice_beam;
   DeterminizeLatticePhonePrunedWrapper(
       tmodel_, &raw_lat, lat_beam, clat, config_.decoder_opts.det_opts);
@@ -51,12 +51,30 @@ struct OnlineNnet2DecodingConfig {
   
   LatticeFasterDecoderConfig decoder_opts;
   nnet2::DecodableNnet2OnlineOptions decodable_opts;
+
+  // If > 0, we determinize the lattice incrementally while decoding, in
+  // chunks of at least this many frames; see
+  // LatticeFasterOnlineDecoder::DeterminizeIncremental().
+  int32 determinize_period;
+  // The number of most recent frames that we leave out of the incremental
+  // determinization, because their tokens may still be pruned.
+  int32 determinize_delay;
   
-  OnlineNnet2DecodingConfig() {  decodable_opts.acoustic_scale = 0.1; }
+  OnlineNnet2DecodingConfig(): determinize_period(0), determinize_delay(25) {
+    decodable_opts.acoustic_scale = 0.1;
+  }
   
   void Register(OptionsItf *po) {
     decoder_opts.Register(po);
     decodable_opts.Register(po);
+    po->Register("determinize-period", &determinize_period, "If >0, "
+                 "determinize the lattice incrementally during decoding, in "
+                 "chunks of at least this many frames, so that getting the "
+                 "lattice at the end of a long utterance is fast.");
+    po->Register("determinize-delay", &determinize_delay, "With "
+                 "--determinize-period > 0, the number of most recent frames "
+                 "that are not determinized yet, since their tokens may still "
+                 "be pruned.");
   }
 };
 
@@ -88,9 +106,10 @@ class SingleUtteranceNnet2Decoder {
   /// (which will typically be desirable in an online-decoding context); if you
   /// want an un-scaled lattice, scale it using ScaleLattice() with the inverse
   /// of the acoustic weight.  "end_of_utterance" will be true if you want the
-  /// final-probs to be included.
+  /// final-probs to be included.  With --determinize-period > 0 this does
+  /// not determinize the whole lattice, but it still copies it.
   void GetLattice(bool end_of_utterance,
-                  CompactLattice *clat) const;
+                  CompactLattice *clat);
   
   /// Outputs an FST corresponding to the single best path through the current
   /// lattice. If "use_final_probs" is true AND we reached the final-state of
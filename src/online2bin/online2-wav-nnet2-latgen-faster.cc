@@ -160,7 +160,7 @@ int main(int argc, char *argv[]) {
       nnet.Read(ki.Stream(), binary);
     }
     
-    fst::Fst<fst::StdArc> *decode_fst = ReadFstKaldi(fst_rxfilename);
+    fst::Fst<fst::StdArc> *decode_fst = fst::ReadDecodingGraph(fst_rxfilename);
     
     fst::SymbolTable *word_syms = NULL;
     if (word_syms_rxfilename != "")
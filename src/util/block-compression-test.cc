@@ -0,0 +1,181 @@
+// util/block-compression-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/block-compression.h"
+#include "util/kaldi-io.h"
+#include <fstream>
+#include <iostream>
+#include <unistd.h>
+
+namespace kaldi {
+
+// Returns random data of the given size, of one of several kinds that are more
+// or less compressible.
+static std::string RandomData(size_t size) {
+  std::string ans(size, ' ');
+  int32 kind = Rand() % 4;
+  for (size_t i = 0; i < size; i++) {
+    switch (kind) {
+      case 0: ans[i] = Rand() % 256; break;  // incompressible.
+      case 1: ans[i] = 0; break;
+      case 2: ans[i] = 'a' + Rand() % 3; break;
+      default:  // repeats of a random string, with some changes.
+        ans[i] = (i < 100 || Rand() % 50 == 0 ? Rand() % 256 :
+                  ans[i - 1 - i % 100]);
+    }
+  }
+  return ans;
+}
+
+void TestBlockCompress() {
+  size_t size = (Rand() % 2 == 0 ? Rand() % 100 :
+                 Rand() % (kCompressedFileBlockSize + 1));
+  std::string data = RandomData(size), output(size + 1, 'x');
+  std::vector<char> compressed(BlockCompressBound(size));
+  size_t compressed_size = BlockCompress(data.data(), size, &(compressed[0]));
+  KALDI_ASSERT(compressed_size <= compressed.size());
+  KALDI_ASSERT(BlockDecompress(&(compressed[0]), compressed_size,
+                               &(output[0]), size));
+  KALDI_ASSERT(output.substr(0, size) == data && output[size] == 'x');
+  // Wrong sizes and truncated input must be detected.
+  KALDI_ASSERT(!BlockDecompress(&(compressed[0]), compressed_size,
+                                &(output[0]), size + 1));
+  if (size > 0)
+    KALDI_ASSERT(!BlockDecompress(&(compressed[0]), compressed_size - 1,
+                                  &(output[0]), size));
+  // Corrupted input must not crash.
+  compressed[Rand() % compressed_size] = Rand() % 256;
+  BlockDecompress(&(compressed[0]), compressed_size, &(output[0]), size);
+}
+
+void TestBlockCompressedFile(bool close_properly) {
+  int32 num_pieces = Rand() % 50;
+  std::vector<std::string> pieces;
+  std::vector<int64> offsets;
+  {
+    Output ko("tmpf.kz", true, false);
+    for (int32 i = 0; i < num_pieces; i++) {
+      pieces.push_back(RandomData(Rand() % 2 == 0 ? Rand() % 20 :
+                                  Rand() % 20000));
+      offsets.push_back(ko.Stream().tellp());
+      ko.Stream() << pieces.back();
+      if (Rand() % 10 == 0) ko.Stream().flush();
+    }
+    if (close_properly) {
+      KALDI_ASSERT(ko.Close());
+    } else {
+      ko.Stream().flush();
+      // Simulate the program dying before Close(): copy the file as it is.
+      std::ifstream is("tmpf.kz", std::ios_base::in | std::ios_base::binary);
+      std::ofstream os("tmpf2.kz", std::ios_base::out | std::ios_base::binary);
+      os << is.rdbuf();
+    }
+  }
+  const char *filename = (close_properly ? "tmpf.kz" : "tmpf2.kz");
+  // Read it all.
+  {
+    Input ki(filename);
+    std::string all;
+    for (int32 i = 0; i < num_pieces; i++) all += pieces[i];
+    std::string read_back((std::istreambuf_iterator<char>(ki.Stream())),
+                          std::istreambuf_iterator<char>());
+    KALDI_ASSERT(read_back == all);
+  }
+  // Read the pieces in random order through offsets.
+  Input ki;
+  for (int32 n = 0; n < num_pieces; n++) {
+    int32 i = Rand() % num_pieces;
+    std::ostringstream rxfilename;
+    rxfilename << filename << ':' << offsets[i];
+    KALDI_ASSERT(ki.Open(rxfilename.str()));
+    KALDI_ASSERT(ki.Stream().tellg() == std::streampos(offsets[i]));
+    std::string piece(pieces[i].size(), ' ');
+    if (!piece.empty())
+      KALDI_ASSERT(ki.Stream().read(&(piece[0]), piece.size()));
+    KALDI_ASSERT(piece == pieces[i]);
+  }
+  unlink("tmpf.kz");
+  unlink("tmpf2.kz");
+}
+
+
+// Changes the int64 at "offset" in the file (or, if offset is negative, at
+// that many bytes from the end), in the little-endian format of the index.
+static void SetInt64InFile(const std::string &filename, int64 offset,
+                           int64 value) {
+  std::fstream fs(filename.c_str(), std::ios_base::in | std::ios_base::out |
+                  std::ios_base::binary);
+  fs.seekp(offset, offset < 0 ? std::ios_base::end : std::ios_base::beg);
+  for (int32 i = 0; i < 8; i++, value >>= 8)
+    fs.put(static_cast<char>(value & 255));
+}
+
+// Reads the int64 at "offset" from the end of the file.
+static int64 GetInt64FromFile(const std::string &filename, int64 offset) {
+  std::ifstream is(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  is.seekg(offset, std::ios_base::end);
+  uint64 ans = 0;
+  char buf[8];
+  is.read(buf, 8);
+  for (int32 i = 7; i >= 0; i--)
+    ans = (ans << 8) | static_cast<unsigned char>(buf[i]);
+  return static_cast<int64>(ans);
+}
+
+// A corrupted index must make Open() fail, not crash later on a seek.
+void TestCorruptedIndex() {
+  std::string data = RandomData(1 + Rand() % 200000);
+  for (int32 n = 0; n < 2; n++) {
+    {
+      Output ko("tmpf.kz", true, false);
+      ko.Stream() << data;
+      KALDI_ASSERT(ko.Close());
+    }
+    // The footer is num_blocks, index_offset, uncompressed_size, magic.
+    int64 num_blocks = GetInt64FromFile("tmpf.kz", -32),
+        index_offset = GetInt64FromFile("tmpf.kz", -24);
+    KALDI_ASSERT(num_blocks > 0);
+    if (n == 0) {
+      // The first block does not start at offset zero.
+      SetInt64InFile("tmpf.kz", index_offset, 1);
+    } else {
+      // No blocks, but nonzero size.
+      SetInt64InFile("tmpf.kz", -32, 0);
+      SetInt64InFile("tmpf.kz", -24, index_offset + 16 * num_blocks);
+    }
+    Input ki;
+    KALDI_ASSERT(!ki.Open("tmpf.kz:10"));
+  }
+  unlink("tmpf.kz");
+}
+
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 100; i++)
+    TestBlockCompress();
+  for (int32 i = 0; i < 10; i++)
+    TestBlockCompressedFile(i % 2 == 0);
+  TestCorruptedIndex();
+  std::cout << "Test OK.\n";
+}
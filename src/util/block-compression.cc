@@ -0,0 +1,477 @@
+// util/block-compression.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include "util/block-compression.h"
+
+
+namespace kaldi {
+
+static const char *kBlockCompressedMagic = "KaldiKz1";
+static const char *kBlockCompressedIndexMagic = "KzIndex1";
+static const size_t kBlockHeaderSize = 8;  // two uint32's.
+static const size_t kBlockFooterSize = 32;  // three int64's and the magic.
+
+// The compressed data is a sequence of "sequences", each of which is a run of
+// literal bytes followed by a match (a copy of earlier output); the last
+// sequence has no match.  A sequence is:
+//   token             one byte: the high 4 bits are the literal length and
+//                     the low 4 bits the match length minus kMinMatch; a value
+//                     of 15 means more length bytes follow.
+//   [literal length]  if 15 in the token, bytes to add, until one is not 255.
+//   literals
+//   offset            2 bytes (little-endian): the match starts this many
+//                     bytes back in the output.
+//   [match length]    as for the literal length.
+static const size_t kMinMatch = 4;
+static const int kHashLog = 14;
+// Matches may not start in the last kMatchStartMargin bytes of the input, or
+// extend into the last kMatchEndMargin bytes (this keeps the search loop
+// simple; the compression loss is negligible).
+static const size_t kMatchStartMargin = 12;
+static const size_t kMatchEndMargin = 5;
+
+static inline uint32 Read32(const unsigned char *p) {
+  uint32 ans;
+  memcpy(&ans, p, 4);
+  return ans;
+}
+
+static inline uint32 HashSequence(uint32 v) {
+  return (v * 2654435761U) >> (32 - kHashLog);
+}
+
+static inline unsigned char *WriteLength(unsigned char *op, size_t length) {
+  for (; length >= 255; length -= 255)
+    *op++ = 255;
+  *op++ = static_cast<unsigned char>(length);
+  return op;
+}
+
+// Reads the extra bytes of a length; returns false if we run out of input.
+static inline bool ReadLength(const unsigned char **ip,
+                              const unsigned char *end, size_t *length) {
+  unsigned char b;
+  do {
+    if (*ip >= end) return false;
+    b = *((*ip)++);
+    *length += b;
+  } while (b == 255);
+  return true;
+}
+
+static inline unsigned char *WriteLiterals(unsigned char *op,
+                                           const unsigned char *literals,
+                                           size_t num_literals,
+                                           size_t match_code) {
+  *op++ = static_cast<unsigned char>(
+      (std::min<size_t>(num_literals, 15) << 4) | match_code);
+  if (num_literals >= 15)
+    op = WriteLength(op, num_literals - 15);
+  memcpy(op, literals, num_literals);
+  return op + num_literals;
+}
+
+size_t BlockCompress(const char *input, size_t size, char *output) {
+  KALDI_ASSERT(size <= kCompressedFileBlockSize);
+  const unsigned char *in = reinterpret_cast<const unsigned char*>(input),
+      *end = in + size, *ip = in, *anchor = in,
+      *match_start_limit = (size > kMatchStartMargin ?
+                            end - kMatchStartMargin : in),
+      *match_end_limit = (size > kMatchEndMargin ? end - kMatchEndMargin : in);
+  unsigned char *op = reinterpret_cast<unsigned char*>(output);
+  // Positions in the input (which are less than 2^16) of the last sequence of
+  // kMinMatch bytes with each hash value.  Zero-initialized entries are
+  // harmless, because we check that the bytes actually match.
+  uint16 table[1 << kHashLog];
+  memset(table, 0, sizeof(table));
+
+  while (ip < match_start_limit) {
+    uint32 v = Read32(ip), h = HashSequence(v);
+    const unsigned char *ref = in + table[h];
+    table[h] = static_cast<uint16>(ip - in);
+    if (ref >= ip || Read32(ref) != v) {
+      ip++;
+      continue;
+    }
+    while (ip > anchor && ref > in && ip[-1] == ref[-1]) {  // extend backward.
+      ip--;
+      ref--;
+    }
+    const unsigned char *match_end = ip + kMinMatch;
+    while (match_end < match_end_limit && *match_end == ref[match_end - ip])
+      match_end++;
+    size_t offset = ip - ref, match_length = match_end - ip - kMinMatch;
+    op = WriteLiterals(op, anchor, ip - anchor,
+                       std::min<size_t>(match_length, 15));
+    *op++ = static_cast<unsigned char>(offset & 255);
+    *op++ = static_cast<unsigned char>(offset >> 8);
+    if (match_length >= 15)
+      op = WriteLength(op, match_length - 15);
+    ip = anchor = match_end;
+  }
+  op = WriteLiterals(op, anchor, end - anchor, 0);
+  return op - reinterpret_cast<unsigned char*>(output);
+}
+
+bool BlockDecompress(const char *input, size_t input_size,
+                     char *output, size_t output_size) {
+  const unsigned char *ip = reinterpret_cast<const unsigned char*>(input),
+      *in_end = ip + input_size;
+  unsigned char *out = reinterpret_cast<unsigned char*>(output),
+      *op = out, *out_end = out + output_size;
+  while (ip < in_end) {
+    size_t token = *ip++, num_literals = token >> 4;
+    if (num_literals == 15 && !ReadLength(&ip, in_end, &num_literals))
+      return false;
+    if (num_literals > static_cast<size_t>(in_end - ip) ||
+        num_literals > static_cast<size_t>(out_end - op))
+      return false;
+    memcpy(op, ip, num_literals);
+    op += num_literals;
+    ip += num_literals;
+    if (ip == in_end) break;  // The last sequence has no match.
+    if (in_end - ip < 2) return false;
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !ReadLength(&ip, in_end, &match_length))
+      return false;
+    match_length += kMinMatch;
+    if (offset == 0 || offset > static_cast<size_t>(op - out) ||
+        match_length > static_cast<size_t>(out_end - op))
+      return false;
+    // The source and destination may overlap (offset < match_length), which
+    // repeats the last "offset" bytes; so we copy byte by byte.
+    const unsigned char *ref = op - offset;
+    for (size_t i = 0; i < match_length; i++)
+      op[i] = ref[i];
+    op += match_length;
+  }
+  return (op == out_end);
+}
+
+bool IsBlockCompressedFilename(const std::string &filename) {
+  size_t len = filename.size();
+  return (len > 3 && filename.compare(len - 3, 3, ".kz") == 0);
+}
+
+
+static inline void PutUint32(uint32 v, char *p) {
+  for (int i = 0; i < 4; i++, v >>= 8)
+    p[i] = static_cast<char>(v & 255);
+}
+
+static inline void PutInt64(int64 n, char *p) {
+  uint64 v = static_cast<uint64>(n);
+  for (int i = 0; i < 8; i++, v >>= 8)
+    p[i] = static_cast<char>(v & 255);
+}
+
+static inline uint32 GetUint32(const char *p) {
+  uint32 ans = 0;
+  for (int i = 3; i >= 0; i--)
+    ans = (ans << 8) | static_cast<unsigned char>(p[i]);
+  return ans;
+}
+
+static inline int64 GetInt64(const char *p) {
+  uint64 ans = 0;
+  for (int i = 7; i >= 0; i--)
+    ans = (ans << 8) | static_cast<unsigned char>(p[i]);
+  return static_cast<int64>(ans);
+}
+
+
+BlockCompressedOutputBuf::BlockCompressedOutputBuf():
+    buffer_(kCompressedFileBlockSize),
+    compressed_(BlockCompressBound(kCompressedFileBlockSize)),
+    uncompressed_offset_(0), file_offset_(0) { }
+
+bool BlockCompressedOutputBuf::Open(const std::string &filename) {
+  if (IsOpen())
+    KALDI_ERR << "BlockCompressedOutputBuf::Open(), already open.";
+  os_.open(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+  if (!os_.is_open()) return false;
+  os_.write(kBlockCompressedMagic, 8);
+  file_offset_ = 8;
+  uncompressed_offset_ = 0;
+  blocks_.clear();
+  setp(&(buffer_[0]), &(buffer_[0]) + buffer_.size());
+  return os_.good();
+}
+
+void BlockCompressedOutputBuf::WriteBlock() {
+  size_t size = pptr() - pbase();
+  if (size == 0) return;
+  const char *data = &(compressed_[0]);
+  size_t stored_size = BlockCompress(pbase(), size, &(compressed_[0]));
+  if (stored_size >= size) {  // Incompressible: store it as is.
+    data = pbase();
+    stored_size = size;
+  }
+  char header[kBlockHeaderSize];
+  PutUint32(size, header);
+  PutUint32(stored_size, header + 4);
+  os_.write(header, kBlockHeaderSize);
+  os_.write(data, stored_size);
+  blocks_.push_back(std::make_pair(uncompressed_offset_, file_offset_));
+  uncompressed_offset_ += size;
+  file_offset_ += kBlockHeaderSize + stored_size;
+  setp(&(buffer_[0]), &(buffer_[0]) + buffer_.size());
+}
+
+BlockCompressedOutputBuf::int_type BlockCompressedOutputBuf::overflow(
+    int_type c) {
+  WriteBlock();
+  if (!os_.good()) return traits_type::eof();
+  if (!traits_type::eq_int_type(c, traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int BlockCompressedOutputBuf::sync() {
+  // Note: this writes a (possibly short) block, so flushing after every
+  // small write will make the compression worse.
+  WriteBlock();
+  os_.flush();
+  return (os_.good() ? 0 : -1);
+}
+
+BlockCompressedOutputBuf::pos_type BlockCompressedOutputBuf::seekoff(
+    off_type off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+  if (off == 0 && way == std::ios_base::cur && (which & std::ios_base::out))
+    return pos_type(uncompressed_offset_ + (pptr() - pbase()));
+  return pos_type(off_type(-1));  // We can't seek.
+}
+
+bool BlockCompressedOutputBuf::Close() {
+  if (!IsOpen())
+    KALDI_ERR << "BlockCompressedOutputBuf::Close(), not open.";
+  WriteBlock();
+  std::vector<char> index(blocks_.size() * 16 + kBlockFooterSize);
+  char *p = &(index[0]);
+  for (size_t i = 0; i < blocks_.size(); i++, p += 16) {
+    PutInt64(blocks_[i].first, p);
+    PutInt64(blocks_[i].second, p + 8);
+  }
+  PutInt64(blocks_.size(), p);
+  PutInt64(file_offset_, p + 8);
+  PutInt64(uncompressed_offset_, p + 16);
+  memcpy(p + 24, kBlockCompressedIndexMagic, 8);
+  os_.write(&(index[0]), index.size());
+  os_.close();
+  blocks_.clear();
+  setp(NULL, NULL);
+  return !os_.fail();
+}
+
+BlockCompressedOutputBuf::~BlockCompressedOutputBuf() {
+  if (IsOpen()) Close();  // the Output class checks the status.
+}
+
+
+BlockCompressedInputBuf::BlockCompressedInputBuf():
+    buffer_(kCompressedFileBlockSize),
+    compressed_(BlockCompressBound(kCompressedFileBlockSize)),
+    current_block_(0), next_block_(0), uncompressed_size_(0) { }
+
+bool BlockCompressedInputBuf::Open(const std::string &filename) {
+  Close();
+  is_.open(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!is_.is_open()) return false;
+  char magic[8];
+  if (!is_.read(magic, 8) || memcmp(magic, kBlockCompressedMagic, 8) != 0) {
+    KALDI_WARN << "File " << filename << " is not in the block-compressed "
+               << "format (files whose names end in .kz must be).";
+    Close();
+    return false;
+  }
+  if (!ReadIndex(filename)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+bool BlockCompressedInputBuf::ReadIndex(const std::string &filename) {
+  is_.seekg(0, std::ios_base::end);
+  int64 file_size = is_.tellg();
+  if (file_size >= static_cast<int64>(8 + kBlockFooterSize)) {
+    char footer[kBlockFooterSize];
+    is_.seekg(file_size - kBlockFooterSize);
+    if (is_.read(footer, kBlockFooterSize) &&
+        memcmp(footer + 24, kBlockCompressedIndexMagic, 8) == 0) {
+      int64 num_blocks = GetInt64(footer), index_offset = GetInt64(footer + 8);
+      uncompressed_size_ = GetInt64(footer + 16);
+      if (num_blocks < 0 || num_blocks > file_size / 16 || index_offset < 8 ||
+          uncompressed_size_ < 0 ||
+          (num_blocks == 0 && uncompressed_size_ > 0) ||
+          index_offset + 16 * num_blocks + static_cast<int64>(kBlockFooterSize)
+          != file_size) {
+        KALDI_WARN << "Corrupted index in block-compressed file " << filename;
+        return false;
+      }
+      std::vector<char> index(16 * num_blocks + 1);
+      is_.seekg(index_offset);
+      if (!is_.read(&(index[0]), 16 * num_blocks)) {
+        KALDI_WARN << "Error reading index of block-compressed file "
+                   << filename;
+        return false;
+      }
+      blocks_.resize(num_blocks);
+      // The blocks must cover the data from offset zero, in order, and lie
+      // between the magic and the index; seekpos() relies on this.
+      for (int64 i = 0; i < num_blocks; i++) {
+        blocks_[i].first = GetInt64(&(index[16 * i]));
+        blocks_[i].second = GetInt64(&(index[16 * i + 8]));
+        if (blocks_[i].first >= uncompressed_size_ ||
+            (i == 0 && blocks_[i].first != 0) ||
+            (i > 0 && blocks_[i].first <= blocks_[i-1].first) ||
+            blocks_[i].second < 8 || blocks_[i].second >= index_offset ||
+            (i > 0 && blocks_[i].second <= blocks_[i-1].second)) {
+          KALDI_WARN << "Corrupted index in block-compressed file "
+                     << filename;
+          return false;
+        }
+      }
+      return true;
+    }
+  }
+  // There is no index, probably because the writer did not finish; find the
+  // blocks from their headers, stopping at the first one that is incomplete.
+  KALDI_WARN << "Block-compressed file " << filename << " has no index "
+             << "(it may be truncated); scanning it.";
+  is_.clear();
+  int64 file_offset = 8;
+  uncompressed_size_ = 0;
+  char header[kBlockHeaderSize];
+  while (file_offset + static_cast<int64>(kBlockHeaderSize) <= file_size) {
+    is_.seekg(file_offset);
+    if (!is_.read(header, kBlockHeaderSize)) break;
+    uint32 size = GetUint32(header), stored_size = GetUint32(header + 4);
+    if (size == 0 || size > kCompressedFileBlockSize ||
+        stored_size > BlockCompressBound(size) ||
+        file_offset + kBlockHeaderSize + stored_size > file_size)
+      break;
+    blocks_.push_back(std::make_pair(uncompressed_size_, file_offset));
+    uncompressed_size_ += size;
+    file_offset += kBlockHeaderSize + stored_size;
+  }
+  is_.clear();
+  return true;
+}
+
+bool BlockCompressedInputBuf::LoadBlock(size_t b) {
+  KALDI_ASSERT(b < blocks_.size());
+  int64 expected_size = (b + 1 < blocks_.size() ? blocks_[b+1].first :
+                         uncompressed_size_) - blocks_[b].first;
+  char header[kBlockHeaderSize];
+  is_.clear();
+  is_.seekg(blocks_[b].second);
+  bool ok = static_cast<bool>(is_.read(header, kBlockHeaderSize));
+  uint32 size = GetUint32(header), stored_size = GetUint32(header + 4);
+  if (ok && size == expected_size && stored_size == size) {
+    ok = static_cast<bool>(is_.read(&(buffer_[0]), size));
+  } else if (ok && size == expected_size &&
+             stored_size <= BlockCompressBound(size)) {
+    ok = is_.read(&(compressed_[0]), stored_size) &&
+        BlockDecompress(&(compressed_[0]), stored_size, &(buffer_[0]), size);
+  } else {
+    ok = false;
+  }
+  if (!ok) {
+    KALDI_WARN << "Error reading block " << b << " of block-compressed file.";
+    setg(NULL, NULL, NULL);
+    next_block_ = blocks_.size();  // Stop reading.
+    return false;
+  }
+  setg(&(buffer_[0]), &(buffer_[0]), &(buffer_[0]) + size);
+  current_block_ = b;
+  next_block_ = b + 1;
+  return true;
+}
+
+int64 BlockCompressedInputBuf::Tell() const {
+  if (eback() != NULL)
+    return blocks_[current_block_].first + (gptr() - eback());
+  else if (next_block_ < blocks_.size())
+    return blocks_[next_block_].first;
+  else
+    return uncompressed_size_;
+}
+
+BlockCompressedInputBuf::int_type BlockCompressedInputBuf::underflow() {
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (next_block_ >= blocks_.size() || !LoadBlock(next_block_))
+    return traits_type::eof();
+  return traits_type::to_int_type(*gptr());
+}
+
+BlockCompressedInputBuf::pos_type BlockCompressedInputBuf::seekoff(
+    off_type off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+  off_type base;
+  if (way == std::ios_base::beg) base = 0;
+  else if (way == std::ios_base::cur) base = Tell();
+  else base = uncompressed_size_;
+  return seekpos(pos_type(base + off), which);
+}
+
+BlockCompressedInputBuf::pos_type BlockCompressedInputBuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  int64 offset = static_cast<off_type>(pos);
+  if (!(which & std::ios_base::in) || !IsOpen() || offset < 0 ||
+      offset > uncompressed_size_)
+    return pos_type(off_type(-1));
+  if (offset == uncompressed_size_) {  // the end.
+    setg(NULL, NULL, NULL);
+    next_block_ = blocks_.size();
+    return pos;
+  }
+  // Find the last block that starts at or before "offset".
+  std::vector<std::pair<int64, int64> >::const_iterator iter =
+      std::upper_bound(blocks_.begin(), blocks_.end(),
+                       std::make_pair(offset, std::numeric_limits<int64>::max()));
+  if (iter == blocks_.begin())  // can't happen unless the index is wrong.
+    return pos_type(off_type(-1));
+  size_t b = (iter - blocks_.begin()) - 1;
+  if (eback() == NULL || current_block_ != b)
+    if (!LoadBlock(b))
+      return pos_type(off_type(-1));
+  setg(eback(), eback() + (offset - blocks_[b].first), egptr());
+  next_block_ = b + 1;
+  return pos;
+}
+
+void BlockCompressedInputBuf::Close() {
+  if (is_.is_open()) is_.close();
+  is_.clear();
+  blocks_.clear();
+  setg(NULL, NULL, NULL);
+  current_block_ = 0;
+  next_block_ = 0;
+  uncompressed_size_ = 0;
+}
+
+}  // namespace kaldi
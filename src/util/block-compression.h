@@ -0,0 +1,181 @@
+// util/block-compression.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_BLOCK_COMPRESSION_H_
+#define KALDI_UTIL_BLOCK_COMPRESSION_H_
+
+#include <fstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+namespace kaldi {
+
+/// \addtogroup io_group
+/// @{
+
+/*
+  This file implements a fast compression codec (an LZ77 variant in the style
+  of LZ4: no entropy coding, so decompression runs at close to memory speed)
+  and a block-compressed file format built on it.  Files whose names end in
+  ".kz" are read and written in this format by the Input and Output classes
+  (see kaldi-io.h), so e.g. "ark,scp:foo.ark.kz,foo.scp" writes a compressed
+  archive, and the offsets in foo.scp still work.
+
+  The file is a sequence of independently compressed blocks of at most
+  kCompressedFileBlockSize bytes of uncompressed data, followed by an index
+  that gives, for each block, its offset in the uncompressed data and in the
+  file.  Offsets into the file (e.g. in scp files, "foo.ark.kz:12345") refer to
+  the uncompressed data; seeking to one means decompressing just the block
+  that contains it.  All the integers are little-endian.  The format is:
+
+    "KaldiKz1"                        8-byte magic string.
+    for each block:
+      uint32 uncompressed size
+      uint32 stored size              if equal to the uncompressed size, the
+                                      block was incompressible and is stored
+                                      as is.
+      the stored data
+    for each block:
+      int64 offset in the uncompressed data
+      int64 offset in the file (of the block's header)
+    int64 number of blocks
+    int64 offset in the file of the index
+    int64 total uncompressed size
+    "KzIndex1"                        8-byte magic string.
+
+  If the file was not closed properly (so the index is missing), the reader
+  finds the blocks by reading their headers, and warns.
+*/
+
+/// The maximum number of bytes of uncompressed data per block; matches are
+/// never further back than this, so offsets fit in 16 bits.
+static const size_t kCompressedFileBlockSize = 65535;
+
+/// Returns the maximum size of the output of BlockCompress() for input of size
+/// "size".
+inline size_t BlockCompressBound(size_t size) { return size + size / 255 + 16; }
+
+/// Compresses "size" bytes from "input" into "output", which must have space
+/// for BlockCompressBound(size) bytes.  "size" must be at most
+/// kCompressedFileBlockSize.  Returns the compressed size.
+size_t BlockCompress(const char *input, size_t size, char *output);
+
+/// Decompresses "input_size" bytes from "input" (the output of
+/// BlockCompress()) into "output", which must have exactly "output_size"
+/// bytes.  Returns false if the data is corrupted (it never reads or writes
+/// outside the buffers).
+bool BlockDecompress(const char *input, size_t input_size,
+                     char *output, size_t output_size);
+
+/// Returns true if "filename" ends in ".kz", i.e. if the Input and Output
+/// classes would read or write it in the block-compressed format.
+bool IsBlockCompressedFilename(const std::string &filename);
+
+
+/// A std::streambuf that writes a block-compressed file.
+class BlockCompressedOutputBuf: public std::streambuf {
+ public:
+  BlockCompressedOutputBuf();
+
+  /// Opens the file "filename" (an actual filename) for writing.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() const { return os_.is_open(); }
+
+  /// Writes any buffered data and the index, and closes the file.  Returns
+  /// false on error.
+  bool Close();
+
+  ~BlockCompressedOutputBuf();
+
+ protected:
+  virtual int_type overflow(int_type c);
+  virtual int sync();
+  // Only supports getting the current position (i.e. tellp()), which is the
+  // position in the uncompressed data.
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir way,
+                           std::ios_base::openmode which);
+
+ private:
+  // Compresses and writes the data in buffer_ as a new block.
+  void WriteBlock();
+
+  std::ofstream os_;
+  std::vector<char> buffer_;  // Uncompressed data of the current block.
+  std::vector<char> compressed_;
+  int64 uncompressed_offset_;  // Uncompressed offset of the start of buffer_.
+  int64 file_offset_;  // Current size of the file.
+  // The index: uncompressed and file offsets of each block.
+  std::vector<std::pair<int64, int64> > blocks_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BlockCompressedOutputBuf);
+};
+
+
+/// A std::streambuf that reads a block-compressed file, and supports seeking
+/// to any position in the uncompressed data.
+class BlockCompressedInputBuf: public std::streambuf {
+ public:
+  BlockCompressedInputBuf();
+
+  /// Opens the file "filename" (an actual filename) for reading, and reads
+  /// its index.  Returns false (with a warning if it was not just that it
+  /// could not be opened) on error.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() const { return is_.is_open(); }
+
+  void Close();
+
+ protected:
+  virtual int_type underflow();
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir way,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+ private:
+  // Reads the index at the end of the file, or if it's not there, scans the
+  // block headers.  Returns false if the file is corrupted.
+  bool ReadIndex(const std::string &filename);
+
+  // Reads and decompresses block b into buffer_ and sets the get area to it.
+  // Returns false on error.
+  bool LoadBlock(size_t b);
+
+  // Returns the current position in the uncompressed data.
+  int64 Tell() const;
+
+  std::ifstream is_;
+  std::vector<char> buffer_;  // Uncompressed data of the current block.
+  std::vector<char> compressed_;
+  size_t current_block_;  // The block in buffer_, if eback() != NULL.
+  size_t next_block_;  // The block underflow() will load next.
+  int64 uncompressed_size_;
+  // Uncompressed and file offsets of each block.
+  std::vector<std::pair<int64, int64> > blocks_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(BlockCompressedInputBuf);
+};
+
+/// @} end "addtogroup io_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_BLOCK_COMPRESSION_H_
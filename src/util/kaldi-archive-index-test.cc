@@ -0,0 +1,96 @@
+// util/kaldi-archive-index-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+
+#include "util/kaldi-archive-index.h"
+#include <fstream>
+#include <set>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <utime.h>
+
+namespace kaldi {
+
+// Writes a file of "size" bytes, standing in for the archive.
+static void WriteDummyArchive(const std::string &filename, int64 size) {
+  std::ofstream os(filename.c_str(), std::ios_base::out | std::ios_base::binary);
+  for (int64 i = 0; i < size; i++)
+    os.put('x');
+}
+
+void TestArchiveIndex() {
+  int32 num_keys = Rand() % 200;
+  std::vector<ArchiveIndexEntry> entries;
+  int64 offset = 0;
+  for (int32 i = 0; i < num_keys; i++) {
+    std::ostringstream os;
+    os << "utt" << (Rand() % 1000);
+    int64 length = 1 + Rand() % 1000;
+    entries.push_back(ArchiveIndexEntry(os.str(), offset + os.str().size() + 1,
+                                        length));
+    offset += os.str().size() + 1 + length;
+  }
+  WriteDummyArchive("tmpf", offset);
+  // The size we give must match the archive.
+  KALDI_ASSERT(!WriteArchiveIndex(ArchiveIndexFilename("tmpf"), "tmpf",
+                                  offset + 1, entries));
+  KALDI_ASSERT(WriteArchiveIndex(ArchiveIndexFilename("tmpf"), "tmpf",
+                                 offset, entries));
+
+  ArchiveIndex index;
+  KALDI_ASSERT(index.Open(ArchiveIndexFilename("tmpf"), "tmpf"));
+  // The keys may repeat; the first of each should be in the index.
+  std::set<std::string> seen;
+  for (int32 i = 0; i < num_keys; i++) {
+    int64 this_offset, this_length;
+    KALDI_ASSERT(index.Lookup(entries[i].key, &this_offset, &this_length));
+    if (seen.insert(entries[i].key).second) {
+      KALDI_ASSERT(this_offset == entries[i].offset &&
+                   this_length == entries[i].length);
+    }
+  }
+  KALDI_ASSERT(index.NumKeys() == static_cast<int64>(seen.size()));
+  int64 this_offset, this_length;
+  KALDI_ASSERT(!index.Lookup("foo", &this_offset, &this_length));
+  index.Close();
+
+  // If the archive has changed, the index should not be used, whether or
+  // not the size has changed.
+  struct utimbuf times;
+  times.actime = times.modtime = time(NULL) - 1000;
+  utime("tmpf", &times);
+  KALDI_ASSERT(!index.Open(ArchiveIndexFilename("tmpf"), "tmpf"));
+  WriteDummyArchive("tmpf", offset + 1);
+  KALDI_ASSERT(!index.Open(ArchiveIndexFilename("tmpf"), "tmpf"));
+  unlink("tmpf");
+  unlink(ArchiveIndexFilename("tmpf").c_str());
+}
+
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestArchiveIndex();
+  std::cout << "Test OK.\n";
+}
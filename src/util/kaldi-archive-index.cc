@@ -0,0 +1,220 @@
+// util/kaldi-archive-index.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include "util/kaldi-archive-index.h"
+#include "util/kaldi-index-common.h"
+
+
+namespace kaldi {
+
+static const char *kArchiveIndexMagic = "KaldiIdx";
+static const uint32 kArchiveIndexByteOrderCheck = 0x01020304;
+static const uint32 kArchiveIndexVersion = 2;
+
+std::string ArchiveIndexFilename(const std::string &archive_filename) {
+  return archive_filename + ".idx";
+}
+
+bool WriteArchiveIndex(const std::string &index_filename,
+                       const std::string &archive_filename,
+                       int64 archive_size,
+                       const std::vector<ArchiveIndexEntry> &entries) {
+  int64 actual_size, archive_mtime;
+  if (!GetFileInfo(archive_filename, &actual_size, &archive_mtime)) {
+    KALDI_WARN << "Cannot write archive index " << index_filename
+               << ": failed to stat archive " << archive_filename;
+    return false;
+  }
+  if (actual_size != archive_size) {
+    KALDI_WARN << "Cannot write archive index " << index_filename
+               << ": archive " << archive_filename << " has size "
+               << actual_size << ", expected " << archive_size;
+    return false;
+  }
+  int64 num_slots = 2;
+  while (num_slots < 2 * static_cast<int64>(entries.size()))
+    num_slots *= 2;
+  uint64 mask = static_cast<uint64>(num_slots - 1);
+
+  std::vector<ArchiveIndexSlot> slots(num_slots);
+  memset(&(slots[0]), 0, sizeof(ArchiveIndexSlot) * num_slots);
+  std::string keys;
+  int64 num_keys = 0;
+  for (size_t i = 0; i < entries.size(); i++) {
+    const std::string &key = entries[i].key;
+    KALDI_ASSERT(!key.empty());
+    uint64 hash = IndexHash(key.data(), key.size());
+    uint64 s = hash & mask;
+    bool duplicate = false;
+    while (slots[s].key_length != 0) {
+      if (slots[s].hash == hash &&
+          slots[s].key_length == static_cast<int32>(key.size()) &&
+          keys.compare(slots[s].key_offset, key.size(), key) == 0) {
+        duplicate = true;
+        break;
+      }
+      s = (s + 1) & mask;
+    }
+    if (duplicate) {
+      KALDI_WARN << "Duplicate key " << key << " in archive, indexing only "
+                 << "the first one: index is " << index_filename;
+      continue;
+    }
+    ArchiveIndexSlot &slot = slots[s];
+    slot.hash = hash;
+    slot.offset = entries[i].offset;
+    slot.length = entries[i].length;
+    slot.key_offset = keys.size();
+    slot.key_length = key.size();
+    keys.append(key);
+    num_keys++;
+  }
+
+  ArchiveIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kArchiveIndexMagic, sizeof(header.magic));
+  header.byte_order_check = kArchiveIndexByteOrderCheck;
+  header.version = kArchiveIndexVersion;
+  header.archive_size = archive_size;
+  header.archive_mtime = archive_mtime;
+  header.num_keys = num_keys;
+  header.num_slots = num_slots;
+  header.keys_size = keys.size();
+
+  // Write to a temporary file and rename it, so that programs reading the
+  // archive at the same time never see a partly written index.
+  std::ostringstream tmp_filename;
+  tmp_filename << index_filename << ".tmp";
+#ifndef _MSC_VER
+  tmp_filename << '.' << getpid();
+#endif
+  std::ofstream os(tmp_filename.str().c_str(),
+                   std::ios_base::out | std::ios_base::binary);
+  if (!os.is_open()) {
+    KALDI_WARN << "Failed to open archive index " << tmp_filename.str()
+               << " for writing.";
+    return false;
+  }
+  os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  os.write(reinterpret_cast<const char*>(&(slots[0])),
+           sizeof(ArchiveIndexSlot) * num_slots);
+  os.write(keys.data(), keys.size());
+  os.close();
+  if (os.fail()) {
+    KALDI_WARN << "Error writing archive index " << tmp_filename.str();
+    std::remove(tmp_filename.str().c_str());
+    return false;
+  }
+  if (std::rename(tmp_filename.str().c_str(), index_filename.c_str()) != 0) {
+    KALDI_WARN << "Failed to rename " << tmp_filename.str() << " to "
+               << index_filename;
+    std::remove(tmp_filename.str().c_str());
+    return false;
+  }
+  return true;
+}
+
+
+ArchiveIndex::ArchiveIndex(): header_(NULL), slots_(NULL), keys_(NULL) { }
+
+bool ArchiveIndex::Open(const std::string &index_filename,
+                        const std::string &archive_filename) {
+  Close();
+  if (!file_.Open(index_filename))
+    return false;  // it will have printed a warning.
+  int64 index_size = file_.Size();
+  if (index_size < static_cast<int64>(sizeof(ArchiveIndexHeader))) {
+    KALDI_WARN << "Archive index " << index_filename << " is too small.";
+    Close();
+    return false;
+  }
+  const char *data = file_.Data();
+  header_ = reinterpret_cast<const ArchiveIndexHeader*>(data);
+  slots_ = reinterpret_cast<const ArchiveIndexSlot*>(
+      data + sizeof(ArchiveIndexHeader));
+
+  std::string error;
+  if (memcmp(header_->magic, kArchiveIndexMagic, sizeof(header_->magic)) != 0)
+    error = "it is not an archive index.";
+  else if (header_->byte_order_check != kArchiveIndexByteOrderCheck)
+    error = "it was written on a machine with a different byte order.";
+  else if (header_->version != kArchiveIndexVersion)
+    error = "it has an unsupported version.";
+  else if (header_->num_slots <= 0 ||
+           (header_->num_slots & (header_->num_slots - 1)) != 0 ||
+           header_->keys_size < 0 ||
+           index_size != static_cast<int64>(sizeof(ArchiveIndexHeader)) +
+           header_->num_slots * static_cast<int64>(sizeof(ArchiveIndexSlot)) +
+           header_->keys_size)
+    error = "it is corrupted or truncated.";
+  else {
+    int64 archive_size, archive_mtime;
+    if (!GetFileInfo(archive_filename, &archive_size, &archive_mtime))
+      error = "failed to stat the archive.";
+    else if (header_->archive_size != archive_size ||
+             header_->archive_mtime != archive_mtime)
+      error = "it is out of date (the archive has changed).";
+  }
+  if (!error.empty()) {
+    KALDI_WARN << "Cannot use archive index " << index_filename
+               << " for archive " << archive_filename << ": " << error;
+    Close();
+    return false;
+  }
+  keys_ = reinterpret_cast<const char*>(slots_ + header_->num_slots);
+  return true;
+}
+
+bool ArchiveIndex::Lookup(const std::string &key,
+                          int64 *offset, int64 *length) const {
+  KALDI_ASSERT(IsOpen());
+  uint64 hash = IndexHash(key.data(), key.size()),
+      mask = static_cast<uint64>(header_->num_slots - 1);
+  for (uint64 s = hash & mask; slots_[s].key_length != 0; s = (s + 1) & mask) {
+    const ArchiveIndexSlot &slot = slots_[s];
+    if (slot.hash == hash &&
+        slot.key_length == static_cast<int32>(key.size()) &&
+        memcmp(keys_ + slot.key_offset, key.data(), key.size()) == 0) {
+      *offset = slot.offset;
+      *length = slot.length;
+      return true;
+    }
+  }
+  return false;
+}
+
+int64 ArchiveIndex::NumKeys() const {
+  KALDI_ASSERT(IsOpen());
+  return header_->num_keys;
+}
+
+void ArchiveIndex::Close() {
+  file_.Close();
+  header_ = NULL;
+  slots_ = NULL;
+  keys_ = NULL;
+}
+
+}  // namespace kaldi
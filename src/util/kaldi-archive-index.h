@@ -0,0 +1,151 @@
+// util/kaldi-archive-index.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
+#define KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/kaldi-mapped-file.h"
+
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+/*
+  An archive index is a "sidecar" file that sits next to an archive on disk
+  (for archive foo.ark it is foo.ark.idx) and tells us, for each key, the byte
+  offset and length of its object in the archive.  It is written by TableWriter
+  when the "idx" option is given in the wspecifier (e.g. "ark,idx:foo.ark"),
+  and used by RandomAccessTableReader when the "idx" option is given in the
+  rspecifier (e.g. "ark,idx:foo.ark"); see kaldi-table.h.  It makes archives
+  randomly accessible in any key order without keeping the objects in memory.
+
+  The index is a hash table laid out so that it can be used directly after
+  being memory-mapped: looking up a key touches a couple of pages and does not
+  require reading the whole file.  The format (in the native byte order; the
+  header contains a check value so we can detect a file written on a machine
+  with the other byte order) is:
+
+    ArchiveIndexHeader
+    num_slots x ArchiveIndexSlot   [num_slots is a power of two]
+    the keys, concatenated with no separators.
+
+  The header records the size and modification time of the archive, and Open()
+  checks them against the actual archive so that an index that is out of date
+  is not silently used.
+*/
+
+struct ArchiveIndexEntry {
+  std::string key;
+  int64 offset;  // Byte offset of the object in the archive (just after
+                 // the key and the space that follows it).
+  int64 length;  // Number of bytes taken by the object.
+  ArchiveIndexEntry(): offset(0), length(0) { }
+  ArchiveIndexEntry(const std::string &key, int64 offset, int64 length):
+      key(key), offset(offset), length(length) { }
+};
+
+// The on-disk header of an index file.
+struct ArchiveIndexHeader {
+  char magic[8];  // "KaldiIdx"
+  uint32 byte_order_check;  // 0x01020304 in the byte order of the writer.
+  uint32 version;  // currently 2.
+  int64 archive_size;  // size in bytes and modification time of the archive
+  int64 archive_mtime;  // that was indexed.
+  int64 num_keys;
+  int64 num_slots;  // a power of two, at least twice num_keys.
+  int64 keys_size;  // total size of the keys, in bytes.
+};
+
+// The on-disk hash-table slot.  An empty slot has key_length == 0 (keys are
+// never empty).  We use linear probing.
+struct ArchiveIndexSlot {
+  uint64 hash;
+  int64 offset;
+  int64 length;
+  int64 key_offset;  // offset of the key within the keys section.
+  int32 key_length;
+  int32 unused;  // padding, zero.
+};
+
+/// Returns the name of the index file for the archive "archive_filename",
+/// which is archive_filename + ".idx".
+std::string ArchiveIndexFilename(const std::string &archive_filename);
+
+/// Writes the index for the archive "archive_filename", which must have been
+/// closed, and which we expect to be of size "archive_size" bytes, containing
+/// the objects in "entries" (which do not have to be in any particular order),
+/// to the file "index_filename" (must be an actual filename, not a pipe).  If
+/// a key appears more than once, it warns and indexes the first one.  The
+/// index is written to a temporary file which is then renamed, so programs
+/// reading it never see a partly written index.  Returns false (with a
+/// warning) if the archive cannot be found or has the wrong size, or if the
+/// index cannot be written; true on success.
+bool WriteArchiveIndex(const std::string &index_filename,
+                       const std::string &archive_filename,
+                       int64 archive_size,
+                       const std::vector<ArchiveIndexEntry> &entries);
+
+/// ArchiveIndex is a read-only view of an index file written by
+/// WriteArchiveIndex().  The file is memory-mapped (where the platform
+/// supports it), so Open() is fast and memory use does not grow with the
+/// number of lookups.
+class ArchiveIndex {
+ public:
+  ArchiveIndex();
+
+  /// Opens the index "index_filename" for the archive "archive_filename".
+  /// Returns false (with a warning) if the index cannot be read, is in the
+  /// wrong format, or was written for a different version of the archive
+  /// (detected by the archive size and modification time).
+  bool Open(const std::string &index_filename,
+            const std::string &archive_filename);
+
+  bool IsOpen() const { return (header_ != NULL); }
+
+  /// Looks up "key"; if found, outputs its offset and length in the archive
+  /// and returns true.  Otherwise returns false.
+  bool Lookup(const std::string &key, int64 *offset, int64 *length) const;
+
+  /// Returns the number of keys in the index.
+  int64 NumKeys() const;
+
+  void Close();
+
+  ~ArchiveIndex() { Close(); }
+
+ private:
+  const ArchiveIndexHeader *header_;  // NULL if not open.
+  const ArchiveIndexSlot *slots_;
+  const char *keys_;
+
+  MappedFile file_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ArchiveIndex);
+};
+
+/// @} end "addtogroup table_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_ARCHIVE_INDEX_H_
@@ -23,6 +23,7 @@
 
 #include <algorithm>
 #include "util/kaldi-io.h"
+#include "util/kaldi-mapped-file.h"
 #include "util/text-utils.h"
 #include "matrix/kaldi-matrix.h"
 
@@ -32,6 +33,38 @@ namespace kaldi {
 /// @{
 
 
+// In binary mode, if we know the position in the file we are writing to,
+// writes spaces so that the data of a binary matrix of BaseFloat written next
+// will be aligned to sizeof(BaseFloat) bytes in the file.  This lets
+// MatrixViewHolder read it from a memory-mapped archive without copying; the
+// spaces are skipped when reading (see Matrix::Read()).  The table writers
+// only do this if given the "align" option, so by default the output is as
+// it always was.  When writing to an in-memory buffer (e.g. the "shards"
+// option of TableWriter) the position in the file is not known and the data
+// may end up unaligned.
+inline void AlignMatrixData(std::ostream &os, bool binary) {
+  if (!binary) return;
+  std::streamoff pos = os.tellp();
+  if (pos < 0) return;  // e.g. a pipe.
+  // The matrix header is the token "FM " (or "DM "), then the number of rows
+  // and columns, each written as a size byte followed by an int32.
+  const std::streamoff header_size = 3 + 2 * (1 + sizeof(int32));
+  std::streamoff misalignment = (pos + header_size) % sizeof(BaseFloat);
+  if (misalignment != 0)
+    os << std::string(sizeof(BaseFloat) - misalignment, ' ');
+}
+
+// AlignTableObject() calls AlignMatrixData() for matrices of BaseFloat, and
+// does nothing for other types.
+template<class T>
+inline void AlignTableObject(std::ostream &os, bool binary, const T &t) { }
+
+inline void AlignTableObject(std::ostream &os, bool binary,
+                             const Matrix<BaseFloat> &t) {
+  AlignMatrixData(os, binary);
+}
+
+
 // KaldiObjectHolder is valid only for Kaldi objects with
 // copy constructors, default constructors, and "normal"
 // Kaldi Write and Read functions.  E.g. it works for
@@ -43,7 +76,14 @@ template<class KaldiType> class KaldiObjectHolder {
   KaldiObjectHolder(): t_(NULL) { }
 
   static bool Write(std::ostream &os, bool binary, const T &t) {
+    return Write(os, binary, t, false);
+  }
+
+  // As above, but if "align" is true, matrices of BaseFloat are aligned in the
+  // file (see AlignMatrixData()).
+  static bool Write(std::ostream &os, bool binary, const T &t, bool align) {
     InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
+    if (align) AlignTableObject(os, binary, t);
     try {
       t.Write(os, binary);
       return os.good();
@@ -93,6 +133,11 @@ template<class KaldiType> class KaldiObjectHolder {
     return *t_;
   }
 
+  void Swap(KaldiObjectHolder<T> *other) {
+    // the t_ values are pointers so this is a shallow swap.
+    std::swap(t_, other->t_);
+  }
+
   ~KaldiObjectHolder() { if (t_) delete t_; }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(KaldiObjectHolder);
@@ -100,6 +145,163 @@ template<class KaldiType> class KaldiObjectHolder {
 };
 
 
+// MatrixViewHolder is for reading matrices of BaseFloat without copying them,
+// when the table is read with the "mmap" option (e.g. "scp,mmap:feats.scp").
+// If the matrix is stored in binary as a matrix of BaseFloat and is suitably
+// aligned in the file, Value() is a SubMatrix that points directly into the
+// memory-mapped file; it is read-only, and is valid until the holder is
+// cleared (e.g. when the next object is read).  The holder keeps a reference
+// to the mapping, so the view stays valid even if the reader closes the file
+// or moves on to another one.  Otherwise (text mode, compressed matrices,
+// double-precision matrices, unaligned data, or no "mmap" option) it reads
+// into a Matrix as KaldiObjectHolder<Matrix<BaseFloat> > would, so it can be
+// used for any table of matrices.  Writing works as for Matrix<BaseFloat>; with
+// the "align" wspecifier option it aligns the data (see AlignMatrixData()), so
+// that it can be read back as a view.
+class MatrixViewHolder {
+ public:
+  typedef MatrixBase<BaseFloat> T;
+
+  MatrixViewHolder(): view_(NULL), file_(NULL) { }
+
+  static bool Write(std::ostream &os, bool binary, const T &t) {
+    return Write(os, binary, t, false);
+  }
+
+  static bool Write(std::ostream &os, bool binary, const T &t, bool align) {
+    InitKaldiOutputStream(os, binary);  // Puts binary header if binary mode.
+    if (align) AlignMatrixData(os, binary);
+    try {
+      t.Write(os, binary);
+      return os.good();
+    } catch (const std::exception &e) {
+      KALDI_WARN << "Exception caught writing Table object: " << e.what();
+      if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+      return false;  // Write failure.
+    }
+  }
+
+  void Clear() {
+    delete view_;
+    view_ = NULL;
+    if (file_ != NULL) file_->Unref();
+    file_ = NULL;
+    mat_.Resize(0, 0);
+  }
+
+  bool Read(std::istream &is) {
+    Clear();
+    bool is_binary;
+    if (!InitKaldiInputStream(is, &is_binary)) {
+      KALDI_WARN << "Reading Table object, failed reading binary header\n";
+      return false;
+    }
+    if (is_binary && ReadView(is))
+      return true;
+    try {
+      mat_.Read(is, is_binary);
+      return true;
+    } catch (std::exception &e) {
+      KALDI_WARN << "Exception caught reading Table object ";
+      if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
+      mat_.Resize(0, 0);
+      return false;
+    }
+  }
+
+  static bool IsReadInBinary() { return true; }
+
+  const T &Value() const {
+    if (view_ != NULL) return *view_;
+    else return mat_;
+  }
+
+  /// Returns true if the current value points into a memory-mapped file,
+  /// i.e. it was read without copying.
+  bool IsView() const { return (view_ != NULL); }
+
+  void Swap(MatrixViewHolder *other) {
+    std::swap(view_, other->view_);
+    std::swap(file_, other->file_);
+    mat_.Swap(&(other->mat_));
+  }
+
+  ~MatrixViewHolder() { Clear(); }
+ private:
+  // If the stream reads from a memory mapping and the next object is a
+  // binary matrix of BaseFloat whose data is suitably aligned, sets view_ to
+  // point to it, advances the stream past it and returns true.  Otherwise
+  // returns false without changing the stream position.
+  bool ReadView(std::istream &is) {
+    MappedStreambuf *buf = dynamic_cast<MappedStreambuf*>(is.rdbuf());
+    if (buf == NULL || buf->Owner() == NULL) return false;
+    const char *token = (sizeof(BaseFloat) == 4 ? "FM " : "DM ");
+    // The header is the token, then the number of rows and columns, each
+    // written as a size byte followed by an int32 (see WriteBasicType()).
+    const size_t header_size = 3 + 2 * (1 + sizeof(int32));
+    const char *begin = buf->Current();
+    size_t remaining = buf->Remaining(), padding = 0;
+    // Skip the spaces written by AlignMatrixData().
+    while (padding < remaining && begin[padding] == ' ')
+      padding++;
+    begin += padding;
+    remaining -= padding;
+    if (remaining < header_size || memcmp(begin, token, 3) != 0 ||
+        begin[3] != sizeof(int32) || begin[8] != sizeof(int32))
+      return false;
+    int32 num_rows, num_cols;
+    memcpy(&num_rows, begin + 4, sizeof(int32));
+    memcpy(&num_cols, begin + 9, sizeof(int32));
+    if (num_rows <= 0 || num_cols <= 0)
+      return false;  // let Matrix::Read() deal with empty or invalid sizes.
+    const char *data = begin + header_size;
+    size_t data_size = sizeof(BaseFloat) * static_cast<size_t>(num_rows) *
+        static_cast<size_t>(num_cols);
+    if (data_size > remaining - header_size ||
+        reinterpret_cast<size_t>(data) % sizeof(BaseFloat) != 0)
+      return false;
+    // SubMatrix takes a non-const pointer, but the user only gets const
+    // access to it.
+    view_ = new SubMatrix<BaseFloat>(
+        reinterpret_cast<BaseFloat*>(const_cast<char*>(data)),
+        num_rows, num_cols, num_cols);
+    file_ = buf->Owner();
+    file_->Ref();
+    buf->Skip(padding + header_size + data_size);
+    return true;
+  }
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MatrixViewHolder);
+  SubMatrix<BaseFloat> *view_;  // Non-NULL if we have a view.
+  SharedMappedFile *file_;  // The mapping view_ points into; we hold a
+                            // reference to it.  Non-NULL iff view_ is.
+  Matrix<BaseFloat> mat_;  // Used if we don't have a view.
+};
+
+
+// HolderWrite() is what the table writers call to write an object.  For the
+// holders of matrices of BaseFloat, "align" says whether to align the data in
+// the file (the "align" wspecifier option; see AlignMatrixData()); the other
+// holders ignore it.
+template<class Holder>
+inline bool HolderWrite(std::ostream &os, bool binary,
+                        const typename Holder::T &t, bool align) {
+  return Holder::Write(os, binary, t);
+}
+
+template<>
+inline bool HolderWrite<KaldiObjectHolder<Matrix<BaseFloat> > >(
+    std::ostream &os, bool binary, const Matrix<BaseFloat> &t, bool align) {
+  return KaldiObjectHolder<Matrix<BaseFloat> >::Write(os, binary, t, align);
+}
+
+template<>
+inline bool HolderWrite<MatrixViewHolder>(
+    std::ostream &os, bool binary, const MatrixBase<BaseFloat> &t, bool align) {
+  return MatrixViewHolder::Write(os, binary, t, align);
+}
+
+
 // BasicHolder is valid for float, double, bool, and integer
 // types.  There will be a compile time error otherwise, because
 // we make sure that the {Write, Read}BasicType functions do not
@@ -175,6 +377,10 @@ template<class BasicType> class BasicHolder {
     return t_;
   }
 
+  void Swap(BasicHolder<T> *other) {
+    std::swap(t_, other->t_);
+  }
+
   ~BasicHolder() { }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(BasicHolder);
@@ -241,21 +447,20 @@ template<class BasicType> class BasicVectorHolder {
         KALDI_WARN << "BasicVectorHolder::Read, error reading line " << (is.eof() ? "[eof]" : "");
         return false;  // probably eof.  fail in any case.
       }
-      std::istringstream line_is(line);
-      try {
-        while (1) {
-          line_is >> std::ws;  // eat up whitespace.
-          if (line_is.eof()) break;
-          BasicType bt;
-          ReadBasicType(line_is, false, &bt);
-          t_.push_back(bt);
+      // Parse the line in place; this is much faster than using a
+      // std::istringstream and ReadBasicType().
+      const char *pos = line.data(), *end = pos + line.size();
+      while (1) {
+        while (pos != end && ::isspace(static_cast<unsigned char>(*pos))) pos++;  // eat up whitespace.
+        if (pos == end) break;
+        BasicType bt;
+        if (!ParseBasicType(&pos, end, &bt)) {
+          KALDI_WARN << "BasicVectorHolder::Read, could not interpret line: " << line;
+          return false;
         }
-        return true;
-      } catch(std::exception &e) {
-        KALDI_WARN << "BasicVectorHolder::Read, could not interpret line: " << line;
-        if (!IsKaldiError(e.what())) { std::cerr << e.what(); }
-        return false;
+        t_.push_back(bt);
       }
+      return true;
     } else {  // binary mode.
       size_t filepos = is.tellg();
       try {
@@ -281,6 +486,10 @@ template<class BasicType> class BasicVectorHolder {
 
   const T &Value() const {  return t_; }
 
+  void Swap(BasicVectorHolder<BasicType> *other) {
+    t_.swap(other->t_);
+  }
+
   ~BasicVectorHolder() { }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(BasicVectorHolder);
@@ -413,6 +622,10 @@ template<class BasicType> class BasicVectorVectorHolder {
 
   const T &Value() const {  return t_; }
 
+  void Swap(BasicVectorVectorHolder<BasicType> *other) {
+    t_.swap(other->t_);
+  }
+
   ~BasicVectorVectorHolder() { }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(BasicVectorVectorHolder);
@@ -547,6 +760,10 @@ template<class BasicType> class BasicPairVectorHolder {
 
   const T &Value() const {  return t_; }
 
+  void Swap(BasicPairVectorHolder<BasicType> *other) {
+    t_.swap(other->t_);
+  }
+
   ~BasicPairVectorHolder() { }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(BasicPairVectorHolder);
@@ -595,6 +812,10 @@ class TokenHolder {
 
   const T &Value() const { return t_; }
 
+  void Swap(TokenHolder *other) {
+    t_.swap(other->t_);
+  }
+
   ~TokenHolder() { }
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(TokenHolder);
@@ -635,9 +856,15 @@ class TokenVectorHolder {
       KALDI_WARN << "BasicVectorHolder::Read, error reading line " << (is.eof() ? "[eof]" : "");
       return false;  // probably eof.  fail in any case.
     }
-    const char *white_chars = " \t\n\r\f\v";
-    SplitStringToVector(line, white_chars, true, &t_);  // true== omit empty strings e.g.
-    // between spaces.
+    // Split on whitespace, omitting empty strings e.g. between spaces.
+    const char *pos = line.data(), *end = pos + line.size();
+    while (1) {
+      while (pos != end && ::isspace(static_cast<unsigned char>(*pos))) pos++;
+      if (pos == end) break;
+      const char *token_begin = pos;
+      while (pos != end && !::isspace(static_cast<unsigned char>(*pos))) pos++;
+      t_.push_back(std::string(token_begin, pos));
+    }
     return true;
   }
 
@@ -647,6 +874,10 @@ class TokenVectorHolder {
 
   const T &Value() const { return t_; }
 
+  void Swap(TokenVectorHolder *other) {
+    t_.swap(other->t_);
+  }
+
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(TokenVectorHolder);
   T t_;
@@ -685,6 +916,10 @@ class HtkMatrixHolder {
 
   const T &Value() const { return t_; }
 
+  void Swap(HtkMatrixHolder *other) {
+    t_.first.Swap(&(other->t_.first));
+    std::swap(t_.second, other->t_.second);
+  }
 
   // No destructor.
  private:
@@ -785,6 +1020,10 @@ template<int kFeatDim> class SphinxMatrixHolder {
 
   const T &Value() const { return feats_; }
 
+  void Swap(SphinxMatrixHolder *other) {
+    feats_.Swap(&(other->feats_));
+  }
+
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SphinxMatrixHolder);
   T feats_;
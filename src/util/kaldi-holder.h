@@ -123,6 +123,13 @@ template<class SomeType> class GenericHolder {
   /// true (so OK to throw exception if no object was read).
   const T &Value() const { return t_; } // if t is a pointer, would return *t_;
 
+  /// Swaps the contents of this holder with another holder of the same type.
+  /// It should be a shallow swap where possible (e.g. swapping pointers, or
+  /// using the Swap() function of the object held).  It's used by the
+  /// background read-ahead in SequentialTableReader (the "bg" option), which
+  /// moves objects between holders instead of copying them.
+  void Swap(GenericHolder<T> *other) { std::swap(t_, other->t_); }
+
   /// The Clear() function doesn't have to do anything.  Its purpose is to
   /// allow the object to free resources if they're no longer needed.
   void Clear() { }
@@ -0,0 +1,67 @@
+// util/kaldi-index-common.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_INDEX_COMMON_H_
+#define KALDI_UTIL_KALDI_INDEX_COMMON_H_
+
+// This header is internal to kaldi-archive-index.cc and kaldi-script-index.cc,
+// which both write index files to disk and check them against the files they
+// were built from; don't include it elsewhere.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <string>
+#include "base/kaldi-common.h"
+
+
+namespace kaldi {
+
+// FNV-1a hash of the "length" bytes at "key".  We don't use StringHasher
+// (stl-utils.h) because the hashes are stored on disk, so they must not change
+// if that one is changed.
+inline uint64 IndexHash(const char *key, size_t length) {
+  uint64 ans = 14695981039346656037ULL;
+  for (size_t i = 0; i < length; i++) {
+    ans ^= static_cast<unsigned char>(key[i]);
+    ans *= 1099511628211ULL;
+  }
+  return ans;
+}
+
+// Gets the size and modification time of a file; returns false if we could
+// not stat it.
+inline bool GetFileInfo(const std::string &filename,
+                        int64 *size, int64 *mtime) {
+  struct stat buf;
+  if (stat(filename.c_str(), &buf) != 0)
+    return false;
+  *size = static_cast<int64>(buf.st_size);
+#ifdef __linux__
+  // Use the full resolution of the modification time, where we can.
+  *mtime = static_cast<int64>(buf.st_mtim.tv_sec) * 1000000000 +
+      buf.st_mtim.tv_nsec;
+#else
+  *mtime = static_cast<int64>(buf.st_mtime);
+#endif
+  return true;
+}
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_INDEX_COMMON_H_
@@ -17,6 +17,8 @@
 // See the Apache 2 License for the specific language governing permissions and
 // limitations under the License.
 #include "util/kaldi-io.h"
+#include "util/kaldi-mapped-file.h"
+#include "util/block-compression.h"
 #include "base/kaldi-math.h"
 #include "util/text-utils.h"
 #include "util/parse-options.h"
@@ -200,6 +202,45 @@ class FileOutputImpl: public OutputImplBase {
   std::ofstream os_;
 };
 
+// CompressedFileOutputImpl is used for actual files whose names end in ".kz";
+// it writes them in the block-compressed format (see block-compression.h).
+// tellp() on the stream gives the position in the uncompressed data, which is
+// what goes in scp files.
+class CompressedFileOutputImpl: public OutputImplBase {
+ public:
+  CompressedFileOutputImpl(): os_(&buf_) { }
+
+  virtual bool Open(const std::string &filename, bool binary) {
+    // Note: "binary" makes no difference; we never translate newlines.
+    if (buf_.IsOpen()) KALDI_ERR << "CompressedFileOutputImpl::Open(), "
+                                 << "open called on already open file.";
+    filename_ = filename;
+    os_.clear();
+    return buf_.Open(MapOsPath(filename_));
+  }
+
+  virtual std::ostream &Stream() {
+    if (!buf_.IsOpen())
+      KALDI_ERR << "CompressedFileOutputImpl::Stream(), file is not open.";
+    return os_;
+  }
+
+  virtual bool Close() {
+    if (!buf_.IsOpen())
+      KALDI_ERR << "CompressedFileOutputImpl::Close(), file is not open.";
+    bool stream_ok = !os_.fail();
+    return buf_.Close() && stream_ok;
+  }
+  virtual ~CompressedFileOutputImpl() {
+    if (buf_.IsOpen() && !buf_.Close())
+      KALDI_ERR << "Error closing output file " << filename_;
+  }
+ private:
+  std::string filename_;
+  BlockCompressedOutputBuf buf_;
+  std::ostream os_;
+};
+
 class StandardOutputImpl: public OutputImplBase {
  public:
   StandardOutputImpl(): is_open_(false) { }
@@ -332,6 +373,9 @@ class InputImplBase {
   // on close for input streams.
   virtual InputType MyType() = 0;  // Because if it's kOffsetFileInput, we may call Open twice
   // (has efficiency benefits).
+  virtual bool IsMapped() const { return false; }  // True for MappedFileInputImpl.
+  virtual bool IsCompressed() const { return false; }  // True for
+                                                       // CompressedFileInputImpl.
 
   virtual ~InputImplBase() { }
 };
@@ -605,6 +649,130 @@ class OffsetFileInputImpl: public InputImplBase {
 };
 
 
+// MappedFileInputImpl is used by Input::OpenMapped() for actual files and for
+// offsets into them.  The whole file is memory-mapped, and like
+// OffsetFileInputImpl, it may be opened again (at a different offset, or on a
+// different file) without being closed, which for the same file just moves
+// the read position.  The mapping is reference-counted, so objects that point
+// into it (see MatrixViewHolder) stay valid when we close it or move on to
+// another file.
+class MappedFileInputImpl: public InputImplBase {
+ public:
+  MappedFileInputImpl(): file_(NULL), is_(&buf_) { }
+
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    // Note: "binary" makes no difference; we read exactly what is in the file.
+    std::string filename;
+    size_t offset = 0;
+    if (ClassifyRxfilename(rxfilename) == kOffsetFileInput)
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    else
+      filename = rxfilename;
+    if (file_ == NULL || filename != filename_) {
+      Close();
+      filename_ = filename;
+      file_ = SharedMappedFile::Open(MapOsPath(filename));
+      if (file_ == NULL)
+        return false;
+      buf_.SetRegion(file_->File().Data(), file_->File().Size(), file_);
+    }
+    is_.clear();
+    if (offset > file_->File().Size()) return false;
+    return (buf_.pubseekpos(offset, std::ios_base::in) ==
+            std::streampos(offset));
+  }
+
+  virtual std::istream &Stream() {
+    if (file_ == NULL)
+      KALDI_ERR << "MappedFileInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual void Close() {
+    buf_.SetRegion(NULL, 0);
+    if (file_ != NULL) file_->Unref();
+    file_ = NULL;
+  }
+
+  // We say kOffsetFileInput so that Input::OpenInternal() will reuse this
+  // object for offsets into the same file.
+  virtual InputType MyType() { return kOffsetFileInput; }
+
+  virtual bool IsMapped() const { return true; }
+
+  virtual ~MappedFileInputImpl() { Close(); }
+
+ private:
+  std::string filename_;  // the actual filename
+  SharedMappedFile *file_;  // we hold one reference; NULL if not open.
+  MappedStreambuf buf_;
+  std::istream is_;
+};
+
+
+// CompressedFileInputImpl is used for actual files whose names end in ".kz",
+// and for offsets into them; these are in the block-compressed format (see
+// block-compression.h), and offsets refer to the uncompressed data.  Like
+// OffsetFileInputImpl, it may be opened again (at a different offset, or on a
+// different file) without being closed, which for the same file just seeks.
+class CompressedFileInputImpl: public InputImplBase {
+ public:
+  CompressedFileInputImpl(): is_(&buf_) { }
+
+  virtual bool Open(const std::string &rxfilename, bool binary) {
+    // Note: "binary" makes no difference; we never translate newlines.
+    std::string filename;
+    size_t offset = 0;
+    if (ClassifyRxfilename(rxfilename) == kOffsetFileInput)
+      OffsetFileInputImpl::SplitFilename(rxfilename, &filename, &offset);
+    else
+      filename = rxfilename;
+    if (!buf_.IsOpen() || filename != filename_) {
+      filename_ = filename;
+      if (!buf_.Open(MapOsPath(filename)))
+        return false;
+    }
+    is_.clear();
+    return (buf_.pubseekpos(offset, std::ios_base::in) ==
+            std::streampos(offset));
+  }
+
+  virtual std::istream &Stream() {
+    if (!buf_.IsOpen())
+      KALDI_ERR << "CompressedFileInputImpl::Stream(), file is not open.";
+    return is_;
+  }
+
+  virtual void Close() { buf_.Close(); }
+
+  // We say kOffsetFileInput so that Input::OpenInternal() will reuse this
+  // object for offsets into the same file.
+  virtual InputType MyType() { return kOffsetFileInput; }
+
+  virtual bool IsCompressed() const { return true; }
+
+ private:
+  std::string filename_;  // the actual filename
+  BlockCompressedInputBuf buf_;
+  std::istream is_;
+};
+
+
+// Returns true if rxfilename, of type "type", refers to a block-compressed
+// file, i.e. if it is a file or an offset into a file, with a name ending in
+// ".kz".
+static bool IsCompressedInput(const std::string &rxfilename, InputType type) {
+  if (type == kFileInput) {
+    return IsBlockCompressedFilename(rxfilename);
+  } else if (type == kOffsetFileInput) {
+    size_t pos = rxfilename.find_last_of(':');
+    return IsBlockCompressedFilename(std::string(rxfilename, 0, pos));
+  } else {
+    return false;
+  }
+}
+
+
 Output::Output(const std::string &wxfilename, bool binary, bool write_header):
     impl_(NULL) {
   if (!Open(wxfilename, binary, write_header)) {
@@ -658,7 +826,9 @@ bool Output::Open(const std::string &wxfn, bool binary, bool header) {
   OutputType type = ClassifyWxfilename(wxfn);
   KALDI_ASSERT(impl_ == NULL);
 
-  if (type ==  kFileOutput) {
+  if (type ==  kFileOutput && IsBlockCompressedFilename(wxfn)) {
+    impl_ = new CompressedFileOutputImpl();
+  } else if (type ==  kFileOutput) {
     impl_ = new FileOutputImpl();
   } else if (type == kStandardOutput) {
     impl_ = new StandardOutputImpl();
@@ -704,11 +874,19 @@ void Input::Close() {
 
 bool Input::OpenInternal(const std::string &rxfilename,
                          bool file_binary,
-                         bool *contents_binary) {
+                         bool *contents_binary,
+                         bool mapped) {
   InputType type = ClassifyRxfilename(rxfilename);
+#ifdef _MSC_VER
+  mapped = false;  // We don't memory-map on Windows.
+#endif
+  if (!file_binary) mapped = false;  // Only binary mode is supported.
+  bool compressed = IsCompressedInput(rxfilename, type);
+  if (compressed) mapped = false;  // We can't map compressed files.
   if (IsOpen()) {
     // May have to close the stream first.
-    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput) {
+    if (type == kOffsetFileInput && impl_->MyType() == kOffsetFileInput &&
+        impl_->IsMapped() == mapped && impl_->IsCompressed() == compressed) {
       // We want to use the same object to Open... this is in case
       // the files are the same, so we can just seek.
       if (!impl_->Open(rxfilename, file_binary)) {  // true is binary mode-- always open in binary.
@@ -725,7 +903,11 @@ bool Input::OpenInternal(const std::string &rxfilename,
       // and fall through to code below which actually opens the file.
     }
   }
-  if (type ==  kFileInput) {
+  if (compressed) {
+    impl_ = new CompressedFileInputImpl();
+  } else if (mapped && (type == kFileInput || type == kOffsetFileInput)) {
+    impl_ = new MappedFileInputImpl();
+  } else if (type ==  kFileInput) {
     impl_ = new FileInputImpl();
   } else if (type == kStandardInput) {
     impl_ = new StandardInputImpl();
@@ -68,6 +68,12 @@ class InputImplBase;  // Forward decl; defined in a .cc file
 //   [these are created by the Table and TableWriter classes; I may also write
 //    a program that creates them for arbitrary files]
 //
+// Actual files whose names end in ".kz" (e.g. "/my/file.ark.kz") are written
+// and read in a block-compressed format, and offsets into them (e.g.
+// "/my/file.ark.kz:24871") refer to positions in the uncompressed data; see
+// block-compression.h.  This is cheaper than a pipe through gzip, and unlike
+// a gzipped file, the offsets in an scp file still work.
+//
 
 
 // Typical usage:
@@ -210,6 +216,15 @@ class Input {
   // binary mode (and ignore the \r).
   inline bool OpenTextMode(const std::string &rxfilename);
 
+  // As Open, but if the rxfilename is an actual file or an offset into one
+  // (e.g. "foo.ark:1234"), it memory-maps the file and reads from the
+  // mapping, which avoids system calls and buffering, and makes seeking
+  // within the file free.  For other types of rxfilename (and on Windows) it
+  // is the same as Open.  The stream's rdbuf() is then a MappedStreambuf
+  // (see kaldi-mapped-file.h), which lets holders read objects in place.
+  inline bool OpenMapped(const std::string &rxfilename,
+                         bool *contents_binary = NULL);
+
   // Return true if currently open for reading and Stream() will
   // succeed.  Does not guarantee that the stream is good.
   inline bool IsOpen();
@@ -226,7 +241,8 @@ class Input {
   // don't worry about the status when we close them.
   ~Input();
  private:
-  bool OpenInternal(const std::string &rxfilename, bool file_binary, bool *contents_binary);
+  bool OpenInternal(const std::string &rxfilename, bool file_binary,
+                    bool *contents_binary, bool mapped = false);
   InputImplBase *impl_;
   KALDI_DISALLOW_COPY_AND_ASSIGN(Input);
 };
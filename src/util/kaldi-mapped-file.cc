@@ -0,0 +1,162 @@
+// util/kaldi-mapped-file.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fstream>
+#ifndef _MSC_VER
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "util/kaldi-mapped-file.h"
+
+
+namespace kaldi {
+
+bool MappedFile::Open(const std::string &filename) {
+  Close();
+  struct stat buf;
+  if (stat(filename.c_str(), &buf) != 0) {
+    KALDI_WARN << "Failed to open file " << filename;
+    return false;
+  }
+  size_t size = buf.st_size;
+#ifndef _MSC_VER
+  if (size != 0) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      KALDI_WARN << "Failed to open file " << filename;
+      return false;
+    }
+    void *addr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);  // the mapping stays valid after the file is closed.
+    if (addr == MAP_FAILED) {
+      KALDI_WARN << "Failed to memory-map file " << filename;
+      return false;
+    }
+    map_addr_ = addr;
+    data_ = static_cast<const char*>(addr);
+  }
+#else
+  if (size != 0) {
+    std::ifstream is(filename.c_str(),
+                     std::ios_base::in | std::ios_base::binary);
+    buffer_.resize(size);
+    is.read(&(buffer_[0]), size);
+    if (!is.good()) {
+      KALDI_WARN << "Failed to read file " << filename;
+      buffer_.clear();
+      return false;
+    }
+    data_ = &(buffer_[0]);
+  }
+#endif
+  filename_ = filename;
+  size_ = size;
+  is_open_ = true;
+  return true;
+}
+
+void MappedFile::Close() {
+#ifndef _MSC_VER
+  if (map_addr_ != NULL)
+    munmap(map_addr_, size_);
+#endif
+  map_addr_ = NULL;
+  buffer_.clear();
+  filename_ = "";
+  data_ = NULL;
+  size_ = 0;
+  is_open_ = false;
+}
+
+
+SharedMappedFile::SharedMappedFile(): ref_count_(1) {
+  pthread_mutex_init(&mutex_, NULL);
+}
+
+SharedMappedFile::~SharedMappedFile() {
+  pthread_mutex_destroy(&mutex_);
+}
+
+SharedMappedFile *SharedMappedFile::Open(const std::string &filename) {
+  SharedMappedFile *ans = new SharedMappedFile();
+  if (!ans->file_.Open(filename)) {
+    delete ans;
+    return NULL;
+  }
+  return ans;
+}
+
+void SharedMappedFile::Ref() {
+  pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(ref_count_ > 0);
+  ref_count_++;
+  pthread_mutex_unlock(&mutex_);
+}
+
+void SharedMappedFile::Unref() {
+  pthread_mutex_lock(&mutex_);
+  KALDI_ASSERT(ref_count_ > 0);
+  bool last = (--ref_count_ == 0);
+  pthread_mutex_unlock(&mutex_);
+  if (last) delete this;
+}
+
+
+void MappedStreambuf::SetRegion(const char *data, size_t size,
+                                SharedMappedFile *owner) {
+  // std::streambuf wants non-const pointers, but we never write through them.
+  char *begin = const_cast<char*>(data);
+  setg(begin, begin, begin + size);
+  owner_ = owner;
+}
+
+void MappedStreambuf::Skip(size_t n) {
+  KALDI_ASSERT(n <= Remaining());
+  setg(eback(), gptr() + n, egptr());
+}
+
+MappedStreambuf::pos_type MappedStreambuf::seekoff(
+    off_type off, std::ios_base::seekdir way, std::ios_base::openmode which) {
+  if (!(which & std::ios_base::in))
+    return pos_type(off_type(-1));
+  off_type base;
+  if (way == std::ios_base::beg) base = 0;
+  else if (way == std::ios_base::cur) base = gptr() - eback();
+  else base = egptr() - eback();
+  return seekpos(pos_type(base + off), which);
+}
+
+MappedStreambuf::pos_type MappedStreambuf::seekpos(
+    pos_type pos, std::ios_base::openmode which) {
+  off_type off = pos;
+  if (!(which & std::ios_base::in) || off < 0 || off > egptr() - eback())
+    return pos_type(off_type(-1));
+  setg(eback(), eback() + off, egptr());
+  return pos;
+}
+
+std::streamsize MappedStreambuf::showmanyc() {
+  std::streamsize ans = egptr() - gptr();
+  return (ans == 0 ? -1 : ans);
+}
+
+}  // namespace kaldi
@@ -0,0 +1,141 @@
+// util/kaldi-mapped-file.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_MAPPED_FILE_H_
+#define KALDI_UTIL_KALDI_MAPPED_FILE_H_
+
+#include <pthread.h>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+
+
+namespace kaldi {
+
+/// \addtogroup io_group
+/// @{
+
+/// MappedFile gives read-only access to the contents of a file by mapping it
+/// into memory (where the platform does not support this, e.g. Windows, it
+/// reads the whole file into memory instead).  The data stays valid until
+/// Close() is called or the object is destroyed.
+class MappedFile {
+ public:
+  MappedFile(): data_(NULL), size_(0), is_open_(false), map_addr_(NULL) { }
+
+  /// Maps the file "filename" (an actual filename, not an rxfilename).
+  /// Returns true on success; on failure it prints a warning.
+  bool Open(const std::string &filename);
+
+  bool IsOpen() const { return is_open_; }
+
+  /// Returns the filename given to Open().
+  const std::string &Filename() const { return filename_; }
+
+  /// Returns the start of the data (may be NULL if Size() == 0).
+  const char *Data() const { return data_; }
+
+  /// Returns the size of the file in bytes.
+  size_t Size() const { return size_; }
+
+  void Close();
+
+  ~MappedFile() { Close(); }
+ private:
+  std::string filename_;
+  const char *data_;
+  size_t size_;
+  bool is_open_;
+  void *map_addr_;  // If we used mmap, the start of the mapped region.
+  std::vector<char> buffer_;  // Otherwise, the file contents.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MappedFile);
+};
+
+
+/// SharedMappedFile is a MappedFile with a reference count, for when objects
+/// read from the file point into it (see MatrixViewHolder in
+/// kaldi-holder-inl.h) and may outlive the Input object that opened it.  It
+/// starts with a reference count of one; whoever wants to keep the data calls
+/// Ref(), and Unref() when done, and the last Unref() deletes the object.
+/// Ref() and Unref() may be called from different threads.
+class SharedMappedFile {
+ public:
+  /// Maps the file "filename" (an actual filename, not an rxfilename).
+  /// Returns NULL (with a warning) on failure.
+  static SharedMappedFile *Open(const std::string &filename);
+
+  const MappedFile &File() const { return file_; }
+
+  void Ref();
+  void Unref();
+ private:
+  SharedMappedFile();
+  ~SharedMappedFile();
+  MappedFile file_;
+  int32 ref_count_;  // protected by mutex_.
+  pthread_mutex_t mutex_;
+  KALDI_DISALLOW_COPY_AND_ASSIGN(SharedMappedFile);
+};
+
+
+/// MappedStreambuf is a read-only std::streambuf over a region of memory
+/// (typically a MappedFile), so that an std::istream can read from it without
+/// any system calls or intermediate buffering, and seeking is free.  It also
+/// lets code that knows about it get at the bytes directly, e.g. to create a
+/// SubMatrix that points into the file (see MatrixViewHolder in
+/// kaldi-holder-inl.h); such code can find it with
+/// dynamic_cast<MappedStreambuf*>(is.rdbuf()).
+class MappedStreambuf: public std::streambuf {
+ public:
+  MappedStreambuf(): owner_(NULL) { }
+
+  /// Sets the region; the read position is put at the start.  "owner", if
+  /// non-NULL, is the file the region belongs to; we don't take a reference.
+  void SetRegion(const char *data, size_t size,
+                 SharedMappedFile *owner = NULL);
+
+  /// Returns the file the region belongs to, or NULL if it was not given.
+  /// Code that keeps pointers into the region after reading must Ref() it
+  /// (and only keep such pointers if it is non-NULL).
+  SharedMappedFile *Owner() const { return owner_; }
+
+  /// Returns a pointer to the current read position.
+  const char *Current() const { return gptr(); }
+
+  /// Returns the number of bytes after the current read position.
+  size_t Remaining() const { return egptr() - gptr(); }
+
+  /// Advances the read position by n bytes; n must be <= Remaining().
+  void Skip(size_t n);
+
+ protected:
+  virtual pos_type seekoff(off_type off, std::ios_base::seekdir way,
+                           std::ios_base::openmode which);
+  virtual pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+  virtual std::streamsize showmanyc();
+ private:
+  SharedMappedFile *owner_;
+};
+
+/// @} end "addtogroup io_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_MAPPED_FILE_H_
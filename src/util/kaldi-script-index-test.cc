@@ -0,0 +1,219 @@
+// util/kaldi-script-index-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include "util/kaldi-script-index.h"
+#include "util/kaldi-table.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utime.h>
+
+namespace kaldi {
+
+// Writes the scp file "filename" and sets its modification time to a few
+// minutes ago (a different time each call, as would happen in reality), so
+// that an index cached now is considered up to date.
+static void WriteScp(
+    const std::string &filename,
+    const std::vector<std::pair<std::string, std::string> > &script) {
+  std::ofstream os(filename.c_str());
+  for (size_t i = 0; i < script.size(); i++)
+    os << script[i].first << (Rand() % 2 == 0 ? " " : " \t ")
+       << script[i].second << '\n';
+  os.close();
+  struct utimbuf times;
+  static int32 counter = 0;
+  times.actime = times.modtime = time(NULL) - 1000 + (counter++ % 500);
+  utime(filename.c_str(), &times);
+}
+
+static void CheckIndex(
+    const ScriptIndex &index,
+    const std::vector<std::pair<std::string, std::string> > &script) {
+  KALDI_ASSERT(index.NumEntries() == static_cast<int64>(script.size()));
+  int64 unsorted_entry = -1;
+  for (size_t i = 0; i < script.size(); i++) {
+    int64 entry;
+    KALDI_ASSERT(index.Lookup(script[i].first, &entry) &&
+                 entry == static_cast<int64>(i));
+    KALDI_ASSERT(index.Key(entry) == script[i].first);
+    KALDI_ASSERT(index.Rxfilename(entry) == script[i].second);
+    if (unsorted_entry == -1 && i > 0 && !(script[i-1].first < script[i].first))
+      unsorted_entry = i;
+  }
+  KALDI_ASSERT(index.UnsortedEntry() == unsorted_entry);
+  int64 entry;
+  KALDI_ASSERT(!index.Lookup("foo", &entry));
+}
+
+void TestScriptIndex() {
+  int32 num_keys = Rand() % 500;
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 i = 0; i < num_keys; i++) {
+    std::ostringstream key, rxfilename;
+    key << "utt" << i;
+    switch (Rand() % 4) {
+      case 0: rxfilename << "/data/raw_mfcc." << (Rand() % 3) << ".ark:"
+                         << (Rand() % 100000); break;
+      case 1: rxfilename << "foo.ark:" << (Rand() % 1000) << "[0:"
+                         << (Rand() % 10) << "]"; break;
+      case 2: rxfilename << "gunzip -c foo" << i << ".gz |"; break;
+      default: rxfilename << "utt" << i << ".mat"; break;
+    }
+    script.push_back(std::make_pair(key.str(), rxfilename.str()));
+  }
+  if (Rand() % 2 == 0)
+    std::sort(script.begin(), script.end());
+  else
+    for (int32 i = 0; i + 1 < num_keys; i++)
+      std::swap(script[i], script[i + Rand() % (num_keys - i)]);
+  WriteScp("tmpf.scp", script);
+  unlink(ScriptIndexCacheFilename("tmpf.scp").c_str());
+
+  bool use_cache = (Rand() % 2 == 0);
+  ScriptIndex *index = ScriptIndex::Acquire("tmpf.scp", use_cache);
+  KALDI_ASSERT(index != NULL);
+  CheckIndex(*index, script);
+  // A second reader of the same scp file shares the index.
+  ScriptIndex *index2 = ScriptIndex::Acquire("tmpf.scp", use_cache);
+  KALDI_ASSERT(index2 == index);
+  index2->Release();
+  index->Release();
+
+  struct stat buf;
+  KALDI_ASSERT((stat(ScriptIndexCacheFilename("tmpf.scp").c_str(), &buf) == 0)
+               == use_cache);
+  // This reads the cache, if we wrote it.
+  index = ScriptIndex::Acquire("tmpf.scp", true);
+  KALDI_ASSERT(index != NULL);
+  CheckIndex(*index, script);
+  index->Release();
+
+  // If the scp file changes, the cache is not used.
+  if (num_keys > 0) {
+    script.pop_back();
+    WriteScp("tmpf.scp", script);
+    index = ScriptIndex::Acquire("tmpf.scp", true);
+    KALDI_ASSERT(index != NULL);
+    CheckIndex(*index, script);
+    index->Release();
+  }
+
+  // A duplicate key is an error.
+  if (!script.empty()) {
+    script.push_back(script[Rand() % script.size()]);
+    WriteScp("tmpf.scp", script);
+    KALDI_ASSERT(ScriptIndex::Acquire("tmpf.scp", true) == NULL);
+  }
+  unlink("tmpf.scp");
+  unlink(ScriptIndexCacheFilename("tmpf.scp").c_str());
+}
+
+
+// Reads the whole of file "filename" into a string.
+static std::string ReadWholeFile(const std::string &filename) {
+  std::ifstream is(filename.c_str(), std::ios_base::in | std::ios_base::binary);
+  std::ostringstream os;
+  os << is.rdbuf();
+  return os.str();
+}
+
+// Corrupts one offset, length, prefix or hash slot of the cached index so that
+// it points outside the data, and checks that the cache is then ignored (the
+// index is rebuilt from the scp file) and rewritten.
+void TestScriptIndexCorruptedCache() {
+  int32 num_keys = 1 + Rand() % 100;
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 i = 0; i < num_keys; i++) {
+    std::ostringstream key, rxfilename;
+    key << "utt" << i;
+    rxfilename << "foo" << (Rand() % 3) << ".ark:" << (Rand() % 100000);
+    script.push_back(std::make_pair(key.str(), rxfilename.str()));
+  }
+  WriteScp("tmpf.scp", script);
+  std::string cache_filename = ScriptIndexCacheFilename("tmpf.scp");
+  unlink(cache_filename.c_str());
+  ScriptIndex *index = ScriptIndex::Acquire("tmpf.scp", true);
+  KALDI_ASSERT(index != NULL);
+  index->Release();
+  std::string cache = ReadWholeFile(cache_filename);
+  KALDI_ASSERT(cache.size() > sizeof(ScriptIndexHeader));
+
+  ScriptIndexHeader header;
+  memcpy(&header, cache.data(), sizeof(header));
+  size_t entries_pos = sizeof(header),
+      prefixes_pos = entries_pos +
+          sizeof(ScriptIndexEntry) * header.num_entries,
+      slots_pos = prefixes_pos + sizeof(int64) * (header.num_prefixes + 1);
+  std::string corrupted(cache);
+  int32 entry = Rand() % num_keys;
+  ScriptIndexEntry e;
+  memcpy(&e, cache.data() + entries_pos + sizeof(e) * entry, sizeof(e));
+  int32 what = Rand() % 5;
+  switch (what) {
+    case 0: e.key_offset = header.strings_size; break;
+    case 1: e.suffix_length = header.strings_size; break;
+    case 2: e.prefix = header.num_prefixes; break;
+    case 3: {
+      int64 offset = header.strings_size + 1;
+      corrupted.replace(prefixes_pos + sizeof(int64) * header.num_prefixes,
+                        sizeof(offset),
+                        reinterpret_cast<const char*>(&offset),
+                        sizeof(offset));
+      break;
+    }
+    default: {
+      uint32 slot = header.num_entries + 1;
+      int64 s = Rand() % header.num_slots;
+      corrupted.replace(slots_pos + sizeof(uint32) * s, sizeof(slot),
+                        reinterpret_cast<const char*>(&slot), sizeof(slot));
+    }
+  }
+  if (what < 3)
+    corrupted.replace(entries_pos + sizeof(e) * entry, sizeof(e),
+                      reinterpret_cast<const char*>(&e), sizeof(e));
+  KALDI_ASSERT(corrupted != cache);
+  {
+    std::ofstream os(cache_filename.c_str(),
+                     std::ios_base::out | std::ios_base::binary);
+    os.write(corrupted.data(), corrupted.size());
+  }
+  index = ScriptIndex::Acquire("tmpf.scp", true);
+  KALDI_ASSERT(index != NULL);
+  CheckIndex(*index, script);
+  index->Release();
+  KALDI_ASSERT(ReadWholeFile(cache_filename) == cache);
+  unlink("tmpf.scp");
+  unlink(cache_filename.c_str());
+}
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestScriptIndex();
+  for (int32 i = 0; i < 10; i++)
+    TestScriptIndexCorruptedCache();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,420 @@
+// util/kaldi-script-index.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <sstream>
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+#include "util/kaldi-script-index.h"
+#include "util/kaldi-index-common.h"
+#include "util/kaldi-io.h"
+#include "util/stl-utils.h"
+#include "util/text-utils.h"
+
+
+namespace kaldi {
+
+static const char *kScriptIndexMagic = "KaldiSix";
+static const uint32 kScriptIndexByteOrderCheck = 0x01020304;
+static const uint32 kScriptIndexVersion = 1;
+
+// The hash of a key, folded to 32 bits.
+static uint32 ScriptIndexHash(const char *key, size_t length) {
+  uint64 ans = IndexHash(key, length);
+  return static_cast<uint32>(ans ^ (ans >> 32));
+}
+
+// Returns the part of an rxfilename that is likely to be shared with other
+// lines of the scp file: the part up to and including its last ':' (not
+// counting any ':' inside a final "[...]" range specifier), e.g. "foo.ark:"
+// for "foo.ark:1234[0:9]".
+static size_t SharedPrefixLength(const std::string &rxfilename) {
+  size_t end = rxfilename.size();
+  if (end != 0 && rxfilename[end - 1] == ']') {
+    size_t bracket = rxfilename.rfind('[');
+    if (bracket != std::string::npos) end = bracket;
+  }
+  if (end == 0) return 0;
+  size_t colon = rxfilename.rfind(':', end - 1);
+  return (colon == std::string::npos ? 0 : colon + 1);
+}
+
+std::string ScriptIndexCacheFilename(const std::string &script_filename) {
+  return script_filename + ".idx";
+}
+
+
+// The indexes of the scp files that are actual files, by filename, so that
+// readers of the same scp file can share them.
+static std::map<std::string, ScriptIndex*> shared_script_indexes;
+static pthread_mutex_t shared_script_indexes_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Locks shared_script_indexes_mutex for the lifetime of the object.
+class ScriptIndexLock {
+ public:
+  ScriptIndexLock() { pthread_mutex_lock(&shared_script_indexes_mutex); }
+  ~ScriptIndexLock() { pthread_mutex_unlock(&shared_script_indexes_mutex); }
+};
+
+
+ScriptIndex::ScriptIndex(): header_(NULL), entries_(NULL),
+                            prefix_offsets_(NULL), slots_(NULL),
+                            strings_(NULL), ref_count_(0), shared_(false) { }
+
+ScriptIndex *ScriptIndex::Acquire(const std::string &script_rxfilename,
+                                  bool use_cache) {
+  int64 script_size = 0, script_mtime = 0;
+  // We only share (and cache) the index if the scp file is an actual file,
+  // because only then can we tell whether it has changed.
+  bool is_file = (ClassifyRxfilename(script_rxfilename) == kFileInput &&
+                  GetFileInfo(script_rxfilename, &script_size, &script_mtime));
+
+  // We hold the lock while building the index, so that several threads
+  // opening the same scp file at the same time only build it once.
+  ScriptIndexLock lock;
+  if (is_file) {
+    std::map<std::string, ScriptIndex*>::iterator iter =
+        shared_script_indexes.find(script_rxfilename);
+    if (iter != shared_script_indexes.end()) {
+      ScriptIndex *index = iter->second;
+      if (index->header_->script_size == script_size &&
+          index->header_->script_mtime == script_mtime) {
+        index->ref_count_++;
+        return index;
+      }
+      // The scp file has changed; its current readers keep the old index.
+      index->shared_ = false;
+      shared_script_indexes.erase(iter);
+    }
+  }
+  ScriptIndex *index = new ScriptIndex();
+  std::string cache_filename = ScriptIndexCacheFilename(script_rxfilename);
+  if (!(use_cache && is_file &&
+        index->ReadCache(cache_filename, script_size, script_mtime))) {
+    if (!index->Build(script_rxfilename, script_size, script_mtime)) {
+      delete index;
+      return NULL;
+    }
+    if (use_cache && is_file)
+      index->WriteCache(cache_filename);
+  }
+  index->ref_count_ = 1;
+  if (is_file) {
+    index->shared_ = true;
+    shared_script_indexes[script_rxfilename] = index;
+  }
+  return index;
+}
+
+void ScriptIndex::Release() {
+  ScriptIndexLock lock;
+  KALDI_ASSERT(ref_count_ > 0);
+  if (--ref_count_ > 0)
+    return;
+  if (shared_) {
+    std::map<std::string, ScriptIndex*>::iterator iter =
+        shared_script_indexes.begin();
+    for (; iter != shared_script_indexes.end(); ++iter) {
+      if (iter->second == this) {
+        shared_script_indexes.erase(iter);
+        break;
+      }
+    }
+  }
+  delete this;
+}
+
+bool ScriptIndex::Build(const std::string &script_rxfilename,
+                        int64 script_size, int64 script_mtime) {
+  bool is_binary;
+  Input input;
+  if (!input.Open(script_rxfilename, &is_binary)) {
+    KALDI_WARN << "Error opening script file: "
+               << PrintableRxfilename(script_rxfilename);
+    return false;
+  }
+  if (is_binary) {
+    KALDI_WARN << "Error: script file appears to be binary: "
+               << PrintableRxfilename(script_rxfilename);
+    return false;
+  }
+  std::istream &is = input.Stream();
+
+  std::vector<ScriptIndexEntry> entries;
+  std::string strings;  // the keys and the rest of the rxfilenames.
+  std::string prefixes;  // the prefixes of the rxfilenames.
+  std::vector<int64> prefix_offsets;  // offsets within "prefixes".
+  unordered_map<std::string, int32, StringHasher> prefix_ids;
+  int64 unsorted_entry = -1;
+
+  std::string line, key, rest, prefix, prev_key;
+  int64 line_number = 0;
+  while (std::getline(is, line)) {
+    line_number++;
+    if (line.empty()) {
+      KALDI_WARN << "Empty " << line_number << "'th line in script file "
+                 << PrintableRxfilename(script_rxfilename);
+      return false;
+    }
+    SplitStringOnFirstSpace(line, &key, &rest);
+    if (key.empty() || rest.empty()) {
+      KALDI_WARN << "Invalid " << line_number << "'th line in script file "
+                 << PrintableRxfilename(script_rxfilename) << ":\"" << line
+                 << '"';
+      return false;
+    }
+    size_t prefix_length = SharedPrefixLength(rest);
+    prefix.assign(rest, 0, prefix_length);
+    std::pair<unordered_map<std::string, int32, StringHasher>::iterator,
+              bool> ans = prefix_ids.insert(
+                  std::make_pair(prefix,
+                                 static_cast<int32>(prefix_offsets.size())));
+    if (ans.second) {
+      prefix_offsets.push_back(prefixes.size());
+      prefixes.append(prefix);
+    }
+    ScriptIndexEntry entry;
+    entry.key_offset = strings.size();
+    entry.hash = ScriptIndexHash(key.data(), key.size());
+    entry.key_length = key.size();
+    entry.suffix_length = rest.size() - prefix_length;
+    entry.prefix = ans.first->second;
+    strings.append(key);
+    strings.append(rest, prefix_length, std::string::npos);
+    if (unsorted_entry == -1 && line_number > 1 && !(prev_key < key))
+      unsorted_entry = entries.size();
+    entries.push_back(entry);
+    prev_key.swap(key);
+  }
+  KALDI_ASSERT(entries.size() < static_cast<size_t>(
+      std::numeric_limits<uint32>::max()));
+
+  int64 num_entries = entries.size(), num_slots = 2,
+      num_prefixes = prefix_offsets.size();
+  while (num_slots < 2 * num_entries)
+    num_slots *= 2;
+  uint32 mask = static_cast<uint32>(num_slots - 1);
+  std::vector<uint32> slots(num_slots, 0);  // entry + 1, or 0 if empty.
+  for (int64 i = 0; i < num_entries; i++) {
+    const ScriptIndexEntry &entry = entries[i];
+    uint32 s = entry.hash & mask;
+    for (; slots[s] != 0; s = (s + 1) & mask) {
+      const ScriptIndexEntry &other = entries[slots[s] - 1];
+      if (other.hash == entry.hash && other.key_length == entry.key_length &&
+          strings.compare(other.key_offset, other.key_length,
+                          strings, entry.key_offset, entry.key_length) == 0) {
+        KALDI_WARN << "Script file " << PrintableRxfilename(script_rxfilename)
+                   << " contains duplicate key: "
+                   << strings.substr(entry.key_offset, entry.key_length);
+        return false;
+      }
+    }
+    slots[s] = i + 1;
+  }
+  // The prefixes go after the other strings.
+  for (int64 i = 0; i < num_prefixes; i++)
+    prefix_offsets[i] += strings.size();
+  prefix_offsets.push_back(strings.size() + prefixes.size());
+
+  ScriptIndexHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kScriptIndexMagic, sizeof(header.magic));
+  header.byte_order_check = kScriptIndexByteOrderCheck;
+  header.version = kScriptIndexVersion;
+  header.script_size = script_size;
+  header.script_mtime = script_mtime;
+  header.num_entries = num_entries;
+  header.num_slots = num_slots;
+  header.num_prefixes = num_prefixes;
+  header.strings_size = strings.size() + prefixes.size();
+  header.unsorted_entry = unsorted_entry;
+
+  size_t size = sizeof(header) + sizeof(ScriptIndexEntry) * num_entries +
+      sizeof(int64) * (num_prefixes + 1) + sizeof(uint32) * num_slots +
+      header.strings_size;
+  buffer_.resize(size);
+  char *p = &(buffer_[0]);
+  memcpy(p, &header, sizeof(header));
+  p += sizeof(header);
+  if (num_entries != 0)
+    memcpy(p, &(entries[0]), sizeof(ScriptIndexEntry) * num_entries);
+  p += sizeof(ScriptIndexEntry) * num_entries;
+  memcpy(p, &(prefix_offsets[0]), sizeof(int64) * (num_prefixes + 1));
+  p += sizeof(int64) * (num_prefixes + 1);
+  memcpy(p, &(slots[0]), sizeof(uint32) * num_slots);
+  p += sizeof(uint32) * num_slots;
+  memcpy(p, strings.data(), strings.size());
+  p += strings.size();
+  memcpy(p, prefixes.data(), prefixes.size());
+  bool ans = SetPointers(&(buffer_[0]), size);
+  KALDI_ASSERT(ans);
+  return true;
+}
+
+bool ScriptIndex::SetPointers(const char *data, size_t size) {
+  if (size < sizeof(ScriptIndexHeader))
+    return false;
+  const ScriptIndexHeader *header =
+      reinterpret_cast<const ScriptIndexHeader*>(data);
+  // We check the counts against "size" one at a time before multiplying, so
+  // that a corrupted header can't make the total size overflow.
+  int64 max_count = static_cast<int64>(size);
+  if (memcmp(header->magic, kScriptIndexMagic, sizeof(header->magic)) != 0 ||
+      header->byte_order_check != kScriptIndexByteOrderCheck ||
+      header->version != kScriptIndexVersion ||
+      header->num_entries < 0 || header->num_entries > max_count ||
+      header->num_entries >=
+      static_cast<int64>(std::numeric_limits<uint32>::max()) ||
+      header->num_prefixes < 0 || header->num_prefixes > max_count ||
+      header->num_prefixes >
+      static_cast<int64>(std::numeric_limits<int32>::max()) ||
+      header->num_slots <= header->num_entries ||
+      header->num_slots > max_count ||
+      (header->num_slots & (header->num_slots - 1)) != 0 ||
+      header->strings_size < 0 || header->strings_size > max_count ||
+      header->unsorted_entry < -1 ||
+      header->unsorted_entry >= header->num_entries ||
+      size != sizeof(ScriptIndexHeader) +
+      sizeof(ScriptIndexEntry) * header->num_entries +
+      sizeof(int64) * (header->num_prefixes + 1) +
+      sizeof(uint32) * header->num_slots + header->strings_size)
+    return false;
+  const ScriptIndexEntry *entries =
+      reinterpret_cast<const ScriptIndexEntry*>(header + 1);
+  const int64 *prefix_offsets = reinterpret_cast<const int64*>(
+      entries + header->num_entries);
+  const uint32 *slots = reinterpret_cast<const uint32*>(
+      prefix_offsets + header->num_prefixes + 1);
+  // Every string we may access must lie within the strings, and Lookup() must
+  // only find valid entries and must find an empty slot to stop at.
+  int64 strings_size = header->strings_size;
+  if (prefix_offsets[0] < 0 ||
+      prefix_offsets[header->num_prefixes] > strings_size)
+    return false;
+  for (int64 i = 0; i < header->num_prefixes; i++)
+    if (prefix_offsets[i + 1] < prefix_offsets[i])
+      return false;
+  for (int64 i = 0; i < header->num_entries; i++) {
+    const ScriptIndexEntry &e = entries[i];
+    if (e.key_offset < 0 || e.key_offset > strings_size ||
+        e.key_length <= 0 || e.suffix_length < 0 ||
+        static_cast<int64>(e.key_length) + e.suffix_length >
+        strings_size - e.key_offset ||
+        e.prefix < 0 || e.prefix >= header->num_prefixes)
+      return false;
+  }
+  int64 num_used_slots = 0;
+  for (int64 s = 0; s < header->num_slots; s++) {
+    if (slots[s] == 0) continue;
+    if (static_cast<int64>(slots[s]) > header->num_entries)
+      return false;
+    num_used_slots++;
+  }
+  if (num_used_slots > header->num_entries)
+    return false;
+  header_ = header;
+  entries_ = entries;
+  prefix_offsets_ = prefix_offsets;
+  slots_ = slots;
+  strings_ = reinterpret_cast<const char*>(slots_ + header->num_slots);
+  return true;
+}
+
+bool ScriptIndex::ReadCache(const std::string &cache_filename,
+                            int64 script_size, int64 script_mtime) {
+  int64 cache_size, cache_mtime;
+  // The modification time may only have a resolution of a second, so if the
+  // cache was written at the same time as the scp file, we don't trust it.
+  if (!GetFileInfo(cache_filename, &cache_size, &cache_mtime) ||
+      cache_mtime <= script_mtime)
+    return false;
+  if (!file_.Open(cache_filename))
+    return false;
+  if (!SetPointers(file_.Data(), file_.Size())) {
+    KALDI_WARN << "Ignoring corrupted or incompatible script index "
+               << cache_filename;
+    file_.Close();
+    return false;
+  }
+  if (header_->script_size != script_size ||
+      header_->script_mtime != script_mtime) {
+    file_.Close();
+    header_ = NULL;
+    return false;
+  }
+  return true;
+}
+
+void ScriptIndex::WriteCache(const std::string &cache_filename) const {
+  // Write to a temporary file and rename it, so that other programs reading
+  // the same scp file never see a partly written cache.
+  std::ostringstream tmp_filename;
+  tmp_filename << cache_filename << ".tmp";
+#ifndef _MSC_VER
+  tmp_filename << '.' << getpid();
+#endif
+  std::ofstream os(tmp_filename.str().c_str(),
+                   std::ios_base::out | std::ios_base::binary);
+  if (os.is_open()) {
+    os.write(&(buffer_[0]), buffer_.size());
+    os.close();
+    if (!os.fail() &&
+        std::rename(tmp_filename.str().c_str(), cache_filename.c_str()) == 0)
+      return;
+  }
+  KALDI_WARN << "Failed to write script index " << cache_filename;
+  std::remove(tmp_filename.str().c_str());
+}
+
+bool ScriptIndex::Lookup(const std::string &key, int64 *entry) const {
+  uint32 hash = ScriptIndexHash(key.data(), key.size()),
+      mask = static_cast<uint32>(header_->num_slots - 1);
+  for (uint32 s = hash & mask; slots_[s] != 0; s = (s + 1) & mask) {
+    const ScriptIndexEntry &e = entries_[slots_[s] - 1];
+    if (e.hash == hash && e.key_length == static_cast<int32>(key.size()) &&
+        memcmp(strings_ + e.key_offset, key.data(), key.size()) == 0) {
+      *entry = slots_[s] - 1;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string ScriptIndex::Key(int64 entry) const {
+  KALDI_ASSERT(entry >= 0 && entry < header_->num_entries);
+  const ScriptIndexEntry &e = entries_[entry];
+  return std::string(strings_ + e.key_offset, e.key_length);
+}
+
+std::string ScriptIndex::Rxfilename(int64 entry) const {
+  KALDI_ASSERT(entry >= 0 && entry < header_->num_entries);
+  const ScriptIndexEntry &e = entries_[entry];
+  const char *prefix = strings_ + prefix_offsets_[e.prefix];
+  std::string ans(prefix, prefix_offsets_[e.prefix + 1] -
+                  prefix_offsets_[e.prefix]);
+  ans.append(strings_ + e.key_offset + e.key_length, e.suffix_length);
+  return ans;
+}
+
+}  // namespace kaldi
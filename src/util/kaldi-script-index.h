@@ -0,0 +1,160 @@
+// util/kaldi-script-index.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
+#define KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
+
+#include <string>
+#include <vector>
+#include "base/kaldi-common.h"
+#include "util/kaldi-mapped-file.h"
+
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+/*
+  A ScriptIndex is a compact, read-only, hashed representation of an scp file,
+  used by RandomAccessTableReader to look up keys in "scp:" rspecifiers.
+  Compared with reading the scp file into a vector of pairs of strings (as
+  ReadScriptFile() does), it needs a fraction of the memory: all the strings
+  live in one buffer, and the part of each rxfilename up to its last ':' (for
+  most scp files, the name of an archive that is shared by many lines) is
+  stored only once.  Lookup is by hash, so the keys do not have to be sorted.
+
+  ScriptIndex objects are shared: if several readers in a process open the same
+  scp file (and it has not changed in between), they get the same object.
+
+  If the "idx" option is given in the rspecifier (e.g. "scp,idx:foo.scp") and
+  the scp file is an actual file, the index is also cached on disk, in
+  foo.scp.idx, and the next program to open the scp file memory-maps the cache
+  instead of parsing the scp file.  The cache records the size and
+  modification time of the scp file, and is ignored (and rewritten) if they do
+  not match.  Its format (in the native byte order) is the same as the layout
+  in memory:
+
+    ScriptIndexHeader
+    num_entries x ScriptIndexEntry     [in the order of the scp file]
+    (num_prefixes + 1) x int64         [offsets of the prefixes in the strings]
+    num_slots x uint32                 [hash table; num_slots is a power of two]
+    the strings.
+*/
+
+struct ScriptIndexHeader {
+  char magic[8];  // "KaldiSix"
+  uint32 byte_order_check;  // 0x01020304 in the byte order of the writer.
+  uint32 version;  // currently 1.
+  int64 script_size;  // size in bytes and modification time of the scp file
+  int64 script_mtime;  // the index was built from (only used for the cache).
+  int64 num_entries;
+  int64 num_slots;  // a power of two, at least twice num_entries.
+  int64 num_prefixes;
+  int64 strings_size;
+  int64 unsorted_entry;  // the first entry whose key is not greater than the
+                         // key before it, or -1 if the keys are sorted.
+};
+
+struct ScriptIndexEntry {
+  int64 key_offset;  // offset of the key in the strings; the rest of the
+                     // rxfilename (after the prefix) follows it directly.
+  uint32 hash;  // hash of the key.
+  int32 key_length;
+  int32 suffix_length;
+  int32 prefix;  // index of the prefix of the rxfilename.
+};
+
+/// Returns the name of the file in which the index of the scp file
+/// "script_filename" is cached, which is script_filename + ".idx".
+std::string ScriptIndexCacheFilename(const std::string &script_filename);
+
+class ScriptIndex {
+ public:
+  /// Returns the index of the scp file "script_rxfilename", reading the scp
+  /// file (or the cache, if use_cache is true) unless another reader already
+  /// has it; it must be given back with Release().  If use_cache is true and
+  /// the scp file is an actual file, it uses the cache file if it is up to
+  /// date, and otherwise writes it.  Returns NULL, with a warning, if the scp
+  /// file cannot be read, has a line that is not of the form "key rxfilename",
+  /// or has a duplicate key.
+  static ScriptIndex *Acquire(const std::string &script_rxfilename,
+                              bool use_cache);
+
+  /// Gives back an index obtained from Acquire(); it is deleted when no
+  /// reader uses it any more.
+  void Release();
+
+  int64 NumEntries() const { return header_->num_entries; }
+
+  /// Looks up "key"; if it is present, outputs its entry (its zero-based
+  /// line number in the scp file) and returns true.
+  bool Lookup(const std::string &key, int64 *entry) const;
+
+  std::string Key(int64 entry) const;
+
+  std::string Rxfilename(int64 entry) const;
+
+  /// Returns the first entry whose key is not greater (in the order of
+  /// std::string) than the key of the entry before it, or -1 if the keys in
+  /// the scp file are sorted.  Used to check the "s" option.
+  int64 UnsortedEntry() const { return header_->unsorted_entry; }
+
+ private:
+  ScriptIndex();
+  ~ScriptIndex() { }
+
+  // Reads the scp file and builds the index in buffer_; script_size and
+  // script_mtime are recorded in the header.  Returns false (with a warning)
+  // on error.
+  bool Build(const std::string &script_rxfilename,
+             int64 script_size, int64 script_mtime);
+
+  // Uses the cache file if it matches the scp file's size and modification
+  // time.  Returns false (without a warning unless it is corrupted) if not.
+  bool ReadCache(const std::string &cache_filename,
+                 int64 script_size, int64 script_mtime);
+
+  // Writes the index in buffer_ to the cache file.
+  void WriteCache(const std::string &cache_filename) const;
+
+  // Sets header_ etc. to point into "data", and returns false if the header,
+  // or any offset, length, prefix or hash slot, is inconsistent with "size",
+  // so that a corrupted cache can't cause reads outside "data".
+  bool SetPointers(const char *data, size_t size);
+
+  std::vector<char> buffer_;  // The index, if we built it ourselves...
+  MappedFile file_;  // ... or if we read it from the cache.
+  const ScriptIndexHeader *header_;
+  const ScriptIndexEntry *entries_;
+  const int64 *prefix_offsets_;
+  const uint32 *slots_;
+  const char *strings_;
+
+  // The following are protected by the mutex in kaldi-script-index.cc.
+  int32 ref_count_;
+  bool shared_;  // true if other readers can get this object from Acquire().
+  KALDI_DISALLOW_COPY_AND_ASSIGN(ScriptIndex);
+};
+
+/// @} end "addtogroup table_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_SCRIPT_INDEX_H_
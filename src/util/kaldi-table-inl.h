@@ -22,8 +22,16 @@
 #ifndef KALDI_UTIL_KALDI_TABLE_INL_H_
 #define KALDI_UTIL_KALDI_TABLE_INL_H_
 
+#include <pthread.h>
 #include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <map>
 #include "util/kaldi-io.h"
+#include "util/kaldi-archive-index.h"
+#include "util/kaldi-script-index.h"
+#include "util/kaldi-table-profile.h"
+#include "util/block-compression.h"
 #include "util/text-utils.h"
 #include "util/stl-utils.h" // for StringHasher.
 
@@ -45,8 +53,20 @@ template<class Holder> class SequentialTableReaderImplBase {
   virtual void FreeCurrent() = 0;
   virtual void Next() = 0;
   virtual bool Close() = 0;
-  SequentialTableReaderImplBase() { }
+  // This function is for the use of SequentialTableReaderBackgroundImpl.  It
+  // loads the current object if needed, swaps it into *other_holder, and puts
+  // the reader in the same state as if FreeCurrent() had been called.  If the
+  // object could not be loaded it returns false and puts the reason in
+  // *error_msg, without printing anything, so that the caller can report the
+  // error if and when the user asks for the object.
+  virtual bool SwapHolder(Holder *other_holder, std::string *error_msg) = 0;
+  // Sets the object in which to record profiling statistics (see
+  // kaldi-table-profile.h); it is NULL if profiling is off.
+  virtual void SetStats(TableIoStats *stats) { stats_ = stats; }
+  SequentialTableReaderImplBase(): stats_(NULL) { }
   virtual ~SequentialTableReaderImplBase() { }
+ protected:
+  TableIoStats *stats_;
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(SequentialTableReaderImplBase);  
 };
@@ -162,6 +182,17 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       KALDI_WARN << "TableReader: FreeCurrent called at the wrong time.";
     }
   }
+  virtual bool SwapHolder(Holder *other_holder, std::string *error_msg) {
+    if (state_ == kHaveScpLine) LoadCurrent(error_msg);
+    if (state_ != kLoadSucceeded) {
+      if (state_ != kLoadFailed)
+        KALDI_ERR << "TableReader: SwapHolder() called at the wrong time.";
+      return false;  // LoadCurrent() set *error_msg.
+    }
+    holder_.Swap(other_holder);
+    state_ = kLoadFailed;  // the same state as after FreeCurrent().
+    return true;
+  }
   void Next() {
     while (1) {
       NextScpLine();
@@ -211,31 +242,31 @@ template<class Holder>  class SequentialTableReaderScriptImpl:
       holder_.Clear();
   }
  private:  
-  bool LoadCurrent() {
-    // Attempts to load object whose rxfilename is on the current scp line.
+  // Attempts to load object whose rxfilename is on the current scp line.  On
+  // failure it prints a warning, or if error_msg is non-NULL it puts the
+  // message there instead.
+  bool LoadCurrent(std::string *error_msg = NULL) {
     if (state_ != kHaveScpLine)
       KALDI_ERR << "TableReader: LoadCurrent() called at the wrong time.";
     bool ans;
     // note, NULL means it doesn't read the binary-mode header
-    if (Holder::IsReadInBinary()) ans = data_input_.Open(data_rxfilename_, NULL);
+    if (Holder::IsReadInBinary())
+      ans = (opts_.memory_map ? data_input_.OpenMapped(data_rxfilename_, NULL) :
+             data_input_.Open(data_rxfilename_, NULL));
     else ans = data_input_.OpenTextMode(data_rxfilename_);
-    if (!ans) {
-      // May want to make this warning a VLOG at some point
-      KALDI_WARN << "TableReader: failed to open file "
-                 << PrintableRxfilename(data_rxfilename_);
-      state_ = kLoadFailed;
-      return false;
-    } else {
-      if (holder_.Read(data_input_.Stream())) {
-        state_ = kLoadSucceeded;
-        return true;
-      } else {  // holder_ will not contain data.
-        KALDI_WARN << "TableReader: failed to load object from "
-                   << PrintableRxfilename(data_rxfilename_);
-        state_ = kLoadFailed;
-        return false;
-      }
+    if (ans && ProfiledHolderRead(&holder_, data_input_.Stream(),
+                                  this->stats_)) {
+      state_ = kLoadSucceeded;
+      return true;
     }
+    // May want to make this warning a VLOG at some point
+    std::string msg = (ans ? "TableReader: failed to load object from " :
+                       "TableReader: failed to open file ") +
+        PrintableRxfilename(data_rxfilename_);
+    if (error_msg != NULL) *error_msg = msg;
+    else KALDI_WARN << msg;
+    state_ = kLoadFailed;  // holder_ will not contain data.
+    return false;
   }
 
   // Reads the next line in the script file.
@@ -333,7 +364,8 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
     bool ans;
     // NULL means don't expect binary-mode header
     if (Holder::IsReadInBinary())
-      ans = input_.Open(archive_rxfilename_, NULL);
+      ans = (opts_.memory_map ? input_.OpenMapped(archive_rxfilename_, NULL) :
+             input_.Open(archive_rxfilename_, NULL));
     else
       ans = input_.OpenTextMode(archive_rxfilename_);
     if (!ans) {  // header.
@@ -391,7 +423,7 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
       return;
     }
     if (c != '\n') is.get();  // Consume the space or tab.
-    if (holder_.Read(is)) {
+    if (ProfiledHolderRead(&holder_, is, this->stats_)) {
       state_ = kHaveObject;
       return;
     } else {
@@ -453,6 +485,13 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
       KALDI_WARN << "TableReader: FreeCurernt called at the wrong time.";
   }
 
+  virtual bool SwapHolder(Holder *other_holder, std::string *error_msg) {
+    Value();  // throws if we don't have an object, which is a coding error.
+    holder_.Swap(other_holder);
+    state_ = kFreedObject;
+    return true;
+  }
+
   virtual bool Close() {
     if (! this->IsOpen())
       KALDI_ERR << "Close() called on TableReader twice or otherwise wrongly.";
@@ -507,8 +546,242 @@ template<class Holder>  class SequentialTableReaderArchiveImpl:
 };
 
 
+// This is the implementation for SequentialTableReader when the "bg"
+// (background) option is given in the rspecifier.  It wraps one of the other
+// two implementations and calls it from a separate thread, which reads up to
+// kQueueSize objects ahead of the user and hands them over through a queue.
+// The objects are moved between holders with Holder::Swap(), so nothing is
+// copied.  If an object could not be loaded (e.g. a file in a non-permissive
+// scp could not be read), nothing is printed until the user calls Value() on
+// that key, as it would be without the "bg" option; keys that the user skips
+// over produce no errors or warnings.
+// We use pthreads directly because util/ cannot depend on thread/.
+template<class Holder>  class SequentialTableReaderBackgroundImpl:
+      public SequentialTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  // Takes ownership of "base_reader", which must not be open yet.
+  explicit SequentialTableReaderBackgroundImpl(
+      SequentialTableReaderImplBase<Holder> *base_reader):
+      base_reader_(base_reader), current_(NULL), thread_running_(false),
+      producer_done_(false), producer_failed_(false), stop_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&not_empty_, NULL);
+    pthread_cond_init(&not_full_, NULL);
+  }
+
+  virtual void SetStats(TableIoStats *stats) {
+    this->stats_ = stats;
+    base_reader_->SetStats(stats);  // the objects are read by base_reader_.
+  }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (thread_running_ || base_reader_->IsOpen())
+      if (!Close())  // call Close() yourself to suppress this exception.
+        KALDI_ERR << "TableReader::Open, error closing previous input.";
+    rspecifier_ = rspecifier;
+    ClassifyRspecifier(rspecifier, NULL, &opts_);
+    if (!base_reader_->Open(rspecifier))
+      return false;  // it will have printed a warning.
+    producer_done_ = false;
+    producer_failed_ = false;
+    stop_ = false;
+    int ret = pthread_create(&thread_, NULL, &Run, this);
+    if (ret != 0)
+      KALDI_ERR << "Error creating background thread for TableReader, errno "
+                << "was: " << (strerror(ret));
+    thread_running_ = true;
+    FetchNext();
+    return true;
+  }
+
+  virtual bool IsOpen() const { return thread_running_; }
+
+  virtual bool Done() const {
+    if (!thread_running_)
+      KALDI_ERR << "Done() called on TableReader object at the wrong time.";
+    return (current_ == NULL);
+  }
+
+  virtual std::string Key() {
+    if (current_ == NULL)
+      KALDI_ERR << "Key() called on TableReader object at the wrong time.";
+    return current_->key;
+  }
+
+  virtual const T &Value() {
+    if (current_ == NULL)
+      KALDI_ERR << "Value() called on TableReader object at the wrong time.";
+    if (!current_->loaded) {
+      KALDI_WARN << current_->error;
+      KALDI_ERR << "TableReader: failed to read object for key "
+                << current_->key << " (to suppress this error, add the "
+                << "permissive (p, ) option to the rspecifier.";
+    }
+    if (current_->freed)
+      KALDI_ERR << "TableReader: you called Value() after FreeCurrent().";
+    return current_->holder.Value();
+  }
+
+  virtual void FreeCurrent() {
+    if (current_ != NULL && current_->loaded && !current_->freed) {
+      current_->holder.Clear();
+      current_->freed = true;
+    } else {
+      KALDI_WARN << "TableReader: FreeCurrent called at the wrong time.";
+    }
+  }
+
+  virtual void Next() {
+    if (current_ == NULL)
+      KALDI_ERR << "TableReader: Next() called wrongly.";
+    delete current_;
+    current_ = NULL;
+    FetchNext();
+  }
+
+  virtual bool SwapHolder(Holder *other_holder, std::string *error_msg) {
+    KALDI_ERR << "SwapHolder() should not be called on this class.";
+    return false;
+  }
+
+  virtual bool Close() {
+    if (!thread_running_)
+      KALDI_ERR << "Close() called on TableReader twice or otherwise wrongly.";
+    StopThread();
+    bool ans = base_reader_->Close();
+    if (producer_failed_) {
+      if (opts_.permissive)
+        KALDI_WARN << "Error detected in background thread of TableReader, "
+                   << "rspecifier was " << rspecifier_ << ", ignoring it as "
+                   << "permissive mode specified.";
+      else
+        ans = false;
+    }
+    return ans;
+  }
+
+  virtual ~SequentialTableReaderBackgroundImpl() {
+    if (thread_running_)
+      StopThread();
+    pthread_cond_destroy(&not_full_);
+    pthread_cond_destroy(&not_empty_);
+    pthread_mutex_destroy(&mutex_);
+    // The destructor of base_reader_ may throw if it was left in an error
+    // state, just like when this class is not used.
+    delete base_reader_;
+  }
+
+ private:
+  // The number of objects we read ahead of the user (the background thread
+  // may additionally hold one object that it is waiting to queue).
+  static const size_t kQueueSize = 4;
+
+  struct Entry {
+    std::string key;
+    Holder holder;
+    bool loaded;  // false if reading the object failed.
+    bool freed;  // true if the user called FreeCurrent().
+    std::string error;  // the error message if !loaded.
+    Entry(): loaded(false), freed(false) { }
+   private:
+    KALDI_DISALLOW_COPY_AND_ASSIGN(Entry);
+  };
+
+  static void *Run(void *this_ptr) {
+    static_cast<SequentialTableReaderBackgroundImpl<Holder>*>(this_ptr)->
+        RunInBackground();
+    return NULL;
+  }
+
+  void RunInBackground() {
+    while (true) {
+      Entry *entry = NULL;
+      bool done = false;
+      try {
+        if (base_reader_->Done()) {
+          done = true;
+        } else {
+          entry = new Entry();
+          entry->key = base_reader_->Key();
+          entry->loaded = base_reader_->SwapHolder(&(entry->holder),
+                                                   &(entry->error));
+          base_reader_->Next();
+        }
+      } catch (const std::exception &e) {
+        KALDI_WARN << "Error reading TableReader in background thread: "
+                   << e.what();
+        producer_failed_ = true;  // read after the join, in Close().
+        done = true;
+      }
+      pthread_mutex_lock(&mutex_);
+      if (!done) {
+        while (queue_.size() >= kQueueSize && !stop_)
+          pthread_cond_wait(&not_full_, &mutex_);
+        if (!stop_) {
+          queue_.push_back(entry);
+          entry = NULL;
+        } else {
+          done = true;
+        }
+      }
+      if (done) producer_done_ = true;
+      pthread_cond_signal(&not_empty_);
+      pthread_mutex_unlock(&mutex_);
+      delete entry;  // only non-NULL if we were asked to stop.
+      if (done) return;
+    }
+  }
+
+  // Waits until the queue is nonempty or the background thread has finished,
+  // and sets current_ to the next object (or NULL if there is none).
+  void FetchNext() {
+    pthread_mutex_lock(&mutex_);
+    while (queue_.empty() && !producer_done_)
+      pthread_cond_wait(&not_empty_, &mutex_);
+    if (!queue_.empty()) {
+      current_ = queue_.front();
+      queue_.pop_front();
+      pthread_cond_signal(&not_full_);
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  void StopThread() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_signal(&not_full_);
+    pthread_mutex_unlock(&mutex_);
+    if (pthread_join(thread_, NULL) != 0)
+      KALDI_ERR << "Error rejoining background thread of TableReader.";
+    thread_running_ = false;
+    delete current_;
+    current_ = NULL;
+    for (size_t i = 0; i < queue_.size(); i++)
+      delete queue_[i];
+    queue_.clear();
+  }
+
+  SequentialTableReaderImplBase<Holder> *base_reader_;
+  std::string rspecifier_;
+  RspecifierOptions opts_;
+  Entry *current_;  // The object the user is looking at; NULL if Done().
+  std::deque<Entry*> queue_;  // Objects read ahead, protected by mutex_.
+
+  pthread_t thread_;
+  bool thread_running_;
+  bool producer_done_;  // set by the background thread when it has finished.
+  bool producer_failed_;  // set if the background thread caught an exception.
+  bool stop_;  // set by us to ask the background thread to finish.
+  pthread_mutex_t mutex_;
+  pthread_cond_t not_empty_;  // signaled when queue_ gets an entry, or at end.
+  pthread_cond_t not_full_;  // signaled when queue_ loses an entry, or at stop.
+};
+
+
 template<class Holder>
-SequentialTableReader<Holder>::SequentialTableReader(const std::string &rspecifier): impl_(NULL) {
+SequentialTableReader<Holder>::SequentialTableReader(const std::string &rspecifier): impl_(NULL), stats_(NULL) {
   if (rspecifier != "" && !Open(rspecifier))
     KALDI_ERR << "Error constructing TableReader: rspecifier is " << rspecifier;
 }
@@ -520,7 +793,8 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
       KALDI_ERR << "Could not close previously open object.";
   // now impl_ will be NULL.
 
-  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, NULL);
+  RspecifierOptions opts;
+  RspecifierType wt = ClassifyRspecifier(rspecifier, NULL, &opts);
   switch (wt) {
     case kArchiveRspecifier:
       impl_ = new SequentialTableReaderArchiveImpl<Holder>();
@@ -532,6 +806,11 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
       KALDI_WARN << "Invalid rspecifier " << rspecifier;
       return false;
   }
+  if (opts.background)  // read ahead in a separate thread.
+    impl_ = new SequentialTableReaderBackgroundImpl<Holder>(impl_);
+  stats_ = NewTableIoStats("SequentialTableReader", rspecifier);
+  impl_->SetStats(stats_);
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   if (!impl_->Open(rspecifier)) {
     delete impl_;
     impl_ = NULL;
@@ -543,6 +822,7 @@ bool SequentialTableReader<Holder>::Open(const std::string &rspecifier) {
 template<class Holder>
 bool SequentialTableReader<Holder>::Close() {
   CheckImpl();  
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   bool ans = impl_->Close();
   delete impl_;  // We don't keep around empty impl_ objects.
   impl_ = NULL;
@@ -576,6 +856,8 @@ template<class Holder>
 const typename SequentialTableReader<Holder>::T &
 SequentialTableReader<Holder>::Value() {
   CheckImpl();
+  // For scp files, the object is read when Value() is first called.
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   return impl_->Value();  // This may throw (if LoadCurrent() returned false you are safe.).
 }
 
@@ -583,6 +865,7 @@ SequentialTableReader<Holder>::Value() {
 template<class Holder>
 void SequentialTableReader<Holder>::Next() {
   CheckImpl();
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   impl_->Next();
 }
 
@@ -623,10 +906,16 @@ template<class Holder> class TableWriterImplBase {
 
   virtual bool IsOpen() const = 0;
 
+  // Sets the object in which to record profiling statistics (see
+  // kaldi-table-profile.h); it is NULL if profiling is off.
+  virtual void SetStats(TableIoStats *stats) { stats_ = stats; }
+
   // May throw on write error if Close was not called.
   virtual ~TableWriterImplBase() { }
 
-  TableWriterImplBase() { }
+  TableWriterImplBase(): stats_(NULL) { }
+ protected:
+  TableIoStats *stats_;
  private:
   KALDI_DISALLOW_COPY_AND_ASSIGN(TableWriterImplBase);
 };
@@ -656,6 +945,15 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
                                            NULL,
                                            &opts_);
     KALDI_ASSERT(ws == kArchiveWspecifier);  // or wrongly called.
+    if (opts_.write_index &&
+        (ClassifyWxfilename(archive_wxfilename_) != kFileOutput ||
+         IsBlockCompressedFilename(archive_wxfilename_))) {
+      KALDI_WARN << "TableWriter: the idx option requires the archive to be "
+                 << "an actual, uncompressed file: wspecifier is " << wspecifier;
+      return false;
+    }
+    index_entries_.clear();
+    archive_size_ = 0;
 
     if (output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kOpen;
@@ -695,12 +993,20 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
     if (!IsToken(key)) // e.g. empty string or has spaces...
       KALDI_ERR << "TableWriter: using invalid key " << key;
     output_.Stream() << key << ' ';
-    if (!Holder::Write(output_.Stream(), opts_.binary, value)) {
+    int64 offset = (opts_.write_index ?
+                    static_cast<int64>(output_.Stream().tellp()) : 0);
+    if (!ProfiledHolderWrite<Holder>(output_.Stream(), opts_.binary, value,
+                                     opts_.align, this->stats_)) {
       KALDI_WARN << "TableWriter: write failure to "
                  << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
       return false;
     }
+    if (opts_.write_index) {
+      archive_size_ = output_.Stream().tellp();
+      index_entries_.push_back(ArchiveIndexEntry(key, offset,
+                                                 archive_size_ - offset));
+    }
     if (state_ == kWriteError) return false;  // Even if this Write seems to have
     // succeeded, we fail because a previous Write failed and the archive may be
     // corrupted and unreadable.
@@ -739,10 +1045,17 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
       return false;
     }
     state_ = kUninitialized;
+    if (opts_.write_index) {
+      bool ans = WriteArchiveIndex(ArchiveIndexFilename(archive_wxfilename_),
+                                   archive_wxfilename_, archive_size_,
+                                   index_entries_);
+      index_entries_.clear();
+      return ans;
+    }
     return true;
   }
 
-  TableWriterArchiveImpl(): state_(kUninitialized) {}
+  TableWriterArchiveImpl(): archive_size_(0), state_(kUninitialized) {}
 
   // May throw on write error if Close was not called.
   virtual ~TableWriterArchiveImpl() {
@@ -757,6 +1070,10 @@ class TableWriterArchiveImpl: public TableWriterImplBase<Holder> {
   WspecifierOptions opts_;
   std::string wspecifier_;
   std::string archive_wxfilename_;
+  // If opts_.write_index, the entries of the index we write at Close(),
+  // and the current size of the archive.
+  std::vector<ArchiveIndexEntry> index_entries_;
+  int64 archive_size_;
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -857,7 +1174,8 @@ class TableWriterScriptImpl: public TableWriterImplBase<Holder> {
                  << PrintableWxfilename(wxfilename);
       return false;
     }
-    if (!Holder::Write(output.Stream(), opts_.binary, value)
+    if (!ProfiledHolderWrite<Holder>(output.Stream(), opts_.binary, value,
+                                     opts_.align, this->stats_)
         || !output.Close()) {
       KALDI_WARN << "TableWriter: failed to write data to "
                  << PrintableWxfilename(wxfilename);
@@ -949,6 +1267,15 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
       KALDI_WARN << "When writing to both archive and script, the script file "
           "will generally not be interpreted correctly unless the archive is "
           "an actual file: wspecifier = " << wspecifier;
+    if (opts_.write_index &&
+        (ClassifyWxfilename(archive_wxfilename_) != kFileOutput ||
+         IsBlockCompressedFilename(archive_wxfilename_))) {
+      KALDI_WARN << "TableWriter: the idx option requires the archive to be "
+                 << "an actual, uncompressed file: wspecifier is " << wspecifier;
+      return false;
+    }
+    index_entries_.clear();
+    archive_size_ = 0;
 
     if (!archive_output_.Open(archive_wxfilename_, opts_.binary, false)) {  // false means no binary header.
       state_ = kUninitialized;
@@ -1016,12 +1343,19 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     std::ostream &script_os = script_output_.Stream();
     script_output_.Stream() << key << ' ' << offset_rxfilename << '\n';
 
-    if (!Holder::Write(archive_output_.Stream(), opts_.binary, value)) {
+    if (!ProfiledHolderWrite<Holder>(archive_output_.Stream(), opts_.binary,
+                                     value, opts_.align, this->stats_)) {
       KALDI_WARN << "TableWriter: write failure to"
                  << PrintableWxfilename(archive_wxfilename_);
       state_ = kWriteError;
       return false;
     }
+    if (opts_.write_index) {
+      archive_size_ = archive_os.tellp();
+      int64 offset = archive_os_pos;
+      index_entries_.push_back(ArchiveIndexEntry(key, offset,
+                                                 archive_size_ - offset));
+    }
 
     if (script_os.fail()) {
       KALDI_WARN << "TableWriter: write failure to script file detected: "
@@ -1068,11 +1402,16 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
     if (script_output_.IsOpen())
       if (!script_output_.Close()) close_success = false;
     bool ans = close_success && (state_ != kWriteError);
+    if (ans && opts_.write_index)
+      ans = WriteArchiveIndex(ArchiveIndexFilename(archive_wxfilename_),
+                              archive_wxfilename_, archive_size_,
+                              index_entries_);
+    index_entries_.clear();
     state_ = kUninitialized;
     return ans;
   }
 
-  TableWriterBothImpl(): state_(kUninitialized) {}
+  TableWriterBothImpl(): archive_size_(0), state_(kUninitialized) {}
 
   // May throw on write error if Close() was not called.
   // User can get the error status by calling Close().
@@ -1090,6 +1429,408 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
   std::string archive_wxfilename_;
   std::string script_wxfilename_;
   std::string wspecifier_;
+  // If opts_.write_index, the entries of the index we write at Close(),
+  // and the current size of the archive.
+  std::vector<ArchiveIndexEntry> index_entries_;
+  int64 archive_size_;
+  enum {               // is stream open?
+    kUninitialized,    // no
+    kOpen,             // yes
+    kWriteError,       // yes
+  } state_;
+};
+
+
+// The implementation of TableWriter we use when writing to an archive plus an
+// associated scp with the "shards=N" option.  The archive is split into N
+// archive files (see ShardArchiveFilename()), and each one is written by its
+// own background thread.  Write() serializes the object into memory on the
+// calling thread (so if several threads call Write() at once, serialization
+// happens in parallel), and queues it for shard (i % N), where i is the number
+// of earlier calls to Write(); a call blocks if that shard already has
+// kQueueSize objects waiting.  The scp file cannot be written as we go, because
+// the shards finish their writes in no particular order, so we collect its
+// lines and write them, in the order of the Write() calls, in Close().  If the
+// scp file is an actual file we write it under a temporary name and rename it
+// only if everything succeeded, so that a failure does not leave a truncated
+// scp file behind (the previous one, if any, is left as it was).
+// We use pthreads directly because util/ cannot depend on thread/.
+template<class Holder>
+class TableWriterShardedImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  virtual bool Open(const std::string &wspecifier) {
+    switch (state_) {
+      case kUninitialized:
+        break;
+      case kWriteError:
+        KALDI_ERR << "TableWriter: opening stream, already open with write error.";
+      case kOpen: default:
+        if (!Close())  // throw because this error may not have been previously detected by user.
+          KALDI_ERR << "TableWriter: opening stream, error closing previously open stream.";
+    }
+    wspecifier_ = wspecifier;
+    WspecifierType ws = ClassifyWspecifier(wspecifier,
+                                           &archive_wxfilename_,
+                                           &script_wxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(ws == kBothWspecifier && opts_.num_shards > 1);  // or wrongly called.
+    if (ClassifyWxfilename(archive_wxfilename_) != kFileOutput) {
+      KALDI_WARN << "TableWriter: the shards option requires the archive to be "
+                 << "an actual file: wspecifier is " << wspecifier;
+      return false;
+    }
+    if (opts_.write_index && IsBlockCompressedFilename(archive_wxfilename_)) {
+      KALDI_WARN << "TableWriter: the idx option requires the archive to be "
+                 << "uncompressed: wspecifier is " << wspecifier;
+      return false;
+    }
+    // We open the script file now, so that we fail early if we can't write it.
+    if (ClassifyWxfilename(script_wxfilename_) == kFileOutput)
+      script_tmp_filename_ = script_wxfilename_ + ".tmp";
+    else
+      script_tmp_filename_ = "";
+    if (!script_output_.Open(script_tmp_filename_.empty() ? script_wxfilename_ :
+                             script_tmp_filename_, false, false))
+      return false;  // It will have printed a warning.
+    for (int32 i = 0; i < opts_.num_shards; i++) {
+      Shard *shard = new Shard();
+      shards_.push_back(shard);
+      shard->wxfilename = ShardArchiveFilename(archive_wxfilename_, i + 1);
+      if (!shard->output.Open(shard->wxfilename, opts_.binary, false)) {
+        // Close and delete the archives we created; don't write any indexes.
+        StopThreads(NULL, true);
+        script_output_.Close();  // Don't care about status: error anyway.
+        if (!script_tmp_filename_.empty())
+          std::remove(script_tmp_filename_.c_str());
+        return false;
+      }
+    }
+    next_index_ = 0;
+    error_ = false;
+    stop_ = false;
+    for (size_t i = 0; i < shards_.size(); i++) {
+      ThreadArg *arg = new ThreadArg(this, shards_[i]);
+      int ret = pthread_create(&(shards_[i]->thread), NULL, &Run, arg);
+      if (ret != 0)
+        KALDI_ERR << "Error creating background thread for TableWriter, errno "
+                  << "was: " << (strerror(ret));
+      shards_[i]->thread_running = true;
+    }
+    state_ = kOpen;
+    return true;
+  }
+
+  virtual bool IsOpen() const {
+    switch (state_) {
+      case kUninitialized: return false;
+      case kOpen: case kWriteError: return true;
+      default: KALDI_ERR << "IsOpen() called on TableWriter in invalid state.";
+    }
+    return false;
+  }
+
+  // Write returns true on success, false on failure, but
+  // some errors may not be detected till we call Close().
+  // Unlike the other implementations, this may be called from several threads
+  // at once.
+  virtual bool Write(const std::string &key, const T &value) {
+    pthread_mutex_lock(&mutex_);
+    if (error_) state_ = kWriteError;  // a background thread failed.
+    switch (state_) {
+      case kOpen: break;
+      case kWriteError:
+        pthread_mutex_unlock(&mutex_);
+        // user should have known from the last
+        // call to Write that there was a problem.  Warn about it.
+        KALDI_WARN << "TableWriter: writing to non-open TableWriter object.";
+        return false;
+      case kUninitialized: default:
+        pthread_mutex_unlock(&mutex_);
+        KALDI_ERR << "TableWriter: Write called on invalid stream";
+    }
+    int64 index = next_index_++;
+    pthread_mutex_unlock(&mutex_);
+    if (!IsToken(key)) // e.g. empty string or has spaces...
+      KALDI_ERR << "TableWriter: using invalid key " << key;
+
+    Item *item = new Item(index, key);
+    {
+      std::ostringstream os;
+      // The position in the shard is not known yet, so we can't align.
+      if (!ProfiledHolderWrite<Holder>(os, opts_.binary, value, false,
+                                       this->stats_)) {
+        delete item;
+        KALDI_WARN << "TableWriter: failed to serialize object with key "
+                   << key << ": wspecifier is " << wspecifier_;
+        pthread_mutex_lock(&mutex_);
+        state_ = kWriteError;
+        pthread_mutex_unlock(&mutex_);
+        return false;
+      }
+      item->data = os.str();
+    }
+    Shard *shard = shards_[index % shards_.size()];
+    pthread_mutex_lock(&mutex_);
+    while (shard->queue.size() >= kQueueSize)
+      pthread_cond_wait(&(shard->not_full), &mutex_);
+    shard->queue.push_back(item);
+    shard->num_pending++;
+    pthread_cond_signal(&(shard->not_empty));
+    bool ans = (state_ == kOpen && !error_);
+    pthread_mutex_unlock(&mutex_);
+    return ans;
+  }
+
+  // Waits until the background threads have written everything queued so far,
+  // then flushes the archives.  Flush will flush any archive; it does not
+  // return error status, any errors will be reported on the next Write or
+  // Close.
+  virtual void Flush() {
+    pthread_mutex_lock(&mutex_);
+    switch (state_) {
+      case kWriteError: case kOpen:
+        break;
+      default:
+        pthread_mutex_unlock(&mutex_);
+        KALDI_WARN << "TableWriter: Flush called on not-open writer.";
+        return;
+    }
+    for (size_t i = 0; i < shards_.size(); i++) {
+      Shard *shard = shards_[i];
+      while (shard->num_pending != 0)
+        pthread_cond_wait(&(shard->not_full), &mutex_);
+      // The background thread only touches the stream after taking an item
+      // from the queue, which it can't do while we hold the mutex.
+      shard->output.Stream().flush();  // Don't check error status.
+    }
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  virtual bool Close() {
+    if (!this->IsOpen())
+      KALDI_ERR << "TableWriter: Close called on a stream that was not open.";
+    std::vector<ScriptLine> lines;
+    bool close_success = StopThreads(&lines);
+    if (error_) close_success = false;
+    if (close_success && state_ == kOpen) {
+      std::sort(lines.begin(), lines.end());
+      std::ostream &script_os = script_output_.Stream();
+      for (size_t i = 0; i < lines.size(); i++)
+        script_os << lines[i].key << ' ' << lines[i].rxfilename << '\n';
+    }
+    if (script_output_.IsOpen() && !script_output_.Close()) {
+      KALDI_WARN << "TableWriter: error writing script file "
+                 << PrintableWxfilename(script_wxfilename_);
+      close_success = false;
+    }
+    bool ans = close_success && (state_ != kWriteError);
+    if (!script_tmp_filename_.empty()) {
+      if (ans && std::rename(script_tmp_filename_.c_str(),
+                             script_wxfilename_.c_str()) != 0) {
+        KALDI_WARN << "TableWriter: failed to rename " << script_tmp_filename_
+                   << " to " << script_wxfilename_;
+        ans = false;
+      }
+      if (!ans) {
+        KALDI_WARN << "TableWriter: not writing script file "
+                   << script_wxfilename_ << " because of errors.";
+        std::remove(script_tmp_filename_.c_str());
+      }
+    }
+    state_ = kUninitialized;
+    return ans;
+  }
+
+  TableWriterShardedImpl(): next_index_(0), error_(false), stop_(false),
+                            state_(kUninitialized) {
+    pthread_mutex_init(&mutex_, NULL);
+  }
+
+  // May throw on write error if Close() was not called.
+  // User can get the error status by calling Close().
+  virtual ~TableWriterShardedImpl() {
+    if (IsOpen() && !Close())
+      KALDI_ERR << "At TableWriter destructor: Write failed or stream close failed: "
+                << wspecifier_;
+    pthread_mutex_destroy(&mutex_);
+  }
+
+ private:
+  // The maximum number of serialized objects waiting for each shard.
+  static const size_t kQueueSize = 4;
+
+  // A serialized object waiting to be written.
+  struct Item {
+    int64 index;  // the number of Write() calls before this one.
+    std::string key;
+    std::string data;
+    Item(int64 index, const std::string &key): index(index), key(key) { }
+  };
+
+  // A line of the scp file.
+  struct ScriptLine {
+    int64 index;
+    std::string key;
+    std::string rxfilename;  // e.g. foo.3.ark:1024
+    bool operator < (const ScriptLine &other) const {
+      return index < other.index;
+    }
+  };
+
+  struct Shard {
+    std::string wxfilename;
+    Output output;
+    std::deque<Item*> queue;  // protected by mutex_.
+    size_t num_pending;  // queue.size() plus any item being written; protected
+                         // by mutex_.
+    pthread_cond_t not_empty;  // signaled when queue gets an item, or at stop.
+    pthread_cond_t not_full;  // signaled when an item has been written.
+    // Only the background thread touches the following while it runs.
+    std::vector<ScriptLine> lines;
+    std::vector<ArchiveIndexEntry> index_entries;  // if opts_.write_index.
+    int64 archive_size;
+    pthread_t thread;
+    bool thread_running;
+    Shard(): num_pending(0), archive_size(0), thread_running(false) {
+      pthread_cond_init(&not_empty, NULL);
+      pthread_cond_init(&not_full, NULL);
+    }
+    ~Shard() {
+      for (size_t i = 0; i < queue.size(); i++)
+        delete queue[i];
+      pthread_cond_destroy(&not_full);
+      pthread_cond_destroy(&not_empty);
+    }
+   private:
+    KALDI_DISALLOW_COPY_AND_ASSIGN(Shard);
+  };
+
+  struct ThreadArg {
+    TableWriterShardedImpl<Holder> *writer;
+    Shard *shard;
+    ThreadArg(TableWriterShardedImpl<Holder> *writer, Shard *shard):
+        writer(writer), shard(shard) { }
+  };
+
+  static void *Run(void *arg_ptr) {
+    ThreadArg *arg = static_cast<ThreadArg*>(arg_ptr);
+    arg->writer->RunInBackground(arg->shard);
+    delete arg;
+    return NULL;
+  }
+
+  // Writes the items queued for "shard" until we are asked to stop and the
+  // queue is empty.
+  void RunInBackground(Shard *shard) {
+    std::ostream &os = shard->output.Stream();
+    bool failed = false;
+    while (true) {
+      pthread_mutex_lock(&mutex_);
+      while (shard->queue.empty() && !stop_)
+        pthread_cond_wait(&(shard->not_empty), &mutex_);
+      if (shard->queue.empty()) {  // and stop_ is set.
+        pthread_mutex_unlock(&mutex_);
+        return;
+      }
+      Item *item = shard->queue.front();
+      shard->queue.pop_front();
+      pthread_mutex_unlock(&mutex_);
+
+      if (!failed) {
+        os << item->key << ' ';
+        int64 offset = os.tellp();
+        os.write(item->data.data(), item->data.size());
+        if (opts_.flush) os.flush();
+        if (os.fail()) {
+          KALDI_WARN << "TableWriter: write failure to archive file detected: "
+                     << PrintableWxfilename(shard->wxfilename);
+          failed = true;
+        } else {
+          shard->archive_size = offset + item->data.size();
+          ScriptLine line;
+          line.index = item->index;
+          line.key = item->key;
+          std::ostringstream ss;
+          ss << shard->wxfilename << ':' << offset;
+          line.rxfilename = ss.str();
+          shard->lines.push_back(line);
+          if (opts_.write_index)
+            shard->index_entries.push_back(
+                ArchiveIndexEntry(item->key, offset, item->data.size()));
+        }
+      }
+      delete item;
+
+      pthread_mutex_lock(&mutex_);
+      if (failed) error_ = true;
+      shard->num_pending--;
+      pthread_cond_broadcast(&(shard->not_full));  // Write() and Flush() wait.
+      pthread_mutex_unlock(&mutex_);
+    }
+  }
+
+  // Tells the background threads to finish writing what is queued, waits for
+  // them, closes the archives (writing their indexes if requested) and
+  // deletes the shards.  If "lines" is non-NULL, outputs the lines of the scp
+  // file, in no particular order.  If "discard" is true (Open() failed), no
+  // indexes are written and the archives that were opened are removed.
+  // Returns false if closing any archive (or writing its index) failed.
+  bool StopThreads(std::vector<ScriptLine> *lines = NULL,
+                   bool discard = false) {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    for (size_t i = 0; i < shards_.size(); i++)
+      pthread_cond_signal(&(shards_[i]->not_empty));
+    pthread_mutex_unlock(&mutex_);
+    bool ans = true;
+    for (size_t i = 0; i < shards_.size(); i++) {
+      Shard *shard = shards_[i];
+      if (shard->thread_running) {
+        if (pthread_join(shard->thread, NULL) != 0)
+          KALDI_ERR << "Error rejoining background thread of TableWriter.";
+        shard->thread_running = false;
+      }
+      bool was_open = shard->output.IsOpen();
+      if (was_open && !shard->output.Close()) {
+        KALDI_WARN << "TableWriter: error closing archive "
+                   << PrintableWxfilename(shard->wxfilename);
+        ans = false;
+      }
+      if (discard) {
+        if (was_open)
+          std::remove(shard->wxfilename.c_str());
+      } else if (ans && !error_ && opts_.write_index &&
+                 !WriteArchiveIndex(ArchiveIndexFilename(shard->wxfilename),
+                                    shard->wxfilename, shard->archive_size,
+                                    shard->index_entries)) {
+        ans = false;
+      }
+      if (lines != NULL)
+        lines->insert(lines->end(), shard->lines.begin(), shard->lines.end());
+      delete shard;
+    }
+    shards_.clear();
+    return ans;
+  }
+
+  Output script_output_;
+  WspecifierOptions opts_;
+  std::string archive_wxfilename_;
+  std::string script_wxfilename_;
+  std::string script_tmp_filename_;  // If the scp file is an actual file, the
+                                     // name we write it under until Close().
+  std::string wspecifier_;
+  std::vector<Shard*> shards_;
+
+  pthread_mutex_t mutex_;
+  int64 next_index_;  // the number of calls to Write() so far; protected by
+                      // mutex_.
+  bool error_;  // set by a background thread if a write failed; protected by
+                // mutex_.
+  bool stop_;  // set by us to ask the background threads to finish; protected
+               // by mutex_.
   enum {               // is stream open?
     kUninitialized,    // no
     kOpen,             // yes
@@ -1098,8 +1839,205 @@ class TableWriterBothImpl: public TableWriterImplBase<Holder> {
 };
 
 
+// This is the implementation of TableWriter we use when the "bg" (background)
+// option is given in the wspecifier.  It wraps one of the other
+// implementations and calls it from a separate thread, so serializing and
+// writing the objects happens in the background.  Write() copies the object
+// (using the copy constructor of T; for FSTs this is cheap as the copy shares
+// the data) and queues it; it blocks if kQueueSize objects are already
+// waiting.  If a write in the background fails, the next call to Write() (or
+// Close()) returns false, so the user sees the error one call later than
+// without the "bg" option, which the interface already allows for ("some
+// errors may not be detected till we call Close()").
+// We use pthreads directly because util/ cannot depend on thread/.
+template<class Holder>
+class TableWriterBackgroundImpl: public TableWriterImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  // Takes ownership of "base_writer", which must not be open yet.
+  explicit TableWriterBackgroundImpl(TableWriterImplBase<Holder> *base_writer):
+      base_writer_(base_writer), num_pending_(0), thread_running_(false),
+      failed_(false), stop_(false) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&not_empty_, NULL);
+    pthread_cond_init(&not_full_, NULL);
+  }
+
+  virtual void SetStats(TableIoStats *stats) {
+    this->stats_ = stats;
+    base_writer_->SetStats(stats);  // the objects are written by base_writer_.
+  }
+
+  virtual bool Open(const std::string &wspecifier) {
+    if (thread_running_)
+      if (!Close())  // throw because this error may not have been previously
+        // detected by the user.
+        KALDI_ERR << "TableWriter: opening stream, error closing previously "
+                  << "open stream.";
+    wspecifier_ = wspecifier;
+    if (!base_writer_->Open(wspecifier))
+      return false;  // it will have printed a warning.
+    failed_ = false;
+    stop_ = false;
+    int ret = pthread_create(&thread_, NULL, &Run, this);
+    if (ret != 0)
+      KALDI_ERR << "Error creating background thread for TableWriter, errno "
+                << "was: " << (strerror(ret));
+    thread_running_ = true;
+    return true;
+  }
+
+  virtual bool IsOpen() const { return thread_running_; }
+
+  // Write returns true on success, false on failure, but
+  // some errors may not be detected till we call Close().
+  virtual bool Write(const std::string &key, const T &value) {
+    if (!thread_running_)
+      KALDI_ERR << "TableWriter: Write called on invalid stream";
+    if (!IsToken(key)) // e.g. empty string or has spaces...
+      KALDI_ERR << "TableWriter: using invalid key " << key;
+    pthread_mutex_lock(&mutex_);
+    while (queue_.size() >= kQueueSize && !failed_)
+      pthread_cond_wait(&not_full_, &mutex_);
+    bool failed = failed_;
+    if (!failed) {
+      queue_.push_back(new Item(key, value));
+      num_pending_++;
+      pthread_cond_signal(&not_empty_);
+    }
+    pthread_mutex_unlock(&mutex_);
+    if (failed)
+      KALDI_WARN << "TableWriter: writing to TableWriter object after an "
+                 << "error in its background thread: wspecifier is "
+                 << wspecifier_;
+    return !failed;
+  }
+
+  // Waits until everything written so far has been passed to the underlying
+  // writer, and flushes it.  Flush will flush any archive; it does not return
+  // error status, any errors will be reported on the next Write or Close.
+  virtual void Flush() {
+    if (!thread_running_) {
+      KALDI_WARN << "TableWriter: Flush called on not-open writer.";
+      return;
+    }
+    pthread_mutex_lock(&mutex_);
+    while (num_pending_ != 0)
+      pthread_cond_wait(&not_full_, &mutex_);
+    // The background thread only uses base_writer_ after taking an item from
+    // the queue, which it can't do while we hold the mutex.
+    base_writer_->Flush();
+    pthread_mutex_unlock(&mutex_);
+  }
+
+  virtual bool Close() {
+    if (!thread_running_)
+      KALDI_ERR << "TableWriter: Close called on a stream that was not open.";
+    StopThread();
+    bool ans = base_writer_->Close();
+    if (failed_) {
+      KALDI_WARN << "TableWriter: closing writer after an error in its "
+                 << "background thread: wspecifier is " << wspecifier_;
+      ans = false;
+    }
+    return ans;
+  }
+
+  // May throw on write error if Close() was not called.
+  // User can get the error status by calling Close().
+  virtual ~TableWriterBackgroundImpl() {
+    if (thread_running_ && !Close())
+      KALDI_ERR << "At TableWriter destructor: Write failed or stream close "
+                << "failed: wspecifier is " << wspecifier_;
+    pthread_cond_destroy(&not_full_);
+    pthread_cond_destroy(&not_empty_);
+    pthread_mutex_destroy(&mutex_);
+    delete base_writer_;
+  }
+
+ private:
+  // The maximum number of objects waiting to be written.
+  static const size_t kQueueSize = 4;
+
+  struct Item {
+    std::string key;
+    T value;
+    Item(const std::string &key, const T &value): key(key), value(value) { }
+  };
+
+  static void *Run(void *this_ptr) {
+    static_cast<TableWriterBackgroundImpl<Holder>*>(this_ptr)->
+        RunInBackground();
+    return NULL;
+  }
+
+  void RunInBackground() {
+    while (true) {
+      pthread_mutex_lock(&mutex_);
+      while (queue_.empty() && !stop_)
+        pthread_cond_wait(&not_empty_, &mutex_);
+      if (queue_.empty()) {  // and stop_ is set.
+        pthread_mutex_unlock(&mutex_);
+        return;
+      }
+      Item *item = queue_.front();
+      queue_.pop_front();
+      bool failed = failed_;
+      pthread_mutex_unlock(&mutex_);
+
+      if (!failed) {
+        try {
+          failed = !base_writer_->Write(item->key, item->value);
+        } catch (const std::exception &e) {
+          KALDI_WARN << "Error writing TableWriter in background thread: "
+                     << e.what();
+          failed = true;
+        }
+      }
+      delete item;
+
+      pthread_mutex_lock(&mutex_);
+      if (failed) failed_ = true;
+      num_pending_--;
+      pthread_cond_broadcast(&not_full_);  // Write() and Flush() wait.
+      pthread_mutex_unlock(&mutex_);
+    }
+  }
+
+  // Waits for the background thread to write what is queued, and to finish.
+  void StopThread() {
+    pthread_mutex_lock(&mutex_);
+    stop_ = true;
+    pthread_cond_signal(&not_empty_);
+    pthread_mutex_unlock(&mutex_);
+    if (pthread_join(thread_, NULL) != 0)
+      KALDI_ERR << "Error rejoining background thread of TableWriter.";
+    thread_running_ = false;
+  }
+
+  TableWriterImplBase<Holder> *base_writer_;
+  std::string wspecifier_;
+  std::deque<Item*> queue_;  // Objects waiting to be written, protected by
+                             // mutex_.
+  size_t num_pending_;  // queue_.size() plus any object being written;
+                        // protected by mutex_.
+
+  pthread_t thread_;
+  bool thread_running_;
+  bool failed_;  // set if a write in the background thread failed; protected
+                 // by mutex_.
+  bool stop_;  // set by us to ask the background thread to finish; protected
+               // by mutex_.
+  pthread_mutex_t mutex_;
+  pthread_cond_t not_empty_;  // signaled when queue_ gets an item, or at stop.
+  pthread_cond_t not_full_;  // signaled when an item has been written.
+};
+
+
 template<class Holder>
-TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL) {
+TableWriter<Holder>::TableWriter(const std::string &wspecifier): impl_(NULL),
+                                                               stats_(NULL) {
   if (wspecifier != "" && !Open(wspecifier)) {
     KALDI_ERR << "TableWriter: failed to write to "
               << wspecifier;
@@ -1120,10 +2058,19 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_ERR << "TableWriter::Open, failed to close previously open writer.";
   }
   KALDI_ASSERT(impl_ == NULL);
-  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, NULL);
+  WspecifierOptions opts;
+  WspecifierType wtype = ClassifyWspecifier(wspecifier, NULL, NULL, &opts);
+  if (opts.num_shards > 1 && wtype != kBothWspecifier) {
+    KALDI_WARN << "TableWriter: the shards option requires both an archive "
+               << "and a script file: wspecifier is " << wspecifier;
+    return false;
+  }
   switch (wtype) {
     case kBothWspecifier:
-      impl_ = new TableWriterBothImpl<Holder>();
+      if (opts.num_shards > 1)
+        impl_ = new TableWriterShardedImpl<Holder>();
+      else
+        impl_ = new TableWriterBothImpl<Holder>();
       break;
     case kArchiveWspecifier:
       impl_ = new TableWriterArchiveImpl<Holder>();
@@ -1135,6 +2082,11 @@ bool TableWriter<Holder>::Open(const std::string &wspecifier) {
       KALDI_WARN << "ClassifyWspecifier: invalid wspecifier " << wspecifier;
       return false;
   }
+  if (opts.background)
+    impl_ = new TableWriterBackgroundImpl<Holder>(impl_);
+  stats_ = NewTableIoStats("TableWriter", wspecifier);
+  impl_->SetStats(stats_);
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   if (impl_->Open(wspecifier)) return true;
   else {  // The class will have printed a more specific warning.
     delete impl_;
@@ -1147,6 +2099,9 @@ template<class Holder>
 void TableWriter<Holder>::Write(const std::string &key,
                                 const T &value) const {
   CheckImpl();
+  // With the "shards" option this may be called from several threads at once;
+  // the statistics are updated under a lock (see AddTableIoStat()).
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   if (!impl_->Write(key, value))
     KALDI_ERR << "Error in TableWriter::Write";
   // More specific warning will have
@@ -1156,12 +2111,14 @@ void TableWriter<Holder>::Write(const std::string &key,
 template<class Holder>
 void TableWriter<Holder>::Flush() {
   CheckImpl();
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   impl_->Flush();
 }
 
 template<class Holder>
 bool TableWriter<Holder>::Close() {
   CheckImpl();
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   bool ans = impl_->Close();
   delete impl_;  // We don't keep around non-open impl_ objects [c.f. definition of IsOpen()]
   impl_ = NULL;
@@ -1213,9 +2170,212 @@ template<class Holder> class RandomAccessTableReaderImplBase {
 
   virtual bool Close() = 0;
 
+  // Reads ahead the objects for those of "keys" that are present, so that
+  // HasKey() and Value() do not have to read them.  The default implementation
+  // does nothing; see RandomAccessTableReader::Prefetch().
+  virtual void Prefetch(const std::vector<std::string> &keys) { }
+
+  // Sets the object in which to record profiling statistics (see
+  // kaldi-table-profile.h); it is NULL if profiling is off.
+  virtual void SetStats(TableIoStats *stats) { stats_ = stats; }
+
+  RandomAccessTableReaderImplBase(): stats_(NULL) { }
   virtual ~RandomAccessTableReaderImplBase() {}
+ protected:
+  TableIoStats *stats_;
 };
 
+// RandomAccessTablePrefetcher holds the objects read by
+// RandomAccessTableReader::Prefetch() for the implementations that know where
+// their objects are stored (scp files and indexed archives).  It reads the
+// objects in the order of (file, byte offset), so that keys asked for in a
+// random order become nearly sequential reads, and keeps them until the next
+// Prefetch() or Close(), so the references returned by Value() for them stay
+// valid until then.  With the "bg" option the reading is done in a separate
+// thread, and Find() waits for the object if it has not been read yet.
+// We use pthreads directly because util/ cannot depend on thread/.
+template<class Holder> class RandomAccessTablePrefetcher {
+ public:
+  RandomAccessTablePrefetcher(): thread_running_(false), stop_(false),
+                                 num_done_(0) {
+    pthread_mutex_init(&mutex_, NULL);
+    pthread_cond_init(&done_cond_, NULL);
+  }
+
+  // Adds a request to read the object for "key" from "rxfilename".  If
+  // "archive" is true, "rxfilename" is an offset into an archive (so there is
+  // no binary-mode header, except as part of the object); otherwise it is an
+  // scp entry.  Requests for keys that were already added are ignored.
+  void AddRequest(const std::string &key, const std::string &rxfilename,
+                  bool archive) {
+    KALDI_ASSERT(!thread_running_ && num_done_ == 0);
+    if (index_.count(key) != 0) return;
+    index_[key] = entries_.size();
+    entries_.push_back(new Entry());
+    Entry *entry = entries_.back();
+    entry->key = key;
+    entry->rxfilename = rxfilename;
+    entry->archive = archive;
+    SplitRxfilenameOffset(rxfilename, &(entry->filename), &(entry->offset));
+  }
+
+  // Reads the objects of the requests, in order of (file, offset); if
+  // "background" is true, this is done in a separate thread and Start()
+  // returns straight away.
+  void Start(const RspecifierOptions &opts, TableIoStats *stats) {
+    opts_ = opts;
+    stats_ = stats;
+    std::stable_sort(entries_.begin(), entries_.end(), EntryPtrLess);
+    for (size_t i = 0; i < entries_.size(); i++)
+      index_[entries_[i]->key] = i;
+    stop_ = false;
+    if (opts_.background && !entries_.empty()) {
+      thread_running_ = true;
+      int ret = pthread_create(&thread_, NULL, &Run, this);
+      if (ret != 0) {
+        thread_running_ = false;
+        KALDI_ERR << "Error creating background thread for "
+                  << "RandomAccessTableReader, errno was: " << strerror(ret);
+      }
+    } else {
+      ReadAll();
+    }
+  }
+
+  // Returns true if "key" was prefetched, in which case *holder is set to the
+  // holder that contains its object, or to NULL if it could not be read (a
+  // warning will have been printed).  Waits for the object if it is still
+  // being read in the background.
+  bool Find(const std::string &key, Holder **holder) {
+    if (entries_.empty()) return false;
+    std::map<std::string, size_t>::const_iterator iter = index_.find(key);
+    if (iter == index_.end()) return false;
+    size_t i = iter->second;
+    if (thread_running_) {
+      pthread_mutex_lock(&mutex_);
+      while (num_done_ <= i)
+        pthread_cond_wait(&done_cond_, &mutex_);
+      pthread_mutex_unlock(&mutex_);
+    }
+    Entry *entry = entries_[i];
+    *holder = (entry->loaded ? &(entry->holder) : NULL);
+    return true;
+  }
+
+  // Stops any reading in progress and frees all the objects.
+  void Clear() {
+    if (thread_running_) {
+      pthread_mutex_lock(&mutex_);
+      stop_ = true;
+      pthread_mutex_unlock(&mutex_);
+      if (pthread_join(thread_, NULL) != 0)
+        KALDI_ERR << "Error rejoining background thread of "
+                  << "RandomAccessTableReader.";
+      thread_running_ = false;
+    }
+    for (size_t i = 0; i < entries_.size(); i++)
+      delete entries_[i];
+    entries_.clear();
+    index_.clear();
+    num_done_ = 0;
+  }
+
+  ~RandomAccessTablePrefetcher() {
+    Clear();
+    pthread_cond_destroy(&done_cond_);
+    pthread_mutex_destroy(&mutex_);
+  }
+
+ private:
+  struct Entry {
+    std::string key;
+    std::string rxfilename;
+    bool archive;
+    std::string filename;  // rxfilename split into the file...
+    int64 offset;  // ... and the offset in it, for sorting.
+    Holder holder;
+    bool loaded;  // true if the object was read successfully.
+    Entry(): archive(false), offset(0), loaded(false) { }
+   private:
+    KALDI_DISALLOW_COPY_AND_ASSIGN(Entry);
+  };
+
+  static bool EntryPtrLess(const Entry *a, const Entry *b) {
+    if (a->filename != b->filename) return a->filename < b->filename;
+    return a->offset < b->offset;
+  }
+
+  static void *Run(void *this_ptr) {
+    static_cast<RandomAccessTablePrefetcher<Holder>*>(this_ptr)->ReadAll();
+    return NULL;
+  }
+
+  void ReadAll() {
+    // A single Input object, so that offsets into the same file do not reopen
+    // it but just seek (mostly forward, as the entries are sorted).  With the
+    // "mmap" option, holders that point into the file (see MatrixViewHolder)
+    // keep a reference to the mapping, so it is not a problem that "input"
+    // moves on to other files and is destroyed when we are done.
+    Input input;
+    for (size_t i = 0; i < entries_.size(); i++) {
+      pthread_mutex_lock(&mutex_);
+      bool stop = stop_;
+      pthread_mutex_unlock(&mutex_);
+      if (stop) return;
+      Entry *entry = entries_[i];
+      try {
+        entry->loaded = ReadEntry(&input, entry);
+      } catch (const std::exception &e) {
+        KALDI_WARN << "Error reading object for key " << entry->key
+                   << " from " << PrintableRxfilename(entry->rxfilename)
+                   << ": " << e.what();
+        entry->loaded = false;
+      }
+      pthread_mutex_lock(&mutex_);
+      num_done_ = i + 1;
+      pthread_cond_broadcast(&done_cond_);
+      pthread_mutex_unlock(&mutex_);
+    }
+  }
+
+  bool ReadEntry(Input *input, Entry *entry) {
+    bool opened;
+    if (!entry->archive)
+      opened = (opts_.memory_map ? input->OpenMapped(entry->rxfilename) :
+                input->Open(entry->rxfilename));
+    else if (Holder::IsReadInBinary())  // NULL means no binary-mode header.
+      opened = (opts_.memory_map ? input->OpenMapped(entry->rxfilename, NULL) :
+                input->Open(entry->rxfilename, NULL));
+    else
+      opened = input->OpenTextMode(entry->rxfilename);
+    if (!opened) {
+      KALDI_WARN << "Error opening stream "
+                 << PrintableRxfilename(entry->rxfilename);
+      return false;
+    }
+    if (!ProfiledHolderRead(&(entry->holder), input->Stream(), stats_)) {
+      KALDI_WARN << "Error reading object for key " << entry->key << " from "
+                 << "stream " << PrintableRxfilename(entry->rxfilename);
+      return false;
+    }
+    return true;
+  }
+
+  RspecifierOptions opts_;
+  TableIoStats *stats_;
+  std::vector<Entry*> entries_;  // sorted by (filename, offset) by Start().
+  std::map<std::string, size_t> index_;  // key -> position in entries_.
+
+  pthread_t thread_;
+  bool thread_running_;
+  bool stop_;  // set by Clear() to ask the background thread to finish.
+  size_t num_done_;  // the number of entries read so far; protected by mutex_.
+  pthread_mutex_t mutex_;
+  pthread_cond_t done_cond_;  // signaled when num_done_ changes.
+  KALDI_DISALLOW_COPY_AND_ASSIGN(RandomAccessTablePrefetcher);
+};
+
+
 
 // Implementation of RandomAccessTableReader for a script file; for simplicity we
 // just read it in all in one go, as it's unlikely someone would generate this
@@ -1231,7 +2391,7 @@ class RandomAccessTableReaderScriptImpl:
  public:
   typedef typename Holder::T T;
 
-  RandomAccessTableReaderScriptImpl(): last_found_(0), state_(kUninitialized) {}
+  RandomAccessTableReaderScriptImpl(): index_(NULL), state_(kUninitialized) {}
 
   virtual bool Open(const std::string &rspecifier) {
     switch (state_) {
@@ -1245,34 +2405,33 @@ class RandomAccessTableReaderScriptImpl:
                                            &script_rxfilename_,
                                            &opts_);
     KALDI_ASSERT(rs == kScriptRspecifier);  // or wrongly called.
-    KALDI_ASSERT(script_.empty());  // no way it could be nonempty at this point.
+    KALDI_ASSERT(index_ == NULL);  // no way it could be set at this point.
 
-    if (! ReadScriptFile(script_rxfilename_,
-                        true,  // print any warnings
-                        &script_)) {  // error reading script file or invalid format
+    // The index may be shared with other readers of the same scp file; with
+    // the "idx" option it is cached on disk (see kaldi-script-index.h).
+    index_ = ScriptIndex::Acquire(script_rxfilename_, opts_.indexed);
+    if (index_ == NULL) {  // error reading script file or invalid format
       state_ = kNotReadScript;
       return false;  // no need to print further warnings.  user gets the error.
     }
 
     rspecifier_ = rspecifier;
     // If opts_.sorted, the user has asserted that the keys are already sorted.
-    // Although we could easily sort them, we want to let the user know of this
+    // We don't need them to be, but we want to let the user know of this
     // mistake.  This same mistake could have serious effects if used with an
-    // archive rather than a script.
-    if (!opts_.sorted)
-      std::sort(script_.begin(), script_.end());
-    for (size_t i = 0; i+1 < script_.size(); i++) {
-      if (script_[i].first.compare(script_[i+1].first) >= 0) {
-        // script[i] not < script[i+1] in lexical order...
-        bool same = (script_[i].first == script_[i+1].first);
-        KALDI_WARN << "Script file " << PrintableRxfilename(script_rxfilename_)
-                   << (same ? " contains duplicate key: " :
-                       " is not sorted (remove s, option or add ns, option): key is ")
-                   << script_[i].first;
-        state_ = kNotReadScript;
-        return false;
-      }
+    // archive rather than a script.  (Duplicate keys are detected when the
+    // index is built.)
+    if (opts_.sorted && index_->UnsortedEntry() >= 0) {
+      KALDI_WARN << "Script file " << PrintableRxfilename(script_rxfilename_)
+                 << " is not sorted (remove s, option or add ns, option): key is "
+                 << index_->Key(index_->UnsortedEntry() - 1);
+      index_->Release();
+      index_ = NULL;
+      state_ = kNotReadScript;
+      return false;
     }
+    if (opts_.once)
+      tombstones_.resize(index_->NumEntries(), false);
     state_ = kNotHaveObject;
     return true;
   }
@@ -1286,9 +2445,11 @@ class RandomAccessTableReaderScriptImpl:
     if (!IsOpen())
       KALDI_ERR << "Close() called on RandomAccessTableReader that was not open.";
     holder_.Clear();
+    prefetcher_.Clear();
     state_ = kUninitialized;
-    last_found_ = 0;
-    script_.clear();
+    index_->Release();
+    index_ = NULL;
+    tombstones_.clear();
     current_key_ = "";
     // This one cannot fail because any errors of a "global"
     // nature would have been detected when we did Open().
@@ -1303,6 +2464,19 @@ class RandomAccessTableReaderScriptImpl:
     return HasKeyInternal(key, preload);
   }
 
+  virtual void Prefetch(const std::vector<std::string> &keys) {
+    if (!IsOpen())
+      KALDI_ERR << "Prefetch() called on non-open object.";
+    prefetcher_.Clear();
+    for (size_t i = 0; i < keys.size(); i++) {
+      int64 entry;
+      if (index_->Lookup(keys[i], &entry) &&
+          !(opts_.once && tombstones_[entry]))
+        prefetcher_.AddRequest(keys[i], index_->Rxfilename(entry), false);
+    }
+    prefetcher_.Start(opts_, this->stats_);
+  }
+
 
   // Write returns true on success, false on failure, but
   // some errors may not be detected till we call Close().
@@ -1311,6 +2485,21 @@ class RandomAccessTableReaderScriptImpl:
     if (!IsOpen())
       KALDI_ERR << "Value() called on non-open object.";
 
+    Holder *prefetched;
+    if (prefetcher_.Find(key, &prefetched)) {
+      int64 entry;
+      index_->Lookup(key, &entry);
+      if (opts_.once && tombstones_[entry])
+        KALDI_ERR << "Value called twice for the same key and ,o (once) "
+                  << "option is used: rspecifier is " << rspecifier_;
+      if (prefetched == NULL)
+        KALDI_ERR << "Could not get item for key " << key
+                  << ", rspecifier is " << rspecifier_ << "[to ignore this, "
+                  << "add the p, (permissive) option to the rspecifier.";
+      if (opts_.once) tombstones_[entry] = true;
+      return prefetched->Value();
+    }
+
     if (!((state_ == kHaveObject || state_ == kGaveObject)
           && key == current_key_)) {  // Not already stored...
       bool has_key = HasKeyInternal(key, true);  // preload.
@@ -1336,6 +2525,8 @@ class RandomAccessTableReaderScriptImpl:
   virtual ~RandomAccessTableReaderScriptImpl() {
     if (state_ == kHaveObject || state_ == kGaveObject)
       holder_.Clear();
+    if (index_ != NULL)
+      index_->Release();
   }
 
  private:
@@ -1356,12 +2547,12 @@ class RandomAccessTableReaderScriptImpl:
       default: break;
     }
     KALDI_ASSERT(IsToken(key));
-    size_t key_pos = 0; // set to zero to suppress warning
-    bool ans = LookupKey(key, &key_pos);
+    int64 key_pos = 0; // set to zero to suppress warning
+    bool ans = index_->Lookup(key, &key_pos);
     if (!ans) return false;
     else {
       // First do a check regarding the "once" option.
-      if (opts_.once && script_[key_pos].second == "") {  // A "tombstone"; user is asking about
+      if (opts_.once && tombstones_[key_pos]) {  // user is asking about
         // already-read key.
         KALDI_ERR << "HasKey called on key whose value was already read, and "
             " you specified the \"once\" option (o, ): try removing o, or adding no, :"
@@ -1369,22 +2560,29 @@ class RandomAccessTableReaderScriptImpl:
       }
       if (!preload)
         return true;  // we have the key.
+      Holder *prefetched;
+      if (prefetcher_.Find(key, &prefetched))
+        return (prefetched != NULL);
       else {  // preload specified, so we have to pre-load the object before returning true.
-        if (!input_.Open(script_[key_pos].second)) {
+        std::string rxfilename = index_->Rxfilename(key_pos);
+        bool opened = (opts_.memory_map ?
+                       input_.OpenMapped(rxfilename) :
+                       input_.Open(rxfilename));
+        if (!opened) {
           KALDI_WARN << "Error opening stream "
-                     << PrintableRxfilename(script_[key_pos].second);
+                     << PrintableRxfilename(rxfilename);
           return false;
         } else {
           // Make sure holder empty.
           if (state_ == kHaveObject || state_ == kGaveObject)
             holder_.Clear();
-          if (holder_.Read(input_.Stream())) {
+          if (ProfiledHolderRead(&holder_, input_.Stream(), this->stats_)) {
             state_ = kHaveObject;
             current_key_ = key;
             return true;
           } else {
             KALDI_WARN << "Error reading object from "
-                "stream " << PrintableRxfilename(script_[key_pos].second);
+                "stream " << PrintableRxfilename(rxfilename);
             state_ = kNotHaveObject;
             return false;
           }
@@ -1393,38 +2591,11 @@ class RandomAccessTableReaderScriptImpl:
     }
   }
   void MakeTombstone(const std::string &key) {
-    size_t offset;
-    if (!LookupKey(key, &offset))
+    int64 entry;
+    if (!index_->Lookup(key, &entry))
       KALDI_ERR << "RandomAccessTableReader object in inconsistent state.";
     else
-      script_[offset].second = "";
-  }
-  bool LookupKey(const std::string &key, size_t *script_offset) {
-    // First, an optimization: if we're going consecutively, this will
-    // make the lookup very fast.  Since we may call HasKey and then
-    // Value(), which both may look up the key, we test if either the
-    // current or next position are correct.
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
-      *script_offset = last_found_;
-      return true;
-    }
-    last_found_++;
-    if (last_found_ < script_.size() && script_[last_found_].first == key) {
-      *script_offset = last_found_;
-      return true;
-    }
-    std::pair<std::string, std::string> pr(key, "");  // Important that ""
-    // compares less than or equal to any string, so lower_bound points to the
-    // element that has the same key.
-    typedef typename std::vector<std::pair<std::string, std::string> >::const_iterator 
-        IterType;
-    IterType iter = std::lower_bound(script_.begin(), script_.end(), pr);
-    if (iter != script_.end() && iter->first == key) {
-      last_found_ = *script_offset = iter - script_.begin();
-      return true;
-    } else {
-      return false;
-    }
+      tombstones_[entry] = true;
   }
 
 
@@ -1437,18 +2608,17 @@ class RandomAccessTableReaderScriptImpl:
   std::string current_key_;  // Key of object in holder_
   Holder holder_;
 
-  // the script_ variable contains pairs of (key, filename), sorted using
-  // std::sort.  This can be used with binary_search to look up filenames for
-  // writing.  If this becomes inefficient we can use std::unordered_map (but I
-  // suspect this wouldn't be significantly faster & would use more memory).
-  // If memory becomes a problem here, the user should probably be passing
-  // only the relevant part of the scp file rather than expecting us to get too
-  // clever in the code.
-  std::vector<std::pair<std::string, std::string> > script_;
-  size_t last_found_;  // This is for an optimization used in FindFilename.
+  // The index of the scp file, which maps keys to filenames; NULL if not
+  // open.
+  ScriptIndex *index_;
+  // If opts_.once, the entries whose values have already been read, so that
+  // future lookups fail.
+  std::vector<bool> tombstones_;
+  // The objects read by Prefetch(), which are served from here.
+  RandomAccessTablePrefetcher<Holder> prefetcher_;
 
   enum {  //           [Do we have          [Does holder_
-    //                script_ set up?]      contain object?]
+    //                index_ set up?]       contain object?]
     kUninitialized,  //     no                     no
     kNotReadScript,  //     no                     no
     kNotHaveObject,  //     yes                    no
@@ -1493,7 +2663,8 @@ template<class Holder>  class RandomAccessTableReaderArchiveImplBase:
     // NULL means don't expect binary-mode header
     bool ans;
     if (Holder::IsReadInBinary())
-      ans = input_.Open(archive_rxfilename_, NULL);
+      ans = (opts_.memory_map ? input_.OpenMapped(archive_rxfilename_, NULL) :
+             input_.Open(archive_rxfilename_, NULL));
     else
       ans = input_.OpenTextMode(archive_rxfilename_);
     if (!ans) {  // header.
@@ -1542,7 +2713,7 @@ template<class Holder>  class RandomAccessTableReaderArchiveImplBase:
     }
     if (c != '\n') is.get();  // Consume the space or tab.
     holder_ = new Holder;
-    if (holder_->Read(is)) {
+    if (ProfiledHolderRead(holder_, is, this->stats_)) {
       state_ = kHaveObject;
       return;
     } else {
@@ -2080,9 +3251,162 @@ template<class Holder>  class RandomAccessTableReaderUnsortedArchiveImpl:
 
 
 
+// RandomAccessTableReaderIndexedArchiveImpl is for random-access reading of
+// archives that have an index (the "idx" option; see kaldi-archive-index.h).
+// Each lookup goes to the memory-mapped index, and each object is read by
+// seeking in the archive, so the keys may be asked for in any order and we
+// only ever hold one object in memory.  The "once", "sorted" and
+// "called-sorted" options make no difference here.
+template<class Holder>
+class RandomAccessTableReaderIndexedArchiveImpl:
+      public RandomAccessTableReaderImplBase<Holder> {
+ public:
+  typedef typename Holder::T T;
+
+  RandomAccessTableReaderIndexedArchiveImpl(): state_(kUninitialized) { }
+
+  virtual bool Open(const std::string &rspecifier) {
+    if (state_ != kUninitialized)
+      KALDI_ERR << "Opening already open RandomAccessTableReader: "
+                << "call Close first.";
+    rspecifier_ = rspecifier;
+    RspecifierType rs = ClassifyRspecifier(rspecifier, &archive_rxfilename_,
+                                           &opts_);
+    KALDI_ASSERT(rs == kArchiveRspecifier && opts_.indexed);
+    if (ClassifyRxfilename(archive_rxfilename_) != kFileInput) {
+      KALDI_WARN << "The idx option requires the archive to be an actual "
+                 << "file: rspecifier is " << rspecifier;
+      return false;
+    }
+    if (!index_.Open(ArchiveIndexFilename(archive_rxfilename_),
+                     archive_rxfilename_))
+      return false;  // It will have printed a warning.
+    state_ = kNoObject;
+    return true;
+  }
+
+  virtual bool HasKey(const std::string &key) {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "HasKey called on RandomAccessTableReader object that is "
+                << "not open.";
+    if (state_ == kHaveObject && key == current_key_)
+      return true;
+    int64 offset, length;
+    if (!index_.Lookup(key, &offset, &length))
+      return false;
+    if (!opts_.permissive)
+      return true;
+    // In permissive mode we only say we have the key if we can read it.
+    Holder *prefetched;
+    if (prefetcher_.Find(key, &prefetched))
+      return (prefetched != NULL);
+    return LoadObject(key, offset);
+  }
+
+  virtual void Prefetch(const std::vector<std::string> &keys) {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "Prefetch() called on non-open object.";
+    prefetcher_.Clear();
+    for (size_t i = 0; i < keys.size(); i++) {
+      int64 offset, length;
+      if (index_.Lookup(keys[i], &offset, &length)) {
+        std::ostringstream ss;
+        ss << archive_rxfilename_ << ':' << offset;
+        prefetcher_.AddRequest(keys[i], ss.str(), true);
+      }
+    }
+    prefetcher_.Start(opts_, this->stats_);
+  }
+
+  virtual const T &Value(const std::string &key) {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "Value() called on non-open object.";
+    Holder *prefetched;
+    if (prefetcher_.Find(key, &prefetched)) {
+      if (prefetched == NULL)
+        KALDI_ERR << "Could not get item for key " << key
+                  << ", rspecifier is " << rspecifier_;
+      return prefetched->Value();
+    }
+    if (!(state_ == kHaveObject && key == current_key_)) {
+      int64 offset, length;
+      if (!index_.Lookup(key, &offset, &length) || !LoadObject(key, offset))
+        KALDI_ERR << "Could not get item for key " << key
+                  << ", rspecifier is " << rspecifier_;
+    }
+    return holder_.Value();
+  }
+
+  virtual bool Close() {
+    if (state_ == kUninitialized)
+      KALDI_ERR << "Close() called on RandomAccessTableReader that was not "
+                << "open.";
+    holder_.Clear();
+    prefetcher_.Clear();
+    input_.Close();
+    index_.Close();
+    current_key_ = "";
+    state_ = kUninitialized;
+    return true;
+  }
+
+  virtual ~RandomAccessTableReaderIndexedArchiveImpl() {
+    if (state_ == kHaveObject)
+      holder_.Clear();
+  }
+
+ private:
+  // Reads the object at byte "offset" in the archive into holder_.  Returns
+  // true on success.
+  bool LoadObject(const std::string &key, int64 offset) {
+    if (state_ == kHaveObject) {
+      holder_.Clear();
+      state_ = kNoObject;
+    }
+    std::ostringstream ss;
+    ss << archive_rxfilename_ << ':' << offset;
+    // Input::Open keeps the archive open if it was the last file we read from,
+    // and just seeks.  NULL means don't expect a binary-mode header.
+    bool ans;
+    if (Holder::IsReadInBinary())
+      ans = (opts_.memory_map ? input_.OpenMapped(ss.str(), NULL) :
+             input_.Open(ss.str(), NULL));
+    else
+      ans = input_.OpenTextMode(ss.str());
+    if (!ans) {
+      KALDI_WARN << "Error opening stream " << PrintableRxfilename(ss.str());
+      return false;
+    }
+    if (!ProfiledHolderRead(&holder_, input_.Stream(), this->stats_)) {
+      KALDI_WARN << "Error reading object for key " << key << " from "
+                 << PrintableRxfilename(ss.str());
+      return false;
+    }
+    current_key_ = key;
+    state_ = kHaveObject;
+    return true;
+  }
+
+  ArchiveIndex index_;
+  Input input_;
+  Holder holder_;
+  std::string current_key_;  // Key of the object in holder_.
+  // The objects read by Prefetch(), which are served from here.
+  RandomAccessTablePrefetcher<Holder> prefetcher_;
+  RspecifierOptions opts_;
+  std::string rspecifier_;
+  std::string archive_rxfilename_;
+  enum {
+    kUninitialized,  // Not open.
+    kNoObject,  // Open, and holder_ is empty.
+    kHaveObject  // Open, and holder_ contains the object for current_key_.
+  } state_;
+};
+
+
 template<class Holder>
 RandomAccessTableReader<Holder>::RandomAccessTableReader(const std::string &rspecifier):
-    impl_(NULL) {
+    impl_(NULL), stats_(NULL) {
   if (rspecifier != "" && !Open(rspecifier))
     KALDI_ERR << "Error opening RandomAccessTableReader object "
         " (rspecifier is: " << rspecifier << ")";
@@ -2099,7 +3423,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
       impl_ = new RandomAccessTableReaderScriptImpl<Holder>();
       break;
     case kArchiveRspecifier:
-      if (opts.sorted) {
+      if (opts.indexed) {
+        impl_ = new RandomAccessTableReaderIndexedArchiveImpl<Holder>();
+      } else if (opts.sorted) {
         if (opts.called_sorted) // "doubly" sorted case.
           impl_ = new RandomAccessTableReaderDSortedArchiveImpl<Holder>();
         else
@@ -2111,6 +3437,9 @@ bool RandomAccessTableReader<Holder>::Open(const std::string &rspecifier) {
                  << rspecifier;
       return false;
   }
+  stats_ = NewTableIoStats("RandomAccessTableReader", rspecifier);
+  impl_->SetStats(stats_);
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   if (impl_->Open(rspecifier))
     return true;
   else {
@@ -2126,6 +3455,7 @@ bool RandomAccessTableReader<Holder>::HasKey(const std::string &key) {
   CheckImpl();
   if (!IsToken(key))
     KALDI_ERR << "Invalid key \"" << key << '"';
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   return impl_->HasKey(key);
 }
 
@@ -2134,12 +3464,25 @@ template<class Holder>
 const typename RandomAccessTableReader<Holder>::T&
 RandomAccessTableReader<Holder>::Value(const std::string &key) {
   CheckImpl();  
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   return impl_->Value(key);
 }
 
+template<class Holder>
+void RandomAccessTableReader<Holder>::Prefetch(
+    const std::vector<std::string> &keys) {
+  CheckImpl();
+  for (size_t i = 0; i < keys.size(); i++)
+    if (!IsToken(keys[i]))
+      KALDI_ERR << "Invalid key \"" << keys[i] << '"';
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
+  impl_->Prefetch(keys);
+}
+
 template<class Holder>
 bool RandomAccessTableReader<Holder>::Close() {
   CheckImpl();
+  TableIoTimer timer(stats_ ? &(stats_->wait_time) : NULL);
   bool ans =impl_->Close();
   delete impl_;
   impl_ = NULL;
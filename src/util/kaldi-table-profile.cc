@@ -0,0 +1,139 @@
+// util/kaldi-table-profile.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#include <pthread.h>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+#include "base/timer.h"
+#include "util/kaldi-table-profile.h"
+
+
+namespace kaldi {
+
+static bool TableIoProfileEnvironment() {
+  const char *value = getenv("KALDI_IO_PROFILE");
+  return (value != NULL && *value != '\0' && strcmp(value, "0") != 0);
+}
+
+static bool table_io_profile_enabled = TableIoProfileEnvironment();
+
+// All the statistics objects; they are never deleted.
+static std::vector<TableIoStats*> table_io_stats;
+static pthread_mutex_t table_io_stats_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool table_io_profile_registered = false;  // the atexit() handler.
+
+static void PrintTableIoProfileAtExit() {
+  std::ostringstream os;
+  PrintTableIoProfile(os);
+  // Log it line by line, so each line gets the usual prefix.
+  std::istringstream is(os.str());
+  std::string line;
+  while (std::getline(is, line))
+    KALDI_LOG << line;
+}
+
+void EnableTableIoProfile() {
+  table_io_profile_enabled = true;
+}
+
+bool TableIoProfileEnabled() {
+  return table_io_profile_enabled;
+}
+
+double TableIoTime() {
+  static Timer timer;
+  return timer.Elapsed();
+}
+
+// We use the same lock as for the list of statistics objects, so that
+// PrintTableIoProfile() sees consistent values.
+void AddTableIoStat(double *stat, double value) {
+  pthread_mutex_lock(&table_io_stats_mutex);
+  *stat += value;
+  pthread_mutex_unlock(&table_io_stats_mutex);
+}
+
+void AddTableIoStat(int64 *stat, int64 value) {
+  pthread_mutex_lock(&table_io_stats_mutex);
+  *stat += value;
+  pthread_mutex_unlock(&table_io_stats_mutex);
+}
+
+TableIoStats *NewTableIoStats(const std::string &type,
+                              const std::string &specifier) {
+  if (!table_io_profile_enabled)
+    return NULL;
+  TableIoStats *stats = new TableIoStats(type, specifier);
+  pthread_mutex_lock(&table_io_stats_mutex);
+  table_io_stats.push_back(stats);
+  if (!table_io_profile_registered) {
+    table_io_profile_registered = true;
+    atexit(PrintTableIoProfileAtExit);
+  }
+  pthread_mutex_unlock(&table_io_stats_mutex);
+  return stats;
+}
+
+void PrintTableIoProfile(std::ostream &os) {
+  pthread_mutex_lock(&table_io_stats_mutex);
+  // Add up the statistics of tables with the same type and specifier, keeping
+  // the order in which they were first opened.
+  std::vector<TableIoStats> totals;
+  std::map<std::pair<std::string, std::string>, size_t> total_index;
+  for (size_t i = 0; i < table_io_stats.size(); i++) {
+    const TableIoStats &stats = *(table_io_stats[i]);
+    std::pair<std::string, std::string> key(stats.type, stats.specifier);
+    std::map<std::pair<std::string, std::string>, size_t>::iterator iter =
+        total_index.find(key);
+    if (iter == total_index.end()) {
+      total_index[key] = totals.size();
+      totals.push_back(stats);
+    } else {
+      TableIoStats &total = totals[iter->second];
+      total.num_objects += stats.num_objects;
+      total.num_bytes += stats.num_bytes;
+      total.wait_time += stats.wait_time;
+      total.holder_time += stats.holder_time;
+    }
+  }
+  pthread_mutex_unlock(&table_io_stats_mutex);
+
+  std::ostringstream ss;  // so that we don't change the flags of "os".
+  ss << "Table I/O profile (waiting = time spent in calls to the table; "
+     << "holder = time spent reading/writing objects):\n";
+  for (size_t i = 0; i < totals.size(); i++) {
+    const TableIoStats &total = totals[i];
+    ss << "  " << total.type << " " << total.specifier << ": "
+       << total.num_objects << " objects, " << std::fixed
+       << std::setprecision(2) << (total.num_bytes / 1048576.0) << " MB, "
+       << std::setprecision(3) << total.wait_time << " s waiting, "
+       << total.holder_time << " s holder";
+    if (total.holder_time > 0.0 && total.num_bytes > 0)
+      ss << " (" << std::setprecision(1)
+         << (total.num_bytes / 1048576.0 / total.holder_time) << " MB/s)";
+    ss << '\n';
+  }
+  os << ss.str();
+}
+
+}  // namespace kaldi
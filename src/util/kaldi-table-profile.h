@@ -0,0 +1,157 @@
+// util/kaldi-table-profile.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_KALDI_TABLE_PROFILE_H_
+#define KALDI_UTIL_KALDI_TABLE_PROFILE_H_
+
+#include <iostream>
+#include <string>
+#include "base/kaldi-common.h"
+#include "util/kaldi-holder.h"
+
+
+namespace kaldi {
+
+/// \addtogroup table_group
+/// @{
+
+/*
+  Table I/O profiling, for finding out which stages of a recipe are limited by
+  I/O.  It is turned on by the --io-profile option (which all programs that
+  use ParseOptions accept), or by setting the environment variable
+  KALDI_IO_PROFILE to a value other than "0".  Then every TableWriter,
+  SequentialTableReader and RandomAccessTableReader records:
+
+    - the number of objects read or written;
+    - the number of bytes they took up, where the position in the stream is
+      known (not for pipes);
+    - the time the program spent waiting in calls to the table object
+      (Open(), Next(), HasKey(), Value(), Write(), Close() and so on);
+    - the time spent in the holder's Read() or Write() functions, i.e. in
+      reading and parsing, or formatting and writing, the objects.  If the
+      "bg" option is used this happens in a separate thread, so it is not
+      part of the waiting time.
+
+  and when the program exits it prints a summary to the log, with a line for
+  each rspecifier and wspecifier.  When profiling is off, the cost is a test
+  of a NULL pointer per call.
+*/
+
+struct TableIoStats {
+  std::string type;  // "SequentialTableReader", "RandomAccessTableReader" or
+                     // "TableWriter".
+  std::string specifier;  // The rspecifier or wspecifier.
+  int64 num_objects;
+  int64 num_bytes;
+  double wait_time;  // in seconds.
+  double holder_time;  // in seconds.
+  TableIoStats(const std::string &type, const std::string &specifier):
+      type(type), specifier(specifier), num_objects(0), num_bytes(0),
+      wait_time(0.0), holder_time(0.0) { }
+};
+
+/// Turns on table I/O profiling for tables opened from now on.
+void EnableTableIoProfile();
+
+/// Returns true if table I/O profiling is on.
+bool TableIoProfileEnabled();
+
+/// If profiling is on, returns a new statistics object for a table of type
+/// "type" opened with "specifier", which will be included in the summary
+/// (it is owned by the profiler); otherwise returns NULL.
+TableIoStats *NewTableIoStats(const std::string &type,
+                              const std::string &specifier);
+
+/// Prints the summary of all the tables opened so far (statistics of tables
+/// with the same type and specifier are added together).  This is called when
+/// the program exits, if profiling is on.
+void PrintTableIoProfile(std::ostream &os);
+
+/// Returns the time in seconds from an arbitrary starting point; for the
+/// profiling code.
+double TableIoTime();
+
+/// Adds "value" to *stat, which is a member of a TableIoStats object.  It
+/// holds a lock while doing so, because a table may be used from several
+/// threads at once (e.g. TableWriter with the "shards" option, or any table
+/// with the "bg" option).
+void AddTableIoStat(double *stat, double value);
+void AddTableIoStat(int64 *stat, int64 value);
+
+/// Adds the time from its construction to its destruction to *time, unless
+/// time is NULL (in which case it does nothing).
+class TableIoTimer {
+ public:
+  explicit TableIoTimer(double *time):
+      time_(time), start_(time != NULL ? TableIoTime() : 0.0) { }
+  ~TableIoTimer() {
+    if (time_ != NULL) AddTableIoStat(time_, TableIoTime() - start_);
+  }
+ private:
+  double *time_;
+  double start_;
+};
+
+/// Calls holder->Read(is), recording it in *stats if stats is not NULL.
+template<class Holder>
+bool ProfiledHolderRead(Holder *holder, std::istream &is,
+                        TableIoStats *stats) {
+  if (stats == NULL)
+    return holder->Read(is);
+  std::streamoff start_pos = is.tellg();
+  double start_time = TableIoTime();
+  bool ans = holder->Read(is);
+  AddTableIoStat(&(stats->holder_time), TableIoTime() - start_time);
+  if (ans) {
+    AddTableIoStat(&(stats->num_objects), 1);
+    std::streamoff end_pos = (start_pos == -1 ? -1 :
+                              static_cast<std::streamoff>(is.tellg()));
+    if (end_pos != -1)
+      AddTableIoStat(&(stats->num_bytes), end_pos - start_pos);
+  }
+  return ans;
+}
+
+/// Calls HolderWrite<Holder>(os, binary, t, align), recording it in *stats if
+/// stats is not NULL.
+template<class Holder>
+bool ProfiledHolderWrite(std::ostream &os, bool binary,
+                         const typename Holder::T &t, bool align,
+                         TableIoStats *stats) {
+  if (stats == NULL)
+    return HolderWrite<Holder>(os, binary, t, align);
+  std::streamoff start_pos = os.tellp();
+  double start_time = TableIoTime();
+  bool ans = HolderWrite<Holder>(os, binary, t, align);
+  AddTableIoStat(&(stats->holder_time), TableIoTime() - start_time);
+  if (ans) {
+    AddTableIoStat(&(stats->num_objects), 1);
+    std::streamoff end_pos = (start_pos == -1 ? -1 :
+                              static_cast<std::streamoff>(os.tellp()));
+    if (end_pos != -1)
+      AddTableIoStat(&(stats->num_bytes), end_pos - start_pos);
+  }
+  return ans;
+}
+
+/// @} end "addtogroup table_group"
+
+}  // namespace kaldi
+
+#endif  // KALDI_UTIL_KALDI_TABLE_PROFILE_H_
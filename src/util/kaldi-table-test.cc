@@ -22,6 +22,8 @@
 #include "util/kaldi-table.h"
 #include "util/kaldi-holder.h"
 #include "util/table-types.h"
+#include "util/kaldi-table-profile.h"
+#include <sys/stat.h>
 
 namespace kaldi {
 
@@ -164,7 +166,28 @@ void UnitTestClassifyWspecifier() {
     KALDI_ASSERT(ans == kBothWspecifier && ark == "" && scp == "" && opts.binary == true && opts.flush == false);
   }
 
+  {
+    std::string a = "ark,scp,shards=4:foo.ark,foo.scp";
+    std::string ark = "x", scp = "y"; WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, &ark, &scp, &opts);
+    KALDI_ASSERT(ans == kBothWspecifier && ark == "foo.ark" && scp == "foo.scp" && opts.num_shards == 4);
+    KALDI_ASSERT(ShardArchiveFilename(ark, 2) == "foo.2.ark" &&
+                 ShardArchiveFilename("foo", 3) == "foo.3" &&
+                 ShardArchiveFilename("foo.ark.kz", 1) == "foo.1.ark.kz");
+  }
 
+  {
+    std::string a = "ark,bg:foo";
+    WspecifierOptions opts;
+    WspecifierType ans = ClassifyWspecifier(a, NULL, NULL, &opts);
+    KALDI_ASSERT(ans == kArchiveWspecifier && opts.background);
+  }
+
+  {
+    std::string a = "ark,scp,shards=0:foo.ark,foo.scp";  // invalid.
+    WspecifierType ans = ClassifyWspecifier(a, NULL, NULL, NULL);
+    KALDI_ASSERT(ans == kNoWspecifier);
+  }
 }
 
 
@@ -313,6 +336,18 @@ void UnitTestClassifyRspecifier() {
     RspecifierType ans = ClassifyRspecifier(a, &b, NULL);
     KALDI_ASSERT(ans == kArchiveRspecifier && b == "a");
   }
+  {
+    std::string a = "bg,ark:a", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kArchiveRspecifier && b == "a" && opts.background);
+  }
+  {
+    std::string a = "scp,nbg:a", b;
+    RspecifierOptions opts;
+    RspecifierType ans = ClassifyRspecifier(a, &b, &opts);
+    KALDI_ASSERT(ans == kScriptRspecifier && b == "a" && !opts.background);
+  }
 
 
 }
@@ -675,6 +710,94 @@ void UnitTestTableSequentialDoubleMatrixBoth(bool binary, bool read_scp) {
 }
 
 
+// Tests the "bg" (background read-ahead) option: reads all of the objects, or
+// stops early, and checks we get the same as was written.
+void UnitTestTableSequentialBackground(bool binary, bool read_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v.push_back( new Matrix<double>(1 + Rand()%4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+
+  bool ans;
+  DoubleMatrixWriter bw(binary ? "b,ark,scp:tmpf,tmpf.scp" : "t,ark,scp:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)  {
+    bw.Write(k[i], *(v[i]));
+  }
+  ans = bw.Close();
+  KALDI_ASSERT(ans);
+
+  // If stop_at < sz we close the reader before reading everything; this
+  // makes sure the background thread is stopped correctly.
+  int32 stop_at = (Rand() % 2 == 0 ? sz : Rand() % (sz + 1));
+  SequentialDoubleMatrixReader sbr(read_scp ? "scp,bg:tmpf.scp" : "ark,bg:tmpf");
+  int32 i = 0;
+  for (; !sbr.Done() && i < stop_at; sbr.Next(), i++) {
+    KALDI_ASSERT(sbr.Key() == k[i]);
+    if (binary)
+      KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i]), 1.0e-10));
+    else
+      KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i])));
+    if (i % 3 == 0)
+      sbr.FreeCurrent();
+  }
+  KALDI_ASSERT(i == stop_at);
+  KALDI_ASSERT(sbr.Close());
+  for (int32 j = 0; j < sz; j++)
+    delete v[j];
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
+// Tests that with the "bg" option, an scp entry that cannot be read only
+// causes an error if the user asks for its value.
+void UnitTestTableSequentialBackgroundError() {
+  {
+    Int32Writer iw("ark,scp:tmpf,tmpf.scp");
+    iw.Write("a", 1);
+    iw.Write("c", 3);
+  }
+  {
+    // Insert a key whose file does not exist, between "a" and "c".
+    std::ifstream is("tmpf.scp");
+    std::string line_a, line_c;
+    std::getline(is, line_a);
+    std::getline(is, line_c);
+    std::ofstream os("tmpf.scp");
+    os << line_a << "\nb tmpf.nonexistent\n" << line_c << "\n";
+  }
+  for (int32 ask_for_b = 0; ask_for_b < 2; ask_for_b++) {
+    SequentialInt32Reader reader("scp,bg:tmpf.scp");
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "a" &&
+                 reader.Value() == 1);
+    reader.Next();
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "b");
+    if (ask_for_b) {
+      bool threw = false;
+      try {
+        reader.Value();
+      } catch (const std::exception &e) {
+        threw = true;
+      }
+      KALDI_ASSERT(threw);
+    }
+    reader.Next();
+    KALDI_ASSERT(!reader.Done() && reader.Key() == "c" &&
+                 reader.Value() == 3);
+    reader.Next();
+    KALDI_ASSERT(reader.Done());
+    KALDI_ASSERT(reader.Close());
+  }
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 // Writing as both and reading as archive.
 void UnitTestTableSequentialBaseFloatVectorBoth(bool binary, bool read_scp) {
   int32 sz = Rand() % 10;
@@ -770,6 +893,7 @@ void UnitTestTableRandomBothDouble(bool binary, bool read_scp,
   else if (Rand()%2 == 0) name += "ncs,";
   if (once) name += "o,";
   else if (Rand()%2 == 0) name += "no,";
+  if (read_scp && Rand()%2 == 0) name += "idx,";  // cache the scp index.
   name += std::string(read_scp ? "scp:tmpf.scp" : "ark:tmpf");
 
   RandomAccessDoubleReader sbr(name);
@@ -801,6 +925,7 @@ void UnitTestTableRandomBothDouble(bool binary, bool read_scp,
       }
     }
   }
+  unlink("tmpf.scp.idx");
 }
 
 
@@ -880,13 +1005,516 @@ void UnitTestTableRandomBothDoubleMatrix(bool binary, bool read_scp,
 
 
 
+// Writes an archive with an index (the "idx" option), and reads it back in
+// random order through the index.
+void UnitTestTableRandomIndexedArchive(bool binary, bool write_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v.push_back( new Matrix<double>(1 + Rand()%4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+  RandomizeVector(&k);  // the keys are not sorted in the archive.
+
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      (write_scp ? "ark,scp,idx:tmpf,tmpf.scp" : "ark,idx:tmpf");
+  DoubleMatrixWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], *(v[i]));
+  KALDI_ASSERT(bw.Close());
+
+  RandomAccessDoubleMatrixReader sbr(Rand() % 2 == 0 ? "ark,idx:tmpf" :
+                                     "p,ark,idx:tmpf");
+  KALDI_ASSERT(!sbr.HasKey("foo"));
+  for (int32 n = 0; n < sz * 2; n++) {
+    int32 i = Rand() % sz;
+    if (Rand() % 2 == 0)
+      KALDI_ASSERT(sbr.HasKey(k[i]));
+    if (binary)
+      KALDI_ASSERT(sbr.Value(k[i]).ApproxEqual(*(v[i]), 1.0e-10));
+    else
+      KALDI_ASSERT(sbr.Value(k[i]).ApproxEqual(*(v[i])));
+  }
+  KALDI_ASSERT(sbr.Close());
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+  unlink("tmpf.idx");
+  unlink("tmpf.scp");
+}
+
+
+// Prefetches random batches of keys from an scp file or an indexed archive,
+// and checks that the references returned by Value() for them stay valid
+// until the next Prefetch().
+// Prefetches with the "mmap" option from an scp file that points into two
+// archives.  The prefetched objects are views into the mappings, which must
+// stay valid after the prefetcher has finished reading (and moved from one
+// archive to the other).
+void UnitTestTableRandomPrefetchMapped() {
+  int32 sz = 2 + Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat>*> v;
+  std::vector<std::pair<std::string, std::string> > script;
+  for (int32 a = 0; a < 2; a++) {
+    std::string ark = (a == 0 ? "tmpf" : "tmpf2");
+    BaseFloatMatrixWriter bw("ark,scp:" + ark + "," + ark + ".scp");
+    for (int32 i = a; i < sz; i += 2) {
+      std::ostringstream os;
+      os << "key" << i;
+      k.push_back(os.str());
+      v.push_back(new Matrix<BaseFloat>(1 + Rand() % 4, 1 + Rand() % 4));
+      v.back()->SetRandn();
+      bw.Write(k.back(), *(v.back()));
+    }
+    KALDI_ASSERT(bw.Close());
+    std::vector<std::pair<std::string, std::string> > this_script;
+    KALDI_ASSERT(ReadScriptFile(ark + ".scp", true, &this_script));
+    script.insert(script.end(), this_script.begin(), this_script.end());
+  }
+  KALDI_ASSERT(WriteScriptFile("tmpf.scp", script));
+
+  RandomAccessBaseFloatMatrixViewReader reader(
+      std::string(Rand() % 2 == 0 ? "bg," : "") + "scp,mmap:tmpf.scp");
+  std::vector<int32> order(sz);
+  for (int32 i = 0; i < sz; i++)
+    order[i] = i;
+  RandomizeVector(&order);
+  std::vector<std::string> keys;
+  for (int32 i = 0; i < sz; i++)
+    keys.push_back(k[order[i]]);
+  reader.Prefetch(keys);
+  for (int32 i = 0; i < sz; i++) {
+    KALDI_ASSERT(reader.HasKey(keys[i]));
+    const MatrixBase<BaseFloat> &value = reader.Value(keys[i]);
+    KALDI_ASSERT(value.ApproxEqual(*(v[order[i]]), 1.0e-10));
+  }
+  KALDI_ASSERT(reader.Close());
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+  unlink("tmpf2");
+  unlink("tmpf.scp");
+  unlink("tmpf2.scp");
+}
+
+void UnitTestTableRandomPrefetch(bool binary, bool read_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v.push_back( new Matrix<double>(1 + Rand()%4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      "ark,scp,idx:tmpf,tmpf.scp";
+  DoubleMatrixWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], *(v[i]));
+  KALDI_ASSERT(bw.Close());
+  if (read_scp) {  // Add an entry that cannot be read.
+    std::vector<std::pair<std::string, std::string> > script;
+    KALDI_ASSERT(ReadScriptFile("tmpf.scp", true, &script));
+    script.push_back(std::make_pair("bad", "tmpf.missing"));
+    KALDI_ASSERT(WriteScriptFile("tmpf.scp", script));
+  }
+
+  std::string rspecifier = std::string(Rand() % 2 == 0 ? "bg," : "") +
+      (read_scp ? "p,scp:tmpf.scp" : "ark,idx:tmpf");
+  RandomAccessDoubleMatrixReader sbr(rspecifier);
+  for (int32 n = 0; n < 3; n++) {
+    std::vector<int32> batch;
+    for (int32 i = 0; i < sz; i++)
+      if (Rand() % 2 == 0)
+        batch.push_back(i);
+    RandomizeVector(&batch);
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < batch.size(); i++)
+      keys.push_back(k[batch[i]]);
+    keys.push_back("foo");
+    if (read_scp) keys.push_back("bad");
+    sbr.Prefetch(keys);
+    KALDI_ASSERT(!sbr.HasKey("foo"));
+    if (read_scp) KALDI_ASSERT(!sbr.HasKey("bad"));
+    std::vector<const Matrix<double>*> values;
+    for (size_t i = 0; i < batch.size(); i++) {
+      KALDI_ASSERT(sbr.HasKey(keys[i]));
+      values.push_back(&(sbr.Value(keys[i])));
+    }
+    if (sz > 0) {  // A key that may not have been prefetched.
+      int32 i = Rand() % sz;
+      KALDI_ASSERT(sbr.Value(k[i]).ApproxEqual(*(v[i]),
+                                                binary ? 1.0e-10 : 0.01));
+    }
+    for (size_t i = 0; i < batch.size(); i++)
+      KALDI_ASSERT(values[i]->ApproxEqual(*(v[batch[i]]),
+                                          binary ? 1.0e-10 : 0.01));
+  }
+  KALDI_ASSERT(sbr.Close());
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+  unlink("tmpf.idx");
+  unlink("tmpf.scp");
+}
+
+// Reads matrices with the "mmap" option, both as ordinary matrices and as
+// views into the file (which will be views only if the data happens to be
+// aligned).
+void UnitTestTableMemoryMapped(bool binary, bool read_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    if (i % 2 == 0) os << "x";  // so the keys have different lengths.
+    k.push_back(os.str());
+    v.push_back( new Matrix<BaseFloat>(1 + Rand() % 4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+  BaseFloatMatrixWriter bw(binary ? "b,ark,scp,idx,align:tmpf,tmpf.scp" :
+                           "t,ark,scp,idx,align:tmpf,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], *(v[i]));
+  KALDI_ASSERT(bw.Close());
+
+  BaseFloat tol = (binary ? 1.0e-10 : 0.01);
+  SequentialBaseFloatMatrixReader sbr(read_scp ? "scp,mmap:tmpf.scp" :
+                                      "ark,mmap:tmpf");
+  SequentialBaseFloatMatrixViewReader svr(read_scp ? "scp,mmap:tmpf.scp" :
+                                          "ark,bg,mmap:tmpf");
+  RandomAccessBaseFloatMatrixViewReader rvr(read_scp ? "scp,mmap:tmpf.scp" :
+                                            "ark,idx,mmap:tmpf");
+  for (int32 i = 0; i < sz; i++, sbr.Next(), svr.Next()) {
+    KALDI_ASSERT(!sbr.Done() && !svr.Done());
+    KALDI_ASSERT(sbr.Key() == k[i] && svr.Key() == k[i]);
+    KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i]), tol));
+    KALDI_ASSERT(svr.Value().ApproxEqual(*(v[i]), tol));
+  }
+  KALDI_ASSERT(sbr.Done() && svr.Done());
+  for (int32 n = 0; n < sz; n++) {
+    int32 i = Rand() % sz;
+    KALDI_ASSERT(rvr.HasKey(k[i]));
+    KALDI_ASSERT(rvr.Value(k[i]).ApproxEqual(*(v[i]), tol));
+  }
+  KALDI_ASSERT(sbr.Close() && svr.Close() && rvr.Close());
+
+  if (binary) {
+    // The writer aligns the data, so every matrix should be read as a view,
+    // and the views should stay valid after the file is closed.
+    std::vector<std::pair<std::string, std::string> > script;
+    KALDI_ASSERT(ReadScriptFile("tmpf.scp", true, &script));
+    KALDI_ASSERT(script.size() == static_cast<size_t>(sz));
+    std::vector<MatrixViewHolder*> holders(sz);
+    {
+      Input ki;
+      for (int32 i = 0; i < sz; i++) {
+        KALDI_ASSERT(ki.OpenMapped(script[i].second, NULL));
+        holders[i] = new MatrixViewHolder();
+        KALDI_ASSERT(holders[i]->Read(ki.Stream()));
+        KALDI_ASSERT(holders[i]->IsView());
+      }
+    }
+    for (int32 i = 0; i < sz; i++) {
+      KALDI_ASSERT(holders[i]->Value().ApproxEqual(*(v[i]), tol));
+      delete holders[i];
+    }
+  }
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+  unlink("tmpf.idx");
+  unlink("tmpf.scp");
+}
+
+
+// Checks that without the "align" option the archive is exactly as it always
+// was (no padding), and that an archive written with it can still be read as
+// matrices of float and of double.
+void UnitTestTableAlign() {
+  int32 sz = 1 + Rand() % 10;
+  std::vector<std::string> k;
+  std::vector<Matrix<BaseFloat>*> v;
+  std::ostringstream expected;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << std::string(Rand() % 4, 'x') << i;
+    k.push_back(os.str());
+    v.push_back(new Matrix<BaseFloat>(1 + Rand() % 4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+    expected << k[i] << ' ';
+    InitKaldiOutputStream(expected, true);
+    v[i]->Write(expected, true);
+  }
+  {
+    BaseFloatMatrixWriter bw("ark:tmpf");
+    for (int32 i = 0; i < sz; i++)
+      bw.Write(k[i], *(v[i]));
+    KALDI_ASSERT(bw.Close());
+    bool binary;
+    Input ki("tmpf", &binary);
+    std::ostringstream contents;
+    contents << ki.Stream().rdbuf();
+    KALDI_ASSERT(contents.str() == expected.str());
+  }
+  {
+    BaseFloatMatrixWriter bw("ark,align:tmpf");
+    for (int32 i = 0; i < sz; i++)
+      bw.Write(k[i], *(v[i]));
+    KALDI_ASSERT(bw.Close());
+  }
+  SequentialBaseFloatMatrixReader sbr("ark:tmpf");
+  SequentialDoubleMatrixReader sdr("ark:tmpf");
+  for (int32 i = 0; i < sz; i++, sbr.Next(), sdr.Next()) {
+    KALDI_ASSERT(!sbr.Done() && !sdr.Done());
+    KALDI_ASSERT(sbr.Key() == k[i] && sdr.Key() == k[i]);
+    KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i]), 1.0e-10));
+    Matrix<BaseFloat> m(sdr.Value());
+    KALDI_ASSERT(m.ApproxEqual(*(v[i]), 1.0e-10));
+  }
+  KALDI_ASSERT(sbr.Done() && sdr.Done());
+  KALDI_ASSERT(sbr.Close() && sdr.Close());
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+}
+
+
+// Writes with the shards option and reads back the merged scp, whose order
+// must be the order in which the objects were written.
+void UnitTestTableSharded(bool binary, bool write_index) {
+  int32 sz = Rand() % 20, num_shards = 2 + Rand() % 3;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v.push_back( new Matrix<double>(1 + Rand()%4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+  RandomizeVector(&k);  // the order should be preserved, not sorted.
+
+  std::ostringstream wspecifier;
+  wspecifier << (binary ? "b," : "t,") << "ark,scp,"
+             << (write_index ? "idx," : "") << "shards=" << num_shards
+             << ":tmpf.ark,tmpf.scp";
+  DoubleMatrixWriter bw(wspecifier.str());
+  for (int32 i = 0; i < sz; i++) {
+    bw.Write(k[i], *(v[i]));
+    if (i == sz / 2) bw.Flush();
+  }
+  KALDI_ASSERT(bw.Close());
+
+  BaseFloat tol = (binary ? 1.0e-10 : 0.01);
+  SequentialDoubleMatrixReader sbr("scp:tmpf.scp");
+  for (int32 i = 0; i < sz; i++, sbr.Next()) {
+    KALDI_ASSERT(!sbr.Done() && sbr.Key() == k[i]);
+    KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i]), tol));
+  }
+  KALDI_ASSERT(sbr.Done() && sbr.Close());
+  if (write_index) {
+    // Every object can be found through the index of its own archive.
+    for (int32 i = 0; i < sz; i++) {
+      std::string ark = ShardArchiveFilename("tmpf.ark", 1 + i % num_shards);
+      RandomAccessDoubleMatrixReader rbr("ark,idx:" + ark);
+      KALDI_ASSERT(rbr.HasKey(k[i]) &&
+                   rbr.Value(k[i]).ApproxEqual(*(v[i]), tol));
+    }
+    // If writing fails (here because an index cannot be written), the scp
+    // file we wrote before must be left as it was.
+    std::string index = ArchiveIndexFilename(ShardArchiveFilename("tmpf.ark",
+                                                                  1));
+    unlink(index.c_str());
+    KALDI_ASSERT(mkdir(index.c_str(), 0700) == 0);
+    std::string old_scp, new_scp;
+    {
+      std::ifstream is("tmpf.scp");
+      std::getline(is, old_scp, '\0');
+    }
+    DoubleMatrixWriter bw2(wspecifier.str());
+    bw2.Write("foo", Matrix<double>(2, 2));
+    KALDI_ASSERT(!bw2.Close());
+    {
+      std::ifstream is("tmpf.scp");
+      std::getline(is, new_scp, '\0');
+    }
+    KALDI_ASSERT(new_scp == old_scp);
+    KALDI_ASSERT(access("tmpf.scp.tmp", F_OK) != 0);
+    rmdir(index.c_str());
+  }
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  for (int32 i = 1; i <= num_shards; i++) {
+    unlink(ShardArchiveFilename("tmpf.ark", i).c_str());
+    unlink(ArchiveIndexFilename(ShardArchiveFilename("tmpf.ark", i)).c_str());
+  }
+  unlink("tmpf.scp");
+
+  // If one of the archives cannot be opened, Open() must fail and leave
+  // nothing behind: no archives, no indexes and no temporary scp file.
+  std::string last_ark = ShardArchiveFilename("tmpf.ark", num_shards);
+  KALDI_ASSERT(mkdir(last_ark.c_str(), 0700) == 0);
+  DoubleMatrixWriter bw3;
+  KALDI_ASSERT(!bw3.Open(wspecifier.str()));
+  for (int32 i = 1; i < num_shards; i++) {
+    std::string ark = ShardArchiveFilename("tmpf.ark", i);
+    KALDI_ASSERT(access(ark.c_str(), F_OK) != 0 &&
+                 access(ArchiveIndexFilename(ark).c_str(), F_OK) != 0);
+  }
+  KALDI_ASSERT(access("tmpf.scp", F_OK) != 0 &&
+               access("tmpf.scp.tmp", F_OK) != 0);
+  rmdir(last_ark.c_str());
+}
+
+// Writes a block-compressed archive and reads it back sequentially, and in
+// random order through the offsets in the scp.
+void UnitTestTableCompressedArchive(bool binary, bool read_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    // Some large matrices, so there is more than one block.
+    v.push_back( new Matrix<double>(1 + Rand() % 4, 1 + Rand() % 1000));
+    v.back()->SetRandn();
+  }
+  DoubleMatrixWriter bw(binary ? "b,ark,scp:tmpf.ark.kz,tmpf.scp" :
+                        "t,ark,scp:tmpf.ark.kz,tmpf.scp");
+  for (int32 i = 0; i < sz; i++)
+    bw.Write(k[i], *(v[i]));
+  KALDI_ASSERT(bw.Close());
+
+  BaseFloat tol = (binary ? 1.0e-10 : 0.01);
+  SequentialDoubleMatrixReader sbr(read_scp ? "scp:tmpf.scp" :
+                                   "ark:tmpf.ark.kz");
+  for (int32 i = 0; i < sz; i++, sbr.Next()) {
+    KALDI_ASSERT(!sbr.Done() && sbr.Key() == k[i]);
+    KALDI_ASSERT(sbr.Value().ApproxEqual(*(v[i]), tol));
+  }
+  KALDI_ASSERT(sbr.Done() && sbr.Close());
+  RandomAccessDoubleMatrixReader rbr("scp:tmpf.scp");
+  for (int32 n = 0; n < sz; n++) {
+    int32 i = Rand() % sz;
+    KALDI_ASSERT(rbr.HasKey(k[i]) && rbr.Value(k[i]).ApproxEqual(*(v[i]), tol));
+  }
+  KALDI_ASSERT(rbr.Close());
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf.ark.kz");
+  unlink("tmpf.scp");
+}
+
+// Writes with the "bg" option, and checks that an error in the background
+// thread is reported by Close().
+void UnitTestTableWriterBackground(bool binary, bool write_scp) {
+  int32 sz = Rand() % 20;
+  std::vector<std::string> k;
+  std::vector<Matrix<double>*> v;
+  for (int32 i = 0; i < sz; i++) {
+    std::ostringstream os;
+    os << "key" << i;
+    k.push_back(os.str());
+    v.push_back( new Matrix<double>(1 + Rand()%4, 1 + Rand() % 4));
+    v.back()->SetRandn();
+  }
+  std::string wspecifier = std::string(binary ? "b," : "t,") +
+      (write_scp ? "ark,scp,bg:tmpf,tmpf.scp" : "ark,bg:tmpf");
+  DoubleMatrixWriter bw(wspecifier);
+  for (int32 i = 0; i < sz; i++) {
+    bw.Write(k[i], *(v[i]));
+    v[i]->SetZero();  // The writer must have taken a copy.
+    if (i == sz / 2) bw.Flush();
+  }
+  KALDI_ASSERT(bw.Close());
+
+  SequentialDoubleMatrixReader sbr(write_scp ? "scp:tmpf.scp" : "ark:tmpf");
+  for (int32 i = 0; i < sz; i++, sbr.Next())
+    KALDI_ASSERT(!sbr.Done() && sbr.Key() == k[i] &&
+                 sbr.Value().NumRows() == v[i]->NumRows());
+  KALDI_ASSERT(sbr.Done() && sbr.Close());
+
+  {
+    // Writing a key that is not in the scp file fails in the background.
+    Output ko("tmpf.scp", false);
+    ko.Stream() << "a tmpf.a\n";
+  }
+  Int32Writer iw("scp,bg:tmpf.scp");
+  iw.Write("a", 1);
+  iw.Write("b", 2);
+  KALDI_ASSERT(!iw.Close());
+
+  for (int32 i = 0; i < sz; i++)
+    delete v[i];
+  unlink("tmpf");
+  unlink("tmpf.a");
+  unlink("tmpf.scp");
+}
+
+// Checks the counts recorded by table I/O profiling.  Note: this turns on
+// profiling for the rest of the program.
+void UnitTestTableIoProfile() {
+  EnableTableIoProfile();
+  KALDI_ASSERT(TableIoProfileEnabled());
+  int32 sz = 1 + Rand() % 10;
+  {
+    Int32VectorWriter writer("ark,scp,bg:tmpf,tmpf.scp");
+    for (int32 i = 0; i < sz; i++) {
+      std::ostringstream key;
+      key << "key" << i;
+      writer.Write(key.str(), std::vector<int32>(i, i));
+    }
+  }
+  {
+    SequentialInt32VectorReader reader("scp:tmpf.scp");
+    for (; !reader.Done(); reader.Next()) {
+      const std::vector<int32> &value = reader.Value();
+      KALDI_ASSERT(value.empty() || value[0] == value.size());
+    }
+  }
+  {
+    RandomAccessInt32VectorReader reader("ark:tmpf");
+    KALDI_ASSERT(reader.HasKey("key0") && !reader.HasKey("foo"));
+  }
+  std::ostringstream os;
+  PrintTableIoProfile(os);
+  std::string profile = os.str();
+  KALDI_LOG << profile;
+  std::ostringstream expected_writer, expected_seq_reader;
+  expected_writer << "TableWriter ark,scp,bg:tmpf,tmpf.scp: " << sz
+                  << " objects, ";
+  expected_seq_reader << "SequentialTableReader scp:tmpf.scp: " << sz
+                      << " objects, ";
+  KALDI_ASSERT(profile.find(expected_writer.str()) != std::string::npos);
+  KALDI_ASSERT(profile.find(expected_seq_reader.str()) != std::string::npos);
+  // The random-access reader reads the whole archive while looking for "foo".
+  KALDI_ASSERT(profile.find("RandomAccessTableReader ark:tmpf: ") !=
+               std::string::npos);
+  unlink("tmpf");
+  unlink("tmpf.scp");
+}
+
 }  // end namespace kaldi.
 
+
 int main() {
   using namespace kaldi;
   UnitTestReadScriptFile();
   UnitTestClassifyWspecifier();
   UnitTestClassifyRspecifier();
+  UnitTestTableSequentialBackgroundError();
+  for (int i = 0; i < 10; i++)
+    UnitTestTableRandomPrefetchMapped();
   for (int i = 0; i < 10; i++) {
     bool b = (i == 0);
     UnitTestTableSequentialBool(b);
@@ -901,6 +1529,14 @@ int main() {
       UnitTestTableSequentialInt32PairVectorBoth(b, c);
       UnitTestTableSequentialInt32VectorVectorBoth(b, c);
       UnitTestTableSequentialBaseFloatVectorBoth(b, c);
+      UnitTestTableSequentialBackground(b, c);
+      UnitTestTableRandomIndexedArchive(b, c);
+      UnitTestTableRandomPrefetch(b, c);
+      UnitTestTableMemoryMapped(b, c);
+      UnitTestTableAlign();
+      UnitTestTableSharded(b, c);
+      UnitTestTableCompressedArchive(b, c);
+      UnitTestTableWriterBackground(b, c);
       for (int k = 0; k < 2; k++) {
         bool d = (k == 0);
         for (int l = 0; l < 2; l++) {
@@ -914,6 +1550,7 @@ int main() {
       }
     }
   }
+  UnitTestTableIoProfile();  // last, as it turns on profiling.
   std::cout << "Test OK.\n";
   return 0;
 }
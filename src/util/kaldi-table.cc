@@ -19,6 +19,7 @@
 
 #include "util/kaldi-table.h"
 #include "util/text-utils.h"
+#include "util/block-compression.h"
 
 namespace kaldi {
 
@@ -140,6 +141,8 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   //  ark,scp,f:filename, wxfilename ->  kBothWspecifier
   // or:
   //  scp,t,nf:rxfilename -> kScriptWspecifier
+  // and with both archive and script we can write several archives:
+  //  ark,scp,shards=4:filename, wxfilename ->  kBothWspecifier
 
   if (archive_wxfilename) archive_wxfilename->clear();
   if (script_wxfilename) script_wxfilename->clear();
@@ -173,6 +176,20 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
       if (opts) opts->binary = false;
     } else if (!strcmp(c, "p")) {
       if (opts) opts->permissive = true;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->write_index = true;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strcmp(c, "nbg")) {
+      if (opts) opts->background = false;
+    } else if (!strcmp(c, "align")) {
+      if (opts) opts->align = true;
+    } else if (!strncmp(c, "shards=", 7)) {
+      int32 num_shards;
+      if (!ConvertStringToInteger(str.substr(7), &num_shards) ||
+          num_shards < 1)
+        return kNoWspecifier;
+      if (opts) opts->num_shards = num_shards;
     } else if (!strcmp(c, "ark")) {
       if (ws == kNoWspecifier) ws = kArchiveWspecifier;
       else return kNoWspecifier;  // We do not allow "scp, ark", only "ark, scp".
@@ -207,6 +224,24 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
   return ws;
 }
 
+std::string ShardArchiveFilename(const std::string &archive_wxfilename,
+                                 int32 shard) {
+  // Keep the ".kz" suffix of block-compressed archives at the end.
+  std::string name = archive_wxfilename, suffix;
+  if (IsBlockCompressedFilename(name)) {
+    name.resize(name.size() - 3);
+    suffix = ".kz";
+  }
+  std::ostringstream ss;
+  size_t len = name.size();
+  if (len > 4 && name.compare(len - 4, 4, ".ark") == 0)
+    ss << name.substr(0, len - 4) << '.' << shard << ".ark";
+  else
+    ss << name << '.' << shard;
+  ss << suffix;
+  return ss.str();
+}
+
 
 
 RspecifierType ClassifyRspecifier(const std::string &rspecifier,
@@ -219,7 +254,8 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
   // We also allow the meaningless prefixes b, and t,
   // plus the options o (once), no (not-once),
   // s (sorted) and ns (not-sorted), p (permissive)
-  // and np (not-permissive).
+  // and np (not-permissive), bg (background) and nbg, idx (indexed) and
+  // nidx, mmap (memory-map) and nmmap.
   // so the following would be valid:
   //
   // f, o, b, np, ark:rxfilename  ->  kArchiveRspecifier
@@ -276,6 +312,18 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
       if (opts) opts->called_sorted = true;
     } else if (!strcmp(c, "ncs")) {
       if (opts) opts->called_sorted = false;
+    } else if (!strcmp(c, "bg")) {
+      if (opts) opts->background = true;
+    } else if (!strcmp(c, "nbg")) {
+      if (opts) opts->background = false;
+    } else if (!strcmp(c, "idx")) {
+      if (opts) opts->indexed = true;
+    } else if (!strcmp(c, "nidx")) {
+      if (opts) opts->indexed = false;
+    } else if (!strcmp(c, "mmap")) {
+      if (opts) opts->memory_map = true;
+    } else if (!strcmp(c, "nmmap")) {
+      if (opts) opts->memory_map = false;
     } else if (!strcmp(c, "ark")) {
       if (rs == kNoRspecifier) rs = kArchiveRspecifier;
       else return kNoRspecifier;  // Repeated or combined ark and scp options invalid.
@@ -292,6 +340,28 @@ RspecifierType ClassifyRspecifier(const std::string &rspecifier,
   return rs;
 }
 
+void SplitRxfilenameOffset(const std::string &rxfilename,
+                           std::string *filename, int64 *offset) {
+  *filename = rxfilename;
+  *offset = 0;
+  size_t end = rxfilename.size();
+  // Remove a range specifier like "[0:9]" or "[0:9,10:19]".
+  if (end > 0 && rxfilename[end - 1] == ']') {
+    size_t bracket = rxfilename.rfind('[');
+    if (bracket == std::string::npos) return;
+    end = bracket;
+  }
+  size_t colon = rxfilename.rfind(':', end == 0 ? 0 : end - 1);
+  if (colon == std::string::npos || colon + 1 == end) return;
+  std::string number(rxfilename, colon + 1, end - colon - 1);
+  int64 n;
+  if (number.find_first_not_of("0123456789") != std::string::npos ||
+      !ConvertStringToInteger(number, &n))
+    return;
+  filename->assign(rxfilename, 0, colon);
+  *offset = n;
+}
+
 
 
 
@@ -34,6 +34,7 @@ namespace kaldi {
 template<class Holder> class RandomAccessTableReaderImplBase;
 template<class Holder>  class SequentialTableReaderImplBase;
 template<class Holder>  class TableWriterImplBase;
+struct TableIoStats;
 
 /// \addtogroup table_group
 /// @{
@@ -70,11 +71,39 @@ typedef std::vector<std::string> KeyList;
 //  p means permissive mode, when writing to an "scp" file only: will ignore
 //     missing scp entries, i.e. won't write anything for those files but will
 //     return success status).
+//  idx means also write an index of the archive (for archive foo.ark, it is
+//     written to foo.ark.idx when the writer is closed), which lets
+//     RandomAccessTableReader look up keys in any order; see the "idx" option
+//     for rspecifiers, and kaldi-archive-index.h.  The archive must be an
+//     actual file, and not block-compressed (see below).
+//  bg means "background": Write() just copies the object and queues it, and a
+//     separate thread serializes and writes it, so the caller does not wait
+//     for the I/O.  The copy is a deep copy made with the copy constructor of
+//     T (Write() only gets a const reference, so it can't swap the object in
+//     as the "bg" rspecifier option does), e.g. for a Matrix it allocates and
+//     copies all of its data; FSTs are cheap to copy, as the copy shares the
+//     data.  So "bg" only pays off when serializing and writing the object
+//     costs clearly more than copying it in memory, e.g. for compressed or
+//     text output, or a slow file system.  A write error may then be reported
+//     by the Write() call after the one that failed, or by Close().  (nbg
+//     means the opposite, and is the default.)
+//  align means that, in binary mode, the writer puts up to three spaces
+//     before each matrix of BaseFloat so that its data is aligned in the
+//     file; the "mmap" rspecifier option can then read it without copying
+//     (see MatrixViewHolder in kaldi-holder-inl.h).  Readers skip the spaces.
+//     It has no effect for other types, for pipes, or with shards=N.
+//  shards=N (only with ark,scp) means write the archive as N separate archive
+//     files, written concurrently by N background threads, plus a single scp
+//     file that is written when the writer is closed; see below.
 //
 //  So the following are valid wspecifiers:
 //  ark,b,f:foo
 //  "ark,b,b:| gzip -c > foo"
 //  "ark,scp,t,nf:foo.ark,|gzip -c > foo.scp.gz"
+//  ark,idx:foo.ark
+//  ark,scp,align:foo.ark,foo.scp
+//  ark,scp,shards=4:foo.ark,foo.scp
+//  "ark,bg:| gzip -c > foo.gz"
 //  ark,b:-
 //
 //  The meanings of rxfilename and wxfilename are as described in
@@ -100,7 +129,19 @@ typedef std::vector<std::string> KeyList;
 //  where the number is the byte offset into the file.
 //  In this case we restrict the archive-filename to be an actual filename,
 //  as we can't see a situtation where an extended filename would make sense
-//  for this (we can't fseek() in pipes).
+//  for this (we can't fseek() in pipes).  The archive may however be
+//  block-compressed, by giving it a name ending in ".kz" (see kaldi-io.h), e.g.
+//  ark,scp:foo.ark.kz,foo.scp; the offsets then refer to the uncompressed data.
+//
+//  With the shards=N option, e.g. ark,scp,shards=4:foo.ark,foo.scp, the
+//  objects are written (in round-robin order) to the archives foo.1.ark,
+//  foo.2.ark, ... foo.4.ark (see ShardArchiveFilename()), each by its own
+//  background thread; Write() only serializes the object into memory and
+//  queues it.  The scp file, which lists the objects in the order in which
+//  Write() was called, is written all at once by Close(), so it will not exist
+//  if the program dies first.  With this option (only), Write() may be called
+//  from several threads at once, and the objects are serialized in parallel.
+//  The idx option, if given, writes an index for each of the archives.
 
 enum WspecifierType  {
   kNoWspecifier,
@@ -113,7 +154,13 @@ struct WspecifierOptions {
   bool binary;
   bool flush;
   bool permissive; // will ignore absent scp entries.
-  WspecifierOptions(): binary(true), flush(false), permissive(false) { }
+  bool write_index;  // will write an index of the archive (foo.ark.idx).
+  int32 num_shards;  // if > 1, the number of archives to write ("shards=N").
+  bool background;  // will write in a separate thread ("bg").
+  bool align;  // will align the data of matrices in the file ("align").
+  WspecifierOptions(): binary(true), flush(false), permissive(false),
+                       write_index(false), num_shards(1), background(false),
+                       align(false) { }
 };
 
 // ClassifyWspecifier returns the type of the wspecifier string,
@@ -125,6 +172,14 @@ WspecifierType ClassifyWspecifier(const std::string &wspecifier,
                                   std::string *script_wxfilename,
                                   WspecifierOptions *opts);
 
+// Returns the filename of archive number "shard" (numbered from 1) when the
+// archive "archive_wxfilename" is written with the shards=N option: for
+// foo.ark it is foo.1.ark, foo.2.ark and so on, and for other names that do
+// not end in .ark we just append the number, e.g. foo.1.  The ".kz" suffix of
+// block-compressed archives is kept at the end, e.g. foo.1.ark.kz.
+std::string ShardArchiveFilename(const std::string &archive_wxfilename,
+                                 int32 shard);
+
 // ReadScriptFile reads an .scp file in its entirety, and appends it
 // (in order as it was in the scp file) in script_out_, which contains
 // pairs of (key, xfilename).  The .scp
@@ -173,6 +228,27 @@ bool WriteScriptFile(std::ostream &os,
 //   p   means "permissive", and causes it to skip over keys whose corresponding
 //       scp-file entries cannot be read. [and to ignore errors in archives and
 //       script files, and just consider the "good" entries].
+//   idx means the archive has an index (for archive foo.ark, the index is
+//       foo.ark.idx, as written by TableWriter with the "idx" option).  This
+//       only makes a difference for RandomAccessTableReader, which will then
+//       look up each key in the index and seek to it, so keys can be asked
+//       for in any order and objects are not kept in memory.  The archive
+//       must be an actual file, and the index must be up to date.  For scp
+//       files, it means the index that RandomAccessTableReader builds from
+//       the scp file (see kaldi-script-index.h) is cached in foo.scp.idx,
+//       so that later programs reading the same scp file can load it
+//       without parsing the scp file.
+//   mmap means memory-map the archive, or the files (and archives) that
+//       the scp file points to, when they are actual files; see
+//       Input::OpenMapped() in kaldi-io.h.  This avoids copies and system calls
+//       when reading, and holders that know about it (e.g. MatrixViewHolder)
+//       can give access to objects in place, without copying them.
+//   bg  means "background".  For SequentialTableReader, it reads and parses
+//       the objects in a separate thread, a few objects ahead of the program,
+//       so that reading and decompression (e.g. "ark:gunzip -c foo.gz|")
+//       overlap with the computation.  It costs extra memory for the objects
+//       that have been read ahead.  For RandomAccessTableReader it makes
+//       Prefetch() read in a separate thread.
 //       We allow the negation of the options above, as in no, ns, np,
 //       but these aren't currently very useful (just equivalent to omitting the
 //       corresponding option).
@@ -186,6 +262,9 @@ bool WriteScriptFile(std::ostream &os,
 //  So for instance the following would be a valid rspecifier:
 //
 //   "o, s, p, ark:gunzip -c foo.gz|"
+//   "ark,bg:gunzip -c foo.gz|"
+//   "ark,idx:foo.ark"
+//   "scp,mmap:feats.scp"
 
 struct  RspecifierOptions {
   // These options only make a difference for the RandomAccessTableReader class.
@@ -198,9 +277,20 @@ struct  RspecifierOptions {
   // For archive files it will suppress errors getting thrown if the archive
   
   // is corrupted and can't be read to the end.
+  bool background;  // For sequential reading, if the "background" option
+  // ("bg") is provided, it will read ahead in a separate thread; for random
+  // access, RandomAccessTableReader::Prefetch() reads in a separate thread.
+  bool indexed;  // For random access to archives, if the "idx" option is
+  // provided, it will use the index of the archive (see kaldi-archive-index.h);
+  // for scp files, it caches the index of the scp file on disk (see
+  // kaldi-script-index.h).
+  bool memory_map;  // If the "mmap" option is provided, files are read through
+  // a memory mapping (see Input::OpenMapped()).
 
   RspecifierOptions(): once(false), sorted(false),
-                       called_sorted(false), permissive(false) { }
+                       called_sorted(false), permissive(false),
+                       background(false), indexed(false),
+                       memory_map(false) { }
 };
 
 enum RspecifierType  {
@@ -212,6 +302,14 @@ enum RspecifierType  {
 RspecifierType ClassifyRspecifier(const std::string &rspecifier, std::string *rxfilename,
                                   RspecifierOptions *opts);
 
+// Splits an rxfilename that is an offset into a file, e.g. "foo.ark:1234"
+// (possibly followed by a range such as "[0:9]"), into the filename and the
+// byte offset; any other rxfilename is output whole, with offset zero.  This is
+// used to put reads in the order in which the data is stored (see
+// RandomAccessTableReader::Prefetch()).
+void SplitRxfilenameOffset(const std::string &rxfilename,
+                           std::string *filename, int64 *offset);
+
 // Class Table<Holder> is useful when you want the entire set of
 // objects in memory.  NOT IMPLEMENTED YET.
 // It is the least scalable way of accessing data in Tables.
@@ -225,7 +323,7 @@ class RandomAccessTableReader {
  public:
   typedef typename Holder::T T;
 
-  RandomAccessTableReader(): impl_(NULL) { }
+  RandomAccessTableReader(): impl_(NULL), stats_(NULL) { }
 
   // This constructor equivalent to default constructor + "open", but
   // throws on error.
@@ -255,18 +353,34 @@ class RandomAccessTableReader {
   // want to catch this error.
   const T &Value(const std::string &key);
 
+  // Prefetch() reads ahead the objects for all of "keys" that are in the
+  // table, for programs that know in advance which keys they will ask for.
+  // For scp files and indexed archives ("ark,idx:"), the objects are read in
+  // the order in which they are stored on disk (sorted by file and byte
+  // offset), which turns random lookups into nearly sequential reads; with
+  // the "bg" option they are read in a separate thread, and Value() only
+  // waits if the object it wants has not been read yet.  HasKey() and
+  // Value() then serve these keys from memory, and the references returned
+  // by Value() for them stay valid until the next call to Prefetch() or
+  // Close() (which free the objects).  It costs the memory for all the
+  // objects, so call it on batches of keys.  For other kinds of rspecifier
+  // it does nothing.
+  void Prefetch(const std::vector<std::string> &keys);
+
   ~RandomAccessTableReader();
 
   // Allow copy-constructor only for non-opened readers (needed for inclusion in
   // stl vector)
   RandomAccessTableReader(const RandomAccessTableReader<Holder> &other):
-      impl_(NULL) { KALDI_ASSERT(other.impl_ == NULL); }
+      impl_(NULL), stats_(NULL) { KALDI_ASSERT(other.impl_ == NULL); }
  private:
   // Disallow assignment.
   RandomAccessTableReader &operator=(const RandomAccessTableReader<Holder>&);
   void CheckImpl() const; // Checks that impl_ is non-NULL; prints an error
                           // message and dies (with KALDI_ERR) if NULL.
   RandomAccessTableReaderImplBase<Holder> *impl_;
+  TableIoStats *stats_;  // Profiling statistics, or NULL (see
+                        // kaldi-table-profile.h).
 };
 
 
@@ -278,7 +392,7 @@ class SequentialTableReader {
  public:
   typedef typename Holder::T T;
 
-  SequentialTableReader(): impl_(NULL) { }
+  SequentialTableReader(): impl_(NULL), stats_(NULL) { }
 
   // This constructor equivalent to default constructor + "open", but
   // throws on error.
@@ -342,13 +456,15 @@ class SequentialTableReader {
   // Allow copy-constructor only for non-opened readers (needed for inclusion in
   // stl vector)
   SequentialTableReader(const SequentialTableReader<Holder> &other):
-      impl_(NULL) { KALDI_ASSERT(other.impl_ == NULL); }
+      impl_(NULL), stats_(NULL) { KALDI_ASSERT(other.impl_ == NULL); }
  private:
   // Disallow assignment.
   SequentialTableReader &operator = (const SequentialTableReader<Holder>&); 
   void CheckImpl() const; // Checks that impl_ is non-NULL; prints an error
                           // message and dies (with KALDI_ERR) if NULL.
   SequentialTableReaderImplBase<Holder> *impl_;
+  TableIoStats *stats_;  // Profiling statistics, or NULL (see
+                        // kaldi-table-profile.h).
 };
 
 
@@ -359,7 +475,7 @@ class TableWriter {
  public:
   typedef typename Holder::T T;
 
-  TableWriter(): impl_(NULL) { }
+  TableWriter(): impl_(NULL), stats_(NULL) { }
 
   // This constructor equivalent to default constructor
   // + "open", but throws on error.  See docs for
@@ -394,7 +510,7 @@ class TableWriter {
   
   // Allow copy-constructor only for non-opened writers (needed for inclusion in
   // stl vector)
-  TableWriter(const TableWriter &other): impl_(NULL) {
+  TableWriter(const TableWriter &other): impl_(NULL), stats_(NULL) {
     KALDI_ASSERT(other.impl_ == NULL);
   }
  private:
@@ -402,6 +518,8 @@ class TableWriter {
   void CheckImpl() const; // Checks that impl_ is non-NULL; prints an error
                           // message and dies (with KALDI_ERR) if NULL.
   TableWriterImplBase<Holder> *impl_;
+  TableIoStats *stats_;  // Profiling statistics, or NULL (see
+                        // kaldi-table-profile.h).
 };
 
 
@@ -0,0 +1,80 @@
+// util/memory-pool-inl.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_MEMORY_POOL_INL_H_
+#define KALDI_UTIL_MEMORY_POOL_INL_H_
+
+// Do not include this file directly.  It is included by memory-pool.h
+
+
+namespace kaldi {
+
+template<class T> MemoryPool<T>::MemoryPool(size_t block_size):
+    block_size_(block_size), cur_block_(0), cur_pos_(0), freed_head_(NULL),
+    num_in_use_(0) {
+  KALDI_ASSERT(block_size > 0);
+}
+
+template<class T>
+inline void *MemoryPool<T>::Allocate() {
+  num_in_use_++;
+  if (freed_head_ != NULL) {
+    Slot *ans = freed_head_;
+    freed_head_ = freed_head_->next;
+    return static_cast<void*>(ans);
+  }
+  if (cur_block_ == blocks_.size())
+    blocks_.push_back(new Slot[block_size_]);
+  Slot *ans = blocks_[cur_block_] + cur_pos_;
+  if (++cur_pos_ == block_size_) {  // move on to the next block; it will be
+    cur_block_++;                   // allocated when we first need it.
+    cur_pos_ = 0;
+  }
+  return static_cast<void*>(ans);
+}
+
+template<class T>
+inline void MemoryPool<T>::Delete(T *t) {
+  KALDI_PARANOID_ASSERT(num_in_use_ > 0);
+  t->~T();
+  Slot *s = reinterpret_cast<Slot*>(t);
+  s->next = freed_head_;
+  freed_head_ = s;
+  num_in_use_--;
+}
+
+template<class T>
+void MemoryPool<T>::Reset() {
+  cur_block_ = 0;
+  cur_pos_ = 0;
+  freed_head_ = NULL;
+  num_in_use_ = 0;
+}
+
+template<class T>
+MemoryPool<T>::~MemoryPool() {
+  for (size_t i = 0; i < blocks_.size(); i++)
+    delete [] blocks_[i];
+}
+
+
+} // end namespace kaldi
+
+#endif
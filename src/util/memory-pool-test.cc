@@ -0,0 +1,80 @@
+// util/memory-pool-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/memory-pool.h"
+#include <set>
+#include <iostream>
+
+namespace kaldi {
+
+struct TestObject {
+  int32 a;
+  float b;
+  TestObject *next;
+  TestObject(int32 a, float b, TestObject *next): a(a), b(b), next(next) { }
+};
+
+void TestMemoryPool() {
+  size_t block_size = 1 + Rand() % 20;
+  MemoryPool<TestObject> pool(block_size);
+
+  for (int32 iter = 0; iter < 5; iter++) {
+    std::vector<TestObject*> objects;
+    int32 num_objects = Rand() % 200;
+    for (int32 i = 0; i < num_objects; i++) {
+      TestObject *obj = new (pool.Allocate()) TestObject(i, 0.5 * i, NULL);
+      objects.push_back(obj);
+      // randomly delete some objects as we go.
+      if (Rand() % 3 == 0) {
+        size_t j = Rand() % objects.size();
+        pool.Delete(objects[j]);
+        objects[j] = objects.back();
+        objects.pop_back();
+      }
+    }
+    KALDI_ASSERT(pool.NumInUse() == objects.size());
+    // make sure no two live objects share storage, and none got overwritten.
+    std::set<TestObject*> seen(objects.begin(), objects.end());
+    KALDI_ASSERT(seen.size() == objects.size());
+    for (size_t i = 0; i < objects.size(); i++)
+      KALDI_ASSERT(objects[i]->b == 0.5 * objects[i]->a);
+
+    size_t num_blocks = pool.NumBlocks();
+    pool.Reset();
+    KALDI_ASSERT(pool.NumInUse() == 0);
+    // after Reset(), allocating the same number of objects again should not
+    // need any more memory from the system.
+    for (size_t i = 0; i < objects.size(); i++)
+      new (pool.Allocate()) TestObject(0, 0.0, NULL);
+    KALDI_ASSERT(pool.NumBlocks() == num_blocks);
+    pool.Reset();
+  }
+}
+
+
+} // end namespace kaldi
+
+
+int main() {
+  using namespace kaldi;
+  for (int32 i = 0; i < 10; i++)
+    TestMemoryPool();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,103 @@
+// util/memory-pool.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef KALDI_UTIL_MEMORY_POOL_H_
+#define KALDI_UTIL_MEMORY_POOL_H_
+#include <vector>
+#include <new>
+#include "base/kaldi-common.h"
+
+
+/* This header provides a simple pooled allocator for small fixed-size objects,
+   of the kind the decoders create and destroy in very large numbers (Tokens
+   and ForwardLinks).  Storage is obtained from the system in large blocks and
+   handed out by incrementing a pointer within the current block; objects that
+   are freed individually go on a free list and are reused first.  Reset()
+   returns all the objects to the pool at once without visiting them, which is
+   what we want at the start and end of each utterance.  Memory is only given
+   back to the system when the pool is destroyed.
+
+   The intended usage is:
+     MemoryPool<Token> pool;
+     Token *tok = new (pool.Allocate()) Token(args...);
+     ...
+     pool.Delete(tok);
+
+   The type T must have a trivial destructor if you use Reset() while objects
+   are still allocated, because their destructors will not be called.  T must
+   not need stricter alignment than double.
+*/
+
+
+namespace kaldi {
+
+template<class T> class MemoryPool {
+ public:
+  /// Constructor.  "block_size" is the number of objects we allocate
+  /// from the system at a time; it should be largish.
+  explicit MemoryPool(size_t block_size = 1024);
+
+  /// Returns uninitialized storage for one object of type T.  You should
+  /// construct the object using placement new.
+  inline void *Allocate();
+
+  /// Destroys the object and returns its storage to the pool.  Think of this
+  /// like calling delete.
+  inline void Delete(T *t);
+
+  /// Returns the storage of all objects to the pool, without calling their
+  /// destructors.  Any pointers the user holds become invalid.  This does not
+  /// free any memory; it only makes it available for reuse.
+  void Reset();
+
+  /// Returns the number of objects currently allocated (i.e. Allocate()
+  /// minus Delete() calls since the last Reset()).
+  size_t NumInUse() const { return num_in_use_; }
+
+  /// Returns the number of blocks we have obtained from the system so far.
+  /// This can be used to monitor how often we actually call the system
+  /// allocator.
+  size_t NumBlocks() const { return blocks_.size(); }
+
+  ~MemoryPool();
+ private:
+  // We put the free-list pointer inside the storage of freed objects.  The
+  // double and the pointer are there to make sure the alignment is adequate.
+  union Slot {
+    Slot *next;
+    double align;
+    char data[sizeof(T)];
+  };
+
+  std::vector<Slot*> blocks_;  // blocks obtained from the system.
+  size_t block_size_;  // number of Slots per block.
+  size_t cur_block_;  // index into blocks_ of block we're allocating from.
+  size_t cur_pos_;  // next unused position in blocks_[cur_block_].
+  Slot *freed_head_;  // head of list of freed Slots.
+  size_t num_in_use_;
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(MemoryPool);
+};
+
+
+} // end namespace kaldi
+
+#include "util/memory-pool-inl.h"
+
+#endif
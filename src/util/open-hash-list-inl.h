@@ -0,0 +1,188 @@
+// util/open-hash-list-inl.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_INL_H_
+
+// Do not include this file directly.  It is included by open-hash-list.h
+
+
+namespace kaldi {
+
+template<class I, class T> OpenHashList<I, T>::OpenHashList() {
+  list_head_ = NULL;
+  list_tail_ = NULL;
+  freed_head_ = NULL;
+  Slot empty;
+  empty.key = I();
+  empty.elem = NULL;
+  slots_.resize(1, empty);
+  mask_ = 0;
+  hash_shift_ = 32;
+}
+
+template<class I, class T> void OpenHashList<I, T>::SetSize(size_t size) {
+  KALDI_ASSERT(list_head_ == NULL && used_slots_.empty());  // make sure empty.
+  size_t num_slots = 1;
+  int32 log2_num_slots = 0;
+  while (num_slots < size) {
+    num_slots *= 2;
+    log2_num_slots++;
+  }
+  KALDI_ASSERT(log2_num_slots <= 32);
+  if (num_slots > slots_.size()) {
+    Slot empty;
+    empty.key = I();
+    empty.elem = NULL;
+    slots_.resize(num_slots, empty);
+    mask_ = num_slots - 1;
+    hash_shift_ = 32 - log2_num_slots;
+  }
+}
+
+template<class I, class T>
+typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Clear() {
+  // Clears the hashtable and gives ownership of the currently contained list
+  // to the user.
+  for (size_t i = 0; i < used_slots_.size(); i++)
+    slots_[used_slots_[i]].elem = NULL;
+  used_slots_.clear();
+  Elem *ans = list_head_;
+  list_head_ = NULL;
+  list_tail_ = NULL;
+  return ans;
+}
+
+template<class I, class T>
+const typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::GetList() const {
+  return list_head_;
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::Delete(Elem *e) {
+  e->tail = freed_head_;
+  freed_head_ = e;
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::Find(I key) {
+  for (size_t index = FirstSlot(key); ; index = (index + 1) & mask_) {
+    const Slot &slot = slots_[index];
+    if (slot.elem == NULL) return NULL;  // Not found.
+    if (slot.key == key) return slot.elem;
+  }
+}
+
+template<class I, class T>
+inline typename OpenHashList<I, T>::Elem* OpenHashList<I, T>::New() {
+  if (freed_head_) {
+    Elem *ans = freed_head_;
+    freed_head_ = freed_head_->tail;
+    return ans;
+  } else {
+    Elem *tmp = new Elem[allocate_block_size_];
+    for (size_t i = 0; i+1 < allocate_block_size_; i++)
+      tmp[i].tail = tmp+i+1;
+    tmp[allocate_block_size_-1].tail = NULL;
+    freed_head_ = tmp;
+    allocated_.push_back(tmp);
+    return this->New();
+  }
+}
+
+template<class I, class T>
+OpenHashList<I, T>::~OpenHashList() {
+  // First test whether we had any memory leak within the
+  // OpenHashList, i.e. things for which the user did not call Delete().
+  size_t num_in_list = 0, num_allocated = 0;
+  for (Elem *e = freed_head_; e != NULL; e = e->tail)
+    num_in_list++;
+  for (size_t i = 0; i < allocated_.size(); i++) {
+    num_allocated += allocate_block_size_;
+    delete[] allocated_[i];
+  }
+  if (num_in_list != num_allocated) {
+    KALDI_WARN << "Possible memory leak: " << num_in_list
+               << " != " << num_allocated
+               << ": you might have forgotten to call Delete on "
+               << "some Elems";
+  }
+}
+
+template<class I, class T>
+inline void OpenHashList<I, T>::AddToTable(Elem *elem) {
+  size_t index = FirstSlot(elem->key);
+  while (slots_[index].elem != NULL)
+    index = (index + 1) & mask_;
+  slots_[index].key = elem->key;
+  slots_[index].elem = elem;
+  used_slots_.push_back(index);
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::Grow() {
+  for (size_t i = 0; i < used_slots_.size(); i++)
+    slots_[used_slots_[i]].elem = NULL;
+  used_slots_.clear();
+  Slot empty;
+  empty.key = I();
+  empty.elem = NULL;
+  KALDI_ASSERT(hash_shift_ > 0);
+  slots_.resize(slots_.size() * 2, empty);
+  mask_ = slots_.size() - 1;
+  hash_shift_--;
+  // Only the first of any elements with the same key goes in the table.
+  for (Elem *e = list_head_; e != NULL; e = e->tail)
+    if (Find(e->key) == NULL)
+      AddToTable(e);
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::Insert(I key, T val) {
+  // Keep the table at most 3/4 full, so the probe sequences stay short.
+  if (4 * (used_slots_.size() + 1) > 3 * slots_.size())
+    Grow();
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = NULL;
+  if (list_tail_ == NULL) list_head_ = elem;
+  else list_tail_->tail = elem;
+  list_tail_ = elem;
+  AddToTable(elem);
+}
+
+template<class I, class T>
+void OpenHashList<I, T>::InsertMore(I key, T val) {
+  Elem *e = Find(key);
+  KALDI_ASSERT(e != NULL); // we assume there is already one element
+  while (e->tail != NULL && e->tail->key == key) e = e->tail;
+  Elem *elem = New();
+  elem->key = key;
+  elem->val = val;
+  elem->tail = e->tail;
+  e->tail = elem;
+  if (list_tail_ == e) list_tail_ = elem;
+}
+
+
+} // end namespace kaldi
+
+#endif
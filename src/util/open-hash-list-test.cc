@@ -0,0 +1,193 @@
+// util/open-hash-list-test.cc
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include "util/open-hash-list.h"
+#include "base/timer.h"
+#include <map> // for baseline.
+#include <cstdlib>
+#include <iostream>
+
+namespace kaldi {
+
+template<class Int, class T> void TestOpenHashList() {
+  typedef typename OpenHashList<Int, T>::Elem Elem;
+
+  OpenHashList<Int, T> hash;
+  hash.SetSize(200);  // must be called before use.
+  std::map<Int, T> m1;
+  for (size_t j = 0; j < 50; j++) {
+    Int key = Rand() % 200;
+    T val = Rand() % 50;
+    m1[key] = val;
+    Elem *e = hash.Find(key);
+    if (e) e->val = val;
+    else  hash.Insert(key, val);
+  }
+
+  std::map<Int, T> m2;
+
+  for (int i = 0; i < 100; i++) {
+    m2.clear();
+    for (typename std::map<Int, T>::const_iterator iter = m1.begin();
+        iter != m1.end();
+        iter++) {
+      m2[iter->first + 1] = iter->second;
+    }
+    std::swap(m1, m2);
+
+    Elem *h = hash.Clear(), *tmp;
+
+    // Sometimes make the table too small, to test that it grows.
+    hash.SetSize(Rand() % 2 == 0 ? 8 : 100 + Rand() % 100);
+
+    std::vector<Int> keys;
+    for (; h != NULL; h = tmp) {
+      hash.Insert(h->key + 1, h->val);
+      keys.push_back(h->key + 1);
+      tmp = h->tail;
+      hash.Delete(h);  // think of this like calling delete.
+    }
+
+    // Now make sure the list is the same as m1, and in insertion order.
+    const Elem *list = hash.GetList();
+    size_t count = 0;
+    for (; list != NULL; list = list->tail, count++) {
+      KALDI_ASSERT(m1[list->key] == list->val);
+      KALDI_ASSERT(list->key == keys[count]);
+    }
+
+    for (size_t j = 0; j < 10; j++) {
+      Int key = Rand() % 200;
+      bool found_m1 = (m1.find(key) != m1.end());
+      Elem *e = hash.Find(key);
+      KALDI_ASSERT( (e != NULL) == found_m1 );
+      if (found_m1)
+        KALDI_ASSERT(m1[key] == e->val);
+    }
+
+    KALDI_ASSERT(m1.size() == count);
+  }
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+void TestOpenHashListInsertMore() {
+  typedef OpenHashList<int32, int32>::Elem Elem;
+  OpenHashList<int32, int32> hash;
+  hash.SetSize(4);
+  for (int32 i = 0; i < 10; i++) {
+    hash.Insert(i, 0);
+    for (int32 j = 1; j < 3; j++)
+      hash.InsertMore(i, j);
+  }
+  hash.InsertMore(5, 3);
+  int32 num_elems = 0;
+  for (const Elem *e = hash.GetList(); e != NULL; e = e->tail, num_elems++) {
+    if (e->tail != NULL)  // elements with the same key are adjacent.
+      KALDI_ASSERT(e->tail->key == e->key || e->tail->key == e->key + 1);
+  }
+  KALDI_ASSERT(num_elems == 31);
+  for (int32 i = 0; i < 10; i++)
+    KALDI_ASSERT(hash.Find(i)->key == i && hash.Find(i)->val == 0);
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+}
+
+
+// Simulates the way the decoders use the hash: on each frame, we clear it,
+// and for each active state we look up a few successor states, inserting them
+// if not present.  The number of active states and the range of state-ids are
+// typical of decoding with a large graph.
+template<class HashType> double TimeHashList(int32 num_active,
+                                             int32 num_frames) {
+  typedef typename HashType::Elem Elem;
+  const int32 num_states = 5000000, arcs_per_state = 4, hash_ratio = 2;
+  std::vector<int32> states(num_active);
+  for (int32 i = 0; i < num_active; i++)
+    states[i] = Rand() % num_states;
+  HashType hash;
+  Timer timer;
+  int64 num_found = 0;
+  for (int32 frame = 0; frame < num_frames; frame++) {
+    Elem *h = hash.Clear(), *tmp;
+    hash.SetSize(num_active * hash_ratio);
+    for (; h != NULL; h = tmp) {
+      tmp = h->tail;
+      hash.Delete(h);
+    }
+    for (int32 i = 0; i < num_active; i++) {
+      int32 base = states[i];
+      for (int32 a = 0; a < arcs_per_state; a++) {
+        int32 next_state = (base + a * 997) % num_states;
+        Elem *e = hash.Find(next_state);
+        if (e == NULL) hash.Insert(next_state, i);
+        else num_found++;
+      }
+      // move the state a little, as the search would.
+      states[i] = (base + 1 + (i % 3)) % num_states;
+    }
+  }
+  double ans = timer.Elapsed();
+  for (Elem *h = hash.Clear(), *tmp; h != NULL; h = tmp) {
+    tmp = h->tail;
+    hash.Delete(h);
+  }
+  KALDI_VLOG(2) << "Found " << num_found << " existing states.";
+  return ans;
+}
+
+void CompareHashListSpeed() {
+  int32 num_frames = 50;
+  int32 active_counts[] = { 1000, 10000, 50000 };
+  for (size_t i = 0; i < sizeof(active_counts) / sizeof(int32); i++) {
+    int32 num_active = active_counts[i];
+    double t_chained = TimeHashList<HashList<int32, int32> >(num_active,
+                                                             num_frames),
+        t_open = TimeHashList<OpenHashList<int32, int32> >(num_active,
+                                                           num_frames);
+    KALDI_LOG << "With " << num_active << " active states, HashList took "
+              << t_chained << " seconds and OpenHashList took " << t_open
+              << " seconds for " << num_frames << " frames.";
+  }
+}
+
+
+} // end namespace kaldi
+
+
+
+int main() {
+  using namespace kaldi;
+  for (size_t i = 0;i < 3;i++) {
+    TestOpenHashList<int, unsigned int>();
+    TestOpenHashList<unsigned int, int>();
+    TestOpenHashList<short int, long int>();
+    TestOpenHashList<short unsigned int, long int>();
+    TestOpenHashList<char, unsigned char>();
+    TestOpenHashList<unsigned char, int>();
+  }
+  TestOpenHashListInsertMore();
+  CompareHashListSpeed();
+  std::cout << "Test OK.\n";
+}
@@ -0,0 +1,158 @@
+// util/open-hash-list.h
+
+// Copyright 2015  The Kaldi Authors
+
+// See ../../COPYING for clarification regarding multiple authors
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//  http://www.apache.org/licenses/LICENSE-2.0
+//
+// THIS CODE IS PROVIDED *AS IS* BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+// KIND, EITHER EXPRESS OR IMPLIED, INCLUDING WITHOUT LIMITATION ANY IMPLIED
+// WARRANTIES OR CONDITIONS OF TITLE, FITNESS FOR A PARTICULAR PURPOSE,
+// MERCHANTABLITY OR NON-INFRINGEMENT.
+// See the Apache 2 License for the specific language governing permissions and
+// limitations under the License.
+
+
+#ifndef KALDI_UTIL_OPEN_HASH_LIST_H_
+#define KALDI_UTIL_OPEN_HASH_LIST_H_
+#include <vector>
+#include "util/stl-utils.h"
+#include "util/hash-list.h"
+
+
+/* This header provides OpenHashList, which has the same interface as HashList
+   (see hash-list.h).  FasterDecoderTpl, LatticeFasterDecoderTpl and
+   LatticeFasterOnlineDecoderTpl can use it for their toks_ member, via their
+   HashListType template argument; the default versions (FasterDecoder etc.)
+   use HashList.  The difference from HashList is in how the hash part is
+   implemented.  HashList has chained
+   buckets, whose elements are found by walking the list of Elems, so a lookup
+   typically touches a bucket and then one or more Elems that are scattered in
+   memory.  OpenHashList uses open addressing with linear probing: each slot of
+   the table holds the key and a pointer to its Elem, so a lookup usually reads
+   a single cache line and only dereferences the Elem it returns.
+
+   The list part is the same as in HashList: a singly-linked list of Elems that
+   survives Clear(), which is what the decoders rely on.  Elements appear in the
+   list in the order they were inserted (InsertMore() puts an element right
+   after the existing elements with the same key).  HashList groups elements by
+   bucket instead; no code relies on that order.
+
+   The table size is always a power of two, and the table grows automatically
+   if it becomes more than 3/4 full, so unlike HashList, inserting more
+   elements than SetSize() was given is not a problem, just slower.
+
+   See open-hash-list-test.cc for an example of how to use this object, and for
+   a comparison of the speed of the two versions.
+*/
+
+
+namespace kaldi {
+
+template<class I, class T> class OpenHashList {
+
+ public:
+  struct Elem {
+    I key;
+    T val;
+    Elem *tail;
+  };
+
+  /// Constructor takes no arguments.  Call SetSize to inform it of the likely size.
+  OpenHashList();
+
+  /// Clears the hash and gives the head of the current list to the user;
+  /// ownership is transferred to the user (the user must call Delete()
+  /// for each element in the list, at his/her leisure).
+  Elem *Clear();
+
+  /// Gives the head of the current list to the user.  Ownership retained in the
+  /// class.
+  const Elem *GetList() const;
+
+  /// Think of this like delete().  It is to be called for each Elem in turn
+  /// after you "obtained ownership" by doing Clear().
+  inline void Delete(Elem *e);
+
+  /// This should probably not be needed to be called directly by the user.
+  /// Think of it as opposite to Delete();
+  inline Elem *New();
+
+  /// Find tries to find this element in the current list using the hashtable.
+  /// It returns NULL if not present.  The Elem it returns is not owned by the
+  /// user, but the user is free to modify the "val" element.
+  inline Elem *Find(I key);
+
+  /// Insert inserts a new element into the hashtable/stored list.  By calling
+  /// this, the user asserts that it is not already present.
+  inline void Insert(I key, T val);
+
+  /// InsertMore inserts another element with the same key into the stored
+  /// list, right after the existing ones.  By calling this, the user asserts
+  /// that one element with that key is already present.  Find() will return
+  /// the first one of the elements with the same key.
+  inline void InsertMore(I key, T val);
+
+  /// SetSize tells the object how many slots to allocate (it is rounded up to
+  /// a power of two, and should typically be at least twice the number of
+  /// objects we expect to go in the structure).  It must be called while the
+  /// hash is empty.
+  void SetSize(size_t sz);
+
+  /// Returns current number of slots.
+  inline size_t Size() { return slots_.size(); }
+
+  ~OpenHashList();
+ private:
+
+  struct Slot {
+    I key;
+    Elem *elem;  // NULL if the slot is empty.
+  };
+
+  // Returns the slot where we start looking for "key".  This is Knuth's
+  // multiplicative hash: we take the top bits of the 32-bit product, because
+  // the low bits of the product only depend on the low bits of the key.
+  inline size_t FirstSlot(I key) const {
+    uint32 product = static_cast<uint32>(key) * 2654435761u;
+    return static_cast<size_t>(static_cast<uint64>(product) >> hash_shift_);
+  }
+
+  // Puts "elem" into the first empty slot for its key.
+  inline void AddToTable(Elem *elem);
+
+  // Doubles the number of slots and re-inserts the current list.
+  void Grow();
+
+  Elem *list_head_;  // head of currently stored list.
+  Elem *list_tail_;  // tail of currently stored list.
+
+  std::vector<Slot> slots_;
+  size_t mask_;  // slots_.size() - 1.
+  int32 hash_shift_;  // 32 - log2(slots_.size()).
+
+  // Indexes of the nonempty slots, so Clear() does not have to visit the
+  // whole table.
+  std::vector<size_t> used_slots_;
+
+  Elem *freed_head_;  // head of list of currently freed elements.
+
+  std::vector<Elem*> allocated_;  // list of allocated blocks.
+
+  static const size_t allocate_block_size_ = 1024;  // Number of Elements to
+  // allocate in one block.
+
+  KALDI_DISALLOW_COPY_AND_ASSIGN(OpenHashList);
+};
+
+
+} // end namespace kaldi
+
+#include "util/open-hash-list-inl.h"
+
+#endif
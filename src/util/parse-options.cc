@@ -31,6 +31,7 @@
 
 #include "util/parse-options.h"
 #include "util/text-utils.h"
+#include "util/kaldi-table-profile.h"
 #include "base/kaldi-common.h"
 
 namespace kaldi {
@@ -38,7 +39,8 @@ namespace kaldi {
 
 ParseOptions::ParseOptions(const std::string &prefix,
                            OptionsItf *other):
-    print_args_(false), help_(false), usage_(""), argc_(0), argv_(NULL) {
+    print_args_(false), help_(false), io_profile_(false), usage_(""),
+    argc_(0), argv_(NULL) {
   ParseOptions *po = dynamic_cast<ParseOptions*>(other);
   if (po != NULL && po->other_parser_ != NULL) {
     // we get here if this constructor is used twice, recursively.
@@ -388,6 +390,9 @@ int ParseOptions::Read(int argc, const char *const argv[]) {
     }
   }
 
+  if (io_profile_)
+    EnableTableIoProfile();
+
   // if the user did not suppress this with --print-args = false....
   if (print_args_) {
     std::ostringstream strm;
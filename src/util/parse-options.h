@@ -36,8 +36,8 @@ namespace kaldi {
 class ParseOptions : public OptionsItf {
  public:
   explicit ParseOptions(const char *usage) :
-    print_args_(true), help_(false), usage_(usage), argc_(0), argv_(NULL),
-    prefix_(""), other_parser_(NULL) {
+    print_args_(true), help_(false), io_profile_(false), usage_(usage),
+    argc_(0), argv_(NULL), prefix_(""), other_parser_(NULL) {
 #ifndef _MSC_VER  // This is just a convenient place to set the stderr to line
     setlinebuf(stderr);  // buffering mode, since it's called at program start.
 #endif  // This helps ensure different programs' output is not mixed up.
@@ -48,6 +48,10 @@ class ParseOptions : public OptionsItf {
     RegisterStandard("help", &help_, "Print out usage message");
     RegisterStandard("verbose", &g_kaldi_verbose_level,
                      "Verbose level (higher->more logging)");
+    RegisterStandard("io-profile", &io_profile_,
+                     "At exit, print a summary of the time spent reading and "
+                     "writing tables (or set the environment variable "
+                     "KALDI_IO_PROFILE=1)");
   }
 
   /**
@@ -217,6 +221,7 @@ class ParseOptions : public OptionsItf {
 
   bool print_args_;     ///< variable for the implicit --print-args parameter
   bool help_;           ///< variable for the implicit --help parameter
+  bool io_profile_;     ///< variable for the implicit --io-profile parameter
   std::string config_;  ///< variable for the implicit --config parameter
   std::vector<std::string> positional_args_;
   const char *usage_;
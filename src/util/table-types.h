@@ -38,6 +38,11 @@ typedef SequentialTableReader<KaldiObjectHolder<Matrix<BaseFloat> > >  Sequentia
 typedef RandomAccessTableReader<KaldiObjectHolder<Matrix<BaseFloat> > >  RandomAccessBaseFloatMatrixReader;
 typedef RandomAccessTableReaderMapped<KaldiObjectHolder<Matrix<BaseFloat> > >  RandomAccessBaseFloatMatrixReaderMapped;
 
+// With the "mmap" rspecifier option, these give access to matrices in the
+// files without copying them; see MatrixViewHolder in kaldi-holder-inl.h.
+typedef SequentialTableReader<MatrixViewHolder>  SequentialBaseFloatMatrixViewReader;
+typedef RandomAccessTableReader<MatrixViewHolder>  RandomAccessBaseFloatMatrixViewReader;
+
 typedef TableWriter<KaldiObjectHolder<Matrix<double> > >  DoubleMatrixWriter;
 typedef SequentialTableReader<KaldiObjectHolder<Matrix<double> > >  SequentialDoubleMatrixReader;
 typedef RandomAccessTableReader<KaldiObjectHolder<Matrix<double> > >  RandomAccessDoubleMatrixReader;